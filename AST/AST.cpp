@@ -10,6 +10,58 @@ const std::string Empty;
 
 namespace monkey::ast {
 
+OperatorType operatorType(TokenType Type) {
+  switch (Type) {
+  case TokenType::PLUS:
+    return OperatorType::PLUS;
+  case TokenType::MINUS:
+    return OperatorType::MINUS;
+  case TokenType::BANG:
+    return OperatorType::BANG;
+  case TokenType::ASTERISK:
+    return OperatorType::ASTERISK;
+  case TokenType::SLASH:
+    return OperatorType::SLASH;
+  case TokenType::LT:
+    return OperatorType::LT;
+  case TokenType::GT:
+    return OperatorType::GT;
+  case TokenType::EQ:
+    return OperatorType::EQ;
+  case TokenType::NOT_EQ:
+    return OperatorType::NOT_EQ;
+  default:
+    return OperatorType::ILLEGAL;
+  }
+}
+
+const char *operatorToString(OperatorType Op) {
+  switch (Op) {
+  case OperatorType::ILLEGAL:
+    return "ILLEGAL";
+  case OperatorType::PLUS:
+    return "+";
+  case OperatorType::MINUS:
+    return "-";
+  case OperatorType::BANG:
+    return "!";
+  case OperatorType::ASTERISK:
+    return "*";
+  case OperatorType::SLASH:
+    return "/";
+  case OperatorType::LT:
+    return "<";
+  case OperatorType::GT:
+    return ">";
+  case OperatorType::EQ:
+    return "==";
+  case OperatorType::NOT_EQ:
+    return "!=";
+  }
+
+  return "UNKNOWN";
+}
+
 Program::Program(std::vector<std::unique_ptr<Statement>> &&Statements)
     : Statements(std::move(Statements)) {}
 
@@ -31,7 +83,7 @@ std::string Program::string() const {
 ASTType Program::type() const { return ASTType::PROGRAM_AST; }
 
 Identifier::Identifier(Token Tok, const std::string &Value)
-    : Tok(Tok), Value(Value) {}
+    : Tok(Tok), Value(Value), Interned(Value) {}
 
 const std::string &Identifier::tokenLiteral() const { return Tok.Literal; }
 
@@ -143,7 +195,8 @@ ASTType FunctionLiteral::type() const { return ASTType::FUNCTION_AST; }
 
 PrefixExpression::PrefixExpression(Token Tok, const std::string &Operator,
                                    std::unique_ptr<Expression> Right)
-    : Tok(Tok), Operator(Operator), Right(std::move(Right)) {}
+    : Tok(Tok), Operator(Operator), Op(operatorType(Tok.Type)),
+      Right(std::move(Right)) {}
 
 const std::string &PrefixExpression::tokenLiteral() const {
   return Tok.Literal;
@@ -163,8 +216,8 @@ ASTType PrefixExpression::type() const { return ASTType::PREFIX_EXPR_AST; }
 InfixExpression::InfixExpression(Token Tok, const std::string &Operator,
                                  std::unique_ptr<Expression> Left,
                                  std::unique_ptr<Expression> Right)
-    : Tok(Tok), Operator(Operator), Left(std::move(Left)),
-      Right(std::move(Right)) {}
+    : Tok(Tok), Operator(Operator), Op(operatorType(Tok.Type)),
+      Left(std::move(Left)), Right(std::move(Right)) {}
 
 const std::string &InfixExpression::tokenLiteral() const { return Tok.Literal; }
 
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <Object/InternedString.h>
 #include <Token/Token.h>
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -29,6 +31,25 @@ enum class ASTType : uint64_t {
   HASH_AST
 };
 
+// The operators of prefix and infix expressions. The parser resolves them so
+// that the compilers and evaluators don't compare the operator strings.
+enum class OperatorType : uint8_t {
+  ILLEGAL,
+  PLUS,
+  MINUS,
+  BANG,
+  ASTERISK,
+  SLASH,
+  LT,
+  GT,
+  EQ,
+  NOT_EQ
+};
+
+// The operator a token stands for, or 'ILLEGAL' if it isn't one.
+OperatorType operatorType(TokenType);
+const char *operatorToString(OperatorType);
+
 struct BlockStatement;
 
 struct Node {
@@ -61,7 +82,6 @@ struct Program : public Node {
 };
 
 struct Identifier : public Expression {
-  Identifier() = default;
   Identifier(Token, const std::string &);
   virtual ~Identifier() = default;
 
@@ -72,6 +92,20 @@ struct Identifier : public Expression {
 
   Token Tok;
   std::string Value;
+  // The name as scopes and symbol tables look it up.
+  object::InternedString Interned;
+
+  // A slot of the environment 'Depth' levels out from the one the identifier
+  // is evaluated in.
+  struct Binding {
+    uint32_t Depth;
+    uint32_t Slot;
+  };
+  // Set by 'evaluator::resolve'. Every scope that declares the name has a
+  // binding, from the innermost outwards, and the last one is a global. A
+  // variable is read from the first binding that has been set, since a 'let'
+  // only shadows outer variables once it has run.
+  std::vector<Binding> Bindings;
 };
 
 struct LetStatement : public Statement {
@@ -148,7 +182,7 @@ struct Boolean : public Expression {
 struct String : public Expression {
   template <typename T>
   explicit String(Token Tok, T &&Value)
-      : Tok(Tok), Value(std::forward<T>(Value)) {}
+      : Tok(Tok), Value(std::forward<T>(Value)), Interned(this->Value) {}
   virtual ~String() = default;
 
   // Node impl.
@@ -158,6 +192,7 @@ struct String : public Expression {
 
   Token Tok;
   const std::string Value;
+  const object::InternedString Interned;
 };
 
 struct FunctionLiteral : public Expression {
@@ -174,6 +209,12 @@ struct FunctionLiteral : public Expression {
   Token Tok;
   std::vector<std::unique_ptr<Identifier>> Parameters;
   std::unique_ptr<BlockStatement> Body;
+  // The number of parameters and other variables of each call, which
+  // 'evaluator::resolve' counts.
+  size_t NumSlots = 0;
+  // The literal that 'evaluator::shareLiteral' moved the parameters and the
+  // body into, for every function made from this one.
+  std::shared_ptr<const FunctionLiteral> Shared;
 };
 
 struct PrefixExpression : public Expression {
@@ -188,6 +229,7 @@ struct PrefixExpression : public Expression {
 
   Token Tok;
   std::string Operator;
+  OperatorType Op = OperatorType::ILLEGAL;
   std::unique_ptr<Expression> Right;
 };
 
@@ -204,6 +246,7 @@ struct InfixExpression : public Expression {
 
   Token Tok;
   std::string Operator;
+  OperatorType Op = OperatorType::ILLEGAL;
   std::unique_ptr<Expression> Left, Right;
 };
 
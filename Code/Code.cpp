@@ -2,9 +2,11 @@
 
 #include <algorithm>
 #include <arpa/inet.h>
+#include <cstring>
 #include <iomanip>
 #include <sstream>
 #include <stdexcept>
+#include <unordered_map>
 
 namespace monkey::code {
 
@@ -24,8 +26,8 @@ std::vector<std::pair<OpCode, Definition>> Definitions = {
     {OpCode::OpGreaterThan, {"OpGreaterThan", {}}},
     {OpCode::OpMinus, {"OpMinus", {}}},
     {OpCode::OpBang, {"OpBang", {}}},
-    {OpCode::OpJumpNotTruthy, {"OpJumpNotTruthy", {2}}},
-    {OpCode::OpJump, {"OpJump", {2}}},
+    {OpCode::OpJumpNotTruthy, {"OpJumpNotTruthy", {4}}},
+    {OpCode::OpJump, {"OpJump", {4}}},
     {OpCode::OpNull, {"OpNull", {}}},
     {OpCode::OpGetGlobal, {"OpGetGlobal", {2}}},
     {OpCode::OpSetGlobal, {"OpSetGlobal", {2}}},
@@ -39,7 +41,20 @@ std::vector<std::pair<OpCode, Definition>> Definitions = {
     {OpCode::OpSetLocal, {"OpSetLocal", {1}}},
     {OpCode::OpGetBuiltIn, {"OpGetBuiltIn", {1}}},
     {OpCode::OpClosure, {"OpClosure", {2, 1}}},
-    {OpCode::OpGetFree, {"OpGetFree", {1}}}};
+    {OpCode::OpGetFree, {"OpGetFree", {1}}},
+    {OpCode::OpAddLocalConst, {"OpAddLocalConst", {1, 2}}},
+    {OpCode::OpSubLocalConst, {"OpSubLocalConst", {1, 2}}},
+    {OpCode::OpJumpIfLocalNotEqConst, {"OpJumpIfLocalNotEqConst", {1, 2, 4}}},
+    {OpCode::OpCallKnown, {"OpCallKnown", {2, 1}}},
+    {OpCode::OpTailCall, {"OpTailCall", {1}}},
+    {OpCode::OpTailCallKnown, {"OpTailCallKnown", {2, 1}}},
+    {OpCode::OpIndexConst, {"OpIndexConst", {2, 2}}},
+    {OpCode::OpExtendArg, {"OpExtendArg", {2}}},
+    {OpCode::OpHalt, {"OpHalt", {}}}};
+
+const unsigned int EXTEND_ARG_SHIFT = 16;
+const int EXTEND_ARG_LIMIT = 1 << EXTEND_ARG_SHIFT;
+
 
 } // namespace
 
@@ -86,6 +101,10 @@ Instructions::fmtInstructions(const Definition &Def,
   case 2:
     return Def.Name + " " + std::to_string(Operands.front()) + " " +
            std::to_string(Operands.at(1));
+  case 3:
+    return Def.Name + " " + std::to_string(Operands.front()) + " " +
+           std::to_string(Operands.at(1)) + " " +
+           std::to_string(Operands.at(2));
   }
 
   return std::string("ERROR: unhandled operandCount for ") + Def.Name + "\n";
@@ -114,6 +133,20 @@ std::vector<char> make(OpCode Op, const std::vector<int> &Operands) {
   if (Iter == Definitions.end())
     return {};
 
+  // Operands that don't fit into two bytes are split. The upper bits go into an
+  // 'OpExtendArg' prefix and the lower bits into the instruction itself.
+  const auto &Widths = Iter->second.OperandWidths;
+  if (!Operands.empty() && Widths.front() == 2 &&
+      Operands.front() >= EXTEND_ARG_LIMIT) {
+    auto Prefix =
+        make(OpCode::OpExtendArg, {Operands.front() >> EXTEND_ARG_SHIFT});
+    auto LowOperands = Operands;
+    LowOperands.front() &= EXTEND_ARG_LIMIT - 1;
+    const auto Instruction = make(Op, LowOperands);
+    Prefix.insert(Prefix.end(), Instruction.begin(), Instruction.end());
+    return Prefix;
+  }
+
   unsigned int InstructionLen = 1;
   for (const auto W : Iter->second.OperandWidths)
     InstructionLen += W;
@@ -128,11 +161,17 @@ std::vector<char> make(OpCode Op, const std::vector<int> &Operands) {
     case 1:
       Instruction.at(Offset) = Operands.at(I);
       break;
-    case 2:
+    case 2: {
       int16_t &WritePos = reinterpret_cast<int16_t &>(Instruction.at(Offset));
       WritePos = htons(Operands.at(I));
       break;
     }
+    case 4: {
+      const uint32_t Val = htonl(Operands.at(I));
+      std::memcpy(&Instruction.at(Offset), &Val, sizeof(Val));
+      break;
+    }
+    }
 
     Offset += Width;
   }
@@ -142,6 +181,12 @@ std::vector<char> make(OpCode Op, const std::vector<int> &Operands) {
 
 std::pair<std::vector<int>, int> readOperands(const Definition &Def,
                                               const Instructions &Ins) {
+  return readOperands(Def, Ins, 0);
+}
+
+std::pair<std::vector<int>, int> readOperands(const Definition &Def,
+                                              const Instructions &Ins,
+                                              unsigned int Start) {
   std::vector<int> Operands(Def.OperandWidths.size(), 0);
   int Offset = 0;
 
@@ -149,12 +194,21 @@ std::pair<std::vector<int>, int> readOperands(const Definition &Def,
     const auto Width = Def.OperandWidths.at(I);
     switch (Width) {
     case 2: {
-      const auto Val = reinterpret_cast<const uint16_t &>(Ins.Value.at(Offset));
+      const auto Val =
+          reinterpret_cast<const uint16_t &>(Ins.Value.at(Start + Offset));
       Operands.at(I) = ntohs(Val);
       break;
     }
+    case 4: {
+      // Jump targets aren't aligned, so they are copied out.
+      uint32_t Val;
+      std::memcpy(&Val, &Ins.Value.at(Start + Offset), sizeof(Val));
+      Operands.at(I) = ntohl(Val);
+      break;
+    }
     case 1:
-      Operands.at(I) = reinterpret_cast<const uint8_t &>(Ins.Value.at(Offset));
+      Operands.at(I) =
+          reinterpret_cast<const uint8_t &>(Ins.Value.at(Start + Offset));
       break;
     }
 
@@ -164,4 +218,77 @@ std::pair<std::vector<int>, int> readOperands(const Definition &Def,
   return {Operands, Offset};
 }
 
+int jumpOperand(OpCode Op) {
+  switch (Op) {
+  case OpCode::OpJump:
+  case OpCode::OpJumpNotTruthy:
+    return 0;
+  case OpCode::OpJumpIfLocalNotEqConst:
+    return 2;
+  default:
+    return -1;
+  }
+}
+
+DecodedInstructions decode(const Instructions &Ins) {
+  DecodedInstructions Decoded;
+  Decoded.Value.reserve(Ins.Value.size() + 1);
+
+  // Byte offset of each instruction to its word offset in the decoded stream.
+  std::unordered_map<int, int> Offsets;
+  std::vector<size_t> Jumps;
+  int Extended = 0;
+  int Start = 0;
+
+  unsigned int I = 0;
+  while (I < Ins.Value.size()) {
+    const auto Op = static_cast<OpCode>(Ins.Value.at(I));
+    const auto &Def = lookup(Ins.Value.at(I));
+    auto Operands = readOperands(Def, Ins, I + 1);
+
+    // Jumps should land on the prefix rather than the instruction it extends.
+    if (!Extended)
+      Start = I;
+
+    I += Operands.second + 1;
+
+    if (Op == OpCode::OpExtendArg) {
+      Extended = Operands.first.front() << EXTEND_ARG_SHIFT;
+      continue;
+    }
+
+    if (Extended) {
+      Operands.first.front() |= Extended;
+      Extended = 0;
+    }
+
+    Offsets[Start] = Decoded.Value.size();
+    const auto JumpOperand = jumpOperand(Op);
+    if (JumpOperand >= 0)
+      Jumps.push_back(Decoded.Value.size() + 1 + JumpOperand);
+
+    if (Op == OpCode::OpIndexConst)
+      Decoded.NumIndexCaches =
+          std::max(Decoded.NumIndexCaches, Operands.first.at(1) + 1);
+
+    Decoded.Value.push_back(static_cast<Word>(Op));
+    for (const auto Operand : Operands.first)
+      Decoded.Value.push_back(Operand);
+  }
+
+  Offsets[Ins.Value.size()] = Decoded.Value.size();
+  Decoded.Value.push_back(static_cast<Word>(OpCode::OpHalt));
+
+  for (const auto J : Jumps) {
+    const auto Target = Offsets.find(Decoded.Value.at(J));
+    if (Target == Offsets.end())
+      throw std::runtime_error("jump to the middle of an instruction: " +
+                               std::to_string(Decoded.Value.at(J)));
+
+    Decoded.Value.at(J) = Target->second;
+  }
+
+  return Decoded;
+}
+
 } // namespace monkey::code
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -48,7 +49,16 @@ enum class OpCode : char {
   OpSetLocal,
   OpGetBuiltIn,
   OpClosure,
-  OpGetFree
+  OpGetFree,
+  OpAddLocalConst,
+  OpSubLocalConst,
+  OpJumpIfLocalNotEqConst,
+  OpCallKnown,
+  OpTailCall,
+  OpTailCallKnown,
+  OpIndexConst,
+  OpExtendArg,
+  OpHalt
 };
 
 struct Definition {
@@ -60,5 +70,25 @@ const Definition &lookup(char);
 std::vector<char> make(OpCode, const std::vector<int> &);
 std::pair<std::vector<int>, int> readOperands(const Definition &,
                                               const Instructions &);
+std::pair<std::vector<int>, int>
+readOperands(const Definition &, const Instructions &, unsigned int);
+
+// Index of the operand holding the target of a jump instruction or -1 if the
+// instruction doesn't jump. Jump targets are four bytes wide and never take an
+// 'OpExtendArg' prefix, so patching a target doesn't change the size of a jump.
+int jumpOperand(OpCode);
+
+// The format that the VM executes. Every instruction is an opcode word followed
+// by one word per operand, all in host byte order. Jump operands are word
+// offsets into the decoded stream and the stream always ends with 'OpHalt'.
+using Word = intptr_t;
+
+struct DecodedInstructions {
+  std::vector<Word> Value;
+  // One more than the highest inline cache of an 'OpIndexConst'.
+  int NumIndexCaches = 0;
+};
+
+DecodedInstructions decode(const Instructions &);
 
 } // namespace monkey::code
@@ -18,7 +18,14 @@ TEST(CodeTests, testMake) {
           {OpCode::OpClosure,
            {65534, 255},
            {static_cast<char>(OpCode::OpClosure), static_cast<char>(255),
-            static_cast<char>(254), static_cast<char>(255)}}};
+            static_cast<char>(254), static_cast<char>(255)}},
+          {OpCode::OpConstant,
+           {65536 * 3 + 2},
+           {static_cast<char>(OpCode::OpExtendArg), 0, 3,
+            static_cast<char>(OpCode::OpConstant), 0, 2}},
+          {OpCode::OpJump,
+           {65536 * 3 + 2},
+           {static_cast<char>(OpCode::OpJump), 0, 3, 0, 2}}};
 
   for (const auto &Test : Tests) {
     const auto &Op = std::get<0>(Test);
@@ -57,7 +64,9 @@ TEST(CodeTests, testReadOperands) {
   const std::vector<std::tuple<OpCode, std::vector<int>, int>> Tests = {
       {OpCode::OpConstant, {65535}, 2},
       {OpCode::OpGetLocal, {255}, 1},
-      {OpCode::OpClosure, {65535, 255}, 3}};
+      {OpCode::OpClosure, {65535, 255}, 3},
+      {OpCode::OpJump, {65536 * 3 + 2}, 4},
+      {OpCode::OpJumpIfLocalNotEqConst, {255, 65535, 65536}, 7}};
 
   for (const auto &Test : Tests) {
     const auto Op = std::get<0>(Test);
@@ -80,4 +89,35 @@ TEST(CodeTests, testReadOperands) {
   }
 }
 
+TEST(CodeTests, testDecode) {
+  const std::vector<Instructions> Ins = {
+      make(OpCode::OpConstant, {1}),   make(OpCode::OpJumpNotTruthy, {16}),
+      make(OpCode::OpGetLocal, {255}), make(OpCode::OpConstant, {65536 + 5}),
+      make(OpCode::OpJump, {10}),      make(OpCode::OpPop, {})};
+
+  Instructions Concatted;
+  for (const auto &I : Ins)
+    std::copy(I.Value.begin(), I.Value.end(),
+              std::back_inserter(Concatted.Value));
+
+  // Jump targets are translated to word offsets and the 'OpExtendArg' prefix
+  // is folded into the operand of the instruction that follows it.
+  const std::vector<Word> Expected = {
+      static_cast<Word>(OpCode::OpConstant),
+      1,
+      static_cast<Word>(OpCode::OpJumpNotTruthy),
+      8,
+      static_cast<Word>(OpCode::OpGetLocal),
+      255,
+      static_cast<Word>(OpCode::OpConstant),
+      65536 + 5,
+      static_cast<Word>(OpCode::OpJump),
+      6,
+      static_cast<Word>(OpCode::OpPop),
+      static_cast<Word>(OpCode::OpHalt)};
+
+  const auto Decoded = decode(Concatted);
+  EXPECT_EQ(Decoded.Value, Expected);
+}
+
 } // namespace monkey::code::test
@@ -0,0 +1,111 @@
+#include "RegisterCode.h"
+
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace monkey::code {
+
+namespace {
+
+using K = OperandKind;
+
+// Indexed by 'RegOpCode'.
+const std::vector<RegisterDefinition> RegisterDefinitions = {
+    {"OpLoadConstant", {K::REGISTER, K::CONSTANT}},
+    {"OpLoadTrue", {K::REGISTER}},
+    {"OpLoadFalse", {K::REGISTER}},
+    {"OpLoadNull", {K::REGISTER}},
+    {"OpMove", {K::REGISTER, K::REGISTER}},
+    {"OpGetGlobal", {K::REGISTER, K::INDEX}},
+    {"OpSetGlobal", {K::INDEX, K::REGISTER}},
+    {"OpGetBuiltIn", {K::REGISTER, K::INDEX}},
+    {"OpGetFree", {K::REGISTER, K::INDEX}},
+    {"OpAdd", {K::REGISTER, K::REGISTER_OR_CONSTANT, K::REGISTER_OR_CONSTANT}},
+    {"OpSub", {K::REGISTER, K::REGISTER_OR_CONSTANT, K::REGISTER_OR_CONSTANT}},
+    {"OpMul", {K::REGISTER, K::REGISTER_OR_CONSTANT, K::REGISTER_OR_CONSTANT}},
+    {"OpDiv", {K::REGISTER, K::REGISTER_OR_CONSTANT, K::REGISTER_OR_CONSTANT}},
+    {"OpEqual",
+     {K::REGISTER, K::REGISTER_OR_CONSTANT, K::REGISTER_OR_CONSTANT}},
+    {"OpNotEqual",
+     {K::REGISTER, K::REGISTER_OR_CONSTANT, K::REGISTER_OR_CONSTANT}},
+    {"OpGreaterThan",
+     {K::REGISTER, K::REGISTER_OR_CONSTANT, K::REGISTER_OR_CONSTANT}},
+    {"OpMinus", {K::REGISTER, K::REGISTER}},
+    {"OpBang", {K::REGISTER, K::REGISTER}},
+    {"OpJump", {K::TARGET}},
+    {"OpJumpIfFalse", {K::REGISTER, K::TARGET}},
+    {"OpJumpIfNotEqual",
+     {K::REGISTER_OR_CONSTANT, K::REGISTER_OR_CONSTANT, K::TARGET}},
+    {"OpJumpIfEqual",
+     {K::REGISTER_OR_CONSTANT, K::REGISTER_OR_CONSTANT, K::TARGET}},
+    {"OpJumpIfNotGreater",
+     {K::REGISTER_OR_CONSTANT, K::REGISTER_OR_CONSTANT, K::TARGET}},
+    {"OpArray", {K::REGISTER, K::REGISTER, K::INDEX}},
+    {"OpHash", {K::REGISTER, K::REGISTER, K::INDEX}},
+    {"OpIndex", {K::REGISTER, K::REGISTER, K::REGISTER_OR_CONSTANT}},
+    {"OpCall", {K::REGISTER, K::REGISTER, K::INDEX}},
+    {"OpReturn", {K::REGISTER_OR_CONSTANT}},
+    {"OpReturnNull", {}},
+    {"OpClosure", {K::REGISTER, K::CONSTANT, K::REGISTER, K::INDEX}},
+    {"OpHalt", {}}};
+
+std::string fmtOperand(OperandKind Kind, Word Operand) {
+  switch (Kind) {
+  case K::REGISTER:
+    return "r" + std::to_string(Operand);
+  case K::REGISTER_OR_CONSTANT:
+    if (isConstantOperand(Operand))
+      return "k" + std::to_string(~Operand);
+    return "r" + std::to_string(Operand);
+  case K::CONSTANT:
+    return "k" + std::to_string(Operand);
+  case K::INDEX:
+  case K::TARGET:
+    break;
+  }
+
+  return std::to_string(Operand);
+}
+
+} // namespace
+
+std::string RegisterInstructions::string() const {
+  std::stringstream SS;
+
+  for (unsigned int I = 0; I < Value.size();) {
+    const auto &Def = lookup(static_cast<RegOpCode>(Value.at(I)));
+    SS << std::setfill('0') << std::setw(4) << I << " " << Def.Name;
+
+    for (unsigned int J = 0; J < Def.Operands.size(); ++J)
+      SS << " " << fmtOperand(Def.Operands.at(J), Value.at(I + 1 + J));
+    SS << "\n";
+
+    I += Def.Operands.size() + 1;
+  }
+
+  return SS.str();
+}
+
+const RegisterDefinition &lookup(RegOpCode Op) {
+  const auto Index = static_cast<size_t>(Op);
+  if (Index >= RegisterDefinitions.size())
+    throw std::runtime_error("register opcode " + std::to_string(Index) +
+                             " undefined");
+
+  return RegisterDefinitions.at(Index);
+}
+
+std::vector<Word> make(RegOpCode Op, const std::vector<Word> &Operands) {
+  const auto &Def = lookup(Op);
+  if (Operands.size() != Def.Operands.size())
+    throw std::runtime_error("wrong number of operands for " + Def.Name);
+
+  std::vector<Word> Instruction;
+  Instruction.reserve(Operands.size() + 1);
+  Instruction.push_back(static_cast<Word>(Op));
+  Instruction.insert(Instruction.end(), Operands.begin(), Operands.end());
+  return Instruction;
+}
+
+} // namespace monkey::code
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Code.h"
+
+#include <string>
+#include <vector>
+
+namespace monkey::code {
+
+// Instruction set of the register VM. Every instruction is an opcode word
+// followed by one word per operand. Operands address slots in the current
+// frame's register window directly instead of going through a stack.
+//
+// Operands of kind 'REGISTER_OR_CONSTANT' hold a register index if they are
+// non-negative and the constant '~Operand' otherwise.
+enum class RegOpCode : uint8_t {
+  OpLoadConstant,
+  OpLoadTrue,
+  OpLoadFalse,
+  OpLoadNull,
+  OpMove,
+  OpGetGlobal,
+  OpSetGlobal,
+  OpGetBuiltIn,
+  OpGetFree,
+  OpAdd,
+  OpSub,
+  OpMul,
+  OpDiv,
+  OpEqual,
+  OpNotEqual,
+  OpGreaterThan,
+  OpMinus,
+  OpBang,
+  OpJump,
+  OpJumpIfFalse,
+  OpJumpIfNotEqual,
+  OpJumpIfEqual,
+  OpJumpIfNotGreater,
+  OpArray,
+  OpHash,
+  OpIndex,
+  OpCall,
+  OpReturn,
+  OpReturnNull,
+  OpClosure,
+  OpHalt
+};
+
+enum class OperandKind {
+  REGISTER,
+  REGISTER_OR_CONSTANT,
+  CONSTANT,
+  INDEX,
+  TARGET
+};
+
+struct RegisterDefinition {
+  std::string Name;
+  std::vector<OperandKind> Operands;
+};
+
+struct RegisterInstructions {
+  std::string string() const;
+
+  std::vector<Word> Value;
+};
+
+const RegisterDefinition &lookup(RegOpCode);
+std::vector<Word> make(RegOpCode, const std::vector<Word> &);
+
+inline Word constantOperand(int Index) { return ~static_cast<Word>(Index); }
+inline bool isConstantOperand(Word Operand) { return Operand < 0; }
+
+} // namespace monkey::code
@@ -1,13 +1,17 @@
 #include "Compiler.h"
 
+#include <Compiler/ConstantFolding.h>
+#include <Compiler/Peephole.h>
 #include <Object/BuiltIns.h>
 
+#include <cassert>
+
 namespace monkey::compiler {
 
-Compiler::Compiler(SymbolTable &SymTable,
-                   std::vector<std::shared_ptr<object::Object>> &Constants)
+Compiler::Compiler(SymbolTable &SymTable, std::vector<object::Value> &Constants)
     : ScopeIndex(0), GlobalSymTable(SymTable), SymTable(&GlobalSymTable),
-      Constants(Constants) {
+      Constants(Constants), Pool(Constants), FoldConstants(true),
+      TopLevelStatement(nullptr) {
   // Main scope.
   Scopes.emplace_back();
 
@@ -16,23 +20,33 @@ Compiler::Compiler(SymbolTable &SymTable,
 }
 
 void Compiler::compile(const ast::Node *Node) {
-  const auto *Program = ast::astCast<const ast::Program *>(Node);
-  if (Program) {
-    for (const auto &Statement : Program->Statements)
+  // Expressions the parser gave up on are missing.
+  if (!Node)
+    return;
+
+  switch (Node->type()) {
+  case ast::ASTType::PROGRAM_AST: {
+    const auto *Program = static_cast<const ast::Program *>(Node);
+    if (FoldConstants)
+      foldConstants(const_cast<ast::Program &>(*Program));
+
+    for (const auto &Statement : Program->Statements) {
+      TopLevelStatement = Statement.get();
       compile(Statement.get());
+    }
     return;
   }
 
-  const auto *ExprS = ast::astCast<const ast::ExpressionStatement *>(Node);
-  if (ExprS) {
+  case ast::ASTType::EXPR_STATEMENT_AST: {
+    const auto *ExprS = static_cast<const ast::ExpressionStatement *>(Node);
     compile(ExprS->Expr.get());
     emit(code::OpCode::OpPop, {});
     return;
   }
 
-  const auto *InfixExpr = ast::astCast<const ast::InfixExpression *>(Node);
-  if (InfixExpr) {
-    if (InfixExpr->Operator == "<") {
+  case ast::ASTType::INFIX_EXPR_AST: {
+    const auto *InfixExpr = static_cast<const ast::InfixExpression *>(Node);
+    if (InfixExpr->Op == ast::OperatorType::LT) {
       compile(InfixExpr->Right.get());
       compile(InfixExpr->Left.get());
       emit(code::OpCode::OpGreaterThan, {});
@@ -42,42 +56,69 @@ void Compiler::compile(const ast::Node *Node) {
     compile(InfixExpr->Left.get());
     compile(InfixExpr->Right.get());
 
-    if (InfixExpr->Operator == "+")
+    switch (InfixExpr->Op) {
+    case ast::OperatorType::PLUS:
       emit(code::OpCode::OpAdd, {});
-    else if (InfixExpr->Operator == "-")
+      return;
+    case ast::OperatorType::MINUS:
       emit(code::OpCode::OpSub, {});
-    else if (InfixExpr->Operator == "*")
+      return;
+    case ast::OperatorType::ASTERISK:
       emit(code::OpCode::OpMul, {});
-    else if (InfixExpr->Operator == "/")
+      return;
+    case ast::OperatorType::SLASH:
       emit(code::OpCode::OpDiv, {});
-    else if (InfixExpr->Operator == ">")
+      return;
+    case ast::OperatorType::GT:
       emit(code::OpCode::OpGreaterThan, {});
-    else if (InfixExpr->Operator == "==")
+      return;
+    case ast::OperatorType::EQ:
       emit(code::OpCode::OpEqual, {});
-    else if (InfixExpr->Operator == "!=")
+      return;
+    case ast::OperatorType::NOT_EQ:
       emit(code::OpCode::OpNotEqual, {});
-    else
+      return;
+    default:
       throw std::runtime_error(
           std::string("unknown operator " + InfixExpr->Operator));
-
-    return;
+    }
   }
 
-  const auto *PrefixE = ast::astCast<const ast::PrefixExpression *>(Node);
-  if (PrefixE) {
+  case ast::ASTType::PREFIX_EXPR_AST: {
+    const auto *PrefixE = static_cast<const ast::PrefixExpression *>(Node);
     compile(PrefixE->Right.get());
 
-    if (PrefixE->Operator == "!")
+    switch (PrefixE->Op) {
+    case ast::OperatorType::BANG:
       emit(code::OpCode::OpBang, {});
-    else if (PrefixE->Operator == "-")
+      return;
+    case ast::OperatorType::MINUS:
       emit(code::OpCode::OpMinus, {});
-    else
+      return;
+    default:
       throw std::runtime_error("unknown operator " + PrefixE->Operator);
-    return;
+    }
   }
 
-  const auto *IfE = ast::astCast<const ast::IfExpression *>(Node);
-  if (IfE) {
+  case ast::ASTType::IF_AST: {
+    const auto *IfE = static_cast<const ast::IfExpression *>(Node);
+    // Only the branch that can be taken is compiled for literal conditions.
+    const auto Constant =
+        FoldConstants ? constantCondition(*IfE) : std::nullopt;
+    if (Constant) {
+      const auto *Branch =
+          *Constant ? IfE->Consequence.get() : IfE->Alternative.get();
+      if (!Branch) {
+        emit(code::OpCode::OpNull, {});
+        return;
+      }
+
+      compile(Branch);
+      if (lastInstructionIs(code::OpCode::OpPop))
+        removeLastPop();
+      return;
+    }
+
     compile(IfE->Condition.get());
 
     // Emit an 'OpJumpNotTruthy' with a bogus value.
@@ -108,18 +149,24 @@ void Compiler::compile(const ast::Node *Node) {
     return;
   }
 
-  const auto *Block = ast::astCast<const ast::BlockStatement *>(Node);
-  if (Block) {
+  case ast::ASTType::BLOCK_AST: {
+    const auto *Block = static_cast<const ast::BlockStatement *>(Node);
     for (const auto &Statement : Block->Statements)
       compile(Statement.get());
 
     return;
   }
 
-  const auto *Let = ast::astCast<const ast::LetStatement *>(Node);
-  if (Let) {
-    const auto &Symbol = SymTable->define(Let->Name->Value);
-    compile(Let->Value.get());
+  case ast::ASTType::LET_AST: {
+    const auto *Let = static_cast<const ast::LetStatement *>(Node);
+    const auto &Symbol = SymTable->define(Let->Name->Interned);
+    // Only a top-level 'let' is known to run exactly once.
+    const auto *FunctionL =
+        ast::astCast<ast::FunctionLiteral *>(Let->Value.get());
+    if (FunctionL && Node == TopLevelStatement)
+      compileKnownFunction(Symbol.Index, *FunctionL);
+    else
+      compile(Let->Value.get());
     if (Symbol.Scope == SymbolScope::GLOBAL_SCOPE)
       emit(code::OpCode::OpSetGlobal, {Symbol.Index});
     else
@@ -127,9 +174,9 @@ void Compiler::compile(const ast::Node *Node) {
     return;
   }
 
-  const auto *Identifier = ast::astCast<const ast::Identifier *>(Node);
-  if (Identifier) {
-    const auto *Symbol = SymTable->resolve(Identifier->Value);
+  case ast::ASTType::IDENTIFIER_AST: {
+    const auto *Identifier = static_cast<const ast::Identifier *>(Node);
+    const auto *Symbol = SymTable->resolve(Identifier->Interned);
     if (!Symbol)
       throw std::runtime_error("undefined variable " + Identifier->Value);
 
@@ -137,8 +184,8 @@ void Compiler::compile(const ast::Node *Node) {
     return;
   }
 
-  const auto *Bool = ast::astCast<const ast::Boolean *>(Node);
-  if (Bool) {
+  case ast::ASTType::BOOLEAN_AST: {
+    const auto *Bool = static_cast<const ast::Boolean *>(Node);
     if (Bool->Value)
       emit(code::OpCode::OpTrue, {});
     else
@@ -146,22 +193,22 @@ void Compiler::compile(const ast::Node *Node) {
     return;
   }
 
-  const auto *IntegerL = ast::astCast<const ast::IntegerLiteral *>(Node);
-  if (IntegerL) {
+  case ast::ASTType::INTEGER_AST: {
+    const auto *IntegerL = static_cast<const ast::IntegerLiteral *>(Node);
     auto Integer = object::makeInteger(IntegerL->Value);
     emit(code::OpCode::OpConstant, {addConstant(std::move(Integer))});
     return;
   }
 
-  const auto *StringL = ast::astCast<const ast::String *>(Node);
-  if (StringL) {
-    auto String = object::makeString(StringL->Value);
+  case ast::ASTType::STRING_AST: {
+    const auto *StringL = static_cast<const ast::String *>(Node);
+    auto String = object::makeString(StringL->Interned);
     emit(code::OpCode::OpConstant, {addConstant(std::move(String))});
     return;
   }
 
-  const auto *ArrayL = ast::astCast<const ast::ArrayLiteral *>(Node);
-  if (ArrayL) {
+  case ast::ASTType::ARRAY_AST: {
+    const auto *ArrayL = static_cast<const ast::ArrayLiteral *>(Node);
     for (const auto &Elem : ArrayL->Elements)
       compile(Elem.get());
 
@@ -169,8 +216,8 @@ void Compiler::compile(const ast::Node *Node) {
     return;
   }
 
-  const auto *HashL = ast::astCast<const ast::HashLiteral *>(Node);
-  if (HashL) {
+  case ast::ASTType::HASH_AST: {
+    const auto *HashL = static_cast<const ast::HashLiteral *>(Node);
     std::vector<std::pair<ast::Expression *, ast::Expression *>> Keys;
     for (const auto &K : HashL->Pairs)
       Keys.emplace_back(K.first.get(), K.second.get());
@@ -190,53 +237,44 @@ void Compiler::compile(const ast::Node *Node) {
     return;
   }
 
-  const auto *Index = ast::astCast<const ast::IndexExpression *>(Node);
-  if (Index) {
+  case ast::ASTType::INDEX_AST: {
+    const auto *Index = static_cast<const ast::IndexExpression *>(Node);
     compile(Index->Left.get());
     compile(Index->Index.get());
     emit(code::OpCode::OpIndex, {});
     return;
   }
 
-  const auto *FunctionL = ast::astCast<ast::FunctionLiteral *>(Node);
-  if (FunctionL) {
-    enterScope();
-    for (const auto &P : FunctionL->Parameters)
-      SymTable->define(P->Value);
-
-    compile(FunctionL->Body.get());
-
-    if (lastInstructionIs(code::OpCode::OpPop))
-      replaceLastPopWithReturn();
-
-    if (!lastInstructionIs(code::OpCode::OpReturnValue))
-      emit(code::OpCode::OpReturn, {});
-
-    const auto FreeSymbols = SymTable->FreeSymbols;
-    const auto NumLocals = SymTable->NumDefinitions;
-    auto Ins = leaveScope();
-
+  case ast::ASTType::FUNCTION_AST: {
+    const auto *FunctionL = static_cast<const ast::FunctionLiteral *>(Node);
+    const auto [CompiledFn, FreeSymbols] = compileFunction(*FunctionL);
     for (const auto &Sym : FreeSymbols)
       loadSymbol(Sym);
 
-    auto CompiledFn = std::make_unique<object::CompiledFunction>(
-        std::move(Ins), NumLocals, FunctionL->Parameters.size());
-
-    const auto FnIndex = addConstant(std::move(CompiledFn));
+    const auto FnIndex = addConstant(CompiledFn);
     emit(code::OpCode::OpClosure,
          {FnIndex, static_cast<int>(FreeSymbols.size())});
     return;
   }
 
-  const auto *Return = ast::astCast<const ast::ReturnStatement *>(Node);
-  if (Return) {
+  case ast::ASTType::RETURN_AST: {
+    const auto *Return = static_cast<const ast::ReturnStatement *>(Node);
     compile(Return->ReturnValue.get());
     emit(code::OpCode::OpReturnValue, {});
     return;
   }
 
-  const auto *Call = ast::astCast<const ast::CallExpression *>(Node);
-  if (Call) {
+  case ast::ASTType::CALL_AST: {
+    const auto *Call = static_cast<const ast::CallExpression *>(Node);
+    if (const auto *Known = knownFunction(*Call)) {
+      for (const auto &A : Call->Arguments)
+        compile(A.get());
+
+      emit(code::OpCode::OpCallKnown,
+           {Known->Closure, static_cast<int>(Call->Arguments.size())});
+      return;
+    }
+
     compile(Call->Function.get());
     for (const auto &A : Call->Arguments)
       compile(A.get());
@@ -244,10 +282,76 @@ void Compiler::compile(const ast::Node *Node) {
     emit(code::OpCode::OpCall, {static_cast<int>(Call->Arguments.size())});
     return;
   }
+  }
+}
+
+std::pair<object::CompiledFunction *, std::vector<Symbol>>
+Compiler::compileFunction(const ast::FunctionLiteral &FunctionL) {
+  enterScope();
+  for (const auto &P : FunctionL.Parameters)
+    SymTable->define(P->Interned);
+
+  compile(FunctionL.Body.get());
+
+  if (lastInstructionIs(code::OpCode::OpPop))
+    replaceLastPopWithReturn();
+
+  if (!lastInstructionIs(code::OpCode::OpReturnValue))
+    emit(code::OpCode::OpReturn, {});
+
+  auto FreeSymbols = SymTable->FreeSymbols;
+  const auto NumLocals = SymTable->NumDefinitions;
+  auto Ins = peephole(leaveScope(), true);
+
+  auto *CompiledFn = object::makeCompiledFunction(
+      std::move(Ins), NumLocals, FunctionL.Parameters.size());
+  return {CompiledFn, std::move(FreeSymbols)};
+}
+
+// Functions defined at the top level can't capture anything, so their closure
+// is built here and kept as a constant. The global is registered before the
+// body is compiled for recursive calls to be known too.
+void Compiler::compileKnownFunction(int GlobalIndex,
+                                    const ast::FunctionLiteral &FunctionL) {
+  const auto ClosureIndex = Pool.reserve();
+  KnownFunctions[GlobalIndex] = {
+      ClosureIndex, static_cast<int>(FunctionL.Parameters.size())};
+
+  const auto [CompiledFn, FreeSymbols] = compileFunction(FunctionL);
+  assert(FreeSymbols.empty());
+
+  // The pool may hand back an identical function compiled earlier.
+  const auto FnIndex = addConstant(CompiledFn);
+  Constants.at(ClosureIndex) =
+      object::makeClosure(Constants.at(FnIndex).object());
+  emit(code::OpCode::OpConstant, {ClosureIndex});
+}
+
+// Calls of a known function with the right number of arguments. Anything else
+// goes through 'OpCall', which raises the error at run time.
+const Compiler::KnownFunction *
+Compiler::knownFunction(const ast::CallExpression &Call) {
+  const auto *Identifier =
+      ast::astCast<const ast::Identifier *>(Call.Function.get());
+  if (!Identifier)
+    return nullptr;
+
+  const auto *Symbol = SymTable->resolve(Identifier->Interned);
+  if (!Symbol || Symbol->Scope != SymbolScope::GLOBAL_SCOPE)
+    return nullptr;
+
+  const auto Iter = KnownFunctions.find(Symbol->Index);
+  if (Iter == KnownFunctions.end() ||
+      Iter->second.NumParameters !=
+          static_cast<int>(Call.Arguments.size()))
+    return nullptr;
+
+  return &Iter->second;
 }
 
 ByteCode Compiler::byteCode() {
-  return ByteCode(std::move(currentInstructions()), Constants);
+  return ByteCode(peephole(currentInstructions(), false), Constants,
+                  GlobalSymTable.NumDefinitions);
 }
 
 int Compiler::emit(code::OpCode Op, const std::vector<int> &Operands) {
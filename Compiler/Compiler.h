@@ -2,19 +2,24 @@
 
 #include <AST/AST.h>
 #include <Code/Code.h>
+#include <Compiler/ConstantPool.h>
 #include <Compiler/SymbolTable.h>
 #include <Object/Object.h>
 
+#include <unordered_map>
+
 namespace monkey::compiler {
 
 struct ByteCode {
   template <typename T>
-  ByteCode(T &&Instructions,
-           std::vector<std::shared_ptr<object::Object>> &Constants)
-      : Instructions(std::forward<T>(Instructions)), Constants(Constants) {}
+  ByteCode(T &&Instructions, std::vector<object::Value> &Constants,
+           int NumGlobals)
+      : Instructions(std::forward<T>(Instructions)), Constants(Constants),
+        NumGlobals(NumGlobals) {}
 
   code::Instructions Instructions;
-  std::vector<std::shared_ptr<object::Object>> &Constants;
+  std::vector<object::Value> &Constants;
+  int NumGlobals;
 };
 
 struct EmittedInstruction {
@@ -34,17 +39,18 @@ struct CompilationScope {
 
 class Compiler {
 public:
-  Compiler(SymbolTable &, std::vector<std::shared_ptr<object::Object>> &);
+  Compiler(SymbolTable &, std::vector<object::Value> &);
   virtual ~Compiler() = default;
 
+  // Compiling a program folds its constant expressions first, which rewrites
+  // the program's AST, unless turned off with 'setFoldConstants'.
   void compile(const ast::Node *);
   ByteCode byteCode();
+  const ConstantPool &constantPool() const { return Pool; }
+  void setFoldConstants(bool Fold) { FoldConstants = Fold; }
 
 protected:
-  template <typename T> int addConstant(T &&Obj) {
-    Constants.push_back(std::forward<T>(Obj));
-    return Constants.size() - 1;
-  }
+  int addConstant(const object::Value &Val) { return Pool.add(Val); }
 
   int emit(code::OpCode, const std::vector<int> &);
   void enterScope();
@@ -60,12 +66,29 @@ protected:
   void replaceLastPopWithReturn();
   void loadSymbol(const Symbol &);
 
+  // A global bound to a function literal by a top-level 'let'. Calls to it
+  // compile to 'OpCallKnown' on its closure.
+  struct KnownFunction {
+    int Closure;
+    int NumParameters;
+  };
+
+  std::pair<object::CompiledFunction *, std::vector<Symbol>>
+  compileFunction(const ast::FunctionLiteral &);
+  void compileKnownFunction(int, const ast::FunctionLiteral &);
+  const KnownFunction *knownFunction(const ast::CallExpression &);
+
   std::vector<CompilationScope> Scopes;
   int ScopeIndex;
   SymbolTable &GlobalSymTable;
   SymbolTable *SymTable;
   std::vector<std::unique_ptr<SymbolTable>> SymTables;
-  std::vector<std::shared_ptr<object::Object>> &Constants;
+  std::vector<object::Value> &Constants;
+  ConstantPool Pool;
+  bool FoldConstants;
+  // Known functions by the index of their global.
+  std::unordered_map<int, KnownFunction> KnownFunctions;
+  const ast::Node *TopLevelStatement;
 };
 
 } // namespace monkey::compiler
@@ -18,8 +18,7 @@ std::unique_ptr<ast::Program> parse(const std::string &Input) {
 
 class TestCompiler : public Compiler {
 public:
-  TestCompiler(SymbolTable &ST,
-               std::vector<std::shared_ptr<object::Object>> &Constants)
+  TestCompiler(SymbolTable &ST, std::vector<object::Value> &Constants)
       : Compiler(ST, Constants) {}
   virtual ~TestCompiler() = default;
 
@@ -40,8 +39,14 @@ public:
   }
 };
 
-using ConstantType =
-    std::variant<int, std::string, std::vector<code::Instructions>>;
+// A closure built by the compiler around the function constant at the index.
+struct ClosureConstant {
+  int Fn;
+};
+
+using ConstantType = std::variant<int, std::string,
+                                  std::vector<code::Instructions>,
+                                  ClosureConstant>;
 
 struct CompilerTestCase {
   const std::string Input;
@@ -69,7 +74,7 @@ void testStringObject(const std::string &Expected,
                       const object::Object *Actual) {
   const auto *String = dynamic_cast<const object::String *>(Actual);
   ASSERT_THAT(String, testing::NotNull());
-  ASSERT_EQ(String->Value, Expected);
+  ASSERT_EQ(String->value(), Expected);
 }
 
 void testInstructions(const std::vector<code::Instructions> &Expected,
@@ -87,34 +92,45 @@ template <typename... Ts> struct Overloaded : Ts... {
 template <typename... Ts> Overloaded(Ts...)->Overloaded<Ts...>;
 
 void testConstants(const std::vector<ConstantType> &Expected,
-                   const std::vector<std::shared_ptr<object::Object>> &Actual) {
+                   const std::vector<object::Value> &Actual) {
   ASSERT_EQ(Expected.size(), Actual.size());
   for (unsigned int I = 0; I < Expected.size(); ++I) {
     std::visit(
         Overloaded{[&Actual, I](const int Arg) {
-                     testIntegerObject(Arg, Actual.at(I).get());
+                     testIntegerObject(Arg, Actual.at(I).toObject());
                    },
                    [&Actual, I](const std::string &Arg) {
-                     testStringObject(Arg, Actual.at(I).get());
+                     testStringObject(Arg, Actual.at(I).asObject());
                    },
                    [&Actual, I](const std::vector<code::Instructions> &Arg) {
                      const auto *Fn =
                          dynamic_cast<const object::CompiledFunction *>(
-                             Actual.at(I).get());
+                             Actual.at(I).asObject());
                      ASSERT_THAT(Fn, testing::NotNull());
                      testInstructions(Arg, Fn->Ins);
+                   },
+                   [&Actual, I](const ClosureConstant &Arg) {
+                     const auto *Cl = dynamic_cast<const object::Closure *>(
+                         Actual.at(I).asObject());
+                     ASSERT_THAT(Cl, testing::NotNull());
+                     ASSERT_EQ(Cl->Fn, Actual.at(Arg.Fn).asObject());
+                     ASSERT_TRUE(Cl->Free.empty());
                    }},
         Expected.at(I));
   }
 }
 
-void runCompilerTests(const std::vector<CompilerTestCase> &Tests) {
+// Constants are only folded when asked for so that the other tests see the
+// code generated for each kind of expression.
+void runCompilerTests(const std::vector<CompilerTestCase> &Tests,
+                      bool Fold = false) {
   for (const auto &Test : Tests) {
     const auto Program = parse(Test.Input);
 
     SymbolTable ST;
-    std::vector<std::shared_ptr<object::Object>> Constants;
+    std::vector<object::Value> Constants;
     TestCompiler C(ST, Constants);
+    C.setFoldConstants(Fold);
     ASSERT_NO_THROW(C.compile(Program.get()));
 
     const auto ByteCode = C.byteCode();
@@ -226,36 +242,36 @@ TEST(CompilerTests, testConditionals) {
        {// 0000
         code::make(code::OpCode::OpTrue, {}),
         // 0001
-        code::make(code::OpCode::OpJumpNotTruthy, {10}),
-        // 0004
+        code::make(code::OpCode::OpJumpNotTruthy, {14}),
+        // 0006
         code::make(code::OpCode::OpConstant, {0}),
-        // 0007
-        code::make(code::OpCode::OpJump, {11}),
-        // 0010
+        // 0009
+        code::make(code::OpCode::OpJump, {15}),
+        // 0014
         code::make(code::OpCode::OpNull, {}),
-        // 0011
+        // 0015
         code::make(code::OpCode::OpPop, {}),
-        // 0012
+        // 0016
         code::make(code::OpCode::OpConstant, {1}),
-        // 0015
+        // 0019
         code::make(code::OpCode::OpPop, {})}},
       {"if (true) { 10 } else { 20 }; 3333;",
        {10, 20, 3333},
        {// 0000
         code::make(code::OpCode::OpTrue, {}),
         // 0001
-        code::make(code::OpCode::OpJumpNotTruthy, {10}),
-        // 0004
+        code::make(code::OpCode::OpJumpNotTruthy, {14}),
+        // 0006
         code::make(code::OpCode::OpConstant, {0}),
-        // 0007
-        code::make(code::OpCode::OpJump, {13}),
-        // 0010
+        // 0009
+        code::make(code::OpCode::OpJump, {17}),
+        // 0014
         code::make(code::OpCode::OpConstant, {1}),
-        // 0013
+        // 0017
         code::make(code::OpCode::OpPop, {}),
-        // 0014
+        // 0018
         code::make(code::OpCode::OpConstant, {2}),
-        // 0017
+        // 0021
         code::make(code::OpCode::OpPop, {})}}};
 
   runCompilerTests(Tests);
@@ -307,6 +323,222 @@ TEST(CompilerTests, testStringExpressions) {
   runCompilerTests(Tests);
 }
 
+TEST(CompilerTests, testConstantFolding) {
+  const std::vector<CompilerTestCase> Tests = {
+      {"1 + 2 * 3 - 4 / 2",
+       {5},
+       {code::make(code::OpCode::OpConstant, {0}),
+        code::make(code::OpCode::OpPop, {})}},
+      {"-(1 - 3)",
+       {2},
+       {code::make(code::OpCode::OpConstant, {0}),
+        code::make(code::OpCode::OpPop, {})}},
+      {"1 < 2",
+       {},
+       {code::make(code::OpCode::OpTrue, {}),
+        code::make(code::OpCode::OpPop, {})}},
+      {"1 + 1 != 2",
+       {},
+       {code::make(code::OpCode::OpFalse, {}),
+        code::make(code::OpCode::OpPop, {})}},
+      {"true == (1 > 2)",
+       {},
+       {code::make(code::OpCode::OpFalse, {}),
+        code::make(code::OpCode::OpPop, {})}},
+      {"\"mon\" + \"key\"",
+       {"mon", "key"},
+       {code::make(code::OpCode::OpConstant, {0}),
+        code::make(code::OpCode::OpConstant, {1}),
+        code::make(code::OpCode::OpAdd, {}),
+        code::make(code::OpCode::OpPop, {})}},
+      {"!true",
+       {},
+       {code::make(code::OpCode::OpFalse, {}),
+        code::make(code::OpCode::OpPop, {})}},
+      {"!!5",
+       {},
+       {code::make(code::OpCode::OpTrue, {}),
+        code::make(code::OpCode::OpPop, {})}},
+      // Left for the VM to report.
+      {"1 / 0",
+       {1, 0},
+       {code::make(code::OpCode::OpConstant, {0}),
+        code::make(code::OpCode::OpConstant, {1}),
+        code::make(code::OpCode::OpDiv, {}),
+        code::make(code::OpCode::OpPop, {})}},
+      {"\"a\" == \"b\"",
+       {"a", "b"},
+       {code::make(code::OpCode::OpConstant, {0}),
+        code::make(code::OpCode::OpConstant, {1}),
+        code::make(code::OpCode::OpEqual, {}),
+        code::make(code::OpCode::OpPop, {})}},
+      {"fn() { 2 * 3 }",
+       {6,
+        std::vector<code::Instructions>{
+            code::make(code::OpCode::OpConstant, {0}),
+            code::make(code::OpCode::OpReturnValue, {})}},
+       {code::make(code::OpCode::OpClosure, {1, 0}),
+        code::make(code::OpCode::OpPop, {})}}};
+
+  runCompilerTests(Tests, true);
+}
+
+TEST(CompilerTests, testAlgebraicSimplification) {
+  const std::vector<CompilerTestCase> Tests = {
+      {"let x = 5; -(-(x * 2))",
+       {5, 2},
+       {code::make(code::OpCode::OpConstant, {0}),
+        code::make(code::OpCode::OpSetGlobal, {0}),
+        code::make(code::OpCode::OpGetGlobal, {0}),
+        code::make(code::OpCode::OpConstant, {1}),
+        code::make(code::OpCode::OpMul, {}),
+        code::make(code::OpCode::OpPop, {})}},
+      {"let x = 5; (x - 2) * 1; 1 * -x",
+       {5, 2},
+       {code::make(code::OpCode::OpConstant, {0}),
+        code::make(code::OpCode::OpSetGlobal, {0}),
+        code::make(code::OpCode::OpGetGlobal, {0}),
+        code::make(code::OpCode::OpConstant, {1}),
+        code::make(code::OpCode::OpSub, {}),
+        code::make(code::OpCode::OpPop, {}),
+        code::make(code::OpCode::OpGetGlobal, {0}),
+        code::make(code::OpCode::OpMinus, {}),
+        code::make(code::OpCode::OpPop, {})}},
+      // The operands may not be integers, which the VM reports.
+      {"let x = \"s\"; x * 1",
+       {"s", 1},
+       {code::make(code::OpCode::OpConstant, {0}),
+        code::make(code::OpCode::OpSetGlobal, {0}),
+        code::make(code::OpCode::OpGetGlobal, {0}),
+        code::make(code::OpCode::OpConstant, {1}),
+        code::make(code::OpCode::OpMul, {}),
+        code::make(code::OpCode::OpPop, {})}},
+      {"let x = true; -(-x)",
+       {},
+       {code::make(code::OpCode::OpTrue, {}),
+        code::make(code::OpCode::OpSetGlobal, {0}),
+        code::make(code::OpCode::OpGetGlobal, {0}),
+        code::make(code::OpCode::OpMinus, {}),
+        code::make(code::OpCode::OpMinus, {}),
+        code::make(code::OpCode::OpPop, {})}},
+      {"let x = 5; x * (3 - 2)",
+       {5, 1},
+       {code::make(code::OpCode::OpConstant, {0}),
+        code::make(code::OpCode::OpSetGlobal, {0}),
+        code::make(code::OpCode::OpGetGlobal, {0}),
+        code::make(code::OpCode::OpConstant, {1}),
+        code::make(code::OpCode::OpMul, {}),
+        code::make(code::OpCode::OpPop, {})}},
+      {"let x = 5; (x - 2) * (3 - 2)",
+       {5, 2},
+       {code::make(code::OpCode::OpConstant, {0}),
+        code::make(code::OpCode::OpSetGlobal, {0}),
+        code::make(code::OpCode::OpGetGlobal, {0}),
+        code::make(code::OpCode::OpConstant, {1}),
+        code::make(code::OpCode::OpSub, {}),
+        code::make(code::OpCode::OpPop, {})}},
+      {"let x = 5; x * 2",
+       {5, 2},
+       {code::make(code::OpCode::OpConstant, {0}),
+        code::make(code::OpCode::OpSetGlobal, {0}),
+        code::make(code::OpCode::OpGetGlobal, {0}),
+        code::make(code::OpCode::OpConstant, {1}),
+        code::make(code::OpCode::OpMul, {}),
+        code::make(code::OpCode::OpPop, {})}}};
+
+  runCompilerTests(Tests, true);
+}
+
+TEST(CompilerTests, testConstantConditions) {
+  const std::vector<CompilerTestCase> Tests = {
+      {"if (true) { 10 } else { 20 }; 3333;",
+       {10, 3333},
+       {code::make(code::OpCode::OpConstant, {0}),
+        code::make(code::OpCode::OpPop, {}),
+        code::make(code::OpCode::OpConstant, {1}),
+        code::make(code::OpCode::OpPop, {})}},
+      {"if (1 > 2) { 10 } else { 20 }",
+       {20},
+       {code::make(code::OpCode::OpConstant, {0}),
+        code::make(code::OpCode::OpPop, {})}},
+      {"if (false) { 10 }",
+       {},
+       {code::make(code::OpCode::OpNull, {}),
+        code::make(code::OpCode::OpPop, {})}},
+      {"if (\"s\") { 10 }",
+       {10},
+       {code::make(code::OpCode::OpConstant, {0}),
+        code::make(code::OpCode::OpPop, {})}},
+      // The other branch defines a name, so both are kept.
+      {"if (true) { 10 } else { let y = 1; y }",
+       {10, 1},
+       {// 0000
+        code::make(code::OpCode::OpTrue, {}),
+        // 0001
+        code::make(code::OpCode::OpJumpNotTruthy, {14}),
+        // 0006
+        code::make(code::OpCode::OpConstant, {0}),
+        // 0009
+        code::make(code::OpCode::OpJump, {23}),
+        // 0014
+        code::make(code::OpCode::OpConstant, {1}),
+        // 0017
+        code::make(code::OpCode::OpSetGlobal, {0}),
+        // 0020
+        code::make(code::OpCode::OpGetGlobal, {0}),
+        // 0023
+        code::make(code::OpCode::OpPop, {})}}};
+
+  runCompilerTests(Tests, true);
+}
+
+TEST(CompilerTests, testConstantDeduplication) {
+  const std::vector<CompilerTestCase> Tests = {
+      // Equal strings are still different objects.
+      {"1; \"a\"; 1; \"a\"",
+       {1, "a", "a"},
+       {code::make(code::OpCode::OpConstant, {0}),
+        code::make(code::OpCode::OpPop, {}),
+        code::make(code::OpCode::OpConstant, {1}),
+        code::make(code::OpCode::OpPop, {}),
+        code::make(code::OpCode::OpConstant, {0}),
+        code::make(code::OpCode::OpPop, {}),
+        code::make(code::OpCode::OpConstant, {2}),
+        code::make(code::OpCode::OpPop, {})}},
+      {"fn() { 5 }; fn() { 5 }",
+       {5,
+        std::vector<code::Instructions>{
+            code::make(code::OpCode::OpConstant, {0}),
+            code::make(code::OpCode::OpReturnValue, {})}},
+       {code::make(code::OpCode::OpClosure, {1, 0}),
+        code::make(code::OpCode::OpPop, {}),
+        code::make(code::OpCode::OpClosure, {1, 0}),
+        code::make(code::OpCode::OpPop, {})}}};
+
+  runCompilerTests(Tests);
+}
+
+TEST(CompilerTests, testConstantsAreSharedAcrossCompilations) {
+  // Like the REPL, which compiles each line into the same constants.
+  SymbolTable ST;
+  std::vector<object::Value> Constants;
+
+  const auto First = parse("let a = 1 + 2;");
+  Compiler C1(ST, Constants);
+  C1.setFoldConstants(false);
+  C1.compile(First.get());
+  ASSERT_EQ(Constants.size(), 2u);
+
+  const auto Second = parse("a - 2 - 1 + 3");
+  Compiler C2(ST, Constants);
+  C2.setFoldConstants(false);
+  C2.compile(Second.get());
+  ASSERT_EQ(Constants.size(), 3u);
+  ASSERT_EQ(C2.constantPool().requested(), 3u);
+  ASSERT_EQ(C2.constantPool().sizeWithoutDeduplication(), 5u);
+  testConstants({1, 2, 3}, Constants);
+}
+
 TEST(CompilerTests, testArrayLiterals) {
   const std::vector<CompilerTestCase> Tests = {
       {"[]",
@@ -372,23 +604,23 @@ TEST(CompilerTests, testHashLiterals) {
 TEST(CompilerTests, testIndexExpressions) {
   const std::vector<CompilerTestCase> Tests = {
       {"[1, 2, 3][1 + 1]",
-       {1, 2, 3, 1, 1},
+       {1, 2, 3},
        {code::make(code::OpCode::OpConstant, {0}),
         code::make(code::OpCode::OpConstant, {1}),
         code::make(code::OpCode::OpConstant, {2}),
         code::make(code::OpCode::OpArray, {3}),
-        code::make(code::OpCode::OpConstant, {3}),
-        code::make(code::OpCode::OpConstant, {4}),
+        code::make(code::OpCode::OpConstant, {0}),
+        code::make(code::OpCode::OpConstant, {0}),
         code::make(code::OpCode::OpAdd, {}),
         code::make(code::OpCode::OpIndex, {}),
         code::make(code::OpCode::OpPop, {})}},
       {"{1: 2}[2 - 1]",
-       {1, 2, 2, 1},
+       {1, 2},
        {code::make(code::OpCode::OpConstant, {0}),
         code::make(code::OpCode::OpConstant, {1}),
         code::make(code::OpCode::OpHash, {2}),
-        code::make(code::OpCode::OpConstant, {2}),
-        code::make(code::OpCode::OpConstant, {3}),
+        code::make(code::OpCode::OpConstant, {1}),
+        code::make(code::OpCode::OpConstant, {0}),
         code::make(code::OpCode::OpSub, {}),
         code::make(code::OpCode::OpIndex, {}),
         code::make(code::OpCode::OpPop, {})}}};
@@ -429,9 +661,144 @@ TEST(CompilerTests, testFunctions) {
   runCompilerTests(Tests);
 }
 
+TEST(CompilerTests, testSuperInstructions) {
+  const std::vector<CompilerTestCase> Tests = {
+      {"fn(a) { a - 1 }",
+       {ConstantType(1),
+        ConstantType(std::vector<code::Instructions>{
+            code::make(code::OpCode::OpSubLocalConst, {0, 0}),
+            code::make(code::OpCode::OpReturnValue, {})})},
+       {code::make(code::OpCode::OpClosure, {1, 0}),
+        code::make(code::OpCode::OpPop, {})}},
+      {"fn(a) { a + 2 }",
+       {ConstantType(2),
+        ConstantType(std::vector<code::Instructions>{
+            code::make(code::OpCode::OpAddLocalConst, {0, 0}),
+            code::make(code::OpCode::OpReturnValue, {})})},
+       {code::make(code::OpCode::OpClosure, {1, 0}),
+        code::make(code::OpCode::OpPop, {})}},
+      {"fn(a) { if (a == 1) { 2 } else { 3 } }",
+       {ConstantType(1), ConstantType(2), ConstantType(3),
+        ConstantType(std::vector<code::Instructions>{
+            // 0000
+            code::make(code::OpCode::OpJumpIfLocalNotEqConst, {0, 0, 16}),
+            // 0008
+            code::make(code::OpCode::OpConstant, {1}),
+            // 0011
+            code::make(code::OpCode::OpJump, {19}),
+            // 0016
+            code::make(code::OpCode::OpConstant, {2}),
+            // 0019
+            code::make(code::OpCode::OpReturnValue, {})})},
+       {code::make(code::OpCode::OpClosure, {3, 0}),
+        code::make(code::OpCode::OpPop, {})}},
+      {"fn(a) { 1 - a }",
+       {ConstantType(1),
+        ConstantType(std::vector<code::Instructions>{
+            code::make(code::OpCode::OpConstant, {0}),
+            code::make(code::OpCode::OpGetLocal, {0}),
+            code::make(code::OpCode::OpSub, {}),
+            code::make(code::OpCode::OpReturnValue, {})})},
+       {code::make(code::OpCode::OpClosure, {1, 0}),
+        code::make(code::OpCode::OpPop, {})}},
+      {"fn(a) { a == 1 }",
+       {ConstantType(1),
+        ConstantType(std::vector<code::Instructions>{
+            code::make(code::OpCode::OpGetLocal, {0}),
+            code::make(code::OpCode::OpConstant, {0}),
+            code::make(code::OpCode::OpEqual, {}),
+            code::make(code::OpCode::OpReturnValue, {})})},
+       {code::make(code::OpCode::OpClosure, {1, 0}),
+        code::make(code::OpCode::OpPop, {})}},
+      {"fn(h) { h[\"a\"] + h[\"b\"] + h[\"a\"] }",
+       {ConstantType(std::string("a")), ConstantType(std::string("b")),
+        ConstantType(std::string("a")),
+        ConstantType(std::vector<code::Instructions>{
+            code::make(code::OpCode::OpGetLocal, {0}),
+            code::make(code::OpCode::OpIndexConst, {0, 0}),
+            code::make(code::OpCode::OpGetLocal, {0}),
+            code::make(code::OpCode::OpIndexConst, {1, 1}),
+            code::make(code::OpCode::OpAdd, {}),
+            code::make(code::OpCode::OpGetLocal, {0}),
+            code::make(code::OpCode::OpIndexConst, {2, 2}),
+            code::make(code::OpCode::OpAdd, {}),
+            code::make(code::OpCode::OpReturnValue, {})})},
+       {code::make(code::OpCode::OpClosure, {3, 0}),
+        code::make(code::OpCode::OpPop, {})}},
+      {"fn(a, i) { a[i] }",
+       {ConstantType(std::vector<code::Instructions>{
+           code::make(code::OpCode::OpGetLocal, {0}),
+           code::make(code::OpCode::OpGetLocal, {1}),
+           code::make(code::OpCode::OpIndex, {}),
+           code::make(code::OpCode::OpReturnValue, {})})},
+       {code::make(code::OpCode::OpClosure, {0, 0}),
+        code::make(code::OpCode::OpPop, {})}}};
+
+  runCompilerTests(Tests);
+}
+
+TEST(CompilerTests, testTailCalls) {
+  const std::vector<CompilerTestCase> Tests = {
+      {"fn(f) { return f(1); }",
+       {ConstantType(1), ConstantType(std::vector<code::Instructions>{
+                             code::make(code::OpCode::OpGetLocal, {0}),
+                             code::make(code::OpCode::OpConstant, {0}),
+                             code::make(code::OpCode::OpTailCall, {1}),
+                             code::make(code::OpCode::OpReturnValue, {})})},
+       {code::make(code::OpCode::OpClosure, {1, 0}),
+        code::make(code::OpCode::OpPop, {})}},
+      // The call returns through the jump over the other branch.
+      {"fn(f) { if (true) { f() } else { 1 } }",
+       {ConstantType(1),
+        ConstantType(std::vector<code::Instructions>{
+            // 0000
+            code::make(code::OpCode::OpTrue, {}),
+            // 0001
+            code::make(code::OpCode::OpJumpNotTruthy, {15}),
+            // 0006
+            code::make(code::OpCode::OpGetLocal, {0}),
+            // 0008
+            code::make(code::OpCode::OpTailCall, {0}),
+            // 0010
+            code::make(code::OpCode::OpJump, {18}),
+            // 0015
+            code::make(code::OpCode::OpConstant, {0}),
+            // 0018
+            code::make(code::OpCode::OpReturnValue, {})})},
+       {code::make(code::OpCode::OpClosure, {1, 0}),
+        code::make(code::OpCode::OpPop, {})}},
+      {"fn(f) { f() + 1 }",
+       {ConstantType(1), ConstantType(std::vector<code::Instructions>{
+                             code::make(code::OpCode::OpGetLocal, {0}),
+                             code::make(code::OpCode::OpCall, {0}),
+                             code::make(code::OpCode::OpConstant, {0}),
+                             code::make(code::OpCode::OpAdd, {}),
+                             code::make(code::OpCode::OpReturnValue, {})})},
+       {code::make(code::OpCode::OpClosure, {1, 0}),
+        code::make(code::OpCode::OpPop, {})}},
+      {"fn(f) { f(); 1 }",
+       {ConstantType(1), ConstantType(std::vector<code::Instructions>{
+                             code::make(code::OpCode::OpGetLocal, {0}),
+                             code::make(code::OpCode::OpCall, {0}),
+                             code::make(code::OpCode::OpPop, {}),
+                             code::make(code::OpCode::OpConstant, {0}),
+                             code::make(code::OpCode::OpReturnValue, {})})},
+       {code::make(code::OpCode::OpClosure, {1, 0}),
+        code::make(code::OpCode::OpPop, {})}},
+      // The main program has no frame to hand over.
+      {"return len([]);",
+       {},
+       {code::make(code::OpCode::OpGetBuiltIn, {0}),
+        code::make(code::OpCode::OpArray, {0}),
+        code::make(code::OpCode::OpCall, {1}),
+        code::make(code::OpCode::OpReturnValue, {})}}};
+
+  runCompilerTests(Tests);
+}
+
 TEST(CompilerTests, testCompilerScopes) {
   SymbolTable ST;
-  std::vector<std::shared_ptr<object::Object>> Constants;
+  std::vector<object::Value> Constants;
   TestCompiler C(ST, Constants);
   ASSERT_EQ(C.getScopeIndex(), 0);
 
@@ -489,29 +856,30 @@ TEST(CompilerTests, testFunctionCalls) {
         code::make(code::OpCode::OpPop, {})}},
       {"let noArg = fn() { 24 };"
        "noArg();",
-       {ConstantType(24), ConstantType(std::vector<code::Instructions>{
-                              code::make(code::OpCode::OpConstant, {0}),
-                              code::make(code::OpCode::OpReturnValue, {})})},
-       {code::make(code::OpCode::OpClosure, {1, 0}),
+       {ClosureConstant{2}, ConstantType(24),
+        ConstantType(std::vector<code::Instructions>{
+            code::make(code::OpCode::OpConstant, {1}),
+            code::make(code::OpCode::OpReturnValue, {})})},
+       {code::make(code::OpCode::OpConstant, {0}),
         code::make(code::OpCode::OpSetGlobal, {0}),
-        code::make(code::OpCode::OpGetGlobal, {0}),
-        code::make(code::OpCode::OpCall, {0}),
+        code::make(code::OpCode::OpCallKnown, {0, 0}),
         code::make(code::OpCode::OpPop, {})}},
       {"let oneArg = fn(a) { a };"
        "oneArg(24);",
-       {ConstantType(std::vector<code::Instructions>{
+       {ClosureConstant{1},
+        ConstantType(std::vector<code::Instructions>{
             code::make(code::OpCode::OpGetLocal, {0}),
             code::make(code::OpCode::OpReturnValue, {})}),
         ConstantType(24)},
-       {code::make(code::OpCode::OpClosure, {0, 0}),
+       {code::make(code::OpCode::OpConstant, {0}),
         code::make(code::OpCode::OpSetGlobal, {0}),
-        code::make(code::OpCode::OpGetGlobal, {0}),
-        code::make(code::OpCode::OpConstant, {1}),
-        code::make(code::OpCode::OpCall, {1}),
+        code::make(code::OpCode::OpConstant, {2}),
+        code::make(code::OpCode::OpCallKnown, {0, 1}),
         code::make(code::OpCode::OpPop, {})}},
       {"let manyArg = fn(a, b, c) { a; b; c };"
        "manyArg(24, 25, 26);",
-       {ConstantType(std::vector<code::Instructions>{
+       {ClosureConstant{1},
+        ConstantType(std::vector<code::Instructions>{
             code::make(code::OpCode::OpGetLocal, {0}),
             code::make(code::OpCode::OpPop, {}),
             code::make(code::OpCode::OpGetLocal, {1}),
@@ -519,13 +887,74 @@ TEST(CompilerTests, testFunctionCalls) {
             code::make(code::OpCode::OpGetLocal, {2}),
             code::make(code::OpCode::OpReturnValue, {})}),
         ConstantType(24), ConstantType(25), ConstantType(26)},
-       {code::make(code::OpCode::OpClosure, {0, 0}),
+       {code::make(code::OpCode::OpConstant, {0}),
         code::make(code::OpCode::OpSetGlobal, {0}),
-        code::make(code::OpCode::OpGetGlobal, {0}),
-        code::make(code::OpCode::OpConstant, {1}),
         code::make(code::OpCode::OpConstant, {2}),
         code::make(code::OpCode::OpConstant, {3}),
-        code::make(code::OpCode::OpCall, {3}),
+        code::make(code::OpCode::OpConstant, {4}),
+        code::make(code::OpCode::OpCallKnown, {0, 3}),
+        code::make(code::OpCode::OpPop, {})}}};
+
+  runCompilerTests(Tests);
+}
+
+TEST(CompilerTests, testKnownFunctionCalls) {
+  const std::vector<CompilerTestCase> Tests = {
+      // Recursive calls are known as well.
+      {"let f = fn(x) { f(x) };"
+       "f(1);",
+       {ClosureConstant{1},
+        ConstantType(std::vector<code::Instructions>{
+            code::make(code::OpCode::OpGetLocal, {0}),
+            code::make(code::OpCode::OpTailCallKnown, {0, 1}),
+            code::make(code::OpCode::OpReturnValue, {})}),
+        ConstantType(1)},
+       {code::make(code::OpCode::OpConstant, {0}),
+        code::make(code::OpCode::OpSetGlobal, {0}),
+        code::make(code::OpCode::OpConstant, {2}),
+        code::make(code::OpCode::OpCallKnown, {0, 1}),
+        code::make(code::OpCode::OpPop, {})}},
+      // A wrong number of arguments is left for the VM to report.
+      {"let f = fn(a) { a };"
+       "f();",
+       {ClosureConstant{1}, ConstantType(std::vector<code::Instructions>{
+                                code::make(code::OpCode::OpGetLocal, {0}),
+                                code::make(code::OpCode::OpReturnValue, {})})},
+       {code::make(code::OpCode::OpConstant, {0}),
+        code::make(code::OpCode::OpSetGlobal, {0}),
+        code::make(code::OpCode::OpGetGlobal, {0}),
+        code::make(code::OpCode::OpCall, {0}),
+        code::make(code::OpCode::OpPop, {})}},
+      // The 'let' may not run, so the global may not hold the function.
+      {"if (true) { let f = fn() { 1 }; };"
+       "f();",
+       {ConstantType(1), ConstantType(std::vector<code::Instructions>{
+                             code::make(code::OpCode::OpConstant, {0}),
+                             code::make(code::OpCode::OpReturnValue, {})})},
+       {code::make(code::OpCode::OpTrue, {}),
+        code::make(code::OpCode::OpJumpNotTruthy, {18}),
+        code::make(code::OpCode::OpClosure, {1, 0}),
+        code::make(code::OpCode::OpSetGlobal, {0}),
+        code::make(code::OpCode::OpJump, {19}),
+        code::make(code::OpCode::OpNull, {}),
+        code::make(code::OpCode::OpPop, {}),
+        code::make(code::OpCode::OpGetGlobal, {0}),
+        code::make(code::OpCode::OpCall, {0}),
+        code::make(code::OpCode::OpPop, {})}},
+      // Parameters shadow the global.
+      {"let f = fn() { 1 };"
+       "fn(f) { f() };",
+       {ClosureConstant{2}, ConstantType(1),
+        ConstantType(std::vector<code::Instructions>{
+            code::make(code::OpCode::OpConstant, {1}),
+            code::make(code::OpCode::OpReturnValue, {})}),
+        ConstantType(std::vector<code::Instructions>{
+            code::make(code::OpCode::OpGetLocal, {0}),
+            code::make(code::OpCode::OpTailCall, {0}),
+            code::make(code::OpCode::OpReturnValue, {})})},
+       {code::make(code::OpCode::OpConstant, {0}),
+        code::make(code::OpCode::OpSetGlobal, {0}),
+        code::make(code::OpCode::OpClosure, {3, 0}),
         code::make(code::OpCode::OpPop, {})}}};
 
   runCompilerTests(Tests);
@@ -592,7 +1021,7 @@ TEST(CompilerTests, testBuiltIns) {
        {ConstantType(std::vector<code::Instructions>{
            code::make(code::OpCode::OpGetBuiltIn, {0}),
            code::make(code::OpCode::OpArray, {0}),
-           code::make(code::OpCode::OpCall, {1}),
+           code::make(code::OpCode::OpTailCall, {1}),
            code::make(code::OpCode::OpReturnValue, {})})},
        {code::make(code::OpCode::OpClosure, {0, 0}),
         code::make(code::OpCode::OpPop, {})}}};
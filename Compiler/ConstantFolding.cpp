@@ -0,0 +1,364 @@
+#include "ConstantFolding.h"
+
+#include <limits>
+
+namespace monkey::compiler {
+
+namespace {
+
+void foldStatement(ast::Statement *);
+void foldExpression(std::unique_ptr<ast::Expression> &);
+
+template <typename T> T *mutableCast(ast::Node *Node) {
+  return const_cast<T *>(ast::astCast<const T *>(Node));
+}
+
+std::unique_ptr<ast::Expression> makeInteger(int64_t Value) {
+  return std::make_unique<ast::IntegerLiteral>(
+      Token(TokenType::INT, std::to_string(Value)), Value);
+}
+
+std::unique_ptr<ast::Expression> makeBoolean(bool Value) {
+  return std::make_unique<ast::Boolean>(
+      Value ? Token(TokenType::TRUE, "true") : Token(TokenType::FALSE, "false"),
+      Value);
+}
+
+bool isInteger(const ast::Expression *Expr, int64_t Value) {
+  const auto *Integer = ast::astCast<const ast::IntegerLiteral *>(Expr);
+  return Integer && Integer->Value == Value;
+}
+
+// Whether the expression evaluates to an integer unless it raises an error.
+// Only integers can be negated, subtracted, multiplied and divided.
+bool isIntegerExpression(const ast::Expression *Expr) {
+  if (!Expr)
+    return false;
+
+  switch (Expr->type()) {
+  case ast::ASTType::INTEGER_AST:
+    return true;
+
+  case ast::ASTType::PREFIX_EXPR_AST:
+    return static_cast<const ast::PrefixExpression *>(Expr)->Op ==
+           ast::OperatorType::MINUS;
+
+  case ast::ASTType::INFIX_EXPR_AST: {
+    const auto Op = static_cast<const ast::InfixExpression *>(Expr)->Op;
+    return Op == ast::OperatorType::MINUS ||
+           Op == ast::OperatorType::ASTERISK || Op == ast::OperatorType::SLASH;
+  }
+
+  default:
+    return false;
+  }
+}
+
+// Returns whether the operation could be done without overflowing.
+bool integerOperation(ast::OperatorType Op, int64_t Left, int64_t Right,
+                      int64_t &Result) {
+  switch (Op) {
+  case ast::OperatorType::PLUS:
+    return !__builtin_add_overflow(Left, Right, &Result);
+  case ast::OperatorType::MINUS:
+    return !__builtin_sub_overflow(Left, Right, &Result);
+  case ast::OperatorType::ASTERISK:
+    return !__builtin_mul_overflow(Left, Right, &Result);
+  case ast::OperatorType::SLASH:
+    if (Right == 0 ||
+        (Left == std::numeric_limits<int64_t>::min() && Right == -1))
+      return false;
+
+    Result = Left / Right;
+    return true;
+  default:
+    return false;
+  }
+}
+
+std::unique_ptr<ast::Expression> foldInfix(ast::InfixExpression &Infix) {
+  const auto Op = Infix.Op;
+  const auto *LeftInt =
+      ast::astCast<const ast::IntegerLiteral *>(Infix.Left.get());
+  const auto *RightInt =
+      ast::astCast<const ast::IntegerLiteral *>(Infix.Right.get());
+  if (LeftInt && RightInt) {
+    const auto L = LeftInt->Value;
+    const auto R = RightInt->Value;
+    int64_t Result;
+    if (integerOperation(Op, L, R, Result))
+      return makeInteger(Result);
+    if (Op == ast::OperatorType::LT)
+      return makeBoolean(L < R);
+    if (Op == ast::OperatorType::GT)
+      return makeBoolean(L > R);
+    if (Op == ast::OperatorType::EQ)
+      return makeBoolean(L == R);
+    if (Op == ast::OperatorType::NOT_EQ)
+      return makeBoolean(L != R);
+    return nullptr;
+  }
+
+  const auto *LeftBool = ast::astCast<const ast::Boolean *>(Infix.Left.get());
+  const auto *RightBool = ast::astCast<const ast::Boolean *>(Infix.Right.get());
+  if (LeftBool && RightBool) {
+    if (Op == ast::OperatorType::EQ)
+      return makeBoolean(LeftBool->Value == RightBool->Value);
+    if (Op == ast::OperatorType::NOT_EQ)
+      return makeBoolean(LeftBool->Value != RightBool->Value);
+    return nullptr;
+  }
+
+  // Other operands would raise an error.
+  if (Op == ast::OperatorType::ASTERISK && isInteger(Infix.Right.get(), 1) &&
+      isIntegerExpression(Infix.Left.get()))
+    return std::move(Infix.Left);
+  if (Op == ast::OperatorType::ASTERISK && isInteger(Infix.Left.get(), 1) &&
+      isIntegerExpression(Infix.Right.get()))
+    return std::move(Infix.Right);
+
+  return nullptr;
+}
+
+std::unique_ptr<ast::Expression> foldPrefix(ast::PrefixExpression &Prefix) {
+  auto *Right = Prefix.Right.get();
+
+  if (Prefix.Op == ast::OperatorType::BANG) {
+    if (const auto *Bool = ast::astCast<const ast::Boolean *>(Right))
+      return makeBoolean(!Bool->Value);
+    // Only false and null are falsy.
+    if (ast::astCast<const ast::IntegerLiteral *>(Right) ||
+        ast::astCast<const ast::String *>(Right))
+      return makeBoolean(false);
+    return nullptr;
+  }
+
+  if (Prefix.Op == ast::OperatorType::MINUS) {
+    const auto *Integer = ast::astCast<const ast::IntegerLiteral *>(Right);
+    if (Integer && Integer->Value != std::numeric_limits<int64_t>::min())
+      return makeInteger(-Integer->Value);
+
+    auto *Inner = mutableCast<ast::PrefixExpression>(Right);
+    if (Inner && Inner->Op == ast::OperatorType::MINUS &&
+        isIntegerExpression(Inner->Right.get()))
+      return std::move(Inner->Right);
+  }
+
+  return nullptr;
+}
+
+void foldBlock(ast::BlockStatement *Block) {
+  if (!Block)
+    return;
+
+  for (auto &Statement : Block->Statements)
+    foldStatement(Statement.get());
+}
+
+void foldExpression(std::unique_ptr<ast::Expression> &Expr) {
+  // Expressions the parser gave up on are missing.
+  auto *Node = Expr.get();
+  if (!Node)
+    return;
+
+  switch (Node->type()) {
+  case ast::ASTType::PREFIX_EXPR_AST: {
+    auto *Prefix = static_cast<ast::PrefixExpression *>(Node);
+    foldExpression(Prefix->Right);
+    if (auto Folded = foldPrefix(*Prefix))
+      Expr = std::move(Folded);
+    return;
+  }
+
+  case ast::ASTType::INFIX_EXPR_AST: {
+    auto *Infix = static_cast<ast::InfixExpression *>(Node);
+    foldExpression(Infix->Left);
+    foldExpression(Infix->Right);
+    if (auto Folded = foldInfix(*Infix))
+      Expr = std::move(Folded);
+    return;
+  }
+
+  case ast::ASTType::IF_AST: {
+    auto *If = static_cast<ast::IfExpression *>(Node);
+    foldExpression(If->Condition);
+    foldBlock(If->Consequence.get());
+    foldBlock(If->Alternative.get());
+    return;
+  }
+
+  case ast::ASTType::FUNCTION_AST:
+    foldBlock(static_cast<ast::FunctionLiteral *>(Node)->Body.get());
+    return;
+
+  case ast::ASTType::CALL_AST: {
+    auto *Call = static_cast<ast::CallExpression *>(Node);
+    foldExpression(Call->Function);
+    for (auto &Arg : Call->Arguments)
+      foldExpression(Arg);
+    return;
+  }
+
+  case ast::ASTType::ARRAY_AST:
+    for (auto &Elem : static_cast<ast::ArrayLiteral *>(Node)->Elements)
+      foldExpression(Elem);
+    return;
+
+  case ast::ASTType::INDEX_AST: {
+    auto *Index = static_cast<ast::IndexExpression *>(Node);
+    foldExpression(Index->Left);
+    foldExpression(Index->Index);
+    return;
+  }
+
+  case ast::ASTType::HASH_AST:
+    for (auto &P : static_cast<ast::HashLiteral *>(Node)->Pairs) {
+      foldExpression(P.first);
+      foldExpression(P.second);
+    }
+    return;
+
+  default:
+    return;
+  }
+}
+
+void foldStatement(ast::Statement *Statement) {
+  if (!Statement)
+    return;
+
+  switch (Statement->type()) {
+  case ast::ASTType::EXPR_STATEMENT_AST:
+    foldExpression(static_cast<ast::ExpressionStatement *>(Statement)->Expr);
+    return;
+
+  case ast::ASTType::LET_AST:
+    foldExpression(static_cast<ast::LetStatement *>(Statement)->Value);
+    return;
+
+  case ast::ASTType::RETURN_AST:
+    foldExpression(
+        static_cast<ast::ReturnStatement *>(Statement)->ReturnValue);
+    return;
+
+  case ast::ASTType::BLOCK_AST:
+    foldBlock(static_cast<ast::BlockStatement *>(Statement));
+    return;
+
+  default:
+    return;
+  }
+}
+
+// Whether compiling the node defines a name in the current scope.
+bool definesNames(const ast::Node *Node) {
+  if (!Node)
+    return false;
+
+  switch (Node->type()) {
+  case ast::ASTType::LET_AST:
+    return true;
+
+  case ast::ASTType::EXPR_STATEMENT_AST:
+    return definesNames(
+        static_cast<const ast::ExpressionStatement *>(Node)->Expr.get());
+
+  case ast::ASTType::RETURN_AST:
+    return definesNames(
+        static_cast<const ast::ReturnStatement *>(Node)->ReturnValue.get());
+
+  case ast::ASTType::BLOCK_AST:
+    for (const auto &Statement :
+         static_cast<const ast::BlockStatement *>(Node)->Statements) {
+      if (definesNames(Statement.get()))
+        return true;
+    }
+    return false;
+
+  case ast::ASTType::PREFIX_EXPR_AST:
+    return definesNames(
+        static_cast<const ast::PrefixExpression *>(Node)->Right.get());
+
+  case ast::ASTType::INFIX_EXPR_AST: {
+    const auto *Infix = static_cast<const ast::InfixExpression *>(Node);
+    return definesNames(Infix->Left.get()) || definesNames(Infix->Right.get());
+  }
+
+  case ast::ASTType::IF_AST: {
+    const auto *If = static_cast<const ast::IfExpression *>(Node);
+    return definesNames(If->Condition.get()) ||
+           definesNames(If->Consequence.get()) ||
+           definesNames(If->Alternative.get());
+  }
+
+  case ast::ASTType::CALL_AST: {
+    const auto *Call = static_cast<const ast::CallExpression *>(Node);
+    if (definesNames(Call->Function.get()))
+      return true;
+    for (const auto &Arg : Call->Arguments) {
+      if (definesNames(Arg.get()))
+        return true;
+    }
+    return false;
+  }
+
+  case ast::ASTType::ARRAY_AST:
+    for (const auto &Elem :
+         static_cast<const ast::ArrayLiteral *>(Node)->Elements) {
+      if (definesNames(Elem.get()))
+        return true;
+    }
+    return false;
+
+  case ast::ASTType::INDEX_AST: {
+    const auto *Index = static_cast<const ast::IndexExpression *>(Node);
+    return definesNames(Index->Left.get()) || definesNames(Index->Index.get());
+  }
+
+  case ast::ASTType::HASH_AST:
+    for (const auto &P : static_cast<const ast::HashLiteral *>(Node)->Pairs) {
+      if (definesNames(P.first.get()) || definesNames(P.second.get()))
+        return true;
+    }
+    return false;
+
+  // Function literals get a scope of their own.
+  default:
+    return false;
+  }
+}
+
+} // namespace
+
+void foldConstants(ast::Program &Program) {
+  for (auto &Statement : Program.Statements)
+    foldStatement(Statement.get());
+}
+
+std::optional<bool> constantCondition(const ast::IfExpression &If) {
+  const auto *Condition = If.Condition.get();
+  if (!Condition)
+    return std::nullopt;
+
+  std::optional<bool> Truthy;
+  switch (Condition->type()) {
+  case ast::ASTType::BOOLEAN_AST:
+    Truthy = static_cast<const ast::Boolean *>(Condition)->Value;
+    break;
+  case ast::ASTType::INTEGER_AST:
+  case ast::ASTType::STRING_AST:
+    Truthy = true;
+    break;
+  default:
+    break;
+  }
+
+  // Names defined by the other branch must still be defined.
+  if (Truthy &&
+      definesNames(*Truthy ? If.Alternative.get() : If.Consequence.get()))
+    return std::nullopt;
+
+  return Truthy;
+}
+
+} // namespace monkey::compiler
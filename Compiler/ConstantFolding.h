@@ -0,0 +1,33 @@
+#pragma once
+
+#include <AST/AST.h>
+
+#include <optional>
+
+namespace monkey::compiler {
+
+// Rewrite the program in place before it is compiled:
+//
+//   1 + 2 * 3             -> 7
+//   1 < 2, true == false  -> true, false
+//   !true, !5             -> false
+//   -(-x)                 -> x
+//   x * 1, 1 * x          -> x
+//
+// Integer operations that would divide by zero or overflow are left for the
+// VM. The last two rewrites only apply when 'x' is known to be an integer, an
+// integer literal or the result of '-', '*' or '/', so that the type error the
+// VM raises for anything else is kept.
+//
+// Strings aren't concatenated. They compare by identity in the VM, and a
+// folded result would be the same string every time the code runs instead of
+// a new one.
+void foldConstants(ast::Program &);
+
+// Whether the condition of the 'if' is a literal that is always truthy or
+// always falsy. Compilers use this to only emit the branch that can be taken.
+// Nothing is returned if the other branch defines names, since later code may
+// refer to them.
+std::optional<bool> constantCondition(const ast::IfExpression &);
+
+} // namespace monkey::compiler
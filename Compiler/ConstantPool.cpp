@@ -0,0 +1,104 @@
+#include "ConstantPool.h"
+
+#include <string_view>
+
+namespace monkey::compiler {
+
+namespace {
+
+size_t combine(size_t Seed, size_t Hash) {
+  return Seed ^ (Hash + 0x9e3779b97f4a7c15 + (Seed << 6) + (Seed >> 2));
+}
+
+// Whether the constant can be shared. Returns its hash if so.
+bool internable(const object::Value &Val, size_t &Hash) {
+  switch (Val.valueType()) {
+  case object::ValueType::INTEGER_VAL:
+    Hash = std::hash<int64_t>()(Val.asInteger());
+    return true;
+  case object::ValueType::BOOLEAN_VAL:
+    Hash = std::hash<bool>()(Val.asBoolean());
+    return true;
+  case object::ValueType::NULL_VAL:
+    Hash = 0;
+    return true;
+  case object::ValueType::OBJECT_VAL:
+    break;
+  }
+
+  // Strings compare by identity, so each literal keeps an object of its own.
+  const auto *Obj = Val.asObject();
+  if (const auto *Fn = object::objCast<const object::CompiledFunction *>(Obj)) {
+    const auto &Ins = Fn->Ins.Value;
+    const auto &RegisterIns = Fn->RegisterIns.Value;
+    Hash = std::hash<std::string_view>()(
+        std::string_view(Ins.data(), Ins.size()));
+    Hash = combine(Hash, std::hash<std::string_view>()(std::string_view(
+                             reinterpret_cast<const char *>(RegisterIns.data()),
+                             RegisterIns.size() * sizeof(code::Word))));
+    Hash = combine(Hash, Fn->NumLocals);
+    Hash = combine(Hash, Fn->NumParameters);
+    return true;
+  }
+
+  return false;
+}
+
+bool sameConstant(const object::Value &Left, const object::Value &Right) {
+  if (Left.valueType() != Right.valueType())
+    return false;
+  if (!Left.isObject())
+    return Left == Right;
+
+  const auto *LeftObj = Left.asObject();
+  const auto *RightObj = Right.asObject();
+  if (LeftObj->type() != RightObj->type())
+    return false;
+
+  const auto *L = object::objCast<const object::CompiledFunction *>(LeftObj);
+  const auto *R = object::objCast<const object::CompiledFunction *>(RightObj);
+  return L->Ins.Value == R->Ins.Value &&
+         L->RegisterIns.Value == R->RegisterIns.Value &&
+         L->NumLocals == R->NumLocals && L->NumParameters == R->NumParameters;
+}
+
+} // namespace
+
+ConstantPool::ConstantPool(std::vector<object::Value> &Constants)
+    : Constants(Constants), Initial(Constants.size()), Requested(0) {
+  for (unsigned int I = 0; I < Constants.size(); ++I) {
+    size_t Hash;
+    if (internable(Constants.at(I), Hash))
+      Index.emplace(Hash, I);
+  }
+}
+
+int ConstantPool::add(const object::Value &Val) {
+  ++Requested;
+
+  size_t Hash;
+  if (!internable(Val, Hash))
+    return append(Val);
+
+  const auto Range = Index.equal_range(Hash);
+  for (auto Iter = Range.first; Iter != Range.second; ++Iter) {
+    if (sameConstant(Constants.at(Iter->second), Val))
+      return Iter->second;
+  }
+
+  const auto I = append(Val);
+  Index.emplace(Hash, I);
+  return I;
+}
+
+int ConstantPool::reserve() {
+  ++Requested;
+  return append(object::Value::null());
+}
+
+int ConstantPool::append(const object::Value &Val) {
+  Constants.push_back(Val);
+  return Constants.size() - 1;
+}
+
+} // namespace monkey::compiler
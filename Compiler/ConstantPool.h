@@ -0,0 +1,41 @@
+#pragma once
+
+#include <Object/Object.h>
+
+#include <unordered_map>
+#include <vector>
+
+namespace monkey::compiler {
+
+// Interns the constants of a program by value. Integers, booleans and
+// functions with identical code are only stored once, including those already
+// in the pool when it's shared between compilations like in the REPL. Strings
+// are never shared since '==' compares them by identity and two literals with
+// the same contents are different strings.
+class ConstantPool {
+public:
+  explicit ConstantPool(std::vector<object::Value> &);
+
+  // Returns the index of a constant equal to the value, adding it if there is
+  // none. Other objects are always added.
+  int add(const object::Value &);
+  // Adds a null placeholder for a constant that can only be built later, like
+  // a function referring to itself. The slot is never shared.
+  int reserve();
+
+  // The number of constants asked for and the size the pool would have
+  // without deduplication.
+  size_t requested() const { return Requested; }
+  size_t sizeWithoutDeduplication() const { return Initial + Requested; }
+
+private:
+  int append(const object::Value &);
+
+  std::vector<object::Value> &Constants;
+  // Indices of the interned constants by the hash of their value.
+  std::unordered_multimap<size_t, int> Index;
+  const size_t Initial;
+  size_t Requested;
+};
+
+} // namespace monkey::compiler
@@ -0,0 +1,211 @@
+#include "Peephole.h"
+
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace monkey::compiler {
+
+namespace {
+
+// Operands wider than this need an 'OpExtendArg' prefix and are never fused.
+constexpr int MAX_FUSED_OPERAND = 1 << 16;
+
+struct Instruction {
+  code::OpCode Op;
+  std::vector<int> Operands;
+  // Byte offset of the instruction (including any 'OpExtendArg' prefix) in
+  // the original code.
+  unsigned int Offset;
+};
+
+std::vector<Instruction> parse(const code::Instructions &Ins) {
+  std::vector<Instruction> Result;
+  int Extended = 0;
+  unsigned int PrefixStart = 0;
+  bool Prefixed = false;
+
+  for (unsigned int I = 0; I < Ins.Value.size();) {
+    const auto Start = I;
+    const auto Op = static_cast<code::OpCode>(Ins.Value.at(I));
+    const auto &Def = code::lookup(Ins.Value.at(I));
+    const auto Operands = code::readOperands(Def, Ins, I + 1);
+    I += Operands.second + 1;
+
+    if (Op == code::OpCode::OpExtendArg) {
+      if (!Prefixed)
+        PrefixStart = Start;
+      Extended = (Extended << 16) | Operands.first.front();
+      Prefixed = true;
+      continue;
+    }
+
+    auto Values = Operands.first;
+    if (Prefixed)
+      Values.front() |= Extended << 16;
+
+    Result.push_back({Op, std::move(Values), Prefixed ? PrefixStart : Start});
+    Extended = 0;
+    Prefixed = false;
+  }
+
+  return Result;
+}
+
+std::optional<code::OpCode> tailCall(code::OpCode Op) {
+  switch (Op) {
+  case code::OpCode::OpCall:
+    return code::OpCode::OpTailCall;
+  case code::OpCode::OpCallKnown:
+    return code::OpCode::OpTailCallKnown;
+  default:
+    return std::nullopt;
+  }
+}
+
+bool isSmallConstant(const Instruction &Ins) {
+  return Ins.Op == code::OpCode::OpConstant &&
+         Ins.Operands.front() < MAX_FUSED_OPERAND;
+}
+
+} // namespace
+
+code::Instructions peephole(const code::Instructions &Ins, bool TailCalls) {
+  const auto Parsed = parse(Ins);
+
+  std::unordered_set<int> JumpTargets;
+  for (const auto &I : Parsed) {
+    const auto JumpOperand = code::jumpOperand(I.Op);
+    if (JumpOperand >= 0)
+      JumpTargets.insert(I.Operands.at(JumpOperand));
+  }
+
+  const auto IsTarget = [&](unsigned int Index) {
+    return JumpTargets.count(Parsed.at(Index).Offset) > 0;
+  };
+
+  std::unordered_map<unsigned int, unsigned int> IndexAt;
+  for (unsigned int I = 0; I < Parsed.size(); ++I)
+    IndexAt[Parsed.at(I).Offset] = I;
+
+  // Whether the instruction at the index returns, following jumps to their
+  // target. The compiler never emits backward jumps.
+  const auto Returns = [&](unsigned int Index) {
+    while (Index < Parsed.size()) {
+      const auto &Ins = Parsed.at(Index);
+      if (Ins.Op == code::OpCode::OpReturnValue)
+        return true;
+      if (Ins.Op != code::OpCode::OpJump)
+        return false;
+
+      const auto Iter = IndexAt.find(Ins.Operands.front());
+      if (Iter == IndexAt.end() || Iter->second <= Index)
+        return false;
+      Index = Iter->second;
+    }
+    return false;
+  };
+
+  const auto Matches = [&](unsigned int Start,
+                           std::initializer_list<code::OpCode> Ops) {
+    if (Start + Ops.size() > Parsed.size())
+      return false;
+
+    unsigned int Index = Start;
+    for (const auto Op : Ops) {
+      if (Parsed.at(Index).Op != Op || (Index != Start && IsTarget(Index)))
+        return false;
+      ++Index;
+    }
+
+    return isSmallConstant(Parsed.at(Start + 1));
+  };
+
+  // Fuse, remembering where each surviving instruction came from so that jump
+  // targets can be relocated afterwards.
+  std::vector<Instruction> Fused;
+  bool RewroteCalls = false;
+  int IndexCaches = 0;
+  for (unsigned int I = 0; I < Parsed.size();) {
+    const auto &Current = Parsed.at(I);
+
+    const auto TailCall = tailCall(Current.Op);
+    if (TailCalls && TailCall && Returns(I + 1)) {
+      Fused.push_back({*TailCall, Current.Operands, Current.Offset});
+      RewroteCalls = true;
+      ++I;
+      continue;
+    }
+
+    if (Matches(I, {code::OpCode::OpGetLocal, code::OpCode::OpConstant,
+                    code::OpCode::OpEqual, code::OpCode::OpJumpNotTruthy})) {
+      Fused.push_back({code::OpCode::OpJumpIfLocalNotEqConst,
+                       {Current.Operands.front(),
+                        Parsed.at(I + 1).Operands.front(),
+                        Parsed.at(I + 3).Operands.front()},
+                       Current.Offset});
+      I += 4;
+      continue;
+    }
+
+    const bool IsAdd = Matches(I, {code::OpCode::OpGetLocal,
+                                   code::OpCode::OpConstant,
+                                   code::OpCode::OpAdd});
+    if (IsAdd || Matches(I, {code::OpCode::OpGetLocal, code::OpCode::OpConstant,
+                             code::OpCode::OpSub})) {
+      Fused.push_back({IsAdd ? code::OpCode::OpAddLocalConst
+                             : code::OpCode::OpSubLocalConst,
+                       {Current.Operands.front(),
+                        Parsed.at(I + 1).Operands.front()},
+                       Current.Offset});
+      I += 3;
+      continue;
+    }
+
+    if (isSmallConstant(Current) && I + 1 < Parsed.size() &&
+        Parsed.at(I + 1).Op == code::OpCode::OpIndex && !IsTarget(I + 1) &&
+        IndexCaches < MAX_FUSED_OPERAND) {
+      Fused.push_back({code::OpCode::OpIndexConst,
+                       {Current.Operands.front(), IndexCaches++},
+                       Current.Offset});
+      I += 2;
+      continue;
+    }
+
+    Fused.push_back(Current);
+    ++I;
+  }
+
+  if (Fused.size() == Parsed.size() && !RewroteCalls)
+    return Ins;
+
+  // Jump targets have a fixed width, so the size of each instruction is known
+  // before the targets are patched.
+  std::unordered_map<int, int> NewOffsets;
+  int Offset = 0;
+  for (const auto &I : Fused) {
+    NewOffsets[I.Offset] = Offset;
+    Offset += code::make(I.Op, I.Operands).size();
+  }
+  NewOffsets[Ins.Value.size()] = Offset;
+
+  code::Instructions Result;
+  for (auto &I : Fused) {
+    const auto JumpOperand = code::jumpOperand(I.Op);
+    if (JumpOperand >= 0) {
+      auto &Target = I.Operands.at(JumpOperand);
+      const auto Iter = NewOffsets.find(Target);
+      if (Iter == NewOffsets.end())
+        throw std::runtime_error("jump to the middle of an instruction");
+      Target = Iter->second;
+    }
+
+    const auto Bytes = code::make(I.Op, I.Operands);
+    Result.Value.insert(Result.Value.end(), Bytes.begin(), Bytes.end());
+  }
+
+  return Result;
+}
+
+} // namespace monkey::compiler
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <Code/Code.h>
+
+namespace monkey::compiler {
+
+// Rewrite common instruction sequences into superinstructions:
+//
+//   OpGetLocal a; OpConstant k; OpAdd     -> OpAddLocalConst a k
+//   OpGetLocal a; OpConstant k; OpSub     -> OpSubLocalConst a k
+//   OpGetLocal a; OpConstant k; OpEqual;
+//   OpJumpNotTruthy t                     -> OpJumpIfLocalNotEqConst a k t
+//   OpConstant k; OpIndex                 -> OpIndexConst k c
+//
+// 'c' numbers the inline cache of the lookup within the instructions.
+//
+// With 'TailCalls' set, calls that lead straight to a return, possibly through
+// jumps, become 'OpTailCall' or 'OpTailCallKnown'. The return stays behind them
+// for code that runs a tail call like any other call. Only function bodies have
+// a frame that a tail call can hand over, so the main program is rewritten
+// without them.
+//
+// A sequence is only fused if no jump lands inside of it. Jump targets are
+// relocated to account for the shorter code.
+code::Instructions peephole(const code::Instructions &, bool TailCalls);
+
+} // namespace monkey::compiler
@@ -0,0 +1,508 @@
+#include "RegisterCompiler.h"
+
+#include <Object/BuiltIns.h>
+
+#include <algorithm>
+
+namespace monkey::compiler {
+
+RegisterCompiler::RegisterCompiler(SymbolTable &SymTable,
+                                   std::vector<object::Value> &Constants)
+    : GlobalSymTable(SymTable), SymTable(&GlobalSymTable),
+      Constants(Constants), Pool(Constants) {
+  // Main scope.
+  Scopes.push_back({{}, {}, 0, 0, 0});
+  allocate(1);
+  currentScope().Floor = RESULT_REGISTER + 1;
+
+  for (unsigned int I = 0; I < object::BUILTINS.size(); ++I)
+    GlobalSymTable.defineBuiltIn(I, object::BUILTINS.at(I).first);
+}
+
+void RegisterCompiler::compile(const ast::Node *Node) {
+  const auto *Program = ast::astCast<const ast::Program *>(Node);
+  if (Program) {
+    for (const auto &Statement : Program->Statements)
+      statement(Statement.get());
+    return;
+  }
+
+  if (const auto *S = dynamic_cast<const ast::Statement *>(Node)) {
+    statement(S);
+    return;
+  }
+
+  expression(static_cast<const ast::Expression *>(Node), RESULT_REGISTER);
+}
+
+RegisterByteCode RegisterCompiler::byteCode() {
+  auto Instructions = currentScope().Instructions;
+  const auto Halt = code::make(code::RegOpCode::OpHalt, {});
+  Instructions.Value.insert(Instructions.Value.end(), Halt.begin(), Halt.end());
+
+  return RegisterByteCode(std::move(Instructions), Constants,
+                          GlobalSymTable.NumDefinitions,
+                          currentScope().NumRegisters);
+}
+
+void RegisterCompiler::statement(const ast::Statement *Node) {
+  const auto *ExprS = ast::astCast<const ast::ExpressionStatement *>(Node);
+  if (ExprS) {
+    // Only the value of top-level expression statements is observable.
+    if (Scopes.size() == 1) {
+      expression(ExprS->Expr.get(), RESULT_REGISTER);
+      return;
+    }
+
+    const auto Mark = currentScope().Next;
+    expression(ExprS->Expr.get(), -1);
+    release(Mark);
+    return;
+  }
+
+  const auto *Let = ast::astCast<const ast::LetStatement *>(Node);
+  if (Let) {
+    const auto &Symbol = SymTable->define(Let->Name->Interned);
+    if (Symbol.Scope == SymbolScope::GLOBAL_SCOPE) {
+      const auto Index = Symbol.Index;
+      const auto Mark = currentScope().Next;
+      const auto Value = expression(Let->Value.get(), -1);
+      emit(code::RegOpCode::OpSetGlobal, {Index, Value});
+      release(Mark);
+    } else {
+      expression(Let->Value.get(), allocateLocal(Symbol));
+    }
+    return;
+  }
+
+  const auto *Return = ast::astCast<const ast::ReturnStatement *>(Node);
+  if (Return) {
+    const auto Mark = currentScope().Next;
+    emit(code::RegOpCode::OpReturn, {operand(Return->ReturnValue.get())});
+    release(Mark);
+    return;
+  }
+
+  const auto *Block = ast::astCast<const ast::BlockStatement *>(Node);
+  if (Block) {
+    for (const auto &Statement : Block->Statements)
+      statement(Statement.get());
+    return;
+  }
+}
+
+int RegisterCompiler::expression(const ast::Expression *Node, int Target) {
+  // Expressions the parser gave up on are missing and evaluate to null.
+  if (!Node) {
+    const auto Dst = target(Target);
+    emit(code::RegOpCode::OpLoadNull, {Dst});
+    return Dst;
+  }
+
+  const auto *IntegerL = ast::astCast<const ast::IntegerLiteral *>(Node);
+  if (IntegerL) {
+    const auto Dst = target(Target);
+    emit(code::RegOpCode::OpLoadConstant,
+         {Dst, addConstant(object::Value::integer(IntegerL->Value))});
+    return Dst;
+  }
+
+  const auto *StringL = ast::astCast<const ast::String *>(Node);
+  if (StringL) {
+    const auto Dst = target(Target);
+    emit(code::RegOpCode::OpLoadConstant,
+         {Dst, addConstant(object::makeString(StringL->Interned))});
+    return Dst;
+  }
+
+  const auto *Bool = ast::astCast<const ast::Boolean *>(Node);
+  if (Bool) {
+    const auto Dst = target(Target);
+    emit(Bool->Value ? code::RegOpCode::OpLoadTrue
+                     : code::RegOpCode::OpLoadFalse,
+         {Dst});
+    return Dst;
+  }
+
+  const auto *Identifier = ast::astCast<const ast::Identifier *>(Node);
+  if (Identifier) {
+    const auto *Symbol = SymTable->resolve(Identifier->Interned);
+    if (!Symbol)
+      throw std::runtime_error("undefined variable " + Identifier->Value);
+
+    return loadSymbol(*Symbol, Target);
+  }
+
+  const auto *PrefixE = ast::astCast<const ast::PrefixExpression *>(Node);
+  if (PrefixE) {
+    code::RegOpCode Op;
+    switch (PrefixE->Op) {
+    case ast::OperatorType::BANG:
+      Op = code::RegOpCode::OpBang;
+      break;
+    case ast::OperatorType::MINUS:
+      Op = code::RegOpCode::OpMinus;
+      break;
+    default:
+      throw std::runtime_error("unknown operator " + PrefixE->Operator);
+    }
+
+    const auto Mark = currentScope().Next;
+    const auto Right = expression(PrefixE->Right.get(), -1);
+    release(Mark);
+
+    const auto Dst = target(Target);
+    emit(Op, {Dst, Right});
+    return Dst;
+  }
+
+  const auto *InfixExpr = ast::astCast<const ast::InfixExpression *>(Node);
+  if (InfixExpr) {
+    const auto Mark = currentScope().Next;
+    code::RegOpCode Op;
+    code::Word Left, Right;
+
+    if (InfixExpr->Op == ast::OperatorType::LT) {
+      Op = code::RegOpCode::OpGreaterThan;
+      Left = operand(InfixExpr->Right.get());
+      Right = operand(InfixExpr->Left.get());
+    } else {
+      switch (InfixExpr->Op) {
+      case ast::OperatorType::PLUS:
+        Op = code::RegOpCode::OpAdd;
+        break;
+      case ast::OperatorType::MINUS:
+        Op = code::RegOpCode::OpSub;
+        break;
+      case ast::OperatorType::ASTERISK:
+        Op = code::RegOpCode::OpMul;
+        break;
+      case ast::OperatorType::SLASH:
+        Op = code::RegOpCode::OpDiv;
+        break;
+      case ast::OperatorType::GT:
+        Op = code::RegOpCode::OpGreaterThan;
+        break;
+      case ast::OperatorType::EQ:
+        Op = code::RegOpCode::OpEqual;
+        break;
+      case ast::OperatorType::NOT_EQ:
+        Op = code::RegOpCode::OpNotEqual;
+        break;
+      default:
+        throw std::runtime_error(
+            std::string("unknown operator " + InfixExpr->Operator));
+      }
+
+      Left = operand(InfixExpr->Left.get());
+      Right = operand(InfixExpr->Right.get());
+    }
+
+    release(Mark);
+    const auto Dst = target(Target);
+    emit(Op, {Dst, Left, Right});
+    return Dst;
+  }
+
+  const auto *IfE = ast::astCast<const ast::IfExpression *>(Node);
+  if (IfE)
+    return ifExpression(IfE, Target);
+
+  const auto *FunctionL = ast::astCast<ast::FunctionLiteral *>(Node);
+  if (FunctionL)
+    return functionLiteral(FunctionL, Target);
+
+  const auto *Call = ast::astCast<const ast::CallExpression *>(Node);
+  if (Call)
+    return callExpression(Call, Target);
+
+  const auto *ArrayL = ast::astCast<const ast::ArrayLiteral *>(Node);
+  if (ArrayL) {
+    const auto Mark = currentScope().Next;
+    const int NumElem = ArrayL->Elements.size();
+    const auto First = allocate(NumElem);
+    for (int I = 0; I < NumElem; ++I)
+      expression(ArrayL->Elements.at(I).get(), First + I);
+    release(Mark);
+
+    const auto Dst = target(Target);
+    emit(code::RegOpCode::OpArray, {Dst, First, NumElem});
+    return Dst;
+  }
+
+  const auto *HashL = ast::astCast<const ast::HashLiteral *>(Node);
+  if (HashL) {
+    std::vector<std::pair<ast::Expression *, ast::Expression *>> Keys;
+    for (const auto &K : HashL->Pairs)
+      Keys.emplace_back(K.first.get(), K.second.get());
+
+    std::sort(Keys.begin(), Keys.end(),
+              [](const std::pair<ast::Expression *, ast::Expression *> &L,
+                 const std::pair<ast::Expression *, ast::Expression *> &R) {
+                return L.first->string() < R.first->string();
+              });
+
+    const auto Mark = currentScope().Next;
+    const int NumElem = Keys.size() * 2;
+    const auto First = allocate(NumElem);
+    for (unsigned int I = 0; I < Keys.size(); ++I) {
+      expression(Keys.at(I).first, First + 2 * I);
+      expression(Keys.at(I).second, First + 2 * I + 1);
+    }
+    release(Mark);
+
+    const auto Dst = target(Target);
+    emit(code::RegOpCode::OpHash, {Dst, First, NumElem});
+    return Dst;
+  }
+
+  const auto *Index = ast::astCast<const ast::IndexExpression *>(Node);
+  if (Index) {
+    const auto Mark = currentScope().Next;
+    const auto Left = expression(Index->Left.get(), -1);
+    const auto I = operand(Index->Index.get());
+    release(Mark);
+
+    const auto Dst = target(Target);
+    emit(code::RegOpCode::OpIndex, {Dst, Left, I});
+    return Dst;
+  }
+
+  throw std::runtime_error("unsupported expression " + Node->string());
+}
+
+code::Word RegisterCompiler::operand(const ast::Expression *Node) {
+  const auto *IntegerL = ast::astCast<const ast::IntegerLiteral *>(Node);
+  if (IntegerL)
+    return code::constantOperand(
+        addConstant(object::Value::integer(IntegerL->Value)));
+
+  const auto *StringL = ast::astCast<const ast::String *>(Node);
+  if (StringL)
+    return code::constantOperand(
+        addConstant(object::makeString(StringL->Interned)));
+
+  const auto *Bool = ast::astCast<const ast::Boolean *>(Node);
+  if (Bool)
+    return code::constantOperand(
+        addConstant(object::Value::boolean(Bool->Value)));
+
+  return expression(Node, -1);
+}
+
+void RegisterCompiler::block(const ast::BlockStatement *Block, int Target) {
+  const auto &Statements = Block->Statements;
+  for (unsigned int I = 0; I + 1 < Statements.size(); ++I)
+    statement(Statements.at(I).get());
+
+  // The value of a block is the value of its last expression statement.
+  const auto *Last =
+      Statements.empty()
+          ? nullptr
+          : ast::astCast<const ast::ExpressionStatement *>(
+                Statements.back().get());
+  if (Last) {
+    expression(Last->Expr.get(), Target);
+    return;
+  }
+
+  if (!Statements.empty())
+    statement(Statements.back().get());
+  emit(code::RegOpCode::OpLoadNull, {Target});
+}
+
+int RegisterCompiler::ifExpression(const ast::IfExpression *IfE, int Target) {
+  const auto Dst = target(Target);
+  const auto Mark = currentScope().Next;
+
+  // Comparisons are folded into the conditional jump.
+  int JumpNotTaken;
+  const auto *Cond =
+      ast::astCast<const ast::InfixExpression *>(IfE->Condition.get());
+  if (Cond && Cond->Op == ast::OperatorType::EQ) {
+    const auto Left = operand(Cond->Left.get());
+    const auto Right = operand(Cond->Right.get());
+    JumpNotTaken = emit(code::RegOpCode::OpJumpIfNotEqual, {Left, Right, 0});
+  } else if (Cond && Cond->Op == ast::OperatorType::NOT_EQ) {
+    const auto Left = operand(Cond->Left.get());
+    const auto Right = operand(Cond->Right.get());
+    JumpNotTaken = emit(code::RegOpCode::OpJumpIfEqual, {Left, Right, 0});
+  } else if (Cond && Cond->Op == ast::OperatorType::GT) {
+    const auto Left = operand(Cond->Left.get());
+    const auto Right = operand(Cond->Right.get());
+    JumpNotTaken = emit(code::RegOpCode::OpJumpIfNotGreater, {Left, Right, 0});
+  } else if (Cond && Cond->Op == ast::OperatorType::LT) {
+    const auto Right = operand(Cond->Right.get());
+    const auto Left = operand(Cond->Left.get());
+    JumpNotTaken = emit(code::RegOpCode::OpJumpIfNotGreater, {Right, Left, 0});
+  } else {
+    const auto Condition = expression(IfE->Condition.get(), -1);
+    JumpNotTaken = emit(code::RegOpCode::OpJumpIfFalse, {Condition, 0});
+  }
+  release(Mark);
+
+  block(IfE->Consequence.get(), Dst);
+  const auto JumpEnd = emit(code::RegOpCode::OpJump, {0});
+
+  patchJump(JumpNotTaken);
+  if (IfE->Alternative)
+    block(IfE->Alternative.get(), Dst);
+  else
+    emit(code::RegOpCode::OpLoadNull, {Dst});
+
+  patchJump(JumpEnd);
+  return Dst;
+}
+
+int RegisterCompiler::functionLiteral(const ast::FunctionLiteral *FunctionL,
+                                      int Target) {
+  enterScope();
+  for (const auto &P : FunctionL->Parameters)
+    allocateLocal(SymTable->define(P->Interned));
+
+  const auto &Statements = FunctionL->Body->Statements;
+  for (unsigned int I = 0; I + 1 < Statements.size(); ++I)
+    statement(Statements.at(I).get());
+
+  // Implicitly return the value of a trailing expression statement.
+  const auto *Last = Statements.empty() ? nullptr : Statements.back().get();
+  const auto *LastExpr = ast::astCast<const ast::ExpressionStatement *>(Last);
+  if (LastExpr) {
+    emit(code::RegOpCode::OpReturn, {operand(LastExpr->Expr.get())});
+  } else {
+    if (Last)
+      statement(Last);
+    if (!ast::astCast<const ast::ReturnStatement *>(Last))
+      emit(code::RegOpCode::OpReturnNull, {});
+  }
+
+  const auto FreeSymbols = SymTable->FreeSymbols;
+  auto Scope = leaveScope();
+
+  auto *CompiledFn = object::makeCompiledFunction(
+      code::Instructions(), Scope.NumRegisters, FunctionL->Parameters.size());
+  CompiledFn->RegisterIns = std::move(Scope.Instructions);
+  const auto FnIndex = addConstant(CompiledFn);
+
+  const auto Mark = currentScope().Next;
+  const int NumFree = FreeSymbols.size();
+  const auto First = allocate(NumFree);
+  for (int I = 0; I < NumFree; ++I)
+    loadSymbol(FreeSymbols.at(I), First + I);
+  release(Mark);
+
+  const auto Dst = target(Target);
+  emit(code::RegOpCode::OpClosure, {Dst, FnIndex, First, NumFree});
+  return Dst;
+}
+
+int RegisterCompiler::callExpression(const ast::CallExpression *Call,
+                                     int Target) {
+  // The callee and its arguments go into consecutive registers, which become
+  // the bottom of the callee's register window.
+  const auto Mark = currentScope().Next;
+  const int NumArgs = Call->Arguments.size();
+  auto Fn = allocate(NumArgs + 1);
+  expression(Call->Function.get(), Fn);
+  for (int I = 0; I < NumArgs; ++I)
+    expression(Call->Arguments.at(I).get(), Fn + 1 + I);
+
+  // A let inside of an argument defined a local above the arguments, which the
+  // callee's window would overwrite. Move the call past it.
+  if (currentScope().Floor > Fn) {
+    const auto NewFn = allocate(NumArgs + 1);
+    for (int I = 0; I <= NumArgs; ++I)
+      emit(code::RegOpCode::OpMove, {NewFn + I, Fn + I});
+    Fn = NewFn;
+  }
+  release(Mark);
+
+  const auto Dst = target(Target);
+  emit(code::RegOpCode::OpCall, {Dst, Fn, NumArgs});
+  return Dst;
+}
+
+int RegisterCompiler::loadSymbol(const Symbol &S, int Target) {
+  if (S.Scope == SymbolScope::LOCAL_SCOPE) {
+    const auto Local = currentScope().Locals.at(S.Index);
+    if (Target < 0 || Target == Local)
+      return Local;
+
+    emit(code::RegOpCode::OpMove, {Target, Local});
+    return Target;
+  }
+
+  const auto Dst = target(Target);
+  if (S.Scope == SymbolScope::GLOBAL_SCOPE)
+    emit(code::RegOpCode::OpGetGlobal, {Dst, S.Index});
+  else if (S.Scope == SymbolScope::BUILTIN_SCOPE)
+    emit(code::RegOpCode::OpGetBuiltIn, {Dst, S.Index});
+  else if (S.Scope == SymbolScope::FREE_SCOPE)
+    emit(code::RegOpCode::OpGetFree, {Dst, S.Index});
+  return Dst;
+}
+
+int RegisterCompiler::emit(code::RegOpCode Op,
+                           const std::vector<code::Word> &Operands) {
+  auto &Ins = currentScope().Instructions.Value;
+  const auto Instruction = code::make(Op, Operands);
+  Ins.insert(Ins.end(), Instruction.begin(), Instruction.end());
+
+  // Position of the last operand, which is where jumps keep their target.
+  return Ins.size() - 1;
+}
+
+void RegisterCompiler::patchJump(int Pos) {
+  auto &Ins = currentScope().Instructions.Value;
+  Ins.at(Pos) = Ins.size();
+}
+
+int RegisterCompiler::allocate(int Count) {
+  auto &Scope = currentScope();
+  const auto First = Scope.Next;
+  Scope.Next += Count;
+  Scope.NumRegisters = std::max(Scope.NumRegisters, Scope.Next);
+  return First;
+}
+
+int RegisterCompiler::allocateLocal(const Symbol &S) {
+  const auto Register = allocate(1);
+
+  auto &Scope = currentScope();
+  Scope.Floor = Register + 1;
+  if (Scope.Locals.size() <= static_cast<size_t>(S.Index))
+    Scope.Locals.resize(S.Index + 1, -1);
+  Scope.Locals.at(S.Index) = Register;
+  return Register;
+}
+
+void RegisterCompiler::release(int Mark) {
+  auto &Scope = currentScope();
+  Scope.Next = std::max(Mark, Scope.Floor);
+}
+
+int RegisterCompiler::target(int Target) {
+  return Target >= 0 ? Target : allocate(1);
+}
+
+RegisterScope &RegisterCompiler::currentScope() { return Scopes.back(); }
+
+void RegisterCompiler::enterScope() {
+  Scopes.push_back({{}, {}, 0, 0, 0});
+  SymTables.push_back(std::make_unique<SymbolTable>(SymTable));
+  SymTable = SymTables.back().get();
+}
+
+RegisterScope RegisterCompiler::leaveScope() {
+  SymTables.pop_back();
+  if (SymTables.empty())
+    SymTable = &GlobalSymTable;
+  else
+    SymTable = SymTables.back().get();
+
+  auto Scope = std::move(Scopes.back());
+  Scopes.pop_back();
+  return Scope;
+}
+
+} // namespace monkey::compiler
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <AST/AST.h>
+#include <Code/RegisterCode.h>
+#include <Compiler/ConstantPool.h>
+#include <Compiler/SymbolTable.h>
+#include <Object/Object.h>
+
+namespace monkey::compiler {
+
+struct RegisterByteCode {
+  template <typename T>
+  RegisterByteCode(T &&Instructions, std::vector<object::Value> &Constants,
+                   int NumGlobals, int NumRegisters)
+      : Instructions(std::forward<T>(Instructions)), Constants(Constants),
+        NumGlobals(NumGlobals), NumRegisters(NumRegisters) {}
+
+  code::RegisterInstructions Instructions;
+  std::vector<object::Value> &Constants;
+  int NumGlobals;
+  int NumRegisters;
+};
+
+struct RegisterScope {
+  code::RegisterInstructions Instructions;
+  // Register of each local symbol, indexed by the symbol's index.
+  std::vector<int> Locals;
+  // Temporaries are allocated like a stack starting at 'Next'. They never go
+  // below 'Floor', which is just above the highest local.
+  int Next;
+  int Floor;
+  // The size of the register window needed by the scope.
+  int NumRegisters;
+};
+
+// Compiles the AST into three-address code for the register VM. Parameters and
+// locals live in fixed registers at the bottom of a function's window and
+// intermediate results in temporaries above them. Literal operands of
+// arithmetic and comparisons are read straight from the constant pool.
+//
+// The main scope reserves register 0 for the value of the last top-level
+// expression statement.
+class RegisterCompiler {
+public:
+  RegisterCompiler(SymbolTable &, std::vector<object::Value> &);
+  virtual ~RegisterCompiler() = default;
+
+  void compile(const ast::Node *);
+  RegisterByteCode byteCode();
+  const ConstantPool &constantPool() const { return Pool; }
+
+  static const int RESULT_REGISTER = 0;
+
+protected:
+  int addConstant(const object::Value &Val) { return Pool.add(Val); }
+
+  void statement(const ast::Statement *);
+  int expression(const ast::Expression *, int);
+  code::Word operand(const ast::Expression *);
+  void block(const ast::BlockStatement *, int);
+  int ifExpression(const ast::IfExpression *, int);
+  int functionLiteral(const ast::FunctionLiteral *, int);
+  int callExpression(const ast::CallExpression *, int);
+  int loadSymbol(const Symbol &, int);
+  int emit(code::RegOpCode, const std::vector<code::Word> &);
+  void patchJump(int);
+  int allocate(int);
+  int allocateLocal(const Symbol &);
+  void release(int);
+  int target(int);
+  RegisterScope &currentScope();
+  void enterScope();
+  RegisterScope leaveScope();
+
+  std::vector<RegisterScope> Scopes;
+  SymbolTable &GlobalSymTable;
+  SymbolTable *SymTable;
+  std::vector<std::unique_ptr<SymbolTable>> SymTables;
+  std::vector<object::Value> &Constants;
+  ConstantPool Pool;
+};
+
+} // namespace monkey::compiler
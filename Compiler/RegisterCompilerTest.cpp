@@ -0,0 +1,146 @@
+#include "RegisterCompiler.h"
+
+#include <Lexer/Lexer.h>
+#include <Parser/Parser.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace monkey::compiler::test {
+
+namespace {
+
+using code::RegOpCode;
+
+std::unique_ptr<ast::Program> parseProgram(const std::string &Input) {
+  lexer::Lexer L(Input);
+  parser::Parser P(L);
+  return P.parseProgram();
+}
+
+code::Word k(int Index) { return code::constantOperand(Index); }
+
+struct RegisterCompilerTestCase {
+  const std::string Input;
+  const std::vector<std::vector<code::Word>> ExpectedInstructions;
+  // Instructions of the last function literal, if any.
+  const std::vector<std::vector<code::Word>> ExpectedFunction;
+};
+
+void testInstructions(const std::vector<std::vector<code::Word>> &Expected,
+                      const code::RegisterInstructions &Actual) {
+  std::vector<code::Word> Concatted;
+  for (const auto &Ins : Expected)
+    Concatted.insert(Concatted.end(), Ins.begin(), Ins.end());
+
+  ASSERT_EQ(Actual.Value, Concatted) << Actual.string();
+}
+
+void runRegisterCompilerTests(
+    const std::vector<RegisterCompilerTestCase> &Tests) {
+  for (const auto &Test : Tests) {
+    const auto Program = parseProgram(Test.Input);
+
+    SymbolTable ST;
+    std::vector<object::Value> Constants;
+    RegisterCompiler C(ST, Constants);
+    ASSERT_NO_THROW(C.compile(Program.get()));
+
+    const auto ByteCode = C.byteCode();
+    testInstructions(Test.ExpectedInstructions, ByteCode.Instructions);
+
+    if (Test.ExpectedFunction.empty())
+      continue;
+
+    const auto Fn = std::find_if(
+        Constants.rbegin(), Constants.rend(), [](const object::Value &V) {
+          return V.type() == object::ObjectType::COMPILED_FUNCTION_OBJ;
+        });
+    ASSERT_NE(Fn, Constants.rend());
+    testInstructions(
+        Test.ExpectedFunction,
+        static_cast<const object::CompiledFunction *>(Fn->asObject())
+            ->RegisterIns);
+  }
+}
+
+} // namespace
+
+TEST(RegisterCompilerTests, testExpressions) {
+  const std::vector<RegisterCompilerTestCase> Tests = {
+      {"1 + 2",
+       {code::make(RegOpCode::OpAdd, {0, k(0), k(1)}),
+        code::make(RegOpCode::OpHalt, {})},
+       {}},
+      {"let a = 1; a * 2",
+       {code::make(RegOpCode::OpLoadConstant, {1, 0}),
+        code::make(RegOpCode::OpSetGlobal, {0, 1}),
+        code::make(RegOpCode::OpGetGlobal, {1, 0}),
+        code::make(RegOpCode::OpMul, {0, 1, k(1)}),
+        code::make(RegOpCode::OpHalt, {})},
+       {}},
+      {"if (true) { 10 }; 3333;",
+       {// 0000
+        code::make(RegOpCode::OpLoadTrue, {1}),
+        // 0002
+        code::make(RegOpCode::OpJumpIfFalse, {1, 10}),
+        // 0005
+        code::make(RegOpCode::OpLoadConstant, {0, 0}),
+        // 0008
+        code::make(RegOpCode::OpJump, {12}),
+        // 0010
+        code::make(RegOpCode::OpLoadNull, {0}),
+        // 0012
+        code::make(RegOpCode::OpLoadConstant, {0, 1}),
+        // 0015
+        code::make(RegOpCode::OpHalt, {})},
+       {}},
+      // The parser leaves out the expressions it couldn't parse.
+      {"let a = ;",
+       {code::make(RegOpCode::OpLoadNull, {1}),
+        code::make(RegOpCode::OpSetGlobal, {0, 1}),
+        code::make(RegOpCode::OpHalt, {})},
+       {}}};
+
+  runRegisterCompilerTests(Tests);
+}
+
+TEST(RegisterCompilerTests, testFunctions) {
+  const std::vector<RegisterCompilerTestCase> Tests = {
+      {"fn(a, b) { let c = a + b; c - 1 }",
+       {code::make(RegOpCode::OpClosure, {0, 1, 1, 0}),
+        code::make(RegOpCode::OpHalt, {})},
+       {code::make(RegOpCode::OpAdd, {2, 0, 1}),
+        code::make(RegOpCode::OpSub, {3, 2, k(0)}),
+        code::make(RegOpCode::OpReturn, {3})}},
+      {"fn(x) { if (x < 2) { 1 } else { 2 } }",
+       {code::make(RegOpCode::OpClosure, {0, 2, 1, 0}),
+        code::make(RegOpCode::OpHalt, {})},
+       {// 0000
+        code::make(RegOpCode::OpJumpIfNotGreater, {k(0), 0, 9}),
+        // 0004
+        code::make(RegOpCode::OpLoadConstant, {1, 1}),
+        // 0007
+        code::make(RegOpCode::OpJump, {12}),
+        // 0009
+        code::make(RegOpCode::OpLoadConstant, {1, 0}),
+        // 0012
+        code::make(RegOpCode::OpReturn, {1})}},
+      {"fn(a) { len(a) }",
+       {code::make(RegOpCode::OpClosure, {0, 0, 1, 0}),
+        code::make(RegOpCode::OpHalt, {})},
+       {code::make(RegOpCode::OpGetBuiltIn, {1, 0}),
+        code::make(RegOpCode::OpMove, {2, 0}),
+        code::make(RegOpCode::OpCall, {1, 1, 1}),
+        code::make(RegOpCode::OpReturn, {1})}},
+      {"fn(a) { fn(b) { a + b } }",
+       {code::make(RegOpCode::OpClosure, {0, 1, 1, 0}),
+        code::make(RegOpCode::OpHalt, {})},
+       {code::make(RegOpCode::OpMove, {1, 0}),
+        code::make(RegOpCode::OpClosure, {1, 0, 1, 1}),
+        code::make(RegOpCode::OpReturn, {1})}}};
+
+  runRegisterCompilerTests(Tests);
+}
+
+} // namespace monkey::compiler::test
@@ -26,8 +26,9 @@ SymbolTable::SymbolTable() : Outer(nullptr), NumDefinitions(0) {}
 SymbolTable::SymbolTable(SymbolTable *Outer)
     : Outer(Outer), NumDefinitions(0) {}
 
-const Symbol &SymbolTable::define(const std::string &Name) {
-  Symbol S{Name, Outer ? SymbolScope::LOCAL_SCOPE : SymbolScope::GLOBAL_SCOPE,
+const Symbol &SymbolTable::define(const object::InternedString &Name) {
+  Symbol S{Name.str(),
+           Outer ? SymbolScope::LOCAL_SCOPE : SymbolScope::GLOBAL_SCOPE,
            NumDefinitions};
   const auto &NewSym = (Store[Name] = std::move(S));
 
@@ -35,9 +36,13 @@ const Symbol &SymbolTable::define(const std::string &Name) {
   return NewSym;
 }
 
+const Symbol &SymbolTable::define(const std::string &Name) {
+  return define(object::InternedString(Name));
+}
+
 const Symbol &SymbolTable::defineBuiltIn(int Index, const std::string &Name) {
   Symbol S{Name, SymbolScope::BUILTIN_SCOPE, Index};
-  const auto &NewSym = (Store[Name] = std::move(S));
+  const auto &NewSym = (Store[object::InternedString(Name)] = std::move(S));
   return NewSym;
 }
 
@@ -45,11 +50,12 @@ const Symbol &SymbolTable::defineFree(const Symbol &Original) {
   FreeSymbols.push_back(Original);
   Symbol S{Original.Name, SymbolScope::FREE_SCOPE,
            static_cast<int>(FreeSymbols.size() - 1)};
-  const auto &NewSym = (Store[Original.Name] = std::move(S));
+  const auto &NewSym =
+      (Store[object::InternedString(Original.Name)] = std::move(S));
   return NewSym;
 }
 
-const Symbol *SymbolTable::resolve(const std::string &Name) {
+const Symbol *SymbolTable::resolve(const object::InternedString &Name) {
   const auto Iter = Store.find(Name);
   if (Iter == Store.end()) {
     if (Outer) {
@@ -66,4 +72,8 @@ const Symbol *SymbolTable::resolve(const std::string &Name) {
   return &Iter->second;
 }
 
+const Symbol *SymbolTable::resolve(const std::string &Name) {
+  return resolve(object::InternedString(Name));
+}
+
 } // namespace monkey::compiler
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <Object/InternedString.h>
+
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -24,9 +26,11 @@ public:
   explicit SymbolTable(SymbolTable *);
   virtual ~SymbolTable() = default;
 
+  const Symbol &define(const object::InternedString &);
   const Symbol &define(const std::string &);
   const Symbol &defineBuiltIn(int, const std::string &);
   const Symbol &defineFree(const Symbol &);
+  const Symbol *resolve(const object::InternedString &);
   const Symbol *resolve(const std::string &);
 
   SymbolTable *Outer;
@@ -34,7 +38,7 @@ public:
   std::vector<Symbol> FreeSymbols;
 
 private:
-  std::unordered_map<std::string, Symbol> Store;
+  std::unordered_map<object::InternedString, Symbol> Store;
 };
 
 } // namespace monkey::compiler
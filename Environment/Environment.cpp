@@ -4,22 +4,25 @@ namespace monkey::environment {
 
 Environment::Environment() : Outer(nullptr) {}
 
-Environment::Environment(Environment *Outer) : Outer(Outer) {}
+Environment::Environment(Environment *Outer, size_t NumSlots)
+    : Slots(NumSlots, nullptr), Outer(Outer) {}
 
-std::shared_ptr<object::Object> Environment::get(const std::string &Name) {
-  auto Iter = Store.find(Name);
-  if (Iter != Store.end())
-    return Iter->second;
-
-  if (Outer)
-    return Outer->get(Name);
+void Environment::set(size_t Slot, object::Object *Value) {
+  Slots[Slot] = Value;
+  gc::heap().writeBarrier(this, Value);
+}
 
-  return nullptr;
+size_t Environment::globalSlot(const object::InternedString &Name) {
+  const auto [Iter, Added] = Globals.emplace(Name, Slots.size());
+  if (Added)
+    Slots.push_back(nullptr);
+  return Iter->second;
 }
 
-void Environment::set(const std::string &Name,
-                      std::shared_ptr<object::Object> Value) {
-  Store[Name] = std::move(Value);
+void Environment::trace(gc::Tracer &Tr) {
+  for (auto *&Value : Slots)
+    Tr.visit(Value);
+  Tr.visit(Outer);
 }
 
 } // namespace monkey::environment
@@ -1,23 +1,46 @@
 #pragma once
 
+#include <Object/InternedString.h>
 #include <Object/ObjectInterface.h>
 
-#include <memory>
 #include <unordered_map>
+#include <vector>
 
 namespace monkey::environment {
 
-class Environment {
+// Environments are cells themselves since functions capture them and they can
+// end up referencing each other in cycles.
+//
+// Variables live in slots that are assigned before the program is evaluated
+// (see 'evaluator::resolve'), so that reading one only follows the chain of
+// outer environments and indexes a vector. Every call gets an environment
+// with a slot for each parameter and 'let' of the function. The global
+// environment also maps the names of its slots, since programs evaluated in it
+// later refer to what the earlier ones defined.
+class Environment : public gc::Cell {
 public:
   Environment();
-  Environment(Environment *);
+  Environment(Environment *Outer, size_t NumSlots);
   virtual ~Environment() = default;
 
-  std::shared_ptr<object::Object> get(const std::string &);
-  void set(const std::string &, std::shared_ptr<object::Object>);
+  // The value in the slot of the environment 'Depth' levels out, or nullptr
+  // if it hasn't been set yet.
+  object::Object *get(size_t Depth, size_t Slot) const {
+    const auto *Env = this;
+    for (; Depth; --Depth)
+      Env = Env->Outer;
+    return Env->Slots[Slot];
+  }
+  void set(size_t Slot, object::Object *);
+
+  // The slot of the global with the name, which is added if it's new.
+  size_t globalSlot(const object::InternedString &);
+
+  void trace(gc::Tracer &) override;
 
 private:
-  std::unordered_map<std::string, std::shared_ptr<object::Object>> Store;
+  std::vector<object::Object *> Slots;
+  std::unordered_map<object::InternedString, size_t> Globals;
   Environment *Outer;
 };
 
@@ -0,0 +1,427 @@
+#include "ClosureCompiler.h"
+#include "Operations.h"
+#include "Resolver.h"
+
+#include <Object/BuiltIns.h>
+
+namespace monkey::evaluator {
+
+namespace {
+
+using Code = object::Function::Code;
+
+Code compile(ast::Node *);
+
+template <typename T> T *mutableCast(ast::Node *Node) {
+  return const_cast<T *>(ast::astCast<const T *>(Node));
+}
+
+std::vector<Code>
+compileAll(const std::vector<std::unique_ptr<ast::Statement>> &Statements) {
+  std::vector<Code> Compiled;
+  Compiled.reserve(Statements.size());
+  for (const auto &Statement : Statements)
+    Compiled.push_back(compile(Statement.get()));
+  return Compiled;
+}
+
+std::vector<Code>
+compileAll(const std::vector<std::unique_ptr<ast::Expression>> &Expressions) {
+  std::vector<Code> Compiled;
+  Compiled.reserve(Expressions.size());
+  for (const auto &Expr : Expressions)
+    Compiled.push_back(compile(Expr.get()));
+  return Compiled;
+}
+
+// Like the evaluator, returns just the error if there is one.
+std::vector<object::Object *> runAll(const std::vector<Code> &Expressions,
+                                     environment::Environment *Env) {
+  // Results stay rooted while later ones are evaluated.
+  gc::RootedVector<object::Object> Results;
+  Results.Elements.reserve(Expressions.size());
+
+  for (const auto &Expr : Expressions) {
+    auto *Evaluated = Expr(Env);
+    if (isError(Evaluated))
+      return {Evaluated};
+
+    Results.Elements.push_back(Evaluated);
+  }
+
+  return std::move(Results.Elements);
+}
+
+Code compileProgram(const ast::Program &Program) {
+  return [Statements = compileAll(Program.Statements)](
+             environment::Environment *Env) -> object::Object * {
+    object::Object *Result = nullptr;
+    for (const auto &Statement : Statements) {
+      Result = Statement(Env);
+      if (auto *ReturnV = object::objCast<object::ReturnValue *>(Result))
+        return ReturnV->Value;
+      if (isError(Result))
+        return Result;
+    }
+
+    return Result;
+  };
+}
+
+Code compileBlock(const ast::BlockStatement &Block) {
+  auto Statements = compileAll(Block.Statements);
+  // The statement's result is the block's, whether it returns or not.
+  if (Statements.size() == 1)
+    return std::move(Statements.front());
+
+  return [Statements = std::move(Statements)](
+             environment::Environment *Env) -> object::Object * {
+    object::Object *Result = nullptr;
+    for (const auto &Statement : Statements) {
+      Result = Statement(Env);
+      if (Result) {
+        const auto Type = Result->type();
+        if (Type == object::ObjectType::RETURN_VALUE_OBJ ||
+            Type == object::ObjectType::ERROR_OBJ)
+          return Result;
+      }
+    }
+
+    return Result;
+  };
+}
+
+Code compileIdentifier(const ast::Identifier &Identifier) {
+  const auto &Bindings = Identifier.Bindings;
+  // Resolved before the program ran, in case no binding is set.
+  auto *BuiltIn = findBuiltIn(Identifier.Value);
+
+  if (Bindings.size() == 1) {
+    return [Binding = Bindings.front(), BuiltIn,
+            Name = Identifier.Value](environment::Environment *Env) {
+      if (auto *Value = Env->get(Binding.Depth, Binding.Slot))
+        return Value;
+      return BuiltIn ? BuiltIn : unboundIdentifier(Name);
+    };
+  }
+
+  return [Bindings, BuiltIn,
+          Name = Identifier.Value](environment::Environment *Env) {
+    for (const auto &Binding : Bindings) {
+      if (auto *Value = Env->get(Binding.Depth, Binding.Slot))
+        return Value;
+    }
+    return BuiltIn ? BuiltIn : unboundIdentifier(Name);
+  };
+}
+
+Code compileIntegerLiteral(int64_t Value) {
+  // Small integers are never collected, so they can be made right away.
+  if (Value >= object::SMALL_INTEGER_MIN &&
+      Value <= object::SMALL_INTEGER_MAX) {
+    auto *Integer = object::makeInteger(Value);
+    return [Integer](environment::Environment *) -> object::Object * {
+      return Integer;
+    };
+  }
+
+  return [Value](environment::Environment *) -> object::Object * {
+    return object::makeInteger(Value);
+  };
+}
+
+Code compilePrefix(ast::OperatorType Op, Code Right) {
+  if (Op == ast::OperatorType::MINUS) {
+    return [Right = std::move(Right)](
+               environment::Environment *Env) -> object::Object * {
+      auto *Value = Right(Env);
+      if (isError(Value))
+        return Value;
+
+      const auto *Integer = object::objCast<const object::Integer *>(Value);
+      if (Integer)
+        return object::makeInteger(-Integer->Value);
+      return evalPrefixExpression(ast::OperatorType::MINUS, *Value);
+    };
+  }
+
+  return [Op, Right = std::move(Right)](
+             environment::Environment *Env) -> object::Object * {
+    auto *Value = Right(Env);
+    if (isError(Value))
+      return Value;
+
+    return evalPrefixExpression(Op, *Value);
+  };
+}
+
+// 'Fn' applies the operator to integers, which is all that most operations
+// in a program see. Other operands, and integers 'Fn' returns nullptr for,
+// take the evaluator's path.
+template <typename F>
+Code compileInfix(ast::OperatorType Op, Code Left, Code Right, F Fn) {
+  return [Op, Left = std::move(Left), Right = std::move(Right),
+          Fn](environment::Environment *Env) -> object::Object * {
+    object::Ref<object::Object> L(Left(Env));
+    if (isError(L.get()))
+      return L.get();
+
+    auto *R = Right(Env);
+    if (isError(R))
+      return R;
+
+    const auto *LeftInt = object::objCast<const object::Integer *>(L.get());
+    const auto *RightInt = object::objCast<const object::Integer *>(R);
+    if (LeftInt && RightInt) {
+      if (auto *Result = Fn(LeftInt->Value, RightInt->Value))
+        return Result;
+    }
+    return evalInfixExpression(Op, *L, *R);
+  };
+}
+
+Code compileInfix(ast::OperatorType Op, Code Left, Code Right) {
+  using Object = object::Object;
+  using object::nativeBooleanToBooleanObject;
+
+  switch (Op) {
+  case ast::OperatorType::PLUS:
+    return compileInfix(Op, std::move(Left), std::move(Right),
+                        [](int64_t A, int64_t B) -> Object * {
+                          return object::makeInteger(A + B);
+                        });
+  case ast::OperatorType::MINUS:
+    return compileInfix(Op, std::move(Left), std::move(Right),
+                        [](int64_t A, int64_t B) -> Object * {
+                          return object::makeInteger(A - B);
+                        });
+  case ast::OperatorType::ASTERISK:
+    return compileInfix(Op, std::move(Left), std::move(Right),
+                        [](int64_t A, int64_t B) -> Object * {
+                          return object::makeInteger(A * B);
+                        });
+  case ast::OperatorType::SLASH:
+    return compileInfix(Op, std::move(Left), std::move(Right),
+                        [](int64_t A, int64_t B) -> Object * {
+                          return object::makeInteger(A / B);
+                        });
+  case ast::OperatorType::LT:
+    return compileInfix(Op, std::move(Left), std::move(Right),
+                        [](int64_t A, int64_t B) -> Object * {
+                          return nativeBooleanToBooleanObject(A < B);
+                        });
+  case ast::OperatorType::GT:
+    return compileInfix(Op, std::move(Left), std::move(Right),
+                        [](int64_t A, int64_t B) -> Object * {
+                          return nativeBooleanToBooleanObject(A > B);
+                        });
+  case ast::OperatorType::EQ:
+    return compileInfix(Op, std::move(Left), std::move(Right),
+                        [](int64_t A, int64_t B) -> Object * {
+                          return nativeBooleanToBooleanObject(A == B);
+                        });
+  case ast::OperatorType::NOT_EQ:
+    return compileInfix(Op, std::move(Left), std::move(Right),
+                        [](int64_t A, int64_t B) -> Object * {
+                          return nativeBooleanToBooleanObject(A != B);
+                        });
+  default:
+    // Integers don't support the operator either, which the evaluator
+    // reports.
+    return compileInfix(Op, std::move(Left), std::move(Right),
+                        [](int64_t, int64_t) -> Object * { return nullptr; });
+  }
+}
+
+Code compileIf(const ast::IfExpression &If) {
+  return [Condition = compile(If.Condition.get()),
+          Consequence = compile(If.Consequence.get()),
+          Alternative = If.Alternative ? compile(If.Alternative.get())
+                                       : Code()](
+             environment::Environment *Env) -> object::Object * {
+    auto *Cond = Condition(Env);
+    if (isError(Cond))
+      return Cond;
+
+    if (isTruthy(Cond))
+      return Consequence(Env);
+    if (Alternative)
+      return Alternative(Env);
+    return object::NULL_GLOBAL;
+  };
+}
+
+Code compileFunction(ast::FunctionLiteral &Function) {
+  auto Run = std::make_shared<const Code>(compile(Function.Body.get()));
+  return [Literal = shareLiteral(Function),
+          Run = std::move(Run)](environment::Environment *Env) {
+    return object::makeFunction(Literal, Run, Env);
+  };
+}
+
+Code compileCall(const ast::CallExpression &Call) {
+  return [Function = compile(Call.Function.get()),
+          Arguments = compileAll(Call.Arguments)](
+             environment::Environment *Env) -> object::Object * {
+    object::Ref<object::Object> Fn(Function(Env));
+    if (isError(Fn.get()))
+      return Fn.get();
+
+    auto Args = runAll(Arguments, Env);
+    if (Args.size() == 1 && isError(Args.front()))
+      return Args.front();
+
+    return applyFunction(Fn.get(), Args);
+  };
+}
+
+Code compileHash(const ast::HashLiteral &Hash) {
+  std::vector<std::pair<Code, Code>> Pairs;
+  Pairs.reserve(Hash.Pairs.size());
+  for (const auto &P : Hash.Pairs)
+    Pairs.emplace_back(compile(P.first.get()), compile(P.second.get()));
+
+  return [Pairs = std::move(Pairs)](
+             environment::Environment *Env) -> object::Object * {
+    object::Hash::PairMap Map;
+    Map.reserve(Pairs.size());
+    // Keeps the keys and values alive while the rest are evaluated.
+    gc::RootedVector<object::Object> Evaluated;
+
+    for (const auto &P : Pairs) {
+      auto *Key = P.first(Env);
+      if (isError(Key))
+        return Key;
+
+      Evaluated.Elements.push_back(Key);
+      object::HashKey HK(Key);
+      if (!object::hasHashKey(HK))
+        return object::newError("unusable as hash key: %s",
+                                object::objTypeToString(Key->type()));
+
+      auto *Value = P.second(Env);
+      if (isError(Value))
+        return Value;
+
+      Evaluated.Elements.push_back(Value);
+      Map.emplace(HK, Value);
+    }
+
+    return object::makeHash(std::move(Map));
+  };
+}
+
+Code compile(ast::Node *Node) {
+  if (const auto *Program = ast::astCast<const ast::Program *>(Node))
+    return compileProgram(*Program);
+
+  if (const auto *ExprS = ast::astCast<const ast::ExpressionStatement *>(Node))
+    return compile(ExprS->Expr.get());
+
+  if (const auto *Block = ast::astCast<const ast::BlockStatement *>(Node))
+    return compileBlock(*Block);
+
+  if (const auto *Let = ast::astCast<const ast::LetStatement *>(Node)) {
+    // A 'let' always defines a variable of the environment it runs in.
+    return [Value = compile(Let->Value.get()),
+            Slot = Let->Name->Bindings.front().Slot](
+               environment::Environment *Env) -> object::Object * {
+      auto *Evaluated = Value(Env);
+      if (isError(Evaluated))
+        return Evaluated;
+
+      Env->set(Slot, Evaluated);
+      return nullptr;
+    };
+  }
+
+  if (const auto *Return = ast::astCast<const ast::ReturnStatement *>(Node)) {
+    return [Value = compile(Return->ReturnValue.get())](
+               environment::Environment *Env) -> object::Object * {
+      auto *Evaluated = Value(Env);
+      if (isError(Evaluated))
+        return Evaluated;
+
+      return object::makeReturn(Evaluated);
+    };
+  }
+
+  if (const auto *Identifier = ast::astCast<const ast::Identifier *>(Node))
+    return compileIdentifier(*Identifier);
+
+  if (const auto *Integer = ast::astCast<const ast::IntegerLiteral *>(Node))
+    return compileIntegerLiteral(Integer->Value);
+
+  if (const auto *Bool = ast::astCast<const ast::Boolean *>(Node)) {
+    auto *Value = object::nativeBooleanToBooleanObject(Bool->Value);
+    return [Value](environment::Environment *) -> object::Object * {
+      return Value;
+    };
+  }
+
+  if (const auto *String = ast::astCast<const ast::String *>(Node)) {
+    return [Interned = String->Interned](
+               environment::Environment *) -> object::Object * {
+      return object::makeString(Interned);
+    };
+  }
+
+  if (auto *Prefix = mutableCast<ast::PrefixExpression>(Node))
+    return compilePrefix(Prefix->Op, compile(Prefix->Right.get()));
+
+  if (auto *Infix = mutableCast<ast::InfixExpression>(Node))
+    return compileInfix(Infix->Op, compile(Infix->Left.get()),
+                        compile(Infix->Right.get()));
+
+  if (const auto *If = ast::astCast<const ast::IfExpression *>(Node))
+    return compileIf(*If);
+
+  if (auto *Function = ast::astCast<ast::FunctionLiteral *>(Node))
+    return compileFunction(*Function);
+
+  if (const auto *Call = ast::astCast<const ast::CallExpression *>(Node))
+    return compileCall(*Call);
+
+  if (const auto *Array = ast::astCast<const ast::ArrayLiteral *>(Node)) {
+    return [Elements = compileAll(Array->Elements)](
+               environment::Environment *Env) -> object::Object * {
+      auto Evaluated = runAll(Elements, Env);
+      if (Evaluated.size() == 1 && isError(Evaluated.front()))
+        return Evaluated.front();
+
+      return object::makeArray(std::move(Evaluated));
+    };
+  }
+
+  if (const auto *Index = ast::astCast<const ast::IndexExpression *>(Node)) {
+    return [Left = compile(Index->Left.get()),
+            Idx = compile(Index->Index.get())](
+               environment::Environment *Env) -> object::Object * {
+      object::Ref<object::Object> L(Left(Env));
+      if (isError(L.get()))
+        return L.get();
+
+      auto *I = Idx(Env);
+      if (isError(I))
+        return I;
+
+      return evalIndexExpression(L.get(), I);
+    };
+  }
+
+  if (const auto *Hash = ast::astCast<const ast::HashLiteral *>(Node))
+    return compileHash(*Hash);
+
+  return [](environment::Environment *) -> object::Object * { return nullptr; };
+}
+
+} // namespace
+
+object::Object *evalClosures(ast::Node *Node, environment::Environment *Env) {
+  gc::Root<environment::Environment> EnvRoot(Env);
+  resolve(Node, Env);
+  const auto Run = compile(Node);
+  return Run(Env);
+}
+
+} // namespace monkey::evaluator
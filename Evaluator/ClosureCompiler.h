@@ -0,0 +1,19 @@
+#pragma once
+
+#include <AST/AST.h>
+#include <Environment/Environment.h>
+#include <Object/Object.h>
+
+namespace monkey::evaluator {
+
+// Evaluates the program like 'eval', but first compiles it to a tree of
+// closures in a single pass. Every closure already knows what kind of node it
+// runs, which operator it applies and which slots it reads, and literals are
+// made ahead of time where that's possible, so running the tree doesn't
+// inspect the syntax tree anymore.
+//
+// The function literals are moved into the closures, so the program can't be
+// evaluated again afterwards.
+object::Object *evalClosures(ast::Node *, environment::Environment *);
+
+} // namespace monkey::evaluator
@@ -1,28 +1,26 @@
 #include "Evaluator.h"
+#include "Operations.h"
+#include "Resolver.h"
 
 #include <Object/BuiltIns.h>
 
-#include <cassert>
-
 namespace monkey::evaluator {
 
 namespace {
 
-bool isError(const std::shared_ptr<object::Object> &Obj) {
-  return Obj && Obj->type() == object::ObjectType::ERROR_OBJ;
-}
+object::Object *evalNode(ast::Node *, environment::Environment *);
 
-std::shared_ptr<object::Object>
+object::Object *
 evalProgram(const std::vector<std::unique_ptr<ast::Statement>> &Statements,
-            std::shared_ptr<environment::Environment> &Env) {
-  std::shared_ptr<object::Object> Result;
+            environment::Environment *Env) {
+  object::Object *Result = nullptr;
   for (const auto &Statement : Statements) {
-    Result = eval(Statement.get(), Env);
-    auto *ReturnV = object::objCast<object::ReturnValue *>(Result.get());
+    Result = evalNode(Statement.get(), Env);
+    auto *ReturnV = object::objCast<object::ReturnValue *>(Result);
     if (ReturnV)
-      return std::move(ReturnV->Value);
+      return ReturnV->Value;
 
-    const auto *ErrorV = object::objCast<const object::Error *>(Result.get());
+    const auto *ErrorV = object::objCast<const object::Error *>(Result);
     if (ErrorV)
       return Result;
   }
@@ -30,12 +28,12 @@ evalProgram(const std::vector<std::unique_ptr<ast::Statement>> &Statements,
   return Result;
 }
 
-std::shared_ptr<object::Object> evalBlockStatement(
+object::Object *evalBlockStatement(
     const std::vector<std::unique_ptr<ast::Statement>> &Statements,
-    std::shared_ptr<environment::Environment> &Env) {
-  std::shared_ptr<object::Object> Result;
+    environment::Environment *Env) {
+  object::Object *Result = nullptr;
   for (const auto &Statement : Statements) {
-    Result = eval(Statement.get(), Env);
+    Result = evalNode(Statement.get(), Env);
     if (Result) {
       const auto &Type = Result->type();
       if (Type == object::ObjectType::RETURN_VALUE_OBJ ||
@@ -47,467 +45,210 @@ std::shared_ptr<object::Object> evalBlockStatement(
   return Result;
 }
 
-std::shared_ptr<object::Object>
-evalBangOperatorExpression(const object::Object &Right) {
-  const auto *Boolean = object::objCast<const object::Boolean *>(&Right);
-  if (Boolean)
-    return object::nativeBooleanToBooleanObject(!Boolean->Value);
-
-  const auto *Null = object::objCast<const object::Null *>(&Right);
-  if (Null)
-    return object::NULL_GLOBAL;
-
-  return object::FALSE_GLOBAL;
-}
-
-std::shared_ptr<object::Object>
-evalMinusPrefixOperatorExpression(const object::Object &Right) {
-  if (Right.type() != object::ObjectType::INTEGER_OBJ)
-    return object::newError("unknown operator: -%s",
-                            object::objTypeToString(Right.type()));
-
-  const auto *Integer = object::objCast<const object::Integer *>(&Right);
-  if (!Integer)
-    return object::NULL_GLOBAL;
-
-  return object::makeInteger(-Integer->Value);
-}
-
-std::shared_ptr<object::Object>
-evalPrefixExpression(const std::string &Operator, const object::Object &Right) {
-  if (Operator == "!")
-    return evalBangOperatorExpression(Right);
-  else if (Operator == "-")
-    return evalMinusPrefixOperatorExpression(Right);
-  else
-    return object::newError("unknown operator: %s:%s", Operator.c_str(),
-                            object::objTypeToString(Right.type()));
-}
-
-std::shared_ptr<object::Object>
-evalIntegerInfixExpression(const std::string &Operator,
-                           const object::Object &Left,
-                           const object::Object &Right) {
-  const auto *LeftInt = object::objCast<const object::Integer *>(&Left);
-  assert(LeftInt);
-  const auto *RightInt = object::objCast<const object::Integer *>(&Right);
-  assert(RightInt);
-
-  if (Operator == "+")
-    return object::makeInteger(LeftInt->Value + RightInt->Value);
-  else if (Operator == "-")
-    return object::makeInteger(LeftInt->Value - RightInt->Value);
-  else if (Operator == "*")
-    return object::makeInteger(LeftInt->Value * RightInt->Value);
-  else if (Operator == "/")
-    return object::makeInteger(LeftInt->Value / RightInt->Value);
-  else if (Operator == "<")
-    return object::nativeBooleanToBooleanObject(LeftInt->Value <
-                                                RightInt->Value);
-  else if (Operator == ">")
-    return object::nativeBooleanToBooleanObject(LeftInt->Value >
-                                                RightInt->Value);
-  else if (Operator == "==")
-    return object::nativeBooleanToBooleanObject(LeftInt->Value ==
-                                                RightInt->Value);
-  else if (Operator == "!=")
-    return object::nativeBooleanToBooleanObject(LeftInt->Value !=
-                                                RightInt->Value);
-  else
-    return object::newError(
-        "unknown operator: %s %s %s", object::objTypeToString(Left.type()),
-        Operator.c_str(), object::objTypeToString(Right.type()));
-}
-
-std::shared_ptr<object::Object>
-evalBooleanInfixExpression(const std::string &Operator,
-                           const object::Object &Left,
-                           const object::Object &Right) {
-  const bool BothEqual = [&Left, &Right]() {
-    if ((Left.type() == object::ObjectType::BOOLEAN_OBJ) ^
-        (Right.type() == object::ObjectType::BOOLEAN_OBJ))
-      return false;
-
-    const auto *L = object::objCast<const object::Boolean *>(&Left);
-    const auto *R = object::objCast<const object::Boolean *>(&Right);
-    assert(L);
-    assert(R);
-
-    return L->Value == R->Value;
-  }();
-
-  if (Operator == "==")
-    return object::nativeBooleanToBooleanObject(BothEqual);
-  else if (Operator == "!=")
-    return object::nativeBooleanToBooleanObject(!BothEqual);
-  else {
-    if ((Left.type() == object::ObjectType::BOOLEAN_OBJ) ^
-        (Right.type() == object::ObjectType::BOOLEAN_OBJ))
-      return object::newError(
-          "type mismatch: %s %s %s", object::objTypeToString(Left.type()),
-          Operator.c_str(), object::objTypeToString(Right.type()));
-    else
-      return object::newError(
-          "unknown operator: %s %s %s", object::objTypeToString(Left.type()),
-          Operator.c_str(), object::objTypeToString(Right.type()));
-  }
-}
-
-std::shared_ptr<object::Object>
-evalNullInfixExpression(const std::string &Operator, const object::Object &Left,
-                        const object::Object &Right) {
-  const bool BothNull = Left.type() == object::ObjectType::NULL_OBJ &&
-                        Right.type() == object::ObjectType::NULL_OBJ;
-
-  if (Operator == "==")
-    return object::nativeBooleanToBooleanObject(BothNull);
-  else if (Operator == "!=")
-    return object::nativeBooleanToBooleanObject(!BothNull);
-  else
-    return object::NULL_GLOBAL;
-}
-
-std::shared_ptr<object::Object>
-evalStringInfixExpression(const std::string &Operator,
-                          const object::Object &Left,
-                          const object::Object &Right) {
-  if (Operator != "+")
-    return object::newError(
-        "unknown operator: %s %s %s", object::objTypeToString(Left.type()),
-        Operator.c_str(), object::objTypeToString(Right.type()));
-
-  const auto *LeftS = object::objCast<const object::String *>(&Left);
-  const auto *RightS = object::objCast<const object::String *>(&Right);
-  assert(LeftS);
-  assert(RightS);
-  return object::makeString(LeftS->Value + RightS->Value);
-}
-
-std::shared_ptr<object::Object>
-evalInfixExpression(const std::string &Operator, const object::Object &Left,
-                    const object::Object &Right) {
-  if (Left.type() == object::ObjectType::INTEGER_OBJ &&
-      Right.type() == object::ObjectType::INTEGER_OBJ)
-    return evalIntegerInfixExpression(Operator, Left, Right);
-  else if (Left.type() == object::ObjectType::NULL_OBJ ||
-           Right.type() == object::ObjectType::NULL_OBJ)
-    return evalNullInfixExpression(Operator, Left, Right);
-  else if (Left.type() == object::ObjectType::BOOLEAN_OBJ ||
-           Right.type() == object::ObjectType::BOOLEAN_OBJ)
-    return evalBooleanInfixExpression(Operator, Left, Right);
-  else if (Left.type() == object::ObjectType::STRING_OBJ ||
-           Right.type() == object::ObjectType::STRING_OBJ)
-    return evalStringInfixExpression(Operator, Left, Right);
-  else if (Left.type() != Right.type())
-    return object::newError(
-        "type mismatch: %s %s %s", object::objTypeToString(Left.type()),
-        Operator.c_str(), object::objTypeToString(Right.type()));
-  else
-    return object::newError(
-        "unknown operator: %s %s %s", object::objTypeToString(Left.type()),
-        Operator.c_str(), object::objTypeToString(Right.type()));
-}
-
-bool isTruthy(const object::Object *Obj) {
-  const auto *NullObj = object::objCast<const object::Null *>(Obj);
-  if (NullObj)
-    return false;
-
-  const auto *BooleanObj = object::objCast<const object::Boolean *>(Obj);
-  if (BooleanObj)
-    return BooleanObj->Value;
-
-  return true;
-}
-
-std::shared_ptr<object::Object>
-evalIfExpression(const ast::IfExpression *Node,
-                 std::shared_ptr<environment::Environment> &Env) {
-  auto Cond = eval(Node->Condition.get(), Env);
+object::Object *
+evalIfExpression(const ast::IfExpression *Node, environment::Environment *Env) {
+  auto *Cond = evalNode(Node->Condition.get(), Env);
   if (isError(Cond))
     return Cond;
 
-  if (isTruthy(Cond.get()))
-    return eval(Node->Consequence.get(), Env);
+  if (isTruthy(Cond))
+    return evalNode(Node->Consequence.get(), Env);
   else if (Node->Alternative)
-    return eval(Node->Alternative.get(), Env);
+    return evalNode(Node->Alternative.get(), Env);
   else
     return object::NULL_GLOBAL;
 }
 
-std::shared_ptr<object::Object>
+object::Object *
 evalIdentifier(const ast::Identifier *Identifier,
-               std::shared_ptr<environment::Environment> &Env) {
-  const auto &Value = Env->get(Identifier->Value);
-  if (Value)
-    return Value;
-
-  const auto BIter = std::find_if(
-      object::BUILTINS.begin(), object::BUILTINS.end(),
-      [Identifier](
-          const std::pair<std::string, std::shared_ptr<object::BuiltIn>> &Fn) {
-        return Fn.first == Identifier->Value;
-      });
-
-  if (BIter != object::BUILTINS.end())
-    return BIter->second;
-
-  return object::newError("identifier not found: %s",
-                          Identifier->Value.c_str());
+               environment::Environment *Env) {
+  for (const auto &Binding : Identifier->Bindings) {
+    if (auto *Value = Env->get(Binding.Depth, Binding.Slot))
+      return Value;
+  }
+
+  return unboundIdentifier(Identifier->Value);
 }
 
-std::vector<std::shared_ptr<object::Object>>
+std::vector<object::Object *>
 evalExpressions(const std::vector<std::unique_ptr<ast::Expression>> &Arguments,
-                std::shared_ptr<environment::Environment> &Env) {
-  std::vector<std::shared_ptr<object::Object>> Results;
+                environment::Environment *Env) {
+  // Results stay rooted while later arguments are evaluated.
+  gc::RootedVector<object::Object> Results;
 
   for (auto &Arg : Arguments) {
-    auto Evaluated = eval(Arg.get(), Env);
+    auto *Evaluated = evalNode(Arg.get(), Env);
     if (isError(Evaluated))
       return {Evaluated};
 
-    Results.push_back(std::move(Evaluated));
+    Results.Elements.push_back(Evaluated);
   }
 
-  return Results;
-}
-
-std::shared_ptr<object::Object>
-evalArrayIndexExpression(const std::shared_ptr<object::Object> &Array,
-                         const std::shared_ptr<object::Object> &Index) {
-  const auto *ArrayObj = object::objCast<const object::Array *>(Array.get());
-  assert(ArrayObj);
-  const auto *Idx = object::objCast<const object::Integer *>(Index.get());
-  assert(Idx);
-
-  if (Idx->Value < 0 ||
-      Idx->Value >= static_cast<int64_t>(ArrayObj->Elements.size()))
-    return object::NULL_GLOBAL;
-
-  return ArrayObj->Elements.at(Idx->Value);
-}
-
-std::shared_ptr<object::Object>
-evalHashIndexExpression(const std::shared_ptr<object::Object> &Hash,
-                        const std::shared_ptr<object::Object> &Index) {
-  const auto *HashObj = object::objCast<const object::Hash *>(Hash.get());
-  assert(HashObj);
-
-  const object::HashKey HK(Index);
-  if (!object::hasHashKey(HK))
-    return object::newError("unusable as hash key: %s",
-                            object::objTypeToString(Index->type()));
-
-  const auto Iter = HashObj->Pairs.find(HK);
-  if (Iter == HashObj->Pairs.end())
-    return object::NULL_GLOBAL;
-
-  return Iter->second;
+  return std::move(Results.Elements);
 }
 
-std::shared_ptr<object::Object>
-evalIndexExpression(const std::shared_ptr<object::Object> &Left,
-                    const std::shared_ptr<object::Object> &Index) {
-  if (Left->type() == object::ObjectType::ARRAY_OBJ &&
-      Index->type() == object::ObjectType::INTEGER_OBJ)
-    return evalArrayIndexExpression(Left, Index);
-  else if (Left->type() == object::ObjectType::HASH_OBJ)
-    return evalHashIndexExpression(Left, Index);
-
-  return object::newError("index operator not supported: %s",
-                          object::objTypeToString(Left->type()));
-}
-
-std::shared_ptr<object::Object>
-evalHashLiteral(const ast::HashLiteral *Hash,
-                std::shared_ptr<environment::Environment> &Env) {
-  std::unordered_map<object::HashKey, std::shared_ptr<object::Object>,
-                     object::HashKeyHasher>
-      Pairs;
+object::Object *
+evalHashLiteral(const ast::HashLiteral *Hash, environment::Environment *Env) {
+  object::Hash::PairMap Pairs;
+  Pairs.reserve(Hash->Pairs.size());
+  // Keeps the keys and values alive while the rest are evaluated.
+  gc::RootedVector<object::Object> Evaluated;
 
   for (const auto &P : Hash->Pairs) {
-    auto Key = eval(P.first.get(), Env);
+    auto *Key = evalNode(P.first.get(), Env);
     if (isError(Key))
       return Key;
 
+    Evaluated.Elements.push_back(Key);
     object::HashKey HK(Key);
     if (!object::hasHashKey(HK))
       return object::newError("unusable as hash key: %s",
                               object::objTypeToString(Key->type()));
 
-    auto Value = eval(P.second.get(), Env);
+    auto *Value = evalNode(P.second.get(), Env);
     if (isError(Value))
       return Value;
 
-    Pairs.emplace(std::move(HK), Value);
+    Evaluated.Elements.push_back(Value);
+    Pairs.emplace(HK, Value);
   }
 
   return object::makeHash(std::move(Pairs));
 }
 
-std::shared_ptr<environment::Environment>
-extendFunctionEnv(const object::Function *Fn,
-                  const std::vector<std::shared_ptr<object::Object>> &Args) {
-  auto Env = std::make_shared<environment::Environment>(Fn->Env.get());
-  assert(Fn->Parameters.size() == Args.size());
-  for (unsigned int I = 0; I < Args.size(); ++I) {
-    const auto &ParamName = Fn->Parameters.at(I)->Value;
-    const auto &Arg = Args.at(I);
-    Env->set(ParamName, Arg);
-  }
-
-  return Env;
-}
-
-std::shared_ptr<object::Object>
-unwrapReturnValue(const std::shared_ptr<object::Object> &Obj) {
-  const auto *ReturnValue = object::objCast<object::ReturnValue *>(Obj.get());
-  if (ReturnValue)
-    return ReturnValue->Value;
-
-  return Obj;
-}
-
-std::shared_ptr<object::Object>
-applyFunction(const std::shared_ptr<object::Object> &Fn,
-              const std::vector<std::shared_ptr<object::Object>> &Args) {
-  const auto *Function = object::objCast<const object::Function *>(Fn.get());
-  if (Function) {
-    auto ExtendedEnv = extendFunctionEnv(Function, Args);
-    auto Evaluated = eval(Function->Body.get(), ExtendedEnv);
-    return unwrapReturnValue(Evaluated);
-  }
-
-  const auto *BuiltIn = object::objCast<const object::BuiltIn *>(Fn.get());
-  if (BuiltIn) {
-    return BuiltIn->Fn(Args);
-  }
-
-  return object::newError("not a function %s",
-                          object::objTypeToString(Fn->type()));
-}
-
-} // namespace
+object::Object *evalNode(ast::Node *Node, environment::Environment *Env) {
+  // Expressions the parser gave up on are missing.
+  if (!Node)
+    return nullptr;
 
-std::shared_ptr<object::Object>
-eval(ast::Node *Node, std::shared_ptr<environment::Environment> &Env) {
-  const auto *Program = ast::astCast<const ast::Program *>(Node);
-  if (Program)
-    return evalProgram(Program->Statements, Env);
+  switch (Node->type()) {
+  case ast::ASTType::PROGRAM_AST:
+    return evalProgram(static_cast<ast::Program *>(Node)->Statements, Env);
 
-  const auto *ExprS = ast::astCast<const ast::ExpressionStatement *>(Node);
-  if (ExprS)
-    return eval(ExprS->Expr.get(), Env);
+  case ast::ASTType::EXPR_STATEMENT_AST:
+    return evalNode(static_cast<ast::ExpressionStatement *>(Node)->Expr.get(),
+                    Env);
 
-  const auto *IntegerL = ast::astCast<const ast::IntegerLiteral *>(Node);
-  if (IntegerL)
-    return object::makeInteger(IntegerL->Value);
+  case ast::ASTType::INTEGER_AST:
+    return object::makeInteger(static_cast<ast::IntegerLiteral *>(Node)->Value);
 
-  const auto *BooleanL = ast::astCast<const ast::Boolean *>(Node);
-  if (BooleanL)
-    return object::nativeBooleanToBooleanObject(BooleanL->Value);
+  case ast::ASTType::BOOLEAN_AST:
+    return object::nativeBooleanToBooleanObject(
+        static_cast<ast::Boolean *>(Node)->Value);
 
-  const auto *PrefixE = ast::astCast<const ast::PrefixExpression *>(Node);
-  if (PrefixE) {
-    auto Right = eval(PrefixE->Right.get(), Env);
+  case ast::ASTType::PREFIX_EXPR_AST: {
+    const auto *PrefixE = static_cast<ast::PrefixExpression *>(Node);
+    auto *Right = evalNode(PrefixE->Right.get(), Env);
     if (isError(Right))
       return Right;
 
-    return evalPrefixExpression(PrefixE->Operator, *Right);
+    return evalPrefixExpression(PrefixE->Op, *Right);
   }
 
-  const auto *InfixE = ast::astCast<const ast::InfixExpression *>(Node);
-  if (InfixE) {
-    auto Left = eval(InfixE->Left.get(), Env);
-    if (isError(Left))
-      return Left;
+  case ast::ASTType::INFIX_EXPR_AST: {
+    const auto *InfixE = static_cast<ast::InfixExpression *>(Node);
+    object::Ref<object::Object> Left(evalNode(InfixE->Left.get(), Env));
+    if (isError(Left.get()))
+      return Left.get();
 
-    auto Right = eval(InfixE->Right.get(), Env);
+    auto *Right = evalNode(InfixE->Right.get(), Env);
     if (isError(Right))
       return Right;
 
-    return evalInfixExpression(InfixE->Operator, *Left, *Right);
+    return evalInfixExpression(InfixE->Op, *Left, *Right);
   }
 
-  const auto *BlockS = ast::astCast<const ast::BlockStatement *>(Node);
-  if (BlockS)
-    return evalBlockStatement(BlockS->Statements, Env);
+  case ast::ASTType::BLOCK_AST:
+    return evalBlockStatement(
+        static_cast<ast::BlockStatement *>(Node)->Statements, Env);
 
-  const auto *IfE = ast::astCast<const ast::IfExpression *>(Node);
-  if (IfE)
-    return evalIfExpression(IfE, Env);
+  case ast::ASTType::IF_AST:
+    return evalIfExpression(static_cast<ast::IfExpression *>(Node), Env);
 
-  const auto *ReturnS = ast::astCast<const ast::ReturnStatement *>(Node);
-  if (ReturnS) {
-    auto Value = eval(ReturnS->ReturnValue.get(), Env);
+  case ast::ASTType::RETURN_AST: {
+    const auto *ReturnS = static_cast<ast::ReturnStatement *>(Node);
+    auto *Value = evalNode(ReturnS->ReturnValue.get(), Env);
     if (isError(Value))
       return Value;
 
-    return object::makeReturn(std::move(Value));
+    return object::makeReturn(Value);
   }
 
-  const auto *LetS = ast::astCast<const ast::LetStatement *>(Node);
-  if (LetS) {
-    auto Value = eval(LetS->Value.get(), Env);
+  case ast::ASTType::LET_AST: {
+    const auto *LetS = static_cast<ast::LetStatement *>(Node);
+    auto *Value = evalNode(LetS->Value.get(), Env);
     if (isError(Value))
       return Value;
 
-    Env->set(LetS->Name->Value, std::move(Value));
+    // A 'let' always defines a variable of the environment it runs in.
+    Env->set(LetS->Name->Bindings.front().Slot, Value);
+    return nullptr;
   }
 
-  const auto *Identifier = ast::astCast<const ast::Identifier *>(Node);
-  if (Identifier)
-    return evalIdentifier(Identifier, Env);
-
-  auto *Function = ast::astCast<ast::FunctionLiteral *>(Node);
-  if (Function)
-    return object::makeFunction(std::move(Function->Parameters),
-                                std::move(Function->Body), Env);
+  case ast::ASTType::IDENTIFIER_AST:
+    return evalIdentifier(static_cast<ast::Identifier *>(Node), Env);
+
+  case ast::ASTType::FUNCTION_AST: {
+    auto Literal = shareLiteral(*static_cast<ast::FunctionLiteral *>(Node));
+    // The function keeps the literal alive while its body runs.
+    auto Run = std::make_shared<const object::Function::Code>(
+        [Body = Literal->Body.get()](environment::Environment *CallEnv) {
+          return evalNode(Body, CallEnv);
+        });
+    return object::makeFunction(std::move(Literal), std::move(Run), Env);
+  }
 
-  const auto *Call = ast::astCast<const ast::CallExpression *>(Node);
-  if (Call) {
-    auto CallFunc = eval(Call->Function.get(), Env);
-    if (isError(CallFunc))
-      return CallFunc;
+  case ast::ASTType::CALL_AST: {
+    const auto *Call = static_cast<ast::CallExpression *>(Node);
+    object::Ref<object::Object> CallFunc(evalNode(Call->Function.get(), Env));
+    if (isError(CallFunc.get()))
+      return CallFunc.get();
 
     auto Args = evalExpressions(Call->Arguments, Env);
     if (Args.size() == 1 && isError(Args.front()))
       return Args.front();
 
-    return applyFunction(CallFunc, Args);
+    return applyFunction(CallFunc.get(), Args);
   }
 
-  const auto *String = ast::astCast<const ast::String *>(Node);
-  if (String)
-    return object::makeString(String->Value);
+  case ast::ASTType::STRING_AST:
+    return object::makeString(static_cast<ast::String *>(Node)->Interned);
 
-  const auto *Array = ast::astCast<const ast::ArrayLiteral *>(Node);
-  if (Array) {
-    auto Elements = evalExpressions(Array->Elements, Env);
+  case ast::ASTType::ARRAY_AST: {
+    auto Elements = evalExpressions(
+        static_cast<ast::ArrayLiteral *>(Node)->Elements, Env);
     if (Elements.size() == 1 && isError(Elements.front()))
       return Elements.front();
 
     return object::makeArray(std::move(Elements));
   }
 
-  const auto *IndexExp = ast::astCast<const ast::IndexExpression *>(Node);
-  if (IndexExp) {
-    auto Left = eval(IndexExp->Left.get(), Env);
-    if (isError(Left))
-      return Left;
+  case ast::ASTType::INDEX_AST: {
+    const auto *IndexExp = static_cast<ast::IndexExpression *>(Node);
+    object::Ref<object::Object> Left(evalNode(IndexExp->Left.get(), Env));
+    if (isError(Left.get()))
+      return Left.get();
 
-    auto Index = eval(IndexExp->Index.get(), Env);
+    auto *Index = evalNode(IndexExp->Index.get(), Env);
     if (isError(Index))
       return Index;
 
-    return evalIndexExpression(Left, Index);
+    return evalIndexExpression(Left.get(), Index);
   }
 
-  const auto *Hash = ast::astCast<const ast::HashLiteral *>(Node);
-  if (Hash)
-    return evalHashLiteral(Hash, Env);
+  case ast::ASTType::HASH_AST:
+    return evalHashLiteral(static_cast<ast::HashLiteral *>(Node), Env);
+  }
 
   return nullptr;
 }
 
+} // namespace
+
+object::Object *eval(ast::Node *Node, environment::Environment *Env) {
+  gc::Root<environment::Environment> EnvRoot(Env);
+  resolve(Node, Env);
+  return evalNode(Node, Env);
+}
+
 } // namespace monkey::evaluator
@@ -6,7 +6,10 @@
 
 namespace monkey::evaluator {
 
-std::shared_ptr<object::Object>
-eval(ast::Node *, std::shared_ptr<environment::Environment> &);
+// The environment must be a global one, which the program's top-level
+// variables are added to. It and everything reachable from it is kept alive
+// while evaluating. The result is only guaranteed to survive until the next
+// collection unless the caller roots it.
+object::Object *eval(ast::Node *, environment::Environment *);
 
 } // namespace monkey::evaluator
@@ -1,18 +1,43 @@
+#include <Evaluator/ClosureCompiler.h>
 #include <Evaluator/Evaluator.h>
 #include <Parser/Parser.h>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <limits>
+
 namespace monkey::evaluator {
 
-std::shared_ptr<object::Object> testEval(const std::string &Input) {
-  lexer::Lexer L(Input);
-  parser::Parser P(L);
-  auto Program = P.parseProgram();
-  auto Env = std::make_shared<environment::Environment>();
-  return eval(Program.get(), Env);
-}
+enum class Engine { TREE_WALKING, CLOSURES };
+
+// Every test runs on both the tree-walking evaluator and the closures the
+// program compiles to.
+class EvaluatorTests : public testing::TestWithParam<Engine> {
+protected:
+  object::Object *evaluate(ast::Node *Node, environment::Environment *Env) {
+    if (GetParam() == Engine::CLOSURES)
+      return evalClosures(Node, Env);
+    return eval(Node, Env);
+  }
+
+  object::Object *testEval(const std::string &Input) {
+    lexer::Lexer L(Input);
+    parser::Parser P(L);
+    auto Program = P.parseProgram();
+    auto *Env = gc::heap().make<environment::Environment>();
+    return evaluate(Program.get(), Env);
+  }
+};
+
+INSTANTIATE_TEST_SUITE_P(Engines, EvaluatorTests,
+                         testing::Values(Engine::TREE_WALKING,
+                                         Engine::CLOSURES),
+                         [](const testing::TestParamInfo<Engine> &Info) {
+                           return Info.param == Engine::CLOSURES
+                                      ? "Closures"
+                                      : "TreeWalking";
+                         });
 
 void testIntegerObject(const object::Object *Obj, int64_t Expected) {
   const auto *IntegerObj = dynamic_cast<const object::Integer *>(Obj);
@@ -31,7 +56,7 @@ void testNullObject(const object::Object *Obj) {
   ASSERT_THAT(NullObj, testing::NotNull());
 }
 
-TEST(EvaluatorTests, testEvalIntegerExpressions) {
+TEST_P(EvaluatorTests, testEvalIntegerExpressions) {
   const std::vector<std::pair<std::string, int64_t>> Tests = {
       {"5", 5},
       {"10", 10},
@@ -51,11 +76,11 @@ TEST(EvaluatorTests, testEvalIntegerExpressions) {
 
   for (const auto &Test : Tests) {
     auto Evaluated = testEval(std::get<0>(Test));
-    testIntegerObject(Evaluated.get(), std::get<1>(Test));
+    testIntegerObject(Evaluated, std::get<1>(Test));
   }
 }
 
-TEST(EvaluatorTests, testEvalBooleanExpressions) {
+TEST_P(EvaluatorTests, testEvalBooleanExpressions) {
   const std::vector<std::pair<std::string, bool>> Tests = {
       {"true", true},
       {"false", false},
@@ -79,42 +104,32 @@ TEST(EvaluatorTests, testEvalBooleanExpressions) {
 
   for (const auto &Test : Tests) {
     auto Evaluated = testEval(std::get<0>(Test));
-    testBooleanObject(Evaluated.get(), std::get<1>(Test));
+    testBooleanObject(Evaluated, std::get<1>(Test));
   }
 }
 
-TEST(EvaluatorTests, testBangOperator) {
+TEST_P(EvaluatorTests, testBangOperator) {
   const std::vector<std::pair<std::string, bool>> Tests = {
       {"!true", false}, {"!false", true},   {"!5", false},
       {"!!true", true}, {"!!false", false}, {"!!5", true}};
 
   for (const auto &Test : Tests) {
     auto Evaluated = testEval(std::get<0>(Test));
-    testBooleanObject(Evaluated.get(), std::get<1>(Test));
+    testBooleanObject(Evaluated, std::get<1>(Test));
   }
 }
 
-void testIfElseExpressionInteger(const std::string &Input, int64_t Expected) {
-  auto Evaluated = testEval(Input);
-  testIntegerObject(Evaluated.get(), Expected);
-}
-
-void testIfElseExpressionNull(const std::string &Input) {
-  auto Evaluated = testEval(Input);
-  testNullObject(Evaluated.get());
+TEST_P(EvaluatorTests, testIfElseExpressions) {
+  testIntegerObject(testEval("if (true) { 10 }"), 10);
+  testNullObject(testEval("if (false) { 10 }"));
+  testIntegerObject(testEval("if (1) { 10 }"), 10);
+  testIntegerObject(testEval("if (1 < 2) { 10 }"), 10);
+  testNullObject(testEval("if (1 > 2) { 10 }"));
+  testIntegerObject(testEval("if (1 > 2) { 10 } else { 20 }"), 20);
+  testIntegerObject(testEval("if (1 < 2) { 10 } else { 20 }"), 10);
 }
 
-TEST(EvaluatorTests, testIfElseExpressions) {
-  testIfElseExpressionInteger("if (true) { 10 }", 10);
-  testIfElseExpressionNull("if (false) { 10 }");
-  testIfElseExpressionInteger("if (1) { 10 }", 10);
-  testIfElseExpressionInteger("if (1 < 2) { 10 }", 10);
-  testIfElseExpressionNull("if (1 > 2) { 10 }");
-  testIfElseExpressionInteger("if (1 > 2) { 10 } else { 20 }", 20);
-  testIfElseExpressionInteger("if (1 < 2) { 10 } else { 20 }", 10);
-}
-
-TEST(EvaluatorTests, testReturnStatements) {
+TEST_P(EvaluatorTests, testReturnStatements) {
   const std::vector<std::pair<std::string, int64_t>> Tests = {
       {"return 10;", 10},
       {"return 10; 9", 10},
@@ -123,11 +138,11 @@ TEST(EvaluatorTests, testReturnStatements) {
 
   for (const auto &Test : Tests) {
     auto Evaluated = testEval(std::get<0>(Test));
-    testIntegerObject(Evaluated.get(), std::get<1>(Test));
+    testIntegerObject(Evaluated, std::get<1>(Test));
   }
 }
 
-TEST(EvaluatorTests, testErrorHandling) {
+TEST_P(EvaluatorTests, testErrorHandling) {
   const std::vector<std::pair<std::string, std::string>> Tests = {
       {"5 + true;", "type mismatch: INTEGER + BOOLEAN"},
       {"5 + true; 5;", "type mismatch: INTEGER + BOOLEAN"},
@@ -151,36 +166,41 @@ TEST(EvaluatorTests, testErrorHandling) {
 
   for (const auto &Test : Tests) {
     auto Evaluated = testEval(std::get<0>(Test));
-    const auto *Error = dynamic_cast<object::Error *>(Evaluated.get());
+    const auto *Error = dynamic_cast<object::Error *>(Evaluated);
     ASSERT_THAT(Error, testing::NotNull());
     ASSERT_EQ(Error->Message, std::get<1>(Test));
   }
 }
 
-TEST(EvaluatorTests, testLetStatements) {
+TEST_P(EvaluatorTests, testLetStatements) {
   const std::vector<std::pair<std::string, int64_t>> Tests = {
       {"let a = 5; a;", 5},
       {"let a = 5 * 5; a;", 25},
       {"let a = 5; let b = a; b;", 5},
       {"let a = 5; let b = a; let c = a + b + 5; c;", 15}};
 
-  for (const auto &Test : Tests)
-    testIntegerObject(testEval(std::get<0>(Test)).get(), std::get<1>(Test));
+  for (const auto &Collecting :
+       {gc::HeapOptions{0, 0, 0.0, 0},
+        gc::HeapOptions{0, std::numeric_limits<size_t>::max(), 2.0, 0}}) {
+    gc::heap().configure(Collecting);
+    for (const auto &Test : Tests)
+      testIntegerObject(testEval(std::get<0>(Test)), std::get<1>(Test));
+  }
 }
 
-TEST(EvaluatorTests, testFunctionObject) {
+TEST_P(EvaluatorTests, testFunctionObject) {
   const std::string Input("fn(x) { x + 2; };");
   auto Evaluated = testEval(Input);
-  const auto *Function = dynamic_cast<object::Function *>(Evaluated.get());
+  const auto *Function = dynamic_cast<object::Function *>(Evaluated);
   ASSERT_THAT(Function, testing::NotNull());
-  ASSERT_EQ(Function->Parameters.size(), 1);
-  ASSERT_EQ(Function->Parameters.front()->string(), "x");
+  ASSERT_EQ(Function->Literal->Parameters.size(), 1);
+  ASSERT_EQ(Function->Literal->Parameters.front()->string(), "x");
 
   const std::string ExpectedBody("(x + 2)");
-  ASSERT_EQ(Function->Body->string(), ExpectedBody);
+  ASSERT_EQ(Function->Literal->Body->string(), ExpectedBody);
 }
 
-TEST(EvaluatorTests, testFunctionApplication) {
+TEST_P(EvaluatorTests, testFunctionApplication) {
   const std::vector<std::pair<std::string, int64_t>> Tests = {
       {"let identity = fn(x) { x; }; identity(5);", 5},
       {"let identity = fn(x) { return x; }; identity(5);", 5},
@@ -189,63 +209,217 @@ TEST(EvaluatorTests, testFunctionApplication) {
       {"let add = fn(x, y) { x + y; }; add(5 + 5, add(5, 5));", 20},
       {"fn(x) { x; }(5)", 5}};
 
-  for (const auto &Test : Tests)
-    testIntegerObject(testEval(std::get<0>(Test)).get(), std::get<1>(Test));
+  for (const auto &Collecting :
+       {gc::HeapOptions{0, 0, 0.0, 0},
+        gc::HeapOptions{0, std::numeric_limits<size_t>::max(), 2.0, 0}}) {
+    gc::heap().configure(Collecting);
+    for (const auto &Test : Tests)
+      testIntegerObject(testEval(std::get<0>(Test)), std::get<1>(Test));
+  }
 }
 
-TEST(EvaluatorTests, testClosures) {
+TEST_P(EvaluatorTests, testClosures) {
   const std::string Input("let newAdder = fn(x) {"
                           "fn(y) { x + y };"
                           "};"
                           "let addTwo = newAdder(2);"
                           "addTwo(2);");
 
-  testIntegerObject(testEval(Input).get(), 4);
+  testIntegerObject(testEval(Input), 4);
+}
+
+TEST_P(EvaluatorTests, testEvaluatingALiteralTwice) {
+  const std::vector<std::pair<std::string, int64_t>> Tests = {
+      {"let mk = fn(n) { fn(y) { n + y } };"
+       "let a = mk(1); let b = mk(2);"
+       "a(10) * 100 + b(10)",
+       1112},
+      {"let f = fn(n) {"
+       "let g = fn(x) { x + 1 };"
+       "if (n == 0) { g(0) } else { f(n - 1) + g(n) }"
+       "};"
+       "f(3)",
+       10}};
+
+  for (const auto &Test : Tests)
+    testIntegerObject(testEval(std::get<0>(Test)), std::get<1>(Test));
+}
+
+TEST_P(EvaluatorTests, testScopes) {
+  const std::vector<std::pair<std::string, int64_t>> Tests = {
+      // Parameters and lets shadow outer variables.
+      {"let x = 1; let f = fn(x) { x }; f(2) + x", 3},
+      {"let x = 1; let f = fn() { let x = 2; x }; f() + x", 3},
+      // Until a 'let' runs, the name still refers to the outer variable.
+      {"let x = 1; let f = fn() { let x = x + 10; x }; f()", 11},
+      {"let x = 1; let f = fn() { if (false) { let x = 2; }; x }; f()", 1},
+      // Lets in blocks define variables of the whole call.
+      {"let f = fn() { if (true) { let y = 5; }; y }; f()", 5},
+      {"if (true) { let y = 6; }; y", 6},
+      // Closures see variables defined after them.
+      {"let f = fn() { let g = fn() { h() }; let h = fn() { 7 }; g() }; f()",
+       7},
+      {"let f = fn() { g() }; let g = fn() { 8 }; f()", 8},
+      {"let a = fn(x) { fn(y) { fn(z) { x + y + z } } }; a(1)(2)(3)", 6},
+      {"let fib = fn(n) { if (n < 2) { n } else { fib(n - 1) + fib(n - 2) } };"
+       "fib(15)",
+       610},
+      {"let len = fn(x) { 9 }; len(\"\")", 9}};
+
+  for (const auto &Test : Tests)
+    testIntegerObject(testEval(Test.first), Test.second);
+
+  const auto *Error = dynamic_cast<const object::Error *>(
+      testEval("let f = fn() { if (false) { let z = 1; }; z }; f()"));
+  ASSERT_THAT(Error, testing::NotNull());
+  ASSERT_EQ(Error->Message, "identifier not found: z");
+}
+
+TEST_P(EvaluatorTests, testGlobalsOutliveTheProgram) {
+  gc::Root<environment::Environment> Env(
+      gc::heap().make<environment::Environment>());
+  const auto Evaluate = [this, &Env](const std::string &Input) {
+    lexer::Lexer L(Input);
+    parser::Parser P(L);
+    auto Program = P.parseProgram();
+    return evaluate(Program.get(), Env);
+  };
+
+  Evaluate("let f = fn() { g() + x };");
+  Evaluate("let g = fn() { 2 }; let x = 3;");
+  testIntegerObject(Evaluate("f()"), 5);
+  Evaluate("let x = 4;");
+  testIntegerObject(Evaluate("f()"), 6);
 }
 
-TEST(EvaluatorTests, testStringLiteral) {
+TEST_P(EvaluatorTests, testCollectingAtEveryCall) {
+  // Collect on every function application so that anything the evaluator
+  // forgets to root is freed while still in use. Minor collections alone also
+  // catch stores into old environments that skip the write barrier.
+  const auto Options = gc::heap().options();
+
+  const std::vector<std::pair<std::string, int64_t>> Tests = {
+      {"let newAdder = fn(x) { fn(y) { x + y } };"
+       "let addTwo = newAdder(2);"
+       "let add = fn(a, b) { a + b };"
+       "add(addTwo(1), addTwo(addTwo(3)));",
+       10},
+      {"let build = fn(n, acc) {"
+       "if (n == 0) { acc } else { build(n - 1, push(acc, [n, \"s\"])) }"
+       "};"
+       "build(20, [])[4][0];",
+       16},
+      {"let h = {\"a\": [1, 2], \"b\": fn() { 3 }};"
+       "let g = fn() { h[\"b\"]() };"
+       "g() + h[\"a\"][1];",
+       5}};
+
+  for (const auto &Collecting :
+       {gc::HeapOptions{0, 0, 0.0, 0},
+        gc::HeapOptions{0, std::numeric_limits<size_t>::max(), 2.0, 0}}) {
+    gc::heap().configure(Collecting);
+    for (const auto &Test : Tests)
+      testIntegerObject(testEval(std::get<0>(Test)), std::get<1>(Test));
+  }
+
+  // Functions and the environments they capture reference each other, which
+  // doesn't keep them alive.
+  gc::heap().collect();
+  ASSERT_EQ(gc::heap().stats().LiveBytes, 0u);
+  gc::heap().configure(Options);
+}
+
+TEST_P(EvaluatorTests, testSmallIntegersAreShared) {
+  const auto Stats = object::smallIntegerStats();
+
+  auto *Small = testEval("let a = 5; a * 2");
+  testIntegerObject(Small, 10);
+  ASSERT_EQ(Small, testEval("15 - 5"));
+  ASSERT_EQ(Small, object::makeInteger(10));
+  ASSERT_EQ(testEval("len([1, 2, 3])"), object::makeInteger(3));
+
+  const auto Large = object::SMALL_INTEGER_MAX + 1;
+  ASSERT_NE(object::makeInteger(Large), object::makeInteger(Large));
+  ASSERT_NE(object::makeInteger(object::SMALL_INTEGER_MIN - 1),
+            object::makeInteger(object::SMALL_INTEGER_MIN - 1));
+
+  ASSERT_GT(object::smallIntegerStats().Hits, Stats.Hits);
+  ASSERT_EQ(object::smallIntegerStats().Misses, Stats.Misses + 4);
+}
+
+TEST_P(EvaluatorTests, testStringLiteral) {
   const std::string Input("\"Hello World\"");
 
   auto Evaluated = testEval(Input);
-  const auto *S = dynamic_cast<const object::String *>(Evaluated.get());
+  const auto *S = dynamic_cast<const object::String *>(Evaluated);
   ASSERT_THAT(S, testing::NotNull());
-  ASSERT_EQ(S->Value, "Hello World");
+  ASSERT_EQ(S->value(), "Hello World");
 }
 
-TEST(EvaluatorTests, testStringConcatenation) {
+TEST_P(EvaluatorTests, testStringConcatenation) {
   const std::string Input("\"Hello\" + \" \" + \"World\"");
 
   auto Evaluated = testEval(Input);
-  const auto *S = dynamic_cast<const object::String *>(Evaluated.get());
+  const auto *S = dynamic_cast<const object::String *>(Evaluated);
+  ASSERT_THAT(S, testing::NotNull());
+  ASSERT_EQ(S->value(), "Hello World");
+}
+
+TEST_P(EvaluatorTests, testLongStringConcatenation) {
+  const std::string Build("let build = fn(s, n) {"
+                          "if (n == 0) { s } else { build(s + \"0123\", n - 1) }"
+                          "};");
+
+  testIntegerObject(testEval(Build + "len(build(\"\", 100))"), 400);
+  testIntegerObject(
+      testEval(Build + "{build(\"\", 100): 1}[build(\"\", 100)]"), 1);
+
+  auto Evaluated = testEval(Build + "\"<\" + build(\"\", 20) + \">\"");
+  const auto *S = dynamic_cast<const object::String *>(Evaluated);
   ASSERT_THAT(S, testing::NotNull());
-  ASSERT_EQ(S->Value, "Hello World");
+  std::string Expected = "<";
+  for (int I = 0; I < 20; ++I)
+    Expected += "0123";
+  ASSERT_EQ(S->value(), Expected + ">");
 }
 
-TEST(EvaluatorTests, testBuiltinFunctions) {
+TEST_P(EvaluatorTests, testBuiltinFunctions) {
   const std::vector<std::pair<std::string, int64_t>> Tests = {
-      {"len(\"\")", 0}, {"len(\"four\")", 4}, {"len(\"hello world\")", 11}};
+      {"len(\"\")", 0},
+      {"len(\"four\")", 4},
+      {"len(\"hello world\")", 11},
+      {"let a = [1, 2]; let b = push(a, 3); let c = push(a, 4);"
+       "last(b) * 10 + last(c) + len(a)",
+       36},
+      {"let a = rest([1, 2, 3]); let b = push(a, 4); len(a) * 10 + last(b)",
+       24},
+      {"len(rest(push(rest([1, 2, 3]), 4)))", 2},
+      {"let h = {\"a\": 1}; let g = assoc(assoc(h, \"b\", 2), \"a\", 3);"
+       "g[\"a\"] + g[\"b\"] + h[\"a\"]",
+       6},
+      {"let h = dissoc({\"a\": 1, \"b\": 2}, \"a\"); h[\"b\"]", 2}};
 
   for (const auto &Test : Tests) {
     auto Evaluated = testEval(std::get<0>(Test));
-    const auto *S = dynamic_cast<const object::Integer *>(Evaluated.get());
+    const auto *S = dynamic_cast<const object::Integer *>(Evaluated);
     ASSERT_THAT(S, testing::NotNull());
     ASSERT_EQ(S->Value, std::get<1>(Test));
   }
 }
 
-TEST(EvaluatorTests, testArrayLiterals) {
+TEST_P(EvaluatorTests, testArrayLiterals) {
   const std::string Input("[1, 2 * 2, 3 + 3]");
 
   auto Evaluated = testEval(Input);
-  const auto *AL = dynamic_cast<const object::Array *>(Evaluated.get());
+  const auto *AL = dynamic_cast<const object::Array *>(Evaluated);
   ASSERT_THAT(AL, testing::NotNull());
-  ASSERT_EQ(AL->Elements.size(), 3);
-  testIntegerObject(AL->Elements.at(0).get(), 1);
-  testIntegerObject(AL->Elements.at(1).get(), 4);
-  testIntegerObject(AL->Elements.at(2).get(), 6);
+  ASSERT_EQ(AL->size(), 3);
+  testIntegerObject((*AL)[0], 1);
+  testIntegerObject((*AL)[1], 4);
+  testIntegerObject((*AL)[2], 6);
 }
 
-TEST(EvaluatorTests, testArrayIndexExpressions) {
+TEST_P(EvaluatorTests, testArrayIndexExpressions) {
   const std::vector<std::pair<std::string, int64_t>> Tests = {
       {"[1, 2, 3][0]", 1},
       {"[1, 2, 3][1]", 2},
@@ -258,18 +432,18 @@ TEST(EvaluatorTests, testArrayIndexExpressions) {
 
   for (const auto &Test : Tests) {
     auto Evaluated = testEval(std::get<0>(Test));
-    testIntegerObject(Evaluated.get(), std::get<1>(Test));
+    testIntegerObject(Evaluated, std::get<1>(Test));
   }
 
   const std::vector<std::string> NullTests = {"[1, 2, 3][3]", "[1, 2, 3][-1]"};
 
   for (const auto &NullTest : NullTests) {
     auto Evaluated = testEval(NullTest);
-    testNullObject(Evaluated.get());
+    testNullObject(Evaluated);
   }
 }
 
-TEST(EvaluatorTests, testHashLiterals) {
+TEST_P(EvaluatorTests, testHashLiterals) {
   const std::string Input("let two = \"two\";"
                           "{"
                           "\"one\": 10 - 9,"
@@ -281,45 +455,57 @@ TEST(EvaluatorTests, testHashLiterals) {
                           "}");
 
   auto Evaluated = testEval(Input);
-  const auto *Hash = dynamic_cast<const object::Hash *>(Evaluated.get());
+  const auto *Hash = dynamic_cast<const object::Hash *>(Evaluated);
   ASSERT_THAT(Hash, testing::NotNull());
 
-  const std::vector<std::pair<object::HashKey, int64_t>> Expected = {
-      {object::HashKey(std::make_shared<object::String>("one")), 1},
-      {object::HashKey(std::make_shared<object::String>("two")), 2},
-      {object::HashKey(std::make_shared<object::String>("three")), 3},
-      {object::HashKey(std::make_shared<object::Integer>(4)), 4},
-      {object::HashKey(std::make_shared<object::Boolean>(true)), 5},
-      {object::HashKey(std::make_shared<object::Boolean>(false)), 6}};
+  const std::vector<std::pair<std::shared_ptr<object::Object>, int64_t>>
+      Expected = {
+          {std::make_shared<object::String>("one"), 1},
+          {std::make_shared<object::String>("two"), 2},
+          {std::make_shared<object::String>("three"), 3},
+          {std::make_shared<object::Integer>(4), 4},
+          {std::make_shared<object::Boolean>(true), 5},
+          {std::make_shared<object::Boolean>(false), 6}};
 
   ASSERT_EQ(Hash->Pairs.size(), Expected.size());
 
   for (const auto &E : Expected) {
-    const auto Iter = Hash->Pairs.find(E.first);
+    const auto Iter = Hash->Pairs.find(object::HashKey(E.first.get()));
     ASSERT_NE(Iter, Hash->Pairs.end());
-    testIntegerObject(Iter->second.get(), E.second);
+    testIntegerObject(Iter->second, E.second);
   }
 }
 
-TEST(EvaluatorTests, testHashIndexExpressions) {
+TEST_P(EvaluatorTests, testHashIndexExpressions) {
   const std::vector<std::pair<std::string, int64_t>> Tests = {
       {"{\"foo\": 5}[\"foo\"]", 5},
       {"let key = \"foo\"; {\"foo\": 5}[key]", 5},
       {"{5: 5}[5]", 5},
       {"{true: 5}[true]", 5},
-      {"{false: 5}[false]", 5}};
+      {"{false: 5}[false]", 5},
+      {"{1: 1, true: 2, \"1\": 3}[true]", 2},
+      // Keys of every length the string hash reads differently.
+      {"let k = fn(s) { s + \"\" };"
+       "let h = {\"\": 1, \"ab\": 2, \"abcdefghij\": 3,"
+       "\"abcdefghijklmnopqrstuvwxyz\": 4,"
+       "\"abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz\": 5};"
+       "h[k(\"\")] + h[k(\"ab\")] + h[k(\"abcdefghij\")] +"
+       "h[k(\"abcdefghijklmnopqrstuvwxyz\")] +"
+       "h[k(\"abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz\")]",
+       15}};
 
   for (const auto &Test : Tests) {
     auto Evaluated = testEval(std::get<0>(Test));
-    testIntegerObject(Evaluated.get(), std::get<1>(Test));
+    testIntegerObject(Evaluated, std::get<1>(Test));
   }
 
-  const std::vector<std::string> NullTests = {"{\"foo\": 5}[\"bar\"]",
-                                              "{}[\"foo\"]"};
+  const std::vector<std::string> NullTests = {
+      "{\"foo\": 5}[\"bar\"]", "{}[\"foo\"]", "{1: 5}[true]",
+      "{\"abcdefghijklmnopq\": 5}[\"abcdefghijklmnopr\"]"};
 
   for (const auto &Test : NullTests) {
     auto Evaluated = testEval(Test);
-    testNullObject(Evaluated.get());
+    testNullObject(Evaluated);
   }
 }
 
@@ -0,0 +1,306 @@
+#include "Operations.h"
+
+#include <Object/BuiltIns.h>
+
+#include <algorithm>
+#include <cassert>
+
+namespace monkey::evaluator {
+
+namespace {
+
+object::Object *evalBangOperatorExpression(const object::Object &Right) {
+  const auto *Boolean = object::objCast<const object::Boolean *>(&Right);
+  if (Boolean)
+    return object::nativeBooleanToBooleanObject(!Boolean->Value);
+
+  const auto *Null = object::objCast<const object::Null *>(&Right);
+  if (Null)
+    return object::NULL_GLOBAL;
+
+  return object::FALSE_GLOBAL;
+}
+
+object::Object *evalMinusPrefixOperatorExpression(const object::Object &Right) {
+  if (Right.type() != object::ObjectType::INTEGER_OBJ)
+    return object::newError("unknown operator: -%s",
+                            object::objTypeToString(Right.type()));
+
+  const auto *Integer = object::objCast<const object::Integer *>(&Right);
+  if (!Integer)
+    return object::NULL_GLOBAL;
+
+  return object::makeInteger(-Integer->Value);
+}
+
+object::Object *evalIntegerInfixExpression(ast::OperatorType Op,
+                                           const object::Object &Left,
+                                           const object::Object &Right) {
+  const auto *LeftInt = object::objCast<const object::Integer *>(&Left);
+  assert(LeftInt);
+  const auto *RightInt = object::objCast<const object::Integer *>(&Right);
+  assert(RightInt);
+
+  switch (Op) {
+  case ast::OperatorType::PLUS:
+    return object::makeInteger(LeftInt->Value + RightInt->Value);
+  case ast::OperatorType::MINUS:
+    return object::makeInteger(LeftInt->Value - RightInt->Value);
+  case ast::OperatorType::ASTERISK:
+    return object::makeInteger(LeftInt->Value * RightInt->Value);
+  case ast::OperatorType::SLASH:
+    return object::makeInteger(LeftInt->Value / RightInt->Value);
+  case ast::OperatorType::LT:
+    return object::nativeBooleanToBooleanObject(LeftInt->Value <
+                                                RightInt->Value);
+  case ast::OperatorType::GT:
+    return object::nativeBooleanToBooleanObject(LeftInt->Value >
+                                                RightInt->Value);
+  case ast::OperatorType::EQ:
+    return object::nativeBooleanToBooleanObject(LeftInt->Value ==
+                                                RightInt->Value);
+  case ast::OperatorType::NOT_EQ:
+    return object::nativeBooleanToBooleanObject(LeftInt->Value !=
+                                                RightInt->Value);
+  default:
+    return object::newError(
+        "unknown operator: %s %s %s", object::objTypeToString(Left.type()),
+        ast::operatorToString(Op), object::objTypeToString(Right.type()));
+  }
+}
+
+object::Object *
+evalBooleanInfixExpression(ast::OperatorType Op, const object::Object &Left,
+                           const object::Object &Right) {
+  const bool BothEqual = [&Left, &Right]() {
+    if ((Left.type() == object::ObjectType::BOOLEAN_OBJ) ^
+        (Right.type() == object::ObjectType::BOOLEAN_OBJ))
+      return false;
+
+    const auto *L = object::objCast<const object::Boolean *>(&Left);
+    const auto *R = object::objCast<const object::Boolean *>(&Right);
+    assert(L);
+    assert(R);
+
+    return L->Value == R->Value;
+  }();
+
+  if (Op == ast::OperatorType::EQ)
+    return object::nativeBooleanToBooleanObject(BothEqual);
+  else if (Op == ast::OperatorType::NOT_EQ)
+    return object::nativeBooleanToBooleanObject(!BothEqual);
+  else {
+    if ((Left.type() == object::ObjectType::BOOLEAN_OBJ) ^
+        (Right.type() == object::ObjectType::BOOLEAN_OBJ))
+      return object::newError(
+          "type mismatch: %s %s %s", object::objTypeToString(Left.type()),
+          ast::operatorToString(Op), object::objTypeToString(Right.type()));
+    else
+      return object::newError(
+          "unknown operator: %s %s %s", object::objTypeToString(Left.type()),
+          ast::operatorToString(Op), object::objTypeToString(Right.type()));
+  }
+}
+
+object::Object *
+evalNullInfixExpression(ast::OperatorType Op, const object::Object &Left,
+                        const object::Object &Right) {
+  const bool BothNull = Left.type() == object::ObjectType::NULL_OBJ &&
+                        Right.type() == object::ObjectType::NULL_OBJ;
+
+  if (Op == ast::OperatorType::EQ)
+    return object::nativeBooleanToBooleanObject(BothNull);
+  else if (Op == ast::OperatorType::NOT_EQ)
+    return object::nativeBooleanToBooleanObject(!BothNull);
+  else
+    return object::NULL_GLOBAL;
+}
+
+object::Object *
+evalStringInfixExpression(ast::OperatorType Op, const object::Object &Left,
+                          const object::Object &Right) {
+  if (Op != ast::OperatorType::PLUS)
+    return object::newError(
+        "unknown operator: %s %s %s", object::objTypeToString(Left.type()),
+        ast::operatorToString(Op), object::objTypeToString(Right.type()));
+
+  const auto *LeftS = object::objCast<const object::String *>(&Left);
+  const auto *RightS = object::objCast<const object::String *>(&Right);
+  assert(LeftS);
+  assert(RightS);
+  return object::concatenate(LeftS, RightS);
+}
+
+object::Object *
+evalArrayIndexExpression(object::Object *Array, object::Object *Index) {
+  const auto *ArrayObj = object::objCast<const object::Array *>(Array);
+  assert(ArrayObj);
+  const auto *Idx = object::objCast<const object::Integer *>(Index);
+  assert(Idx);
+
+  if (Idx->Value < 0 ||
+      Idx->Value >= static_cast<int64_t>(ArrayObj->size()))
+    return object::NULL_GLOBAL;
+
+  return (*ArrayObj)[Idx->Value];
+}
+
+object::Object *
+evalHashIndexExpression(object::Object *Hash, object::Object *Index) {
+  const auto *HashObj = object::objCast<const object::Hash *>(Hash);
+  assert(HashObj);
+
+  const object::HashKey HK(Index);
+  if (!object::hasHashKey(HK))
+    return object::newError("unusable as hash key: %s",
+                            object::objTypeToString(Index->type()));
+
+  if (auto *Found = HashObj->find(Index))
+    return Found;
+  return object::NULL_GLOBAL;
+}
+
+environment::Environment *
+extendFunctionEnv(const object::Function *Fn,
+                  const std::vector<object::Object *> &Args) {
+  const auto &Literal = *Fn->Literal;
+  auto *Env =
+      gc::heap().make<environment::Environment>(Fn->Env, Literal.NumSlots);
+  assert(Literal.Parameters.size() == Args.size());
+  // The parameters come first.
+  const auto NumArgs = std::min(Args.size(), Literal.Parameters.size());
+  for (size_t I = 0; I < NumArgs; ++I)
+    Env->set(I, Args[I]);
+
+  return Env;
+}
+
+object::Object *unwrapReturnValue(object::Object *Obj) {
+  const auto *ReturnValue = object::objCast<object::ReturnValue *>(Obj);
+  if (ReturnValue)
+    return ReturnValue->Value;
+
+  return Obj;
+}
+
+} // namespace
+
+bool isError(const object::Object *Obj) {
+  return Obj && Obj->type() == object::ObjectType::ERROR_OBJ;
+}
+
+bool isTruthy(const object::Object *Obj) {
+  const auto *NullObj = object::objCast<const object::Null *>(Obj);
+  if (NullObj)
+    return false;
+
+  const auto *BooleanObj = object::objCast<const object::Boolean *>(Obj);
+  if (BooleanObj)
+    return BooleanObj->Value;
+
+  return true;
+}
+
+object::Object *evalPrefixExpression(ast::OperatorType Op,
+                                     const object::Object &Right) {
+  switch (Op) {
+  case ast::OperatorType::BANG:
+    return evalBangOperatorExpression(Right);
+  case ast::OperatorType::MINUS:
+    return evalMinusPrefixOperatorExpression(Right);
+  default:
+    return object::newError("unknown operator: %s:%s",
+                            ast::operatorToString(Op),
+                            object::objTypeToString(Right.type()));
+  }
+}
+
+object::Object *
+evalInfixExpression(ast::OperatorType Op, const object::Object &Left,
+                    const object::Object &Right) {
+  if (Left.type() == object::ObjectType::INTEGER_OBJ &&
+      Right.type() == object::ObjectType::INTEGER_OBJ)
+    return evalIntegerInfixExpression(Op, Left, Right);
+  else if (Left.type() == object::ObjectType::NULL_OBJ ||
+           Right.type() == object::ObjectType::NULL_OBJ)
+    return evalNullInfixExpression(Op, Left, Right);
+  else if (Left.type() == object::ObjectType::BOOLEAN_OBJ ||
+           Right.type() == object::ObjectType::BOOLEAN_OBJ)
+    return evalBooleanInfixExpression(Op, Left, Right);
+  else if (Left.type() == object::ObjectType::STRING_OBJ ||
+           Right.type() == object::ObjectType::STRING_OBJ)
+    return evalStringInfixExpression(Op, Left, Right);
+  else if (Left.type() != Right.type())
+    return object::newError(
+        "type mismatch: %s %s %s", object::objTypeToString(Left.type()),
+        ast::operatorToString(Op), object::objTypeToString(Right.type()));
+  else
+    return object::newError(
+        "unknown operator: %s %s %s", object::objTypeToString(Left.type()),
+        ast::operatorToString(Op), object::objTypeToString(Right.type()));
+}
+
+object::Object *
+evalIndexExpression(object::Object *Left, object::Object *Index) {
+  if (Left->type() == object::ObjectType::ARRAY_OBJ &&
+      Index->type() == object::ObjectType::INTEGER_OBJ)
+    return evalArrayIndexExpression(Left, Index);
+  else if (Left->type() == object::ObjectType::HASH_OBJ)
+    return evalHashIndexExpression(Left, Index);
+
+  return object::newError("index operator not supported: %s",
+                          object::objTypeToString(Left->type()));
+}
+
+object::Object *
+applyFunction(object::Object *Fn, const std::vector<object::Object *> &Args) {
+  const auto *Function = object::objCast<const object::Function *>(Fn);
+  if (Function) {
+    // The caller keeps the function, and with it its body, alive.
+    gc::Root<environment::Environment> ExtendedEnv(
+        extendFunctionEnv(Function, Args));
+    gc::heap().safePoint();
+
+    auto *Evaluated = (*Function->Run)(ExtendedEnv);
+    return unwrapReturnValue(Evaluated);
+  }
+
+  const auto *BuiltIn = object::objCast<const object::BuiltIn *>(Fn);
+  if (BuiltIn) {
+    const std::vector<object::Value> Values(Args.begin(), Args.end());
+    return BuiltIn->Fn(Values).toObject();
+  }
+
+  return object::newError("not a function %s",
+                          object::objTypeToString(Fn->type()));
+}
+
+object::BuiltIn *findBuiltIn(const std::string &Name) {
+  const auto BIter =
+      std::find_if(object::BUILTINS.begin(), object::BUILTINS.end(),
+                   [&Name](const auto &Fn) { return Fn.first == Name; });
+
+  return BIter != object::BUILTINS.end() ? BIter->second.get() : nullptr;
+}
+
+object::Object *unboundIdentifier(const std::string &Name) {
+  if (auto *BuiltIn = findBuiltIn(Name))
+    return BuiltIn;
+
+  return object::newError("identifier not found: %s", Name.c_str());
+}
+
+std::shared_ptr<const ast::FunctionLiteral>
+shareLiteral(ast::FunctionLiteral &Function) {
+  if (!Function.Shared) {
+    auto Literal = std::make_shared<ast::FunctionLiteral>(
+        Function.Tok, std::move(Function.Parameters),
+        std::move(Function.Body));
+    Literal->NumSlots = Function.NumSlots;
+    Function.Shared = std::move(Literal);
+  }
+
+  return Function.Shared;
+}
+
+} // namespace monkey::evaluator
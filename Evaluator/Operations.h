@@ -0,0 +1,44 @@
+#pragma once
+
+#include <AST/AST.h>
+#include <Environment/Environment.h>
+#include <Object/Object.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace monkey::evaluator {
+
+// What the tree-walking evaluator and the closures that 'evalClosures'
+// compiles do once they have evaluated the operands.
+
+bool isError(const object::Object *);
+// Only false and null are falsy.
+bool isTruthy(const object::Object *);
+
+object::Object *evalPrefixExpression(ast::OperatorType,
+                                     const object::Object &Right);
+object::Object *evalInfixExpression(ast::OperatorType,
+                                    const object::Object &Left,
+                                    const object::Object &Right);
+object::Object *evalIndexExpression(object::Object *Left,
+                                    object::Object *Index);
+
+// Calls a function or a builtin. Functions run their body in a new
+// environment, which is a safe point.
+object::Object *applyFunction(object::Object *,
+                              const std::vector<object::Object *> &Args);
+
+// The builtin with the name or nullptr.
+object::BuiltIn *findBuiltIn(const std::string &Name);
+// The builtin with the name, or an error if there is none. Used for
+// identifiers whose bindings are all unset.
+object::Object *unboundIdentifier(const std::string &Name);
+
+// Moves the parameters and the body out of the literal the first time, so
+// that all the functions made from it share them.
+std::shared_ptr<const ast::FunctionLiteral>
+shareLiteral(ast::FunctionLiteral &);
+
+} // namespace monkey::evaluator
@@ -0,0 +1,147 @@
+#include "Resolver.h"
+
+#include <unordered_map>
+
+namespace monkey::evaluator {
+
+namespace {
+
+template <typename T> T *mutableCast(ast::Node *Node) {
+  return const_cast<T *>(ast::astCast<const T *>(Node));
+}
+
+// Calls 'Fn' with each child of the node that can contain identifiers. The
+// name of a 'let' is left to the caller.
+template <typename F> void forEachChild(ast::Node *Node, F &&Fn) {
+  const auto Visit = [&Fn](const auto &Child) {
+    if (Child)
+      Fn(Child.get());
+  };
+
+  if (auto *Program = mutableCast<ast::Program>(Node)) {
+    for (const auto &Statement : Program->Statements)
+      Visit(Statement);
+  } else if (auto *Block = mutableCast<ast::BlockStatement>(Node)) {
+    for (const auto &Statement : Block->Statements)
+      Visit(Statement);
+  } else if (auto *ExprS = mutableCast<ast::ExpressionStatement>(Node)) {
+    Visit(ExprS->Expr);
+  } else if (auto *Let = mutableCast<ast::LetStatement>(Node)) {
+    Visit(Let->Value);
+  } else if (auto *Return = mutableCast<ast::ReturnStatement>(Node)) {
+    Visit(Return->ReturnValue);
+  } else if (auto *Prefix = mutableCast<ast::PrefixExpression>(Node)) {
+    Visit(Prefix->Right);
+  } else if (auto *Infix = mutableCast<ast::InfixExpression>(Node)) {
+    Visit(Infix->Left);
+    Visit(Infix->Right);
+  } else if (auto *If = mutableCast<ast::IfExpression>(Node)) {
+    Visit(If->Condition);
+    Visit(If->Consequence);
+    Visit(If->Alternative);
+  } else if (auto *Function = ast::astCast<ast::FunctionLiteral *>(Node)) {
+    Visit(Function->Body);
+  } else if (auto *Call = mutableCast<ast::CallExpression>(Node)) {
+    Visit(Call->Function);
+    for (const auto &Arg : Call->Arguments)
+      Visit(Arg);
+  } else if (auto *Array = mutableCast<ast::ArrayLiteral>(Node)) {
+    for (const auto &Elem : Array->Elements)
+      Visit(Elem);
+  } else if (auto *Index = mutableCast<ast::IndexExpression>(Node)) {
+    Visit(Index->Left);
+    Visit(Index->Index);
+  } else if (auto *Hash = mutableCast<ast::HashLiteral>(Node)) {
+    for (const auto &P : Hash->Pairs) {
+      Visit(P.first);
+      Visit(P.second);
+    }
+  }
+}
+
+class Resolver {
+public:
+  explicit Resolver(environment::Environment *Globals) : Globals(Globals) {}
+
+  void resolve(ast::Node *Node) {
+    if (auto *Identifier = mutableCast<ast::Identifier>(Node)) {
+      bind(*Identifier);
+      return;
+    }
+
+    if (auto *Let = mutableCast<ast::LetStatement>(Node))
+      bind(*Let->Name);
+
+    if (auto *Function = ast::astCast<ast::FunctionLiteral *>(Node)) {
+      resolveFunction(*Function);
+      return;
+    }
+
+    forEachChild(Node, [this](ast::Node *Child) { resolve(Child); });
+  }
+
+private:
+  using Scope = std::unordered_map<object::InternedString, uint32_t>;
+
+  void resolveFunction(ast::FunctionLiteral &Function) {
+    // Evaluating a literal moves its body into 'Shared', which was resolved
+    // before that.
+    if (!Function.Body)
+      return;
+
+    Scopes.emplace_back();
+    for (const auto &Param : Function.Parameters)
+      declare(Param->Interned);
+    // Variables can be read before their 'let', for instance by a closure.
+    declareLets(Function.Body.get());
+
+    for (const auto &Param : Function.Parameters)
+      bind(*Param);
+    resolve(Function.Body.get());
+
+    Function.NumSlots = Scopes.back().size();
+    Scopes.pop_back();
+  }
+
+  void declare(const object::InternedString &Name) {
+    auto &Current = Scopes.back();
+    Current.emplace(Name, static_cast<uint32_t>(Current.size()));
+  }
+
+  void declareLets(ast::Node *Node) {
+    if (ast::astCast<ast::FunctionLiteral *>(Node))
+      return;
+
+    if (auto *Let = mutableCast<ast::LetStatement>(Node))
+      declare(Let->Name->Interned);
+
+    forEachChild(Node, [this](ast::Node *Child) { declareLets(Child); });
+  }
+
+  void bind(ast::Identifier &Identifier) {
+    Identifier.Bindings.clear();
+
+    const auto Depth = static_cast<uint32_t>(Scopes.size());
+    for (uint32_t I = 0; I < Depth; ++I) {
+      const auto &S = Scopes[Depth - 1 - I];
+      const auto Iter = S.find(Identifier.Interned);
+      if (Iter != S.end())
+        Identifier.Bindings.push_back({I, Iter->second});
+    }
+
+    const auto Global = Globals->globalSlot(Identifier.Interned);
+    Identifier.Bindings.push_back({Depth, static_cast<uint32_t>(Global)});
+  }
+
+  environment::Environment *Globals;
+  // The scopes of the functions around the node, innermost last.
+  std::vector<Scope> Scopes;
+};
+
+} // namespace
+
+void resolve(ast::Node *Node, environment::Environment *Globals) {
+  Resolver(Globals).resolve(Node);
+}
+
+} // namespace monkey::evaluator
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <AST/AST.h>
+#include <Environment/Environment.h>
+
+namespace monkey::evaluator {
+
+// Bind every identifier of the program to the environment slots it can be
+// read from, and count the slots each function literal needs. Top-level
+// variables become slots of the global environment, which keeps them for the
+// programs evaluated after this one.
+//
+// Names are scoped like the evaluator always did: a 'let' anywhere in a
+// function, outside of nested functions, declares a variable of every call,
+// and names that no function declares are globals. Names that aren't defined
+// at all still get a global slot, which stays empty unless a later program
+// defines them.
+void resolve(ast::Node *, environment::Environment *Globals);
+
+} // namespace monkey::evaluator
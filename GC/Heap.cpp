@@ -0,0 +1,337 @@
+#include "Heap.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace monkey::gc {
+
+namespace {
+
+const size_t PAGE_SIZE = 64 << 10;
+const size_t GRANULE = 16;
+// Cells larger than this get an allocation of their own.
+const size_t MAX_SMALL_SIZE = 512;
+const size_t NUM_SIZE_CLASSES = MAX_SMALL_SIZE / GRANULE;
+
+size_t sizeClass(size_t Size) { return (Size + GRANULE - 1) / GRANULE - 1; }
+size_t classSize(size_t SizeClass) { return (SizeClass + 1) * GRANULE; }
+
+} // namespace
+
+// Free cells start with a null word where live cells have their vtable
+// pointer, which is how sweeping tells them apart.
+struct Heap::FreeCell {
+  void *Null;
+  FreeCell *Next;
+};
+
+struct Heap::Page {
+  explicit Page(size_t SizeClass)
+      : SizeClass(SizeClass),
+        Memory(static_cast<char *>(std::malloc(PAGE_SIZE))),
+        End(Memory + PAGE_SIZE / classSize(SizeClass) * classSize(SizeClass)),
+        Cursor(Memory) {
+    if (!Memory)
+      throw std::bad_alloc();
+  }
+  ~Page() { std::free(Memory); }
+
+  void *take(size_t Size) {
+    if (Cursor != End) {
+      void *Slot = Cursor;
+      Cursor += Size;
+      return Slot;
+    }
+
+    auto *Slot = FreeList;
+    if (Slot)
+      FreeList = Slot->Next;
+    return Slot;
+  }
+
+  bool full() const { return Cursor == End && !FreeList; }
+
+  const size_t SizeClass;
+  char *const Memory;
+  // The end of the last cell that fits.
+  char *const End;
+  // Cells at and above the cursor have never been allocated.
+  char *Cursor;
+  FreeCell *FreeList = nullptr;
+  // Whether cells were allocated here since the last collection.
+  bool HasYoung = false;
+};
+
+void Tracer::mark(Cell *C) {
+  if (C->MarkEpoch == Epoch || (Minor && C->Old))
+    return;
+
+  C->MarkEpoch = Epoch;
+  Worklist.push_back(C);
+}
+
+void Tracer::drain() {
+  while (!Worklist.empty()) {
+    auto *C = Worklist.back();
+    Worklist.pop_back();
+    C->trace(*this);
+  }
+}
+
+Heap::Heap()
+    : Created(std::chrono::steady_clock::now()), SinceCollection(0),
+      SinceMajor(0), Threshold(Options.MinThreshold), Epoch(0),
+      Spaces(NUM_SIZE_CLASSES), OldLargeCells(0) {}
+
+Heap::~Heap() {
+  // Nothing is marked with a future epoch so this destroys every cell.
+  sweep(Epoch + 1, false);
+}
+
+void Heap::configure(const HeapOptions &NewOptions) {
+  Options = NewOptions;
+  Threshold = Options.MinThreshold;
+}
+
+double Heap::allocationRate() const {
+  const auto Mutator =
+      std::chrono::steady_clock::now() - Created - Stats.PauseTime;
+  const auto Seconds = std::chrono::duration<double>(Mutator).count();
+  return Seconds > 0 ? static_cast<double>(Stats.AllocatedBytes) / Seconds
+                     : 0.0;
+}
+
+void Heap::collectYoung() {
+  const auto Start = std::chrono::steady_clock::now();
+  mark(true);
+  sweep(Epoch, true);
+  ++Stats.MinorCollections;
+  recordPause(Start);
+
+  if (SinceMajor >= Threshold ||
+      (Options.MaxHeapSize && Stats.LiveBytes > Options.MaxHeapSize))
+    collect();
+}
+
+void Heap::collect() {
+  const auto Start = std::chrono::steady_clock::now();
+  mark(false);
+  sweep(Epoch, false);
+  SinceMajor = 0;
+  Threshold = std::max(
+      Options.MinThreshold,
+      static_cast<size_t>(static_cast<double>(Stats.LiveBytes) *
+                          Options.GrowthFactor));
+  recordPause(Start);
+
+  if (Options.MaxHeapSize && Stats.LiveBytes > Options.MaxHeapSize)
+    throw std::runtime_error("out of memory");
+}
+
+void Heap::addRoots(RootProvider *R) { Roots.push_back(R); }
+
+void Heap::removeRoots(RootProvider *R) {
+  // Roots are almost always removed in the reverse order they were added.
+  const auto Iter = std::find(Roots.rbegin(), Roots.rend(), R);
+  if (Iter != Roots.rend())
+    Roots.erase(std::next(Iter).base());
+}
+
+void *Heap::allocate(size_t Size) {
+  void *Memory;
+
+  if (Size > MAX_SMALL_SIZE) {
+    Memory = std::malloc(Size);
+    if (!Memory)
+      throw std::bad_alloc();
+
+    LargeCells.emplace_back(static_cast<Cell *>(Memory), Size);
+    Stats.HeapBytes += Size;
+  } else {
+    const auto SizeClass = sizeClass(Size);
+    Size = classSize(SizeClass);
+    auto &S = Spaces[SizeClass];
+    Memory = S.Current ? S.Current->take(Size) : nullptr;
+    if (!Memory) {
+      S.Current = nextPage(SizeClass);
+      Memory = S.Current->take(Size);
+    }
+  }
+
+  Stats.AllocatedBytes += Size;
+  Stats.LiveBytes += Size;
+  SinceCollection += Size;
+  return Memory;
+}
+
+// Give back memory whose cell was never constructed.
+void Heap::deallocate(void *Memory, size_t Size) {
+  if (Size > MAX_SMALL_SIZE) {
+    const auto Iter = std::find_if(
+        LargeCells.rbegin(), LargeCells.rend(),
+        [Memory](const auto &Large) { return Large.first == Memory; });
+    LargeCells.erase(std::next(Iter).base());
+    std::free(Memory);
+    Stats.HeapBytes -= Size;
+  } else {
+    // The next collection sweeps the page and reuses the cell.
+    Size = classSize(sizeClass(Size));
+    new (Memory) FreeCell{nullptr, nullptr};
+  }
+
+  Stats.AllocatedBytes -= Size;
+  Stats.LiveBytes -= Size;
+  SinceCollection -= Size;
+}
+
+Heap::Page *Heap::nextPage(size_t SizeClass) {
+  auto &Available = Spaces[SizeClass].Available;
+  Page *P;
+  if (Available.empty()) {
+    Pages.push_back(std::make_unique<Page>(SizeClass));
+    Stats.HeapBytes += PAGE_SIZE;
+    P = Pages.back().get();
+  } else {
+    P = Available.back();
+    Available.pop_back();
+  }
+
+  P->HasYoung = true;
+  return P;
+}
+
+// Mark everything reachable from the roots. A minor collection also starts
+// from the old cells that young ones were stored into.
+void Heap::mark(bool Minor) {
+  Tracer Tr(++Epoch, Minor);
+  for (auto *R : Roots)
+    R->traceRoots(Tr);
+  if (Minor) {
+    for (auto *C : RememberedSet)
+      C->trace(Tr);
+  }
+  Tr.drain();
+
+  // Every young cell is either promoted or freed by the sweep, so no old cell
+  // points to a young one afterwards.
+  for (auto *C : RememberedSet)
+    C->Remembered = false;
+  RememberedSet.clear();
+}
+
+// Destroy every cell not marked in the given epoch, promote the young cells
+// that were and make the pages with room available for allocation. A minor
+// collection only looks at young cells. A major one also gives back pages
+// left without any live cell.
+void Heap::sweep(uint32_t LiveEpoch, bool Minor) {
+  Stats.NurseryBytes += SinceCollection;
+  ++Stats.Collections;
+  SinceCollection = 0;
+  size_t Freed = 0;
+
+  std::vector<std::unique_ptr<Page>> Kept;
+  for (auto &P : Pages) {
+    if ((!Minor || P->HasYoung) && !sweepPage(*P, LiveEpoch, Minor, Freed) &&
+        !Minor) {
+      Stats.HeapBytes -= PAGE_SIZE;
+      continue;
+    }
+
+    Kept.push_back(std::move(P));
+  }
+  Pages = std::move(Kept);
+
+  for (auto &S : Spaces) {
+    S.Current = nullptr;
+    S.Available.clear();
+  }
+  for (const auto &P : Pages) {
+    if (!P->full())
+      Spaces[P->SizeClass].Available.push_back(P.get());
+  }
+
+  std::vector<std::pair<Cell *, size_t>> KeptLarge(
+      LargeCells.begin(), LargeCells.begin() + (Minor ? OldLargeCells : 0));
+  for (auto Iter = LargeCells.begin() + (Minor ? OldLargeCells : 0);
+       Iter != LargeCells.end(); ++Iter) {
+    auto *C = Iter->first;
+    if (C->MarkEpoch == LiveEpoch) {
+      if (!C->Old) {
+        C->Old = true;
+        SinceMajor += Iter->second;
+        Stats.PromotedBytes += Iter->second;
+      }
+      KeptLarge.push_back(*Iter);
+      continue;
+    }
+
+    C->~Cell();
+    std::free(C);
+    Stats.HeapBytes -= Iter->second;
+    Freed += Iter->second;
+  }
+  LargeCells = std::move(KeptLarge);
+  OldLargeCells = LargeCells.size();
+
+  Stats.FreedBytes += Freed;
+  Stats.LiveBytes -= Freed;
+}
+
+// Sweep a page and thread its free cells into the page's free list. Returns
+// whether any cell is still alive. Empty pages go back to bump allocation.
+bool Heap::sweepPage(Page &P, uint32_t LiveEpoch, bool Minor, size_t &Freed) {
+  const auto Size = classSize(P.SizeClass);
+  bool Empty = true;
+  P.FreeList = nullptr;
+  P.HasYoung = false;
+
+  for (auto *Slot = P.Cursor; Slot != P.Memory;) {
+    Slot -= Size;
+    void *FirstWord;
+    std::memcpy(&FirstWord, Slot, sizeof(FirstWord));
+
+    if (FirstWord) {
+      auto *C = reinterpret_cast<Cell *>(Slot);
+      if (C->Old && Minor) {
+        Empty = false;
+        continue;
+      }
+      if (C->MarkEpoch == LiveEpoch) {
+        if (!C->Old) {
+          C->Old = true;
+          SinceMajor += Size;
+          Stats.PromotedBytes += Size;
+        }
+        Empty = false;
+        continue;
+      }
+
+      C->~Cell();
+      Freed += Size;
+    }
+
+    P.FreeList = new (Slot) FreeCell{nullptr, P.FreeList};
+  }
+
+  if (Empty) {
+    P.Cursor = P.Memory;
+    P.FreeList = nullptr;
+  }
+  return !Empty;
+}
+
+void Heap::recordPause(std::chrono::steady_clock::time_point Start) {
+  const auto Pause = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - Start);
+  Stats.PauseTime += Pause;
+  Stats.MaxPauseTime = std::max(Stats.MaxPauseTime, Pause);
+}
+
+Heap &heap() {
+  static Heap TheHeap;
+  return TheHeap;
+}
+
+} // namespace monkey::gc
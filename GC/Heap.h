@@ -0,0 +1,248 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace monkey::gc {
+
+class Tracer;
+
+// Base class of everything the collector manages. Cells may also live outside
+// the heap, for example as globals or on the C++ stack. The collector traces
+// through those but never frees them.
+class Cell {
+public:
+  virtual ~Cell() = default;
+
+  // Visit every cell directly referenced by this one.
+  virtual void trace(Tracer &) {}
+
+private:
+  friend class Heap;
+  friend class Tracer;
+
+  // The collection that last found the cell alive.
+  uint32_t MarkEpoch = 0;
+  // Set once the cell survives a collection. Minor collections neither trace
+  // nor free old cells.
+  bool Old = false;
+  // Whether the cell is in the heap's remembered set.
+  bool Remembered = false;
+};
+
+class Tracer {
+public:
+  template <typename T> void visit(T *&Slot) {
+    if (Slot)
+      mark(Slot);
+  }
+
+private:
+  friend class Heap;
+
+  Tracer(uint32_t Epoch, bool Minor) : Epoch(Epoch), Minor(Minor) {}
+
+  void mark(Cell *);
+  void drain();
+
+  const uint32_t Epoch;
+  const bool Minor;
+  std::vector<Cell *> Worklist;
+};
+
+// References the collector can't find on its own, such as the VM's stack.
+class RootProvider {
+public:
+  virtual ~RootProvider() = default;
+
+  virtual void traceRoots(Tracer &) = 0;
+};
+
+struct HeapOptions {
+  // Raise "out of memory" when a collection leaves more than this many bytes
+  // alive. 0 means no limit.
+  size_t MaxHeapSize = 0;
+  // Follow a minor collection with a major one once this many bytes have been
+  // promoted since the last major collection.
+  size_t MinThreshold = 4 << 20;
+  // After a major collection the threshold becomes the live size times this
+  // factor, but never less than 'MinThreshold'.
+  double GrowthFactor = 2.0;
+  // Run a minor collection at the next safe point once this many bytes have
+  // been allocated since the last collection.
+  size_t NurserySize = 1 << 20;
+};
+
+struct HeapStats {
+  // Minor and major collections.
+  uint64_t Collections = 0;
+  uint64_t MinorCollections = 0;
+  // Totals since the heap was created.
+  uint64_t AllocatedBytes = 0;
+  uint64_t FreedBytes = 0;
+  // Young bytes the collections looked at and the part of them that survived.
+  uint64_t NurseryBytes = 0;
+  uint64_t PromotedBytes = 0;
+  std::chrono::nanoseconds PauseTime{0};
+  std::chrono::nanoseconds MaxPauseTime{0};
+  // Bytes held by cells that haven't been freed yet.
+  size_t LiveBytes = 0;
+  // Bytes held by pages and large cells, whether in use or not.
+  size_t HeapBytes = 0;
+
+  // The fraction of young bytes that survived their first collection.
+  double survivalRate() const {
+    return NurseryBytes ? static_cast<double>(PromotedBytes) /
+                              static_cast<double>(NurseryBytes)
+                        : 0.0;
+  }
+};
+
+// A precise, generational mark-sweep heap. Small cells come from pages that
+// each hold cells of a single size class and larger ones are allocated
+// individually. New cells are bumped off the end of a page, or taken from the
+// free cells of partly used pages once the page is full.
+//
+// Cells allocated since the last collection are young. Most of them are
+// temporaries, so a minor collection only marks young cells, starting from the
+// roots and the remembered set, and only sweeps the pages they were allocated
+// in. Survivors are promoted where they are: cells never move because the VMs
+// keep raw pointers to them across safe points. A major collection marks and
+// sweeps everything.
+//
+// Collections only happen at safe points, which the VMs and the evaluator
+// reach where everything they still need is reachable from a root. Pointers
+// held anywhere else don't keep cells alive.
+class Heap {
+public:
+  Heap();
+  ~Heap();
+  Heap(const Heap &) = delete;
+  Heap &operator=(const Heap &) = delete;
+
+  void configure(const HeapOptions &);
+  const HeapOptions &options() const { return Options; }
+  const HeapStats &stats() const { return Stats; }
+  // Bytes allocated per second, leaving out the time spent collecting.
+  double allocationRate() const;
+
+  template <typename T, typename... ArgTypes> T *make(ArgTypes &&...Args) {
+    static_assert(std::is_base_of_v<Cell, T>, "only cells live on the heap");
+
+    void *Memory = allocate(sizeof(T));
+    try {
+      return new (Memory) T(std::forward<ArgTypes>(Args)...);
+    } catch (...) {
+      deallocate(Memory, sizeof(T));
+      throw;
+    }
+  }
+
+  // Collect if enough has been allocated since the last collection.
+  void safePoint() {
+    if (SinceCollection >= Options.NurserySize)
+      collectYoung();
+  }
+  // Run a minor collection, followed by a major one if enough has been
+  // promoted since the last.
+  void collectYoung();
+  // Run a major collection.
+  void collect();
+
+  // Must be called when a pointer to 'Target' is stored into 'Owner' after
+  // 'Owner' was constructed. Old cells that point to young ones are traced by
+  // minor collections.
+  void writeBarrier(Cell *Owner, Cell *Target) {
+    if (Owner->Old && Target && !Target->Old && !Owner->Remembered) {
+      Owner->Remembered = true;
+      RememberedSet.push_back(Owner);
+    }
+  }
+
+  void addRoots(RootProvider *);
+  void removeRoots(RootProvider *);
+
+private:
+  struct Page;
+  struct FreeCell;
+  // The pages small cells of one size class are allocated from.
+  struct Space {
+    Page *Current = nullptr;
+    // Pages with room for more cells.
+    std::vector<Page *> Available;
+  };
+
+  void *allocate(size_t);
+  void deallocate(void *, size_t);
+  Page *nextPage(size_t SizeClass);
+  void mark(bool Minor);
+  void sweep(uint32_t LiveEpoch, bool Minor);
+  bool sweepPage(Page &, uint32_t LiveEpoch, bool Minor, size_t &Freed);
+  void recordPause(std::chrono::steady_clock::time_point Start);
+
+  HeapOptions Options;
+  HeapStats Stats;
+  const std::chrono::steady_clock::time_point Created;
+  size_t SinceCollection;
+  size_t SinceMajor;
+  size_t Threshold;
+  uint32_t Epoch;
+  std::vector<std::unique_ptr<Page>> Pages;
+  std::vector<Space> Spaces;
+  std::vector<std::pair<Cell *, size_t>> LargeCells;
+  // Large cells before this index are old.
+  size_t OldLargeCells;
+  std::vector<Cell *> RememberedSet;
+  std::vector<RootProvider *> Roots;
+};
+
+// The heap shared by everything in the process. Monkey is single threaded.
+Heap &heap();
+
+// Keeps a cell alive while in scope.
+template <typename T> class Root : public RootProvider {
+public:
+  explicit Root(T *Ptr = nullptr) : Ptr(Ptr) { heap().addRoots(this); }
+  ~Root() { heap().removeRoots(this); }
+  Root(const Root &) = delete;
+  Root &operator=(const Root &) = delete;
+
+  Root &operator=(T *Other) {
+    Ptr = Other;
+    return *this;
+  }
+
+  T *get() const { return Ptr; }
+  T *operator->() const { return Ptr; }
+  T &operator*() const { return *Ptr; }
+  operator T *() const { return Ptr; }
+
+  void traceRoots(Tracer &Tr) override { Tr.visit(Ptr); }
+
+private:
+  T *Ptr;
+};
+
+// Keeps every cell in the vector alive while in scope.
+template <typename T> class RootedVector : public RootProvider {
+public:
+  RootedVector() { heap().addRoots(this); }
+  ~RootedVector() { heap().removeRoots(this); }
+  RootedVector(const RootedVector &) = delete;
+  RootedVector &operator=(const RootedVector &) = delete;
+
+  void traceRoots(Tracer &Tr) override {
+    for (auto &Element : Elements)
+      Tr.visit(Element);
+  }
+
+  std::vector<T *> Elements;
+};
+
+} // namespace monkey::gc
@@ -0,0 +1,182 @@
+#include "Heap.h"
+
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <stdexcept>
+
+namespace monkey::gc::test {
+
+// A threshold that never triggers a major collection on its own.
+const size_t NEVER = std::numeric_limits<size_t>::max();
+
+// Counts its destruction and references another node.
+struct Node : public Cell {
+  explicit Node(int &Destroyed) : Destroyed(Destroyed) {}
+  ~Node() override { ++Destroyed; }
+
+  void trace(Tracer &Tr) override { Tr.visit(Next); }
+
+  int &Destroyed;
+  Node *Next = nullptr;
+};
+
+// Too large for any of the size classes.
+struct LargeNode : public Node {
+  using Node::Node;
+
+  char Payload[4096] = {};
+};
+
+// Restores the heap's options and frees the test's nodes at the end of a test.
+class HeapTests : public testing::Test {
+protected:
+  void SetUp() override {
+    Options = heap().options();
+    heap().collect();
+  }
+  void TearDown() override {
+    heap().configure(Options);
+    heap().collect();
+  }
+
+  HeapOptions Options;
+  int Destroyed = 0;
+};
+
+TEST_F(HeapTests, testUnreachableCellsAreFreed) {
+  const auto Live = heap().stats().LiveBytes;
+
+  for (int I = 0; I < 1000; ++I)
+    heap().make<Node>(Destroyed);
+  heap().make<LargeNode>(Destroyed);
+  ASSERT_GT(heap().stats().LiveBytes, Live);
+
+  heap().collect();
+  ASSERT_EQ(Destroyed, 1001);
+  ASSERT_EQ(heap().stats().LiveBytes, Live);
+}
+
+TEST_F(HeapTests, testRootedCellsSurvive) {
+
+  {
+    Root<Node> Head(heap().make<Node>(Destroyed));
+    Head->Next = heap().make<LargeNode>(Destroyed);
+    Head->Next->Next = heap().make<Node>(Destroyed);
+
+    RootedVector<Node> Nodes;
+    Nodes.Elements.push_back(heap().make<Node>(Destroyed));
+
+    heap().collect();
+    ASSERT_EQ(Destroyed, 0);
+
+    // Cells can be reused once they have been freed.
+    Head->Next = nullptr;
+    heap().collect();
+    ASSERT_EQ(Destroyed, 2);
+    heap().make<Node>(Destroyed);
+  }
+
+  heap().collect();
+  ASSERT_EQ(Destroyed, 5);
+}
+
+TEST_F(HeapTests, testCyclesAreCollected) {
+
+  auto *A = heap().make<Node>(Destroyed);
+  A->Next = heap().make<Node>(Destroyed);
+  A->Next->Next = A;
+
+  // Cells outside the heap are traced through but never freed.
+  Node Outside(Destroyed);
+  Outside.Next = A;
+  Root<Node> R(&Outside);
+  heap().collect();
+  ASSERT_EQ(Destroyed, 0);
+
+  Outside.Next = nullptr;
+  heap().collect();
+  ASSERT_EQ(Destroyed, 2);
+}
+
+TEST_F(HeapTests, testSafePointsFollowNurserySize) {
+  heap().configure({0, NEVER, 2.0, sizeof(LargeNode)});
+  const auto Stats = heap().stats();
+
+  heap().make<Node>(Destroyed);
+  heap().safePoint();
+  ASSERT_EQ(heap().stats().MinorCollections, Stats.MinorCollections);
+
+  heap().make<LargeNode>(Destroyed);
+  heap().safePoint();
+  ASSERT_EQ(heap().stats().MinorCollections, Stats.MinorCollections + 1);
+  ASSERT_EQ(heap().stats().Collections, Stats.Collections + 1);
+  ASSERT_EQ(Destroyed, 2);
+  ASSERT_GT(heap().stats().FreedBytes - Stats.FreedBytes, sizeof(LargeNode));
+}
+
+TEST_F(HeapTests, testMinorCollectionsOnlyFreeYoungCells) {
+  heap().configure({0, NEVER, 2.0});
+
+  Root<Node> Head(heap().make<Node>(Destroyed));
+  Head->Next = heap().make<LargeNode>(Destroyed);
+  heap().make<Node>(Destroyed);
+  heap().collectYoung();
+  ASSERT_EQ(Destroyed, 1);
+
+  // Old cells are only freed by major collections.
+  Head = nullptr;
+  heap().collectYoung();
+  ASSERT_EQ(Destroyed, 1);
+  heap().collect();
+  ASSERT_EQ(Destroyed, 3);
+}
+
+TEST_F(HeapTests, testWriteBarrier) {
+  heap().configure({0, NEVER, 2.0});
+
+  Root<Node> Head(heap().make<Node>(Destroyed));
+  heap().collectYoung();
+
+  // Nothing but the old head references the new cells.
+  Head->Next = heap().make<Node>(Destroyed);
+  heap().writeBarrier(Head, Head->Next);
+  Head->Next->Next = heap().make<LargeNode>(Destroyed);
+  heap().collectYoung();
+  ASSERT_EQ(Destroyed, 0);
+
+  Head->Next->Next = nullptr;
+  heap().collect();
+  ASSERT_EQ(Destroyed, 1);
+}
+
+TEST_F(HeapTests, testStats) {
+  heap().configure({0, NEVER, 2.0});
+  const auto Stats = heap().stats();
+
+  Root<Node> Head(heap().make<Node>(Destroyed));
+  for (int I = 0; I < 9; ++I)
+    heap().make<Node>(Destroyed);
+  heap().collectYoung();
+
+  const auto &After = heap().stats();
+  const auto Nursery = After.NurseryBytes - Stats.NurseryBytes;
+  ASSERT_EQ(Nursery, After.AllocatedBytes - Stats.AllocatedBytes);
+  ASSERT_EQ(After.PromotedBytes - Stats.PromotedBytes, Nursery / 10);
+  ASSERT_LE(After.MaxPauseTime, After.PauseTime);
+  ASSERT_GT(After.PauseTime, Stats.PauseTime);
+  ASSERT_GT(After.survivalRate(), 0.0);
+  ASSERT_GT(heap().allocationRate(), 0.0);
+}
+
+TEST_F(HeapTests, testMaxHeapSize) {
+  heap().configure({sizeof(LargeNode), 0, 2.0});
+
+  Root<Node> Head(heap().make<LargeNode>(Destroyed));
+  ASSERT_NO_THROW(heap().collect());
+
+  Head->Next = heap().make<LargeNode>(Destroyed);
+  ASSERT_THROW(heap().collect(), std::runtime_error);
+}
+
+} // namespace monkey::gc::test
@@ -0,0 +1,200 @@
+#include "Assembler.h"
+
+#include <cstring>
+
+namespace monkey::jit {
+
+namespace {
+
+// Low three bits of the register number. The fourth goes into the REX prefix.
+uint8_t reg(Register R) { return static_cast<uint8_t>(R) & 7; }
+bool extended(Register R) { return static_cast<uint8_t>(R) & 8; }
+
+} // namespace
+
+void Assembler::push(Register R) {
+  if (extended(R))
+    emit8(0x41);
+  emit8(0x50 + reg(R));
+}
+
+void Assembler::pop(Register R) {
+  if (extended(R))
+    emit8(0x41);
+  emit8(0x58 + reg(R));
+}
+
+void Assembler::mov(Register Dst, Register Src) {
+  // mov r/m64, r64
+  rex(true, Src, Dst);
+  emit8(0x89);
+  emit8(0xC0 | (reg(Src) << 3) | reg(Dst));
+}
+
+void Assembler::mov(Register Dst, uint64_t Imm) {
+  // movabs r64, imm64
+  rex(true, Register::RAX, Dst);
+  emit8(0xB8 + reg(Dst));
+  emit64(Imm);
+}
+
+void Assembler::load(Register Dst, Register Base, int32_t Disp) {
+  rex(true, Dst, Base);
+  emit8(0x8B);
+  memoryOperand(reg(Dst), Base, Disp);
+}
+
+void Assembler::store(Register Base, int32_t Disp, Register Src) {
+  rex(true, Src, Base);
+  emit8(0x89);
+  memoryOperand(reg(Src), Base, Disp);
+}
+
+void Assembler::add(Register Dst, Register Src) {
+  rex(true, Src, Dst);
+  emit8(0x01);
+  emit8(0xC0 | (reg(Src) << 3) | reg(Dst));
+}
+
+void Assembler::sub(Register Dst, Register Src) {
+  rex(true, Src, Dst);
+  emit8(0x29);
+  emit8(0xC0 | (reg(Src) << 3) | reg(Dst));
+}
+
+void Assembler::imul(Register Dst, Register Src) {
+  rex(true, Dst, Src);
+  emit8(0x0F);
+  emit8(0xAF);
+  emit8(0xC0 | (reg(Dst) << 3) | reg(Src));
+}
+
+void Assembler::cmp(Register Left, Register Right) {
+  rex(true, Right, Left);
+  emit8(0x39);
+  emit8(0xC0 | (reg(Right) << 3) | reg(Left));
+}
+
+void Assembler::neg(Register R) {
+  rex(true, Register::RAX, R);
+  emit8(0xF7);
+  emit8(0xD8 | reg(R));
+}
+
+void Assembler::xor8(Register R, int8_t Imm) {
+  rex(true, Register::RAX, R);
+  emit8(0x83);
+  emit8(0xF0 | reg(R));
+  emit8(Imm);
+}
+
+void Assembler::set(Condition C, Register R) {
+  // setcc r8
+  emit8(0x0F);
+  emit8(static_cast<uint8_t>(C) + 0x10);
+  emit8(0xC0 | reg(R));
+  // movzx r32, r8
+  emit8(0x0F);
+  emit8(0xB6);
+  emit8(0xC0 | (reg(R) << 3) | reg(R));
+}
+
+void Assembler::addRsp(int8_t Imm) {
+  emit8(0x48);
+  emit8(0x83);
+  emit8(0xC4);
+  emit8(Imm);
+}
+
+void Assembler::subRsp(int8_t Imm) {
+  emit8(0x48);
+  emit8(0x83);
+  emit8(0xEC);
+  emit8(Imm);
+}
+
+void Assembler::cmp8(Register Base, int32_t Disp, uint8_t Imm) {
+  if (extended(Base))
+    emit8(0x41);
+  emit8(0x80);
+  memoryOperand(7, Base, Disp);
+  emit8(Imm);
+}
+
+void Assembler::cmp64(Register Base, int32_t Disp, int32_t Imm) {
+  rex(true, Register::RAX, Base);
+  emit8(0x81);
+  memoryOperand(7, Base, Disp);
+  emit32(Imm);
+}
+
+void Assembler::call(Register R) {
+  emit8(0xFF);
+  emit8(0xD0 | reg(R));
+}
+
+void Assembler::testEax() {
+  emit8(0x85);
+  emit8(0xC0);
+}
+
+void Assembler::xorEax() {
+  emit8(0x31);
+  emit8(0xC0);
+}
+
+void Assembler::movEax(uint32_t Imm) {
+  emit8(0xB8);
+  emit32(Imm);
+}
+
+void Assembler::ret() { emit8(0xC3); }
+
+size_t Assembler::jmp() {
+  emit8(0xE9);
+  const auto Pos = Code.size();
+  emit32(0);
+  return Pos;
+}
+
+size_t Assembler::jcc(Condition C) {
+  emit8(0x0F);
+  emit8(static_cast<uint8_t>(C));
+  const auto Pos = Code.size();
+  emit32(0);
+  return Pos;
+}
+
+void Assembler::bind(size_t Displacement, size_t Target) {
+  // Relative to the end of the jump instruction.
+  const auto Rel = static_cast<int32_t>(Target - (Displacement + 4));
+  std::memcpy(&Code.at(Displacement), &Rel, sizeof(Rel));
+}
+
+void Assembler::rex(bool Wide, Register Reg, Register RM) {
+  emit8(0x40 | (Wide ? 8 : 0) | (extended(Reg) ? 4 : 0) |
+        (extended(RM) ? 1 : 0));
+}
+
+// ModRM (and SIB if needed) for [Base + disp32] with the given reg field.
+void Assembler::memoryOperand(uint8_t RegField, Register Base, int32_t Disp) {
+  emit8(0x80 | (RegField << 3) | reg(Base));
+  // RSP and R12 can only be used as a base through a SIB byte.
+  if (reg(Base) == 4)
+    emit8(0x24);
+  emit32(static_cast<uint32_t>(Disp));
+}
+
+void Assembler::emit8(uint8_t Byte) { Code.push_back(Byte); }
+
+void Assembler::emit32(uint32_t Value) {
+  for (int I = 0; I < 4; ++I)
+    emit8(static_cast<uint8_t>(Value >> (8 * I)));
+}
+
+void Assembler::emit64(uint64_t Value) {
+  for (int I = 0; I < 8; ++I)
+    emit8(static_cast<uint8_t>(Value >> (8 * I)));
+}
+
+} // namespace monkey::jit
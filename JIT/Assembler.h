@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace monkey::jit {
+
+enum class Register : uint8_t {
+  RAX = 0,
+  RCX = 1,
+  RDX = 2,
+  RBX = 3,
+  RSP = 4,
+  RBP = 5,
+  RSI = 6,
+  RDI = 7,
+  R12 = 12,
+  R13 = 13
+};
+
+// Second opcode byte of the 'jcc' form. 'setcc' is 0x10 above.
+enum class Condition : uint8_t {
+  ZERO = 0x84,
+  NOT_ZERO = 0x85,
+  LESS_EQUAL = 0x8E,
+  GREATER = 0x8F
+};
+
+// Emits the handful of x86-64 instructions the baseline JIT needs. Jumps are
+// always emitted with 32-bit displacements and return the position of the
+// displacement so that it can be bound to a target later.
+class Assembler {
+public:
+  const std::vector<uint8_t> &code() const { return Code; }
+  size_t size() const { return Code.size(); }
+
+  void push(Register);
+  void pop(Register);
+  void mov(Register, Register);
+  void mov(Register, uint64_t);
+  // mov Dst, qword [Base + Disp]
+  void load(Register, Register, int32_t);
+  // mov qword [Base + Disp], Src
+  void store(Register, int32_t, Register);
+  void add(Register, Register);
+  void sub(Register, Register);
+  void imul(Register, Register);
+  void cmp(Register, Register);
+  void neg(Register);
+  void xor8(Register, int8_t);
+  // Set the register to 1 if the condition holds and to 0 otherwise. Only
+  // RAX to RBX are supported.
+  void set(Condition, Register);
+  void addRsp(int8_t);
+  void subRsp(int8_t);
+  // cmp byte [Base + Disp], Imm
+  void cmp8(Register, int32_t, uint8_t);
+  // cmp qword [Base + Disp], Imm
+  void cmp64(Register, int32_t, int32_t);
+  void call(Register);
+  void testEax();
+  void xorEax();
+  void movEax(uint32_t);
+  void ret();
+  size_t jmp();
+  size_t jcc(Condition);
+  void bind(size_t, size_t);
+
+private:
+  void rex(bool, Register, Register);
+  void memoryOperand(uint8_t, Register, int32_t);
+  void emit8(uint8_t);
+  void emit32(uint32_t);
+  void emit64(uint64_t);
+
+  std::vector<uint8_t> Code;
+};
+
+} // namespace monkey::jit
@@ -0,0 +1,65 @@
+#include "Assembler.h"
+
+#include <gtest/gtest.h>
+
+namespace monkey::jit::test {
+
+TEST(AssemblerTests, testEncoding) {
+  Assembler A;
+  A.push(Register::RBX);
+  A.push(Register::R12);
+  A.mov(Register::RBX, Register::RDI);
+  A.mov(Register::R12, Register::RAX);
+  A.mov(Register::RSI, 0x1122334455667788);
+  A.cmp8(Register::R12, 0x20, 1);
+  A.cmp64(Register::R12, 0x28, -1);
+  A.call(Register::RAX);
+  A.testEax();
+  A.pop(Register::R12);
+  A.ret();
+
+  const std::vector<uint8_t> Expected = {
+      // push rbx
+      0x53,
+      // push r12
+      0x41, 0x54,
+      // mov rbx, rdi
+      0x48, 0x89, 0xFB,
+      // mov r12, rax
+      0x49, 0x89, 0xC4,
+      // movabs rsi, 0x1122334455667788
+      0x48, 0xBE, 0x88, 0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11,
+      // cmp byte [r12 + 0x20], 1
+      0x41, 0x80, 0xBC, 0x24, 0x20, 0x00, 0x00, 0x00, 0x01,
+      // cmp qword [r12 + 0x28], -1
+      0x49, 0x81, 0xBC, 0x24, 0x28, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF,
+      // call rax
+      0xFF, 0xD0,
+      // test eax, eax
+      0x85, 0xC0,
+      // pop r12
+      0x41, 0x5C,
+      // ret
+      0xC3,
+  };
+  EXPECT_EQ(A.code(), Expected);
+}
+
+TEST(AssemblerTests, testJumps) {
+  Assembler A;
+  const auto Forward = A.jmp();
+  const auto Target = A.size();
+  A.ret();
+  const auto Backward = A.jcc(Condition::NOT_ZERO);
+  A.bind(Forward, Target);
+  A.bind(Backward, Target);
+
+  const std::vector<uint8_t> Expected = {
+      0xE9, 0x00, 0x00, 0x00, 0x00,       // jmp +0
+      0xC3,                               // ret
+      0x0F, 0x85, 0xF9, 0xFF, 0xFF, 0xFF, // jnz -7
+  };
+  EXPECT_EQ(A.code(), Expected);
+}
+
+} // namespace monkey::jit::test
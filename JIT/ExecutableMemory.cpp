@@ -0,0 +1,28 @@
+#include "ExecutableMemory.h"
+
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace monkey::jit {
+
+const void *install(const std::vector<uint8_t> &Code) {
+  const size_t PageSize = sysconf(_SC_PAGESIZE);
+  const size_t Size = (Code.size() + PageSize - 1) / PageSize * PageSize;
+
+  void *Memory = mmap(nullptr, Size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (Memory == MAP_FAILED)
+    return nullptr;
+
+  std::memcpy(Memory, Code.data(), Code.size());
+
+  if (mprotect(Memory, Size, PROT_READ | PROT_EXEC)) {
+    munmap(Memory, Size);
+    return nullptr;
+  }
+
+  return Memory;
+}
+
+} // namespace monkey::jit
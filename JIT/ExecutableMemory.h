@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace monkey::jit {
+
+// Copy machine code into its own mapping and make it executable. The mapping
+// is never writable and executable at the same time. Code is never freed since
+// compiled functions may be shared between VMs for the lifetime of the
+// process. Returns nullptr if the memory can't be mapped.
+const void *install(const std::vector<uint8_t> &);
+
+} // namespace monkey::jit
@@ -0,0 +1,19 @@
+#include "PerfMap.h"
+
+#include <unistd.h>
+
+namespace monkey::jit {
+
+PerfMap::PerfMap(const std::string &Path) : Out(Path, std::ios::app) {}
+
+PerfMap &PerfMap::instance() {
+  static PerfMap Map("/tmp/perf-" + std::to_string(getpid()) + ".map");
+  return Map;
+}
+
+void PerfMap::add(const void *Start, size_t Size, const std::string &Name) {
+  Out << std::hex << reinterpret_cast<uintptr_t>(Start) << " " << Size
+      << std::dec << " " << Name << std::endl;
+}
+
+} // namespace monkey::jit
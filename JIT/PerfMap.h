@@ -0,0 +1,23 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+
+namespace monkey::jit {
+
+// Writes the symbol map that 'perf' reads to name JIT compiled code. Each
+// line is "START SIZE NAME" with START and SIZE in hex.
+class PerfMap {
+public:
+  explicit PerfMap(const std::string &);
+
+  // The map 'perf' looks for: /tmp/perf-<pid>.map.
+  static PerfMap &instance();
+
+  void add(const void *, size_t, const std::string &);
+
+private:
+  std::ofstream Out;
+};
+
+} // namespace monkey::jit
@@ -6,132 +6,158 @@
 namespace monkey::object {
 
 // Null global should probably go in here. Instead, we check for nullptr in the
-// evaluator and vm and then return a Null object. So it's just a wasted
-// construction of a shared_ptr.
+// evaluator and vm and then return a Null object.
+//
+// The builtins live for the whole program and are allocated outside the heap.
 const std::vector<std::pair<std::string, std::shared_ptr<BuiltIn>>> BUILTINS = {
     {"len",
-     std::make_shared<BuiltIn>([](const std::vector<std::shared_ptr<Object>>
-                                      &Args) -> std::shared_ptr<Object> {
+     std::make_shared<BuiltIn>([](const std::vector<Value> &Args) -> Value {
        if (Args.size() != 1)
          return newError("wrong number of arguments. got=%d, want=1",
                          Args.size());
 
-       const auto *StringObj = objCast<const String *>(Args.front().get());
+       const auto *StringObj = objCast<const String *>(Args.front().asObject());
        if (StringObj)
-         return makeInteger(StringObj->Value.size());
+         return Value::integer(StringObj->size());
 
-       const auto *ArrayObj = objCast<const Array *>(Args.front().get());
+       const auto *ArrayObj = objCast<const Array *>(Args.front().asObject());
        if (ArrayObj)
-         return makeInteger(ArrayObj->Elements.size());
+         return Value::integer(ArrayObj->size());
 
        return newError("argument to \"len\" not supported, got %s",
-                       objTypeToString(Args.front()->type()));
+                       objTypeToString(Args.front().type()));
      })},
     {"first",
-     std::make_shared<BuiltIn>([](const std::vector<std::shared_ptr<Object>>
-                                      &Args) -> std::shared_ptr<Object> {
+     std::make_shared<BuiltIn>([](const std::vector<Value> &Args) -> Value {
        if (Args.size() != 1)
          return newError("wrong number of arguments. got=%d, want=1",
                          Args.size());
 
-       if (Args.front()->type() != ObjectType::ARRAY_OBJ)
+       if (Args.front().type() != ObjectType::ARRAY_OBJ)
          return newError("argument to \"first\" must be ARRAY, got %s",
-                         objTypeToString(Args.front()->type()));
+                         objTypeToString(Args.front().type()));
 
-       const auto *ArrayObj = objCast<const Array *>(Args.front().get());
+       const auto *ArrayObj = objCast<const Array *>(Args.front().asObject());
        assert(ArrayObj);
-       if (!ArrayObj->Elements.empty())
-         return ArrayObj->Elements.front();
+       if (!ArrayObj->empty())
+         return ArrayObj->front();
 
-       return NULL_GLOBAL;
+       return Value::null();
      })},
     {"last",
-     std::make_shared<BuiltIn>([](const std::vector<std::shared_ptr<Object>>
-                                      &Args) -> std::shared_ptr<Object> {
+     std::make_shared<BuiltIn>([](const std::vector<Value> &Args) -> Value {
        if (Args.size() != 1)
          return newError("wrong number of arguments. got=%d, want=1",
                          Args.size());
 
-       if (Args.front()->type() != ObjectType::ARRAY_OBJ)
+       if (Args.front().type() != ObjectType::ARRAY_OBJ)
          return newError("argument to \"last\" must be ARRAY, got %s",
-                         objTypeToString(Args.front()->type()));
+                         objTypeToString(Args.front().type()));
 
-       const auto *ArrayObj = objCast<const Array *>(Args.front().get());
+       const auto *ArrayObj = objCast<const Array *>(Args.front().asObject());
        assert(ArrayObj);
-       if (!ArrayObj->Elements.empty())
-         return ArrayObj->Elements.back();
+       if (!ArrayObj->empty())
+         return ArrayObj->back();
 
-       return NULL_GLOBAL;
+       return Value::null();
      })},
     {"rest",
-     std::make_shared<BuiltIn>([](const std::vector<std::shared_ptr<Object>>
-                                      &Args) -> std::shared_ptr<Object> {
+     std::make_shared<BuiltIn>([](const std::vector<Value> &Args) -> Value {
        if (Args.size() != 1)
          return newError("wrong number of arguments. got=%d, want=1",
                          Args.size());
 
-       if (Args.front()->type() != ObjectType::ARRAY_OBJ)
+       if (Args.front().type() != ObjectType::ARRAY_OBJ)
          return newError("argument to \"rest\" must be ARRAY, got %s",
-                         objTypeToString(Args.front()->type()));
+                         objTypeToString(Args.front().type()));
 
-       const auto *ArrayObj = objCast<const Array *>(Args.front().get());
+       const auto *ArrayObj = objCast<const Array *>(Args.front().asObject());
        assert(ArrayObj);
-       if (!ArrayObj->Elements.empty()) {
-         std::vector<std::shared_ptr<Object>> Rest;
-         std::copy(ArrayObj->Elements.begin() + 1, ArrayObj->Elements.end(),
-                   std::back_inserter(Rest));
-         return std::make_shared<Array>(std::move(Rest));
-       }
-
-       return NULL_GLOBAL;
+       if (!ArrayObj->empty())
+         return ArrayObj->rest();
+
+       return Value::null();
      })},
     {"push",
-     std::make_shared<BuiltIn>([](const std::vector<std::shared_ptr<Object>>
-                                      &Args) -> std::shared_ptr<Object> {
+     std::make_shared<BuiltIn>([](const std::vector<Value> &Args) -> Value {
        if (Args.size() != 2)
          return newError("wrong number of arguments. got=%d, want=2",
                          Args.size());
 
-       if (Args.front()->type() != ObjectType::ARRAY_OBJ)
+       if (Args.front().type() != ObjectType::ARRAY_OBJ)
          return newError("argument to \"push\" must be ARRAY, got %s",
-                         objTypeToString(Args.front()->type()));
+                         objTypeToString(Args.front().type()));
 
-       const auto *ArrayObj = objCast<const Array *>(Args.front().get());
+       const auto *ArrayObj = objCast<const Array *>(Args.front().asObject());
        assert(ArrayObj);
-       auto Pushed = ArrayObj->Elements;
-       Pushed.push_back(Args.at(1));
-       return makeArray(std::move(Pushed));
+       return ArrayObj->push(Args.at(1).toObject());
+     })},
+    {"puts",
+     std::make_shared<BuiltIn>([](const std::vector<Value> &Args) -> Value {
+       for (const auto &Arg : Args)
+         printf("%s\n", Arg.inspect().c_str());
+
+       return Value::null();
      })},
-    {"puts", std::make_shared<BuiltIn>(
-                 [](const std::vector<std::shared_ptr<Object>> &Args)
-                     -> std::shared_ptr<Object> {
-                   for (const auto &Arg : Args)
-                     printf("%s\n", Arg->inspect().c_str());
+    {"assoc",
+     std::make_shared<BuiltIn>([](const std::vector<Value> &Args) -> Value {
+       if (Args.size() != 3)
+         return newError("wrong number of arguments. got=%d, want=3",
+                         Args.size());
+
+       if (Args.front().type() != ObjectType::HASH_OBJ)
+         return newError("argument to \"assoc\" must be HASH, got %s",
+                         objTypeToString(Args.front().type()));
+
+       auto *Key = Args.at(1).toObject();
+       if (!hasHashKey(HashKey(Key)))
+         return newError("unusable as hash key: %s",
+                         objTypeToString(Key->type()));
+
+       const auto *HashObj = objCast<const Hash *>(Args.front().asObject());
+       assert(HashObj);
+       return HashObj->assoc(Key, Args.at(2).toObject());
+     })},
+    {"dissoc",
+     std::make_shared<BuiltIn>([](const std::vector<Value> &Args) -> Value {
+       if (Args.size() != 2)
+         return newError("wrong number of arguments. got=%d, want=2",
+                         Args.size());
+
+       if (Args.front().type() != ObjectType::HASH_OBJ)
+         return newError("argument to \"dissoc\" must be HASH, got %s",
+                         objTypeToString(Args.front().type()));
+
+       auto *Key = Args.at(1).toObject();
+       if (!hasHashKey(HashKey(Key)))
+         return newError("unusable as hash key: %s",
+                         objTypeToString(Key->type()));
 
-                   return NULL_GLOBAL;
-                 })}};
+       const auto *HashObj = objCast<const Hash *>(Args.front().asObject());
+       assert(HashObj);
+       return HashObj->dissoc(Key);
+     })}};
 
-std::shared_ptr<Error> newError(const char *Format, ...) {
+Error *newError(const char *Format, ...) {
 #define ERROR_SIZE 1024
   char ErrorBuf[ERROR_SIZE];
   va_list ArgList;
   va_start(ArgList, Format);
   vsnprintf(ErrorBuf, ERROR_SIZE, Format, ArgList);
   va_end(ArgList);
-  return std::make_shared<Error>(ErrorBuf);
+  return gc::heap().make<Error>(ErrorBuf);
 }
 
-std::shared_ptr<BuiltIn> getBuiltInByName(const std::string &Name) {
-  const auto Iter = std::find_if(
-      BUILTINS.begin(), BUILTINS.end(),
-      [&Name](const std::pair<std::string, std::shared_ptr<BuiltIn>> &P) {
-        return P.first == Name;
-      });
+BuiltIn *getBuiltInByName(const std::string &Name) {
+  const auto Iter = std::find_if(BUILTINS.begin(), BUILTINS.end(),
+                                 [&Name](const auto &P) {
+                                   return P.first == Name;
+                                 });
 
   if (Iter == BUILTINS.end())
     return nullptr;
 
-  return Iter->second;
+  return Iter->second.get();
 }
 
 } // namespace monkey::object
@@ -0,0 +1,166 @@
+#include "HashMap.h"
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace monkey::object {
+
+namespace {
+
+constexpr int8_t EMPTY = -128;
+
+// Spreads the key's hash over all bits. Integers hash to themselves, which
+// would put consecutive keys into the same group.
+size_t mix(size_t Hash) {
+  const auto R = static_cast<__uint128_t>(Hash) * 0x9e3779b97f4a7c15ull;
+  return static_cast<size_t>(R) ^ static_cast<size_t>(R >> 64);
+}
+
+// The low 7 bits go into the control bytes and the rest pick the group.
+int8_t controlByte(size_t Hash) { return static_cast<int8_t>(Hash & 0x7f); }
+
+size_t firstGroup(size_t Hash, size_t NumGroups) {
+  return (Hash >> 7) & (NumGroups - 1);
+}
+
+// A bit for each of the 16 control bytes of the group that equals 'Byte'.
+uint32_t matchByte(const int8_t *Group, int8_t Byte) {
+#ifdef __SSE2__
+  const auto Bytes =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(Group));
+  return static_cast<uint32_t>(
+      _mm_movemask_epi8(_mm_cmpeq_epi8(Bytes, _mm_set1_epi8(Byte))));
+#else
+  uint32_t Mask = 0;
+  for (int I = 0; I < 16; ++I)
+    if (Group[I] == Byte)
+      Mask |= 1u << I;
+  return Mask;
+#endif
+}
+
+} // namespace
+
+HashKey::HashKey(Object *Key) : Key(Key) {}
+
+bool HashKey::operator==(const HashKey &Other) const {
+  return Key == Other.Key || Key->equals(*Other.Key);
+}
+
+bool hasHashKey(const HashKey &Hash) {
+  const auto ObjType = Hash.Key->type();
+  return ObjType == ObjectType::BOOLEAN_OBJ ||
+         ObjType == ObjectType::INTEGER_OBJ ||
+         ObjType == ObjectType::STRING_OBJ;
+}
+
+HashMap::const_iterator HashMap::find(const HashKey &Key) const {
+  if (Entries.empty())
+    return end();
+
+  const auto Index = lookup(Key, mix(Key.Key->hash()));
+  return Index == NOT_FOUND ? end() : begin() + Index;
+}
+
+std::pair<HashMap::iterator, bool> HashMap::emplace(const HashKey &Key,
+                                                    Object *Value) {
+  const auto Hash = mix(Key.Key->hash());
+  const auto Index = lookup(Key, Hash);
+  if (Index != NOT_FOUND)
+    return {begin() + Index, false};
+
+  return {begin() + insert(Key, Hash, Value), true};
+}
+
+Object *&HashMap::operator[](const HashKey &Key) {
+  const auto Hash = mix(Key.Key->hash());
+  auto Index = lookup(Key, Hash);
+  if (Index == NOT_FOUND)
+    Index = insert(Key, Hash, nullptr);
+
+  return Entries[Index].second;
+}
+
+void HashMap::reserve(size_t Count) {
+  if (!Count)
+    return;
+
+  size_t NumGroups = 1;
+  while (Count * 8 > NumGroups * GROUP_SIZE * 7)
+    NumGroups *= 2;
+  if (NumGroups > Groups.size())
+    rehash(NumGroups);
+
+  Entries.reserve(Count);
+  Hashes.reserve(Count);
+}
+
+uint32_t HashMap::lookup(const HashKey &Key, size_t Hash) const {
+  if (Groups.empty())
+    return NOT_FOUND;
+
+  const auto Mask = Groups.size() - 1;
+  const auto Byte = controlByte(Hash);
+  auto G = firstGroup(Hash, Groups.size());
+
+  // Triangular probing visits every group since their number is a power of
+  // two, and there is always an empty slot to end on.
+  for (size_t Step = 1;; ++Step) {
+    const auto &Current = Groups[G];
+    for (auto Match = matchByte(Current.Control, Byte); Match;
+         Match &= Match - 1) {
+      const auto Index = Current.Slots[__builtin_ctz(Match)];
+      // Dispatching on the key that's looked up, which is likely in the cache
+      // already, doesn't have to wait for the entry's key to be loaded.
+      if (Key == Entries[Index].first)
+        return Index;
+    }
+
+    if (matchByte(Current.Control, EMPTY))
+      return NOT_FOUND;
+    G = (G + Step) & Mask;
+  }
+}
+
+uint32_t HashMap::insert(const HashKey &Key, size_t Hash, Object *Value) {
+  const auto Index = static_cast<uint32_t>(Entries.size());
+  // Keep at least one slot in eight empty so that probes stay short.
+  if ((Entries.size() + 1) * 8 > Groups.size() * GROUP_SIZE * 7)
+    rehash(std::max<size_t>(1, Groups.size() * 2));
+
+  Entries.emplace_back(Key, Value);
+  Hashes.push_back(Hash);
+  place(Hash, Index);
+  return Index;
+}
+
+void HashMap::place(size_t Hash, uint32_t Index) {
+  const auto Mask = Groups.size() - 1;
+  auto G = firstGroup(Hash, Groups.size());
+
+  for (size_t Step = 1;; ++Step) {
+    auto &Current = Groups[G];
+    const auto Empty = matchByte(Current.Control, EMPTY);
+    if (Empty) {
+      const auto Slot = __builtin_ctz(Empty);
+      Current.Control[Slot] = controlByte(Hash);
+      Current.Slots[Slot] = Index;
+      return;
+    }
+
+    G = (G + Step) & Mask;
+  }
+}
+
+void HashMap::rehash(size_t NumGroups) {
+  Groups.assign(NumGroups, Group());
+  for (auto &G : Groups)
+    std::fill(std::begin(G.Control), std::end(G.Control), EMPTY);
+  for (uint32_t I = 0; I < Entries.size(); ++I)
+    place(Hashes[I], I);
+}
+
+} // namespace monkey::object
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "ObjectInterface.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace monkey::object {
+
+// Borrows the key, which the hash keeps alive by tracing it.
+struct HashKey {
+  explicit HashKey(Object *);
+
+  bool operator==(const HashKey &) const;
+
+  Object *Key;
+};
+
+bool hasHashKey(const HashKey &);
+
+// An open addressing hash table that keeps its entries in insertion order.
+//
+// The entries are stored densely, in the order they were inserted, and the
+// table only holds their positions. It's laid out like a Swiss table: every
+// slot has a control byte that is either empty or holds 7 bits of the key's
+// hash, and a probe looks at a group of 16 control bytes at once, with SSE2
+// where it's available. Most keys that aren't in a group are ruled out
+// without looking at the entries.
+//
+// Hashes are immutable so entries are never removed.
+class HashMap {
+public:
+  using Entry = std::pair<HashKey, Object *>;
+  using iterator = std::vector<Entry>::iterator;
+  using const_iterator = std::vector<Entry>::const_iterator;
+
+  iterator begin() { return Entries.begin(); }
+  iterator end() { return Entries.end(); }
+  const_iterator begin() const { return Entries.begin(); }
+  const_iterator end() const { return Entries.end(); }
+  size_t size() const { return Entries.size(); }
+  bool empty() const { return Entries.empty(); }
+
+  const_iterator find(const HashKey &) const;
+  // Inserts the key unless it's already there, like 'std::unordered_map'.
+  std::pair<iterator, bool> emplace(const HashKey &, Object *);
+  // The value of the key, which is inserted with a null value if it's new.
+  Object *&operator[](const HashKey &);
+  void reserve(size_t);
+
+private:
+  static constexpr size_t GROUP_SIZE = 16;
+  static constexpr uint32_t NOT_FOUND = UINT32_MAX;
+
+  // The control bytes of a group are next to the positions of their entries,
+  // so that a probe usually only touches one or two cache lines.
+  struct alignas(16) Group {
+    int8_t Control[GROUP_SIZE];
+    uint32_t Slots[GROUP_SIZE];
+  };
+
+  // The position of the entry with the key or 'NOT_FOUND'.
+  uint32_t lookup(const HashKey &, size_t Hash) const;
+  // Appends the entry, which must not be in the table yet.
+  uint32_t insert(const HashKey &, size_t Hash, Object *);
+  // Puts the position of an entry into the first free slot of its probe.
+  void place(size_t Hash, uint32_t Index);
+  void rehash(size_t NumGroups);
+
+  std::vector<Entry> Entries;
+  // The hash of each entry, so that growing doesn't hash the keys again.
+  std::vector<size_t> Hashes;
+  // The number of groups is always a power of two.
+  std::vector<Group> Groups;
+};
+
+} // namespace monkey::object
@@ -0,0 +1,82 @@
+#include "HashMap.h"
+#include "Object.h"
+
+#include <gtest/gtest.h>
+
+namespace monkey::object::test {
+
+int64_t integerValue(const Object *Obj) {
+  const auto *Integer = objCast<const object::Integer *>(Obj);
+  EXPECT_NE(Integer, nullptr);
+  return Integer ? Integer->Value : 0;
+}
+
+TEST(HashMapTests, testFindsInsertedKeys) {
+  HashMap Map;
+  std::vector<Object *> Keys;
+  for (int64_t I = 0; I < 10000; ++I) {
+    Keys.push_back(makeInteger(I * 7));
+    Map[HashKey(Keys.back())] = makeInteger(I);
+  }
+
+  ASSERT_EQ(Map.size(), Keys.size());
+  for (int64_t I = 0; I < 10000; ++I) {
+    // Integers outside the small range are new objects.
+    const auto Iter = Map.find(HashKey(makeInteger(I * 7)));
+    ASSERT_NE(Iter, Map.end());
+    ASSERT_EQ(integerValue(Iter->second), I);
+  }
+
+  ASSERT_EQ(Map.find(HashKey(makeInteger(1))), Map.end());
+  ASSERT_EQ(Map.find(HashKey(makeInteger(70000))), Map.end());
+}
+
+TEST(HashMapTests, testKeepsInsertionOrder) {
+  HashMap Map;
+  Map.reserve(3);
+  for (const auto *Key : {"c", "a", "b"})
+    Map.emplace(HashKey(makeString(Key)), NULL_GLOBAL);
+
+  std::vector<std::string> Order;
+  for (const auto &E : Map)
+    Order.push_back(E.first.Key->inspect());
+
+  ASSERT_EQ(Order, (std::vector<std::string>{"c", "a", "b"}));
+}
+
+TEST(HashMapTests, testInsertingExistingKeys) {
+  HashMap Map;
+  auto *Key = makeString("key");
+
+  ASSERT_TRUE(Map.emplace(HashKey(Key), makeInteger(1)).second);
+  const auto Emplaced = Map.emplace(HashKey(makeString("key")), makeInteger(2));
+  ASSERT_FALSE(Emplaced.second);
+  ASSERT_EQ(integerValue(Emplaced.first->second), 1);
+
+  Map[HashKey(makeString("key"))] = makeInteger(3);
+  ASSERT_EQ(Map.size(), 1);
+  ASSERT_EQ(integerValue(Map.find(HashKey(Key))->second), 3);
+}
+
+TEST(HashMapTests, testKeysOfDifferentTypes) {
+  HashMap Map;
+  Map[HashKey(makeInteger(1))] = makeInteger(1);
+  Map[HashKey(TRUE_GLOBAL)] = makeInteger(2);
+  Map[HashKey(makeString("1"))] = makeInteger(3);
+
+  ASSERT_EQ(Map.size(), 3);
+  ASSERT_EQ(integerValue(Map.find(HashKey(makeInteger(1)))->second), 1);
+  ASSERT_EQ(integerValue(Map.find(HashKey(TRUE_GLOBAL))->second), 2);
+  ASSERT_EQ(integerValue(Map.find(HashKey(makeString("1")))->second), 3);
+  ASSERT_EQ(Map.find(HashKey(FALSE_GLOBAL)), Map.end());
+}
+
+TEST(HashMapTests, testEmptyMap) {
+  HashMap Map;
+  Map.reserve(0);
+
+  ASSERT_TRUE(Map.empty());
+  ASSERT_EQ(Map.find(HashKey(makeString("key"))), Map.end());
+}
+
+} // namespace monkey::object::test
@@ -0,0 +1,229 @@
+#include "HashTrie.h"
+
+#include <algorithm>
+
+namespace monkey::object {
+
+namespace {
+
+constexpr unsigned BITS = 5;
+constexpr size_t MASK = (1 << BITS) - 1;
+// Nodes this deep have used up the hash and only hold colliding keys.
+constexpr unsigned MAX_SHIFT = sizeof(size_t) * 8;
+
+uint32_t bitFor(size_t Hash, unsigned Shift) {
+  return 1u << ((Hash >> Shift) & MASK);
+}
+
+// Where the bit's entry or child is among those of the map.
+size_t slot(uint32_t Map, uint32_t Bit) {
+  return __builtin_popcount(Map & (Bit - 1));
+}
+
+} // namespace
+
+// Nodes are never changed once they are shared. Updates copy the nodes on the
+// path to the key and change the copies.
+struct HashTrie::Node {
+  // The slots that hold an entry and those that hold a child.
+  uint32_t EntryMap = 0;
+  uint32_t ChildMap = 0;
+  std::vector<Entry> Entries;
+  std::vector<NodePtr> Children;
+
+  const Entry *find(const HashKey &Key, size_t Hash, unsigned Shift) const {
+    if (Shift >= MAX_SHIFT) {
+      for (const auto &E : Entries) {
+        if (Key == E.Key)
+          return &E;
+      }
+      return nullptr;
+    }
+
+    const auto Bit = bitFor(Hash, Shift);
+    if (EntryMap & Bit) {
+      const auto &E = Entries[slot(EntryMap, Bit)];
+      return E.Hash == Hash && Key == E.Key ? &E : nullptr;
+    }
+
+    if (ChildMap & Bit)
+      return Children[slot(ChildMap, Bit)]->find(Key, Hash, Shift + BITS);
+    return nullptr;
+  }
+
+  NodePtr assoc(const Entry &New, unsigned Shift, bool &Added) const {
+    auto Copy = std::make_shared<Node>(*this);
+
+    if (Shift >= MAX_SHIFT) {
+      for (auto &E : Copy->Entries) {
+        if (New.Key == E.Key) {
+          E.Value = New.Value;
+          return Copy;
+        }
+      }
+
+      Copy->Entries.push_back(New);
+      Added = true;
+      return Copy;
+    }
+
+    const auto Bit = bitFor(New.Hash, Shift);
+    if (EntryMap & Bit) {
+      const auto I = slot(EntryMap, Bit);
+      auto &Old = Copy->Entries[I];
+      if (Old.Hash == New.Hash && New.Key == Old.Key) {
+        Old.Value = New.Value;
+        return Copy;
+      }
+
+      // Both keys move down into a new child.
+      auto Child = pair(Old, New, Shift + BITS);
+      Copy->Entries.erase(Copy->Entries.begin() + I);
+      Copy->EntryMap ^= Bit;
+      Copy->ChildMap |= Bit;
+      Copy->Children.insert(
+          Copy->Children.begin() + slot(Copy->ChildMap, Bit), std::move(Child));
+      Added = true;
+      return Copy;
+    }
+
+    if (ChildMap & Bit) {
+      auto &Child = Copy->Children[slot(ChildMap, Bit)];
+      Child = Child->assoc(New, Shift + BITS, Added);
+      return Copy;
+    }
+
+    Copy->EntryMap |= Bit;
+    Copy->Entries.insert(Copy->Entries.begin() + slot(Copy->EntryMap, Bit),
+                         New);
+    Added = true;
+    return Copy;
+  }
+
+  // Returns nullptr if the key isn't in the node.
+  NodePtr dissoc(const HashKey &Key, size_t Hash, unsigned Shift) const {
+    if (Shift >= MAX_SHIFT) {
+      const auto I =
+          std::find_if(Entries.begin(), Entries.end(),
+                       [&Key](const Entry &E) { return Key == E.Key; });
+      if (I == Entries.end())
+        return nullptr;
+
+      auto Copy = std::make_shared<Node>(*this);
+      Copy->Entries.erase(Copy->Entries.begin() + (I - Entries.begin()));
+      return Copy;
+    }
+
+    const auto Bit = bitFor(Hash, Shift);
+    if (EntryMap & Bit) {
+      const auto I = slot(EntryMap, Bit);
+      const auto &E = Entries[I];
+      if (E.Hash != Hash || !(Key == E.Key))
+        return nullptr;
+
+      auto Copy = std::make_shared<Node>(*this);
+      Copy->Entries.erase(Copy->Entries.begin() + I);
+      Copy->EntryMap ^= Bit;
+      return Copy;
+    }
+
+    if (!(ChildMap & Bit))
+      return nullptr;
+
+    const auto I = slot(ChildMap, Bit);
+    auto Child = Children[I]->dissoc(Key, Hash, Shift + BITS);
+    if (!Child)
+      return nullptr;
+
+    auto Copy = std::make_shared<Node>(*this);
+    if (Child->Children.empty() && Child->Entries.size() == 1) {
+      // A child with a single entry is pulled up so that tries stay shallow.
+      Copy->Children.erase(Copy->Children.begin() + I);
+      Copy->ChildMap ^= Bit;
+      Copy->EntryMap |= Bit;
+      Copy->Entries.insert(Copy->Entries.begin() + slot(Copy->EntryMap, Bit),
+                           Child->Entries.front());
+    } else {
+      Copy->Children[I] = std::move(Child);
+    }
+
+    return Copy;
+  }
+
+  // A node with the two entries, whose keys differ.
+  static NodePtr pair(const Entry &A, const Entry &B, unsigned Shift) {
+    auto N = std::make_shared<Node>();
+    if (Shift >= MAX_SHIFT) {
+      N->Entries = {A, B};
+      return N;
+    }
+
+    const auto BitA = bitFor(A.Hash, Shift);
+    const auto BitB = bitFor(B.Hash, Shift);
+    if (BitA == BitB) {
+      N->ChildMap = BitA;
+      N->Children.push_back(pair(A, B, Shift + BITS));
+      return N;
+    }
+
+    N->EntryMap = BitA | BitB;
+    N->Entries = BitA < BitB ? std::vector<Entry>{A, B}
+                             : std::vector<Entry>{B, A};
+    return N;
+  }
+
+  template <typename F> void forEach(F &&Fn) const {
+    for (const auto &E : Entries)
+      Fn(E);
+    for (const auto &Child : Children)
+      Child->forEach(Fn);
+  }
+};
+
+HashTrie::HashTrie() : HashTrie(std::make_shared<Node>(), 0, 0) {}
+
+HashTrie::HashTrie(NodePtr Root, size_t Size, uint64_t NextOrder)
+    : Root(std::move(Root)), Size(Size), NextOrder(NextOrder) {}
+
+Object *HashTrie::find(const HashKey &Key) const {
+  if (!Size)
+    return nullptr;
+
+  const auto *E = Root->find(Key, Key.Key->hash(), 0);
+  return E ? E->Value : nullptr;
+}
+
+HashTrie HashTrie::assoc(const HashKey &Key, Object *Value) const {
+  bool Added = false;
+  auto NewRoot = Root->assoc({Key, Value, Key.Key->hash(), NextOrder}, 0, Added);
+  return HashTrie(std::move(NewRoot), Size + Added, NextOrder + Added);
+}
+
+HashTrie HashTrie::dissoc(const HashKey &Key) const {
+  auto NewRoot = Size ? Root->dissoc(Key, Key.Key->hash(), 0) : nullptr;
+  if (!NewRoot)
+    return *this;
+
+  return HashTrie(std::move(NewRoot), Size - 1, NextOrder);
+}
+
+std::vector<const HashTrie::Entry *> HashTrie::entries() const {
+  std::vector<const Entry *> Entries;
+  Entries.reserve(Size);
+  Root->forEach([&Entries](const Entry &E) { Entries.push_back(&E); });
+  std::sort(Entries.begin(), Entries.end(),
+            [](const Entry *A, const Entry *B) { return A->Order < B->Order; });
+  return Entries;
+}
+
+void HashTrie::trace(gc::Tracer &Tr) const {
+  Root->forEach([&Tr](const Entry &E) {
+    // Marking never moves a cell, so the shared nodes can stay unchanged.
+    auto *Key = E.Key.Key;
+    auto *Value = E.Value;
+    Tr.visit(Key);
+    Tr.visit(Value);
+  });
+}
+
+} // namespace monkey::object
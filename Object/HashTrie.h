@@ -0,0 +1,60 @@
+#pragma once
+
+#include "HashMap.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace monkey::object {
+
+// A persistent hash array mapped trie. Updates return a new trie that shares
+// every node with the old one except those on the path to the key, so they
+// take O(log32 n) time and space.
+//
+// Every node indexes its children and entries with 5 bits of the key's hash,
+// starting from the lowest, and keeps entries inline until a second key needs
+// the same slot. Keys whose hashes are equal end up in a list at the bottom.
+//
+// Entries remember when their key was first added so that the trie can be
+// listed in insertion order, like 'HashMap'.
+class HashTrie {
+public:
+  struct Entry {
+    HashKey Key;
+    Object *Value;
+    size_t Hash;
+    uint64_t Order;
+  };
+
+  HashTrie();
+
+  size_t size() const { return Size; }
+  bool empty() const { return !Size; }
+
+  // The value of the key or nullptr if it's missing.
+  Object *find(const HashKey &) const;
+  // The trie with the key mapped to the value. A key that was already there
+  // keeps its place in the order.
+  HashTrie assoc(const HashKey &, Object *Value) const;
+  // The trie without the key.
+  HashTrie dissoc(const HashKey &) const;
+
+  // The entries in insertion order.
+  std::vector<const Entry *> entries() const;
+  // Visit every key and value. Nodes shared with other tries are visited
+  // again for each of them.
+  void trace(gc::Tracer &) const;
+
+private:
+  struct Node;
+  using NodePtr = std::shared_ptr<const Node>;
+
+  HashTrie(NodePtr Root, size_t Size, uint64_t NextOrder);
+
+  NodePtr Root;
+  size_t Size;
+  uint64_t NextOrder;
+};
+
+} // namespace monkey::object
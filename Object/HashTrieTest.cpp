@@ -0,0 +1,127 @@
+#include "HashTrie.h"
+#include "Object.h"
+
+#include <gtest/gtest.h>
+
+namespace monkey::object::test {
+
+namespace {
+
+int64_t valueOf(const Object *Obj) {
+  const auto *Integer = objCast<const object::Integer *>(Obj);
+  EXPECT_NE(Integer, nullptr);
+  return Integer ? Integer->Value : 0;
+}
+
+// Keys that all hash the same, which only the bottom of the trie tells apart.
+struct CollidingKey : public Object {
+  explicit CollidingKey(int64_t Id) : Id(Id) {}
+
+  ObjectType type() const override { return ObjectType::INTEGER_OBJ; }
+  std::string inspect() const override { return std::to_string(Id); }
+  size_t hash() const override { return 42; }
+  bool equals(const Object &Obj) const override {
+    const auto *Other = dynamic_cast<const CollidingKey *>(&Obj);
+    return Other && Other->Id == Id;
+  }
+
+  const int64_t Id;
+};
+
+std::vector<std::string> keysInOrder(const HashTrie &Trie) {
+  std::vector<std::string> Keys;
+  for (const auto *E : Trie.entries())
+    Keys.push_back(E->Key.Key->inspect());
+  return Keys;
+}
+
+} // namespace
+
+TEST(HashTrieTests, testFindsAssociatedKeys) {
+  HashTrie Trie;
+  for (int64_t I = 0; I < 10000; ++I)
+    Trie = Trie.assoc(HashKey(makeInteger(I * 7)), makeInteger(I));
+
+  ASSERT_EQ(Trie.size(), 10000);
+  for (int64_t I = 0; I < 10000; ++I) {
+    const auto *Value = Trie.find(HashKey(makeInteger(I * 7)));
+    ASSERT_NE(Value, nullptr);
+    ASSERT_EQ(valueOf(Value), I);
+  }
+
+  ASSERT_EQ(Trie.find(HashKey(makeInteger(1))), nullptr);
+  ASSERT_EQ(Trie.find(HashKey(makeInteger(70000))), nullptr);
+}
+
+TEST(HashTrieTests, testUpdatesLeaveTheOriginal) {
+  const auto Original = HashTrie()
+                            .assoc(HashKey(makeString("a")), makeInteger(1))
+                            .assoc(HashKey(makeString("b")), makeInteger(2));
+  const auto Replaced =
+      Original.assoc(HashKey(makeString("a")), makeInteger(3));
+  const auto Added = Original.assoc(HashKey(makeString("c")), makeInteger(4));
+  const auto Removed = Original.dissoc(HashKey(makeString("b")));
+
+  ASSERT_EQ(Original.size(), 2);
+  ASSERT_EQ(valueOf(Original.find(HashKey(makeString("a")))), 1);
+  ASSERT_EQ(valueOf(Original.find(HashKey(makeString("b")))), 2);
+  ASSERT_EQ(Original.find(HashKey(makeString("c"))), nullptr);
+
+  ASSERT_EQ(Replaced.size(), 2);
+  ASSERT_EQ(valueOf(Replaced.find(HashKey(makeString("a")))), 3);
+  ASSERT_EQ(Added.size(), 3);
+  ASSERT_EQ(valueOf(Added.find(HashKey(makeString("c")))), 4);
+  ASSERT_EQ(Removed.size(), 1);
+  ASSERT_EQ(Removed.find(HashKey(makeString("b"))), nullptr);
+}
+
+TEST(HashTrieTests, testDissoc) {
+  HashTrie Trie;
+  for (int64_t I = 0; I < 1000; ++I)
+    Trie = Trie.assoc(HashKey(makeInteger(I)), makeInteger(I));
+  for (int64_t I = 0; I < 1000; I += 2)
+    Trie = Trie.dissoc(HashKey(makeInteger(I)));
+
+  ASSERT_EQ(Trie.size(), 500);
+  for (int64_t I = 0; I < 1000; ++I) {
+    const auto *Value = Trie.find(HashKey(makeInteger(I)));
+    if (I % 2)
+      ASSERT_EQ(valueOf(Value), I);
+    else
+      ASSERT_EQ(Value, nullptr);
+  }
+
+  ASSERT_EQ(Trie.dissoc(HashKey(makeInteger(0))).size(), 500);
+  ASSERT_EQ(HashTrie().dissoc(HashKey(makeInteger(0))).size(), 0);
+}
+
+TEST(HashTrieTests, testCollidingKeys) {
+  HashTrie Trie;
+  for (int64_t I = 0; I < 5; ++I)
+    Trie = Trie.assoc(HashKey(gc::heap().make<CollidingKey>(I)),
+                      makeInteger(I));
+  Trie = Trie.dissoc(HashKey(gc::heap().make<CollidingKey>(2)));
+
+  ASSERT_EQ(Trie.size(), 4);
+  for (int64_t I = 0; I < 5; ++I) {
+    const auto *Value = Trie.find(HashKey(gc::heap().make<CollidingKey>(I)));
+    if (I == 2)
+      ASSERT_EQ(Value, nullptr);
+    else
+      ASSERT_EQ(valueOf(Value), I);
+  }
+}
+
+TEST(HashTrieTests, testKeepsInsertionOrder) {
+  HashTrie Trie;
+  for (const auto *Key : {"c", "a", "b"})
+    Trie = Trie.assoc(HashKey(makeString(Key)), NULL_GLOBAL);
+  Trie = Trie.assoc(HashKey(makeString("c")), TRUE_GLOBAL);
+  ASSERT_EQ(keysInOrder(Trie), (std::vector<std::string>{"c", "a", "b"}));
+
+  Trie = Trie.dissoc(HashKey(makeString("c")))
+             .assoc(HashKey(makeString("c")), NULL_GLOBAL);
+  ASSERT_EQ(keysInOrder(Trie), (std::vector<std::string>{"a", "b", "c"}));
+}
+
+} // namespace monkey::object::test
@@ -0,0 +1,35 @@
+#include "InternedString.h"
+
+#include <memory>
+#include <unordered_map>
+
+namespace monkey::object {
+
+namespace {
+
+struct CharsHasher {
+  size_t operator()(std::string_view Chars) const { return hashChars(Chars); }
+};
+
+} // namespace
+
+InternedString::InternedString() : InternedString(std::string_view()) {}
+
+InternedString::InternedString(std::string_view Chars) {
+  // The keys point into the entries, which never move.
+  static std::unordered_map<std::string_view, std::unique_ptr<Entry>,
+                            CharsHasher>
+      Table;
+
+  auto Iter = Table.find(Chars);
+  if (Iter == Table.end()) {
+    auto New = std::make_unique<Entry>(Entry{std::string(Chars), 0});
+    New->Hash = hashChars(New->Value);
+    const std::string_view Key(New->Value);
+    Iter = Table.emplace(Key, std::move(New)).first;
+  }
+
+  E = Iter->second.get();
+}
+
+} // namespace monkey::object
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace monkey::object {
+
+// The hash of a string's characters, whether they are interned or not.
+size_t hashChars(std::string_view);
+
+// A handle to a string that is stored once for the whole process. Handles to
+// equal strings point to the same entry, so they compare in O(1), and the
+// entry keeps the string's hash.
+//
+// Entries are never freed. Only the text of programs, such as identifiers and
+// string literals, is interned, and not the strings they build at run time.
+class InternedString {
+public:
+  InternedString();
+  explicit InternedString(std::string_view);
+
+  const std::string &str() const { return E->Value; }
+  size_t hash() const { return E->Hash; }
+
+  bool operator==(const InternedString &Other) const { return E == Other.E; }
+  bool operator!=(const InternedString &Other) const { return E != Other.E; }
+
+private:
+  struct Entry {
+    std::string Value;
+    size_t Hash;
+  };
+
+  const Entry *E;
+};
+
+} // namespace monkey::object
+
+namespace std {
+
+template <> struct hash<monkey::object::InternedString> {
+  size_t operator()(const monkey::object::InternedString &S) const {
+    return S.hash();
+  }
+};
+
+} // namespace std
@@ -0,0 +1,33 @@
+#include "InternedString.h"
+#include "Object.h"
+
+#include <gtest/gtest.h>
+
+namespace monkey::object::test {
+
+TEST(InternedStringTests, testEqualStringsShareAnEntry) {
+  const InternedString A("foobar");
+  const InternedString B(std::string("foo") + "bar");
+  const InternedString C("foobaz");
+
+  ASSERT_EQ(A, B);
+  ASSERT_EQ(&A.str(), &B.str());
+  ASSERT_NE(A, C);
+  ASSERT_EQ(A.str(), "foobar");
+  ASSERT_EQ(InternedString(), InternedString(""));
+}
+
+TEST(InternedStringTests, testInternedStringsMatchOtherStrings) {
+  const auto *Interned = makeString(InternedString("hello world"));
+  const auto *Plain = makeString("hello world");
+  const auto *Other = makeString(InternedString("hello there"));
+
+  ASSERT_EQ(Interned->value(), "hello world");
+  ASSERT_EQ(Interned->size(), 11);
+  ASSERT_TRUE(Interned->equals(*Plain));
+  ASSERT_TRUE(Plain->equals(*Interned));
+  ASSERT_FALSE(Interned->equals(*Other));
+  ASSERT_EQ(Interned->hash(), Plain->hash());
+}
+
+} // namespace monkey::object::test
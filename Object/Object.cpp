@@ -1,28 +1,168 @@
 #include "Object.h"
 
+#include <algorithm>
+#include <cstring>
 #include <sstream>
 
 namespace monkey::object {
 
-const std::shared_ptr<Object> TRUE_GLOBAL = std::make_shared<Boolean>(true);
-const std::shared_ptr<Object> FALSE_GLOBAL = std::make_shared<Boolean>(false);
-const std::shared_ptr<Object> NULL_GLOBAL = std::make_shared<Null>();
+namespace {
+Boolean TrueObject(true);
+Boolean FalseObject(false);
+Null NullObject;
 
-boost::pool_allocator<object::Integer> INTEGER_ALLOC;
-boost::pool_allocator<object::ReturnValue> RETURN_ALLOC;
-boost::pool_allocator<object::Function> FUNCTION_ALLOC;
-boost::pool_allocator<object::String> STRING_ALLOC;
-boost::pool_allocator<object::Array> ARRAY_ALLOC;
-boost::pool_allocator<object::Hash> HASH_ALLOC;
-boost::pool_allocator<object::Closure> CLOSURE_ALLOC;
+std::vector<Integer> makeSmallIntegers() {
+  std::vector<Integer> Integers;
+  Integers.reserve(SMALL_INTEGER_MAX - SMALL_INTEGER_MIN + 1);
+  for (int64_t I = SMALL_INTEGER_MIN; I <= SMALL_INTEGER_MAX; ++I)
+    Integers.emplace_back(I);
 
-const std::shared_ptr<Object> &nativeBooleanToBooleanObject(bool Val) {
+  return Integers;
+}
+
+std::vector<Integer> SmallIntegers = makeSmallIntegers();
+SmallIntegerStats SmallStats;
+
+// wyhash (final version 4) by Wang Yi, which is in the public domain.
+constexpr uint64_t WY_SECRET[4] = {0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+                               0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull};
+
+constexpr void wymum(uint64_t &A, uint64_t &B) {
+  const auto R = static_cast<__uint128_t>(A) * B;
+  A = static_cast<uint64_t>(R);
+  B = static_cast<uint64_t>(R >> 64);
+}
+
+constexpr uint64_t wymix(uint64_t A, uint64_t B) {
+  wymum(A, B);
+  return A ^ B;
+}
+
+uint64_t read8(const uint8_t *P) {
+  uint64_t V;
+  std::memcpy(&V, P, sizeof(V));
+  return V;
+}
+
+uint64_t read4(const uint8_t *P) {
+  uint32_t V;
+  std::memcpy(&V, P, sizeof(V));
+  return V;
+}
+
+uint64_t wyhash(const void *Key, size_t Len, uint64_t Seed) {
+  const auto *P = static_cast<const uint8_t *>(Key);
+  Seed ^= wymix(Seed ^ WY_SECRET[0], WY_SECRET[1]);
+  uint64_t A, B;
+
+  if (Len <= 16) {
+    if (Len >= 4) {
+      A = (read4(P) << 32) | read4(P + ((Len >> 3) << 2));
+      B = (read4(P + Len - 4) << 32) | read4(P + Len - 4 - ((Len >> 3) << 2));
+    } else if (Len > 0) {
+      A = (static_cast<uint64_t>(P[0]) << 16) |
+          (static_cast<uint64_t>(P[Len >> 1]) << 8) | P[Len - 1];
+      B = 0;
+    } else {
+      A = B = 0;
+    }
+  } else {
+    auto I = Len;
+    if (I >= 48) {
+      auto See1 = Seed, See2 = Seed;
+      do {
+        Seed = wymix(read8(P) ^ WY_SECRET[1], read8(P + 8) ^ Seed);
+        See1 = wymix(read8(P + 16) ^ WY_SECRET[2], read8(P + 24) ^ See1);
+        See2 = wymix(read8(P + 32) ^ WY_SECRET[3], read8(P + 40) ^ See2);
+        P += 48;
+        I -= 48;
+      } while (I >= 48);
+      Seed ^= See1 ^ See2;
+    }
+
+    while (I > 16) {
+      Seed = wymix(read8(P) ^ WY_SECRET[1], read8(P + 8) ^ Seed);
+      I -= 16;
+      P += 16;
+    }
+
+    A = read8(P + I - 16);
+    B = read8(P + I - 8);
+  }
+
+  A ^= WY_SECRET[1];
+  B ^= Seed;
+  wymum(A, B);
+  return wymix(A ^ WY_SECRET[0] ^ Len, B ^ WY_SECRET[1]);
+}
+
+// Keys of different types are told apart by seeding their hashes with the
+// type, which saves 'HashKeyHasher' from asking for it.
+constexpr uint64_t typeSeed(ObjectType Type) {
+  return wymix(static_cast<uint64_t>(Type), WY_SECRET[0]);
+}
+
+constexpr uint64_t INTEGER_SEED = typeSeed(ObjectType::INTEGER_OBJ);
+constexpr uint64_t BOOLEAN_SEED = typeSeed(ObjectType::BOOLEAN_OBJ);
+constexpr uint64_t STRING_SEED = typeSeed(ObjectType::STRING_OBJ);
+} // namespace
+
+size_t hashChars(std::string_view Chars) {
+  return wyhash(Chars.data(), Chars.size(), 0);
+}
+
+Object *const TRUE_GLOBAL = &TrueObject;
+Object *const FALSE_GLOBAL = &FalseObject;
+Object *const NULL_GLOBAL = &NullObject;
+
+Object *nativeBooleanToBooleanObject(bool Val) {
   if (Val)
     return TRUE_GLOBAL;
 
   return FALSE_GLOBAL;
 }
 
+const SmallIntegerStats &smallIntegerStats() { return SmallStats; }
+
+Integer *makeInteger(int64_t Value) {
+  if (Value >= SMALL_INTEGER_MIN && Value <= SMALL_INTEGER_MAX) {
+    ++SmallStats.Hits;
+    return &SmallIntegers[Value - SMALL_INTEGER_MIN];
+  }
+
+  ++SmallStats.Misses;
+  return gc::heap().make<Integer>(Value);
+}
+
+PinnedObjects::PinnedObjects() { gc::heap().addRoots(this); }
+
+PinnedObjects::~PinnedObjects() { gc::heap().removeRoots(this); }
+
+void PinnedObjects::add(const Object *Obj) {
+  static PinnedObjects Pinned;
+  if (Obj->Pinned)
+    return;
+
+  Obj->Pinned = true;
+  Pinned.Objects.push_back(const_cast<Object *>(Obj));
+}
+
+void PinnedObjects::traceRoots(gc::Tracer &Tr) {
+  // Forget the objects whose references are all gone.
+  Objects.erase(std::remove_if(Objects.begin(), Objects.end(),
+                               [](Object *Obj) {
+                                 if (Obj->refCount())
+                                   return false;
+
+                                 Obj->Pinned = false;
+                                 return true;
+                               }),
+                Objects.end());
+
+  for (auto &Obj : Objects)
+    Tr.visit(Obj);
+}
+
 const char *objTypeToString(ObjectType Type) {
   switch (Type) {
   case ObjectType::INTEGER_OBJ:
@@ -60,7 +200,9 @@ ObjectType Integer::type() const { return ObjectType::INTEGER_OBJ; }
 
 std::string Integer::inspect() const { return std::to_string(Value); }
 
-size_t Integer::hash() const { return std::hash<int64_t>()(Value); }
+size_t Integer::hash() const {
+  return INTEGER_SEED ^ std::hash<int64_t>()(Value);
+}
 
 bool Integer::equals(const Object &Obj) const {
   const auto *I = objCast<const Integer *>(&Obj);
@@ -76,7 +218,9 @@ ObjectType Boolean::type() const { return ObjectType::BOOLEAN_OBJ; }
 
 std::string Boolean::inspect() const { return Value ? "true" : "false"; }
 
-size_t Boolean::hash() const { return std::hash<bool>()(Value); }
+size_t Boolean::hash() const {
+  return BOOLEAN_SEED ^ std::hash<bool>()(Value);
+}
 
 bool Boolean::equals(const Object &Obj) const {
   const auto *B = objCast<const Boolean *>(&Obj);
@@ -94,20 +238,23 @@ ObjectType ReturnValue::type() const { return ObjectType::RETURN_VALUE_OBJ; }
 
 std::string ReturnValue::inspect() const { return Value->inspect(); }
 
+void ReturnValue::trace(gc::Tracer &Tr) { Tr.visit(Value); }
+
 ObjectType Error::type() const { return ObjectType::ERROR_OBJ; }
 
 std::string Error::inspect() const { return "ERROR: " + Message; }
 
-Function::Function(std::vector<std::unique_ptr<ast::Identifier>> &&Parameters,
-                   std::unique_ptr<ast::BlockStatement> Body,
-                   std::shared_ptr<environment::Environment> &Env)
-    : Parameters(std::move(Parameters)), Body(std::move(Body)), Env(Env) {}
+Function::Function(std::shared_ptr<const ast::FunctionLiteral> Literal,
+                   std::shared_ptr<const Code> Run,
+                   environment::Environment *Env)
+    : Literal(std::move(Literal)), Run(std::move(Run)), Env(Env) {}
 
 ObjectType Function::type() const { return ObjectType::FUNCTION_OBJ; }
 
 std::string Function::inspect() const {
   std::stringstream SS;
   SS << "fn(";
+  const auto &Parameters = Literal->Parameters;
   for (const auto &Param : Parameters) {
     SS << Param->string();
     if (&Param != &Parameters.back())
@@ -115,23 +262,76 @@ std::string Function::inspect() const {
   }
 
   SS << ") {\n";
-  SS << Body->string();
+  SS << Literal->Body->string();
   SS << "\n}";
   return SS.str();
 }
 
+void Function::trace(gc::Tracer &Tr) { Tr.visit(Env); }
+
+String::String(InternedString Interned)
+    : Interned(Interned), Length(Interned.str().size()) {}
+
+String::String(const String *Left, const String *Right)
+    : Left(Left), Right(Right), Length(Left->size() + Right->size()) {}
+
 ObjectType String::type() const { return ObjectType::STRING_OBJ; }
 
-std::string String::inspect() const { return Value; }
+std::string String::inspect() const { return value(); }
 
-size_t String::hash() const { return std::hash<std::string>()(Value); }
+size_t String::hash() const {
+  if (!Hashed) {
+    HashCode = STRING_SEED ^ (Interned ? Interned->hash() : hashChars(value()));
+    Hashed = true;
+  }
+  return HashCode;
+}
 
 bool String::equals(const Object &Obj) const {
   const auto *S = objCast<const String *>(&Obj);
   if (!S)
     return false;
 
-  return Value == S->Value;
+  if (Interned && S->Interned)
+    return *Interned == *S->Interned;
+  return Length == S->Length && value() == S->value();
+}
+
+void String::trace(gc::Tracer &Tr) {
+  // Marking doesn't change the halves.
+  auto *L = const_cast<String *>(Left);
+  auto *R = const_cast<String *>(Right);
+  Tr.visit(L);
+  Tr.visit(R);
+}
+
+void String::flatten() const {
+  std::string Flat;
+  Flat.reserve(Length);
+
+  // Strings built in a loop are deeply nested, so walk them without recursing.
+  std::vector<const String *> Pending{Right, Left};
+  while (!Pending.empty()) {
+    const auto *S = Pending.back();
+    Pending.pop_back();
+    if (S->Left) {
+      Pending.push_back(S->Right);
+      Pending.push_back(S->Left);
+    } else {
+      Flat += S->value();
+    }
+  }
+
+  Value = std::move(Flat);
+  Left = Right = nullptr;
+}
+
+String *concatenate(const String *Left, const String *Right) {
+  constexpr size_t MIN_ROPE_LENGTH = 64;
+  if (Left->size() + Right->size() < MIN_ROPE_LENGTH)
+    return makeString(Left->value() + Right->value());
+
+  return gc::heap().make<String>(Left, Right);
 }
 
 BuiltIn::BuiltIn(const BuiltInFunction &Fn) : Fn(Fn) {}
@@ -140,46 +340,54 @@ ObjectType BuiltIn::type() const { return ObjectType::BUILTIN_OBJ; }
 
 std::string BuiltIn::inspect() const { return "builtin string"; }
 
-Array::Array(std::vector<std::shared_ptr<object::Object>> &&Elements)
-    : Elements(std::move(Elements)) {}
+Array::Array(Buffer &&Elements)
+    : Elements(std::make_shared<Buffer>(std::move(Elements))), Offset(0),
+      Length(this->Elements->size()) {}
+
+Array::Array(std::shared_ptr<Buffer> Elements, size_t Offset, size_t Length)
+    : Elements(std::move(Elements)), Offset(Offset), Length(Length) {}
 
 ObjectType Array::type() const { return ObjectType::ARRAY_OBJ; }
 
 std::string Array::inspect() const {
   std::stringstream SS;
   SS << "[";
-  for (const auto &E : Elements) {
-    SS << E->inspect();
-    if (E.get() != Elements.back().get())
+  for (size_t I = 0; I < Length; ++I) {
+    if (I)
       SS << ", ";
+    SS << (*this)[I]->inspect();
   }
 
   SS << "]";
   return SS.str();
 }
 
-HashKey::HashKey(const std::shared_ptr<object::Object> &Key) : Key(Key) {}
-
-bool HashKey::operator==(const HashKey &Other) const {
-  return Key->equals(*Other.Key);
+void Array::trace(gc::Tracer &Tr) {
+  for (size_t I = Offset; I < Offset + Length; ++I)
+    Tr.visit((*Elements)[I]);
 }
 
-bool hasHashKey(const HashKey &Hash) {
-  const auto ObjType = Hash.Key->type();
-  return ObjType == ObjectType::BOOLEAN_OBJ ||
-         ObjType == ObjectType::INTEGER_OBJ ||
-         ObjType == ObjectType::STRING_OBJ;
+Array *Array::rest() const {
+  return gc::heap().make<Array>(Elements, Offset + 1, Length - 1);
 }
 
-size_t HashKeyHasher::operator()(const HashKey &Hash) const {
-  const auto TypeHash =
-      std::hash<uint64_t>()(static_cast<uint64_t>(Hash.Key->type()));
-  return TypeHash ^ Hash.Key->hash();
+Array *Array::push(Object *Obj) const {
+  // Only one array can extend the buffer, the others copy their window.
+  if (Offset + Length == Elements->size()) {
+    Elements->push_back(Obj);
+    return gc::heap().make<Array>(Elements, Offset, Length + 1);
+  }
+
+  Buffer Pushed;
+  Pushed.reserve(Length + 1);
+  Pushed.assign(begin(), end());
+  Pushed.push_back(Obj);
+  return gc::heap().make<Array>(std::move(Pushed));
 }
 
-Hash::Hash(std::unordered_map<HashKey, std::shared_ptr<object::Object>,
-                              HashKeyHasher> &&Pairs)
-    : Pairs(std::move(Pairs)) {}
+Hash::Hash(PairMap &&Pairs) : Pairs(std::move(Pairs)), Derived(false) {}
+
+Hash::Hash(HashTrie &&Trie) : Trie(std::move(Trie)), Derived(true) {}
 
 ObjectType Hash::type() const { return ObjectType::HASH_OBJ; }
 
@@ -188,18 +396,86 @@ std::string Hash::inspect() const {
   SS << "{";
 
   bool First = true;
-  for (const auto &P : Pairs) {
+  const auto Print = [&SS, &First](const Object *Key, const Object *Value) {
     if (!First)
       SS << ", ";
 
     First = false;
-    SS << P.first.Key->inspect() << ": " << P.second->inspect();
+    SS << Key->inspect() << ": " << Value->inspect();
+  };
+
+  if (Derived) {
+    for (const auto *E : Trie.entries())
+      Print(E->Key.Key, E->Value);
+  } else {
+    for (const auto &P : Pairs)
+      Print(P.first.Key, P.second);
   }
 
   SS << "}";
   return SS.str();
 }
 
+Object *Hash::find(Object *Key) const {
+  if (Derived)
+    return Trie.find(HashKey(Key));
+
+  const auto I = Pairs.find(HashKey(Key));
+  return I == Pairs.end() ? nullptr : I->second;
+}
+
+Object *Hash::find(Object *Key, HashIndexCache &Cache) const {
+  if (Derived)
+    return Trie.find(HashKey(Key));
+
+  if (Cache.Index < Pairs.size()) {
+    const auto &Cached = *(Pairs.begin() + Cache.Index);
+    if (Cached.first.Key == Key)
+      return Cached.second;
+  }
+
+  const auto I = Pairs.find(HashKey(Key));
+  if (I == Pairs.end())
+    return nullptr;
+
+  Cache.Index = I - Pairs.begin();
+  return I->second;
+}
+
+size_t Hash::size() const { return Derived ? Trie.size() : Pairs.size(); }
+
+Hash *Hash::assoc(Object *Key, Object *Value) const {
+  return makeHash(trie().assoc(HashKey(Key), Value));
+}
+
+Hash *Hash::dissoc(Object *Key) const {
+  return makeHash(trie().dissoc(HashKey(Key)));
+}
+
+const HashTrie &Hash::trie() const {
+  if (!Derived && Trie.size() != Pairs.size()) {
+    for (const auto &P : Pairs)
+      Trie = Trie.assoc(P.first, P.second);
+  }
+
+  return Trie;
+}
+
+void Hash::trace(gc::Tracer &Tr) {
+  // A trie built from the pairs holds nothing else.
+  if (Derived) {
+    Trie.trace(Tr);
+    return;
+  }
+
+  for (auto &P : Pairs) {
+    // Marking never moves a cell so the key's hash stays the same.
+    auto *Key = P.first.Key;
+    Tr.visit(Key);
+    Tr.visit(P.second);
+  }
+}
+
 ObjectType CompiledFunction::type() const {
   return ObjectType::COMPILED_FUNCTION_OBJ;
 }
@@ -218,4 +494,10 @@ std::string Closure::inspect() const {
   return SS.str();
 }
 
+void Closure::trace(gc::Tracer &Tr) {
+  Tr.visit(Fn);
+  for (auto &V : Free)
+    V.trace(Tr);
+}
+
 } // namespace monkey::object
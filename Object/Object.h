@@ -1,39 +1,62 @@
 #pragma once
 
+#include "HashMap.h"
+#include "HashTrie.h"
+#include "InternedString.h"
 #include "ObjectInterface.h"
+#include "Ref.h"
+#include "Value.h"
 
 #include <AST/AST.h>
 #include <Code/Code.h>
+#include <Code/RegisterCode.h>
 #include <Environment/Environment.h>
 
-#include <boost/pool/pool_alloc.hpp>
-
 #include <functional>
 #include <memory>
+#include <optional>
+
+namespace monkey::vm {
+struct Trace;
+} // namespace monkey::vm
 
 namespace monkey::object {
 
-extern const std::shared_ptr<Object> TRUE_GLOBAL;
-extern const std::shared_ptr<Object> FALSE_GLOBAL;
-extern const std::shared_ptr<Object> NULL_GLOBAL;
-
-const std::shared_ptr<Object> &nativeBooleanToBooleanObject(bool Val);
-
-enum class ObjectType : uint64_t {
-  INTEGER_OBJ,
-  BOOLEAN_OBJ,
-  NULL_OBJ,
-  RETURN_VALUE_OBJ,
-  ERROR_OBJ,
-  FUNCTION_OBJ,
-  STRING_OBJ,
-  BUILTIN_OBJ,
-  ARRAY_OBJ,
-  HASH_OBJ,
-  COMPILED_FUNCTION_OBJ,
-  CLOSURE_OBJ
+// The singletons live outside the heap and are never collected.
+extern Object *const TRUE_GLOBAL;
+extern Object *const FALSE_GLOBAL;
+extern Object *const NULL_GLOBAL;
+
+Object *nativeBooleanToBooleanObject(bool Val);
+
+// Integers in this range are preallocated outside the heap, like the
+// singletons, and shared by every 'makeInteger' call. The build can change the
+// range with MONKEY_SMALL_INTEGER_MIN and MONKEY_SMALL_INTEGER_MAX.
+#ifndef MONKEY_SMALL_INTEGER_MIN
+#define MONKEY_SMALL_INTEGER_MIN -128
+#endif
+#ifndef MONKEY_SMALL_INTEGER_MAX
+#define MONKEY_SMALL_INTEGER_MAX 1023
+#endif
+const int64_t SMALL_INTEGER_MIN = MONKEY_SMALL_INTEGER_MIN;
+const int64_t SMALL_INTEGER_MAX = MONKEY_SMALL_INTEGER_MAX;
+static_assert(SMALL_INTEGER_MIN <= SMALL_INTEGER_MAX,
+              "the small integer range is empty");
+
+struct SmallIntegerStats {
+  // Calls to 'makeInteger' inside and outside the range.
+  uint64_t Hits = 0;
+  uint64_t Misses = 0;
+
+  double hitRate() const {
+    return Hits + Misses ? static_cast<double>(Hits) /
+                               static_cast<double>(Hits + Misses)
+                         : 0.0;
+  }
 };
 
+const SmallIntegerStats &smallIntegerStats();
+
 const char *objTypeToString(ObjectType);
 
 struct Integer : public Object {
@@ -46,7 +69,8 @@ struct Integer : public Object {
   size_t hash() const override;
   bool equals(const Object &) const override;
 
-  int64_t Value;
+  // Small integers are shared so they must never change.
+  const int64_t Value;
 };
 
 struct Boolean : public Object {
@@ -72,15 +96,15 @@ struct Null : public Object {
 };
 
 struct ReturnValue : public Object {
-  template <typename T>
-  explicit ReturnValue(T &&Value) : Value(std::forward<T>(Value)) {}
+  explicit ReturnValue(Object *Value) : Value(Value) {}
   virtual ~ReturnValue() = default;
 
   // Object impl.
   ObjectType type() const override;
   std::string inspect() const override;
+  void trace(gc::Tracer &) override;
 
-  std::shared_ptr<object::Object> Value;
+  Object *Value;
 };
 
 struct Error : public Object {
@@ -96,36 +120,73 @@ struct Error : public Object {
 };
 
 struct Function : public Object {
-  Function(std::vector<std::unique_ptr<ast::Identifier>> &&,
-           std::unique_ptr<ast::BlockStatement>,
-           std::shared_ptr<environment::Environment> &);
+  // Runs the body in the environment of a call.
+  using Code = std::function<Object *(environment::Environment *)>;
+
+  Function(std::shared_ptr<const ast::FunctionLiteral>,
+           std::shared_ptr<const Code>, environment::Environment *);
   virtual ~Function() = default;
 
   // Object impl.
   ObjectType type() const override;
   std::string inspect() const override;
-
-  std::vector<std::unique_ptr<ast::Identifier>> Parameters;
-  std::unique_ptr<ast::BlockStatement> Body;
-  std::shared_ptr<environment::Environment> Env;
+  void trace(gc::Tracer &) override;
+
+  // Both are shared by every function made from the same literal. 'Run'
+  // either walks the literal's body or calls the closures it was compiled to,
+  // depending on the evaluator that made the function.
+  std::shared_ptr<const ast::FunctionLiteral> Literal;
+  std::shared_ptr<const Code> Run;
+  environment::Environment *Env;
 };
 
+// Concatenating long strings doesn't copy them. The result only points to
+// both halves until its characters are needed, which copies them all at once,
+// so building a string piece by piece takes linear time.
+//
+// Strings from the program text are interned, which lets them be compared
+// without looking at their characters.
 struct String : public Object {
   template <typename T>
-  explicit String(T &&Value) : Value(std::forward<T>(Value)) {}
+  explicit String(T &&Value)
+      : Value(std::forward<T>(Value)), Length(this->Value.size()) {}
+  explicit String(InternedString);
+  String(const String *Left, const String *Right);
   virtual ~String() = default;
 
   // Object impl.
   ObjectType type() const override;
   std::string inspect() const override;
+  // Computed on first use since most strings are never used as keys.
   size_t hash() const override;
   bool equals(const Object &) const override;
-
-  const std::string Value;
+  void trace(gc::Tracer &) override;
+
+  // The characters, which are copied out of the halves on first use.
+  const std::string &value() const {
+    if (Interned)
+      return Interned->str();
+    if (Left)
+      flatten();
+    return Value;
+  }
+  size_t size() const { return Length; }
+
+  mutable size_t HashCode = 0;
+  mutable bool Hashed = false;
+
+private:
+  void flatten() const;
+
+  mutable std::string Value;
+  // Both are set until the string is flattened.
+  mutable const String *Left = nullptr;
+  mutable const String *Right = nullptr;
+  const std::optional<InternedString> Interned;
+  const size_t Length;
 };
 
-using BuiltInFunction = std::function<std::shared_ptr<Object>(
-    const std::vector<std::shared_ptr<Object>> &)>;
+using BuiltInFunction = std::function<Value(const std::vector<Value> &)>;
 
 struct BuiltIn : public Object {
   explicit BuiltIn(const BuiltInFunction &);
@@ -138,42 +199,88 @@ struct BuiltIn : public Object {
   BuiltInFunction Fn;
 };
 
+// Arrays are immutable, so they share their elements. An array is a window
+// into a buffer that other arrays may look at as well: 'rest' starts the window
+// one element later, and 'push' appends to the buffer in place if nothing was
+// appended after the array's last element yet. Building an array by pushing
+// and taking it apart with 'rest' therefore never copies it.
 struct Array : public Object {
-  explicit Array(std::vector<std::shared_ptr<object::Object>> &&);
+  using Buffer = std::vector<Object *>;
+
+  explicit Array(Buffer &&);
+  Array(std::shared_ptr<Buffer>, size_t Offset, size_t Length);
   virtual ~Array() = default;
 
   // Object impl.
   ObjectType type() const override;
   std::string inspect() const override;
-
-  const std::vector<std::shared_ptr<object::Object>> Elements;
+  void trace(gc::Tracer &) override;
+
+  size_t size() const { return Length; }
+  bool empty() const { return !Length; }
+  Object *operator[](size_t I) const { return (*Elements)[Offset + I]; }
+  Object *front() const { return (*this)[0]; }
+  Object *back() const { return (*this)[Length - 1]; }
+  // Pushing to the array may invalidate its iterators.
+  Object *const *begin() const { return Elements->data() + Offset; }
+  Object *const *end() const { return begin() + Length; }
+
+  // The array without its first element, which must exist.
+  Array *rest() const;
+  // The array with 'Obj' appended.
+  Array *push(Object *Obj) const;
+
+private:
+  // Elements past the end of the window may belong to other arrays or to none.
+  std::shared_ptr<Buffer> Elements;
+  size_t Offset;
+  size_t Length;
 };
 
-struct HashKey {
-  explicit HashKey(const std::shared_ptr<object::Object> &);
-
-  bool operator==(const HashKey &) const;
-
-  const std::shared_ptr<object::Object> Key;
-};
-
-bool hasHashKey(const HashKey &);
-
-struct HashKeyHasher {
-  size_t operator()(const HashKey &) const;
+// The position of the entry where a lookup last found its key. Keys built from
+// the same constant are the same object, so checking the remembered entry only
+// compares pointers.
+struct HashIndexCache {
+  size_t Index = 0;
 };
 
+// Hashes built from literals keep their pairs in a flat table, which is the
+// fastest to build and look up. Those derived with 'assoc' and 'dissoc' keep
+// them in a trie instead, which shares most of its nodes with the hash it was
+// derived from.
 struct Hash : public Object {
-  explicit Hash(std::unordered_map<HashKey, std::shared_ptr<object::Object>,
-                                   HashKeyHasher> &&);
+  using PairMap = HashMap;
+
+  explicit Hash(PairMap &&);
+  explicit Hash(HashTrie &&);
 
   // Object impl.
   ObjectType type() const override;
   std::string inspect() const override;
-
-  const std::unordered_map<HashKey, std::shared_ptr<object::Object>,
-                           HashKeyHasher>
-      Pairs;
+  void trace(gc::Tracer &) override;
+
+  // The value of the key or nullptr if it's missing. The key must be usable
+  // as a hash key.
+  Object *find(Object *Key) const;
+  // Like above, but the cache is tried first and updated when the key is
+  // found elsewhere.
+  Object *find(Object *Key, HashIndexCache &) const;
+  size_t size() const;
+
+  // The hash with the key mapped to the value, or without the key. The key
+  // must be usable as a hash key.
+  Hash *assoc(Object *Key, Object *Value) const;
+  Hash *dissoc(Object *Key) const;
+
+  // Only used when 'Derived' is false.
+  PairMap Pairs;
+  // The pairs of a derived hash. Other hashes build it from 'Pairs' the first
+  // time they are derived from.
+  mutable HashTrie Trie;
+  const bool Derived;
+
+private:
+  const HashTrie &trie() const;
 };
 
 struct CompiledFunction : public Object {
@@ -187,22 +294,36 @@ struct CompiledFunction : public Object {
   std::string inspect() const override;
 
   code::Instructions Ins;
+  code::DecodedInstructions DecodedIns;
+  // Only set for functions compiled for the register VM. 'NumLocals' is the
+  // size of the function's register window then.
+  code::RegisterInstructions RegisterIns;
   const int NumLocals;
   const int NumParameters;
+  // Bookkeeping of the VM's JIT. 'NativeCode' is a 'vm::NativeFunction' once
+  // the function has been compiled.
+  mutable int CallCount = 0;
+  mutable const void *NativeCode = nullptr;
+  // How often the function tail called itself and its trace once it has been
+  // recorded.
+  mutable int LoopCount = 0;
+  mutable std::shared_ptr<const vm::Trace> Trace;
+  // The caches of the function's 'OpIndexConst' instructions.
+  mutable std::vector<HashIndexCache> IndexCaches;
 };
 
 struct Closure : public Object {
-  template <typename T> explicit Closure(T &&Fn) : Fn(std::forward<T>(Fn)) {}
-  template <typename T0, typename T1>
-  Closure(T0 &&Fn, T1 &&Free)
-      : Fn(std::forward<T0>(Fn)), Free(std::forward<T1>(Free)) {}
+  explicit Closure(Object *Fn) : Fn(Fn) {}
+  template <typename T>
+  Closure(Object *Fn, T &&Free) : Fn(Fn), Free(std::forward<T>(Free)) {}
 
   // Object impl.
   ObjectType type() const override;
   std::string inspect() const override;
+  void trace(gc::Tracer &) override;
 
-  const std::shared_ptr<Object> Fn;
-  const std::vector<std::shared_ptr<Object>> Free;
+  Object *Fn;
+  std::vector<Value> Free;
 };
 
 template <typename T, ObjectType ObjType>
@@ -271,60 +392,53 @@ template <> inline const Closure *objCast<const Closure *>(const Object *Obj) {
   return objCastImpl<const Closure *, ObjectType::CLOSURE_OBJ>(Obj);
 }
 
-extern boost::pool_allocator<object::Integer> INTEGER_ALLOC;
-extern boost::pool_allocator<object::ReturnValue> RETURN_ALLOC;
-extern boost::pool_allocator<object::Function> FUNCTION_ALLOC;
-extern boost::pool_allocator<object::String> STRING_ALLOC;
-extern boost::pool_allocator<object::Array> ARRAY_ALLOC;
-extern boost::pool_allocator<object::Hash> HASH_ALLOC;
-extern boost::pool_allocator<object::Closure> CLOSURE_ALLOC;
-
-inline std::shared_ptr<Integer> makeInteger(int Value) {
-  return std::allocate_shared<Integer, boost::pool_allocator<Integer>>(
-      INTEGER_ALLOC, Value);
+// Returns the preallocated integer when 'Value' is small.
+Integer *makeInteger(int64_t Value);
+
+inline ReturnValue *makeReturn(Object *Return) {
+  return gc::heap().make<ReturnValue>(Return);
 }
 
-template <typename T>
-inline std::shared_ptr<ReturnValue> makeReturn(T &&Return) {
-  return std::allocate_shared<ReturnValue, boost::pool_allocator<ReturnValue>>(
-      RETURN_ALLOC, std::forward<T>(Return));
+inline Function *
+makeFunction(std::shared_ptr<const ast::FunctionLiteral> Literal,
+             std::shared_ptr<const Function::Code> Run,
+             environment::Environment *Env) {
+  return gc::heap().make<Function>(std::move(Literal), std::move(Run), Env);
 }
 
-inline std::shared_ptr<Function>
-makeFunction(std::vector<std::unique_ptr<ast::Identifier>> &&Parameters,
-             std::unique_ptr<ast::BlockStatement> Body,
-             std::shared_ptr<environment::Environment> &Env) {
-  return std::allocate_shared<Function, boost::pool_allocator<Function>>(
-      FUNCTION_ALLOC, std::move(Parameters), std::move(Body), Env);
+template <typename T> inline String *makeString(T &&Value) {
+  return gc::heap().make<String>(std::forward<T>(Value));
 }
 
-template <typename T> inline std::shared_ptr<String> makeString(T &&Value) {
-  return std::allocate_shared<String, boost::pool_allocator<String>>(
-      STRING_ALLOC, std::forward<T>(Value));
+// Short results are copied right away, since the characters fit into the
+// 'std::string' about as cheaply as the pointers to the halves.
+String *concatenate(const String *Left, const String *Right);
+
+inline Array *makeArray(Array::Buffer &&Value) {
+  return gc::heap().make<Array>(std::move(Value));
 }
 
-inline std::shared_ptr<Array>
-makeArray(std::vector<std::shared_ptr<Object>> &&Value) {
-  return std::allocate_shared<Array, boost::pool_allocator<Array>>(
-      ARRAY_ALLOC, std::move(Value));
+inline Hash *makeHash(Hash::PairMap &&Value) {
+  return gc::heap().make<Hash>(std::move(Value));
 }
 
-inline std::shared_ptr<Hash> makeHash(
-    std::unordered_map<HashKey, std::shared_ptr<object::Object>, HashKeyHasher>
-        &&Value) {
-  return std::allocate_shared<Hash, boost::pool_allocator<Hash>>(
-      HASH_ALLOC, std::move(Value));
+inline Hash *makeHash(HashTrie &&Value) {
+  return gc::heap().make<Hash>(std::move(Value));
+}
+
+template <typename T>
+inline CompiledFunction *makeCompiledFunction(T &&Ins, int NumLocals,
+                                              int NumParameters) {
+  return gc::heap().make<CompiledFunction>(std::forward<T>(Ins), NumLocals,
+                                           NumParameters);
 }
 
-template <typename T> inline std::shared_ptr<Closure> makeClosure(T &&Value) {
-  return std::allocate_shared<Closure, boost::pool_allocator<Closure>>(
-      CLOSURE_ALLOC, std::forward<T>(Value));
+inline Closure *makeClosure(Object *Fn) {
+  return gc::heap().make<Closure>(Fn);
 }
 
-template <typename T0, typename T1>
-inline std::shared_ptr<Closure> makeClosure(T0 &&Fn, T1 &&Free) {
-  return std::allocate_shared<Closure, boost::pool_allocator<Closure>>(
-      CLOSURE_ALLOC, std::forward<T0>(Fn), std::forward<T1>(Free));
+template <typename T> inline Closure *makeClosure(Object *Fn, T &&Free) {
+  return gc::heap().make<Closure>(Fn, std::forward<T>(Free));
 }
 
 } // namespace monkey::object
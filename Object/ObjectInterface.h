@@ -1,21 +1,70 @@
 #pragma once
 
+#include "RefCount.h"
+
+#include <GC/Heap.h>
+
+#include <cstdint>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 namespace monkey::object {
 
-enum class ObjectType : uint64_t;
+enum class ObjectType : uint64_t {
+  INTEGER_OBJ,
+  BOOLEAN_OBJ,
+  NULL_OBJ,
+  RETURN_VALUE_OBJ,
+  ERROR_OBJ,
+  FUNCTION_OBJ,
+  STRING_OBJ,
+  BUILTIN_OBJ,
+  ARRAY_OBJ,
+  HASH_OBJ,
+  COMPILED_FUNCTION_OBJ,
+  CLOSURE_OBJ
+};
+
+struct Object;
+
+// The objects that have had references since the last collection. Those that
+// still do are roots.
+class PinnedObjects : public gc::RootProvider {
+public:
+  ~PinnedObjects() override;
+
+  static void add(const Object *);
+
+  void traceRoots(gc::Tracer &) override;
 
-struct Object {
-  virtual ~Object() = default;
+private:
+  PinnedObjects();
 
+  std::vector<Object *> Objects;
+};
+
+struct Object : public gc::Cell {
   virtual ObjectType type() const = 0;
   virtual std::string inspect() const = 0;
   virtual size_t hash() const { throw std::runtime_error("no impl"); }
   virtual bool equals(const Object &) const {
     throw std::runtime_error("no impl");
   }
+
+  // Used by Ref.
+  void retain() const {
+    if (RefCountPolicy::increment(RefCount))
+      PinnedObjects::add(this);
+  }
+  void release() const { RefCountPolicy::decrement(RefCount); }
+  uint32_t refCount() const { return RefCountPolicy::load(RefCount); }
+
+private:
+  friend class PinnedObjects;
+
+  mutable RefCountPolicy::Count RefCount{0};
+  mutable bool Pinned = false;
 };
 
 } // namespace monkey::object
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "ObjectInterface.h"
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace monkey::object {
+
+// An intrusive, counted reference to an object. Objects with references are
+// roots, so a Ref keeps its object alive wherever it is stored, unlike a raw
+// pointer which must be reachable from the VM or the evaluator at every safe
+// point. The count lives in the object and is updated according to
+// RefCountPolicy.
+template <typename T> class Ref {
+public:
+  Ref() = default;
+  Ref(std::nullptr_t) {}
+  explicit Ref(T *Ptr) : Ptr(Ptr) {
+    if (Ptr)
+      Ptr->retain();
+  }
+  Ref(const Ref &Other) : Ref(Other.Ptr) {}
+  Ref(Ref &&Other) noexcept : Ptr(std::exchange(Other.Ptr, nullptr)) {}
+  template <typename U,
+            typename = std::enable_if_t<std::is_convertible_v<U *, T *>>>
+  Ref(const Ref<U> &Other) : Ref(Other.get()) {}
+  ~Ref() {
+    if (Ptr)
+      Ptr->release();
+  }
+
+  Ref &operator=(Ref Other) noexcept {
+    std::swap(Ptr, Other.Ptr);
+    return *this;
+  }
+
+  T *get() const { return Ptr; }
+  T *operator->() const { return Ptr; }
+  T &operator*() const { return *Ptr; }
+  explicit operator bool() const { return Ptr != nullptr; }
+
+private:
+  T *Ptr = nullptr;
+};
+
+} // namespace monkey::object
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace monkey::object {
+
+// How objects count the references to them. Monkey is single threaded, so
+// counts are plain integers unless the build asks for atomic ones with
+// MONKEY_ATOMIC_REF_COUNT. The heap itself is never thread safe.
+struct NonAtomicRefCount {
+  using Count = uint32_t;
+
+  // Returns whether the count was 0.
+  static bool increment(Count &C) { return C++ == 0; }
+  static void decrement(Count &C) { --C; }
+  static uint32_t load(const Count &C) { return C; }
+};
+
+struct AtomicRefCount {
+  using Count = std::atomic<uint32_t>;
+
+  static bool increment(Count &C) {
+    return C.fetch_add(1, std::memory_order_relaxed) == 0;
+  }
+  static void decrement(Count &C) {
+    C.fetch_sub(1, std::memory_order_release);
+  }
+  static uint32_t load(const Count &C) {
+    return C.load(std::memory_order_acquire);
+  }
+};
+
+#ifdef MONKEY_ATOMIC_REF_COUNT
+using RefCountPolicy = AtomicRefCount;
+#else
+using RefCountPolicy = NonAtomicRefCount;
+#endif
+
+} // namespace monkey::object
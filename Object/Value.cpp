@@ -0,0 +1,56 @@
+#include "Value.h"
+#include "Object.h"
+
+namespace monkey::object {
+
+Object *Value::toObject() const {
+  switch (Type) {
+  case ValueType::INTEGER_VAL:
+    return makeInteger(Int);
+  case ValueType::BOOLEAN_VAL:
+    return nativeBooleanToBooleanObject(Bool);
+  case ValueType::NULL_VAL:
+    return NULL_GLOBAL;
+  case ValueType::OBJECT_VAL:
+    break;
+  }
+
+  return Obj;
+}
+
+std::string Value::inspect() const {
+  switch (Type) {
+  case ValueType::INTEGER_VAL:
+    return std::to_string(Int);
+  case ValueType::BOOLEAN_VAL:
+    return Bool ? "true" : "false";
+  case ValueType::NULL_VAL:
+    return "null";
+  case ValueType::OBJECT_VAL:
+    break;
+  }
+
+  return Obj->inspect();
+}
+
+size_t Value::typeOffset() {
+  const Value V;
+  return reinterpret_cast<const char *>(&V.Type) -
+         reinterpret_cast<const char *>(&V);
+}
+
+size_t Value::integerOffset() {
+  const Value V;
+  return reinterpret_cast<const char *>(&V.Int) -
+         reinterpret_cast<const char *>(&V);
+}
+
+int64_t Value::unboxInteger(const Object &Obj) {
+  return static_cast<const Integer &>(Obj).Value;
+}
+
+bool Value::unboxBoolean(const Object &Obj) {
+  return static_cast<const Boolean &>(Obj).Value;
+}
+
+} // namespace monkey::object
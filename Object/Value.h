@@ -0,0 +1,143 @@
+#pragma once
+
+#include "ObjectInterface.h"
+
+#include <cstdint>
+
+namespace monkey::object {
+
+enum class ValueType : uint8_t {
+  OBJECT_VAL,
+  INTEGER_VAL,
+  BOOLEAN_VAL,
+  NULL_VAL
+};
+
+// A value as seen by the VM. Integers, booleans and null are held inline so
+// that arithmetic and comparisons don't touch the heap. Everything else is
+// boxed in an Object.
+//
+// A default constructed Value holds no object at all (the equivalent of a null
+// Object pointer) and is used for unused stack and global slots.
+class Value {
+public:
+  Value() : Type(ValueType::OBJECT_VAL), Int(0) {}
+  Value(Object *Obj) : Value() { assign(Obj); }
+
+  static Value integer(int64_t I) {
+    Value V;
+    V.Type = ValueType::INTEGER_VAL;
+    V.Int = I;
+    return V;
+  }
+  static Value boolean(bool B) {
+    Value V;
+    V.Type = ValueType::BOOLEAN_VAL;
+    V.Bool = B;
+    return V;
+  }
+  static Value null() {
+    Value V;
+    V.Type = ValueType::NULL_VAL;
+    return V;
+  }
+
+  ValueType valueType() const { return Type; }
+  ObjectType type() const {
+    switch (Type) {
+    case ValueType::INTEGER_VAL:
+      return ObjectType::INTEGER_OBJ;
+    case ValueType::BOOLEAN_VAL:
+      return ObjectType::BOOLEAN_OBJ;
+    case ValueType::NULL_VAL:
+      return ObjectType::NULL_OBJ;
+    case ValueType::OBJECT_VAL:
+      break;
+    }
+
+    return Obj->type();
+  }
+
+  bool isInteger() const { return Type == ValueType::INTEGER_VAL; }
+  bool isBoolean() const { return Type == ValueType::BOOLEAN_VAL; }
+  bool isNull() const { return Type == ValueType::NULL_VAL; }
+  bool isObject() const { return Type == ValueType::OBJECT_VAL; }
+  bool empty() const { return isObject() && !Obj; }
+
+  int64_t asInteger() const { return Int; }
+  bool asBoolean() const { return Bool; }
+  const Object *asObject() const { return isObject() ? Obj : nullptr; }
+  Object *object() const { return isObject() ? Obj : nullptr; }
+
+  // Box the value into an Object. Booleans and null map onto the global
+  // singletons and integers are allocated.
+  Object *toObject() const;
+  std::string inspect() const;
+
+  void trace(gc::Tracer &Tr) {
+    if (isObject())
+      Tr.visit(Obj);
+  }
+
+  // Identity comparison. Inline values compare by value and boxed values by
+  // address.
+  bool operator==(const Value &Other) const {
+    if (Type != Other.Type)
+      return false;
+
+    switch (Type) {
+    case ValueType::INTEGER_VAL:
+      return Int == Other.Int;
+    case ValueType::BOOLEAN_VAL:
+      return Bool == Other.Bool;
+    case ValueType::NULL_VAL:
+      return true;
+    case ValueType::OBJECT_VAL:
+      break;
+    }
+
+    return Obj == Other.Obj;
+  }
+  bool operator!=(const Value &Other) const { return !(*this == Other); }
+
+  // Where the tag and the inline integer live, for code generated by the JIT.
+  static size_t typeOffset();
+  static size_t integerOffset();
+
+private:
+  void assign(Object *Ptr) {
+    if (!Ptr)
+      return;
+
+    // Keep the invariant that a boxed value is never an integer, boolean or
+    // null so that identity comparisons work regardless of where the value
+    // came from.
+    switch (Ptr->type()) {
+    case ObjectType::INTEGER_OBJ:
+      Type = ValueType::INTEGER_VAL;
+      Int = unboxInteger(*Ptr);
+      return;
+    case ObjectType::BOOLEAN_OBJ:
+      Type = ValueType::BOOLEAN_VAL;
+      Bool = unboxBoolean(*Ptr);
+      return;
+    case ObjectType::NULL_OBJ:
+      Type = ValueType::NULL_VAL;
+      return;
+    default:
+      Obj = Ptr;
+    }
+  }
+
+  static int64_t unboxInteger(const Object &);
+  static bool unboxBoolean(const Object &);
+
+  ValueType Type;
+  union {
+    int64_t Int;
+    bool Bool;
+    Object *Obj;
+  };
+};
+
+} // namespace monkey::object
@@ -111,11 +111,7 @@ std::unique_ptr<ast::LetStatement> Parser::parseLetStatement() {
   if (!expectPeek(TokenType::IDENT))
     return nullptr;
 
-  auto Name = std::make_unique<ast::Identifier>();
-  Name->Tok = CurToken;
-  Name->Value = CurToken.Literal;
-
-  LS->Name = std::move(Name);
+  LS->Name = std::make_unique<ast::Identifier>(CurToken, CurToken.Literal);
 
   if (!expectPeek(TokenType::ASSIGN))
     return nullptr;
@@ -190,9 +186,8 @@ std::unique_ptr<ast::IntegerLiteral> Parser::parseIntegerLiteral() {
 }
 
 std::unique_ptr<ast::Expression> Parser::parsePrefixExpression() {
-  auto Prefix = std::make_unique<ast::PrefixExpression>();
-  Prefix->Tok = CurToken;
-  Prefix->Operator = CurToken.Literal;
+  auto Prefix = std::make_unique<ast::PrefixExpression>(
+      CurToken, CurToken.Literal, nullptr);
 
   nextToken();
 
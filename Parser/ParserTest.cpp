@@ -61,6 +61,7 @@ void testInfixExpression(ast::Expression *E, const T0 &Left,
 
   testLiteralExpression(IE->Left.get(), Left);
   ASSERT_EQ(IE->Operator, Operator);
+  ASSERT_EQ(ast::operatorToString(IE->Op), Operator);
   testLiteralExpression(IE->Right.get(), Right);
 }
 
@@ -186,6 +187,7 @@ TEST(ParserTests, testParsingPrefixExpressions) {
     ASSERT_THAT(PE, testing::NotNull());
 
     ASSERT_EQ(PE->Operator, std::get<1>(Test));
+    ASSERT_EQ(ast::operatorToString(PE->Op), std::get<1>(Test));
 
     testIntegerLiteral(PE->Right.get(), std::get<2>(Test));
   }
@@ -210,6 +212,7 @@ TEST(ParserTests, testParsingPrefixExpressions) {
     ASSERT_THAT(PE, testing::NotNull());
 
     ASSERT_EQ(PE->Operator, std::get<1>(Test));
+    ASSERT_EQ(ast::operatorToString(PE->Op), std::get<1>(Test));
 
     testBooleanLiteral(PE->Right.get(), std::get<2>(Test));
   }
@@ -18,8 +18,8 @@ void REPL::start() {
   std::string Line;
   environment::Environment Env;
   compiler::SymbolTable ST;
-  std::vector<std::shared_ptr<object::Object>> Constants;
-  std::array<std::shared_ptr<object::Object>, GLOBALS_SIZE> Globals;
+  std::vector<object::Value> Constants;
+  std::vector<object::Value> Globals;
 
   while (std::cin) {
     std::cout << Prompt;
@@ -48,7 +48,7 @@ void REPL::start() {
       std::cout << "Woops! Compilation failed:\n  " << E.what() << "\n";
     }
 
-    const auto *StackTop = Machine.lastPoppedStackElem();
+    const auto StackTop = Machine.lastPoppedStackElem();
     if (StackTop)
       std::cout << StackTop->inspect() << "\n";
   }
@@ -2,11 +2,20 @@
 
 namespace monkey::vm {
 
-Frame::Frame() : Cl(nullptr), IP(-1), BasePointer(-1) {}
+Frame::Frame() : IP(0), BasePointer(-1) {}
 
-code::Instructions &Frame::instructions() {
-  auto *ClObj = static_cast<object::Closure *>(Cl.get());
-  return static_cast<object::CompiledFunction *>(ClObj->Fn.get())->Ins;
+const code::Word *Frame::instructions() const {
+  const auto *ClObj = static_cast<const object::Closure *>(Cl.asObject());
+  const auto *FnObj =
+      static_cast<const object::CompiledFunction *>(ClObj->Fn);
+  return FnObj->DecodedIns.Value.data();
+}
+
+object::HashIndexCache *Frame::indexCaches() const {
+  const auto *ClObj = static_cast<const object::Closure *>(Cl.asObject());
+  const auto *FnObj =
+      static_cast<const object::CompiledFunction *>(ClObj->Fn);
+  return FnObj->IndexCaches.data();
 }
 
 } // namespace monkey::vm
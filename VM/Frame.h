@@ -8,11 +8,13 @@ struct Frame {
   Frame();
   template <typename T>
   Frame(T &&Cl, int BasePointer)
-      : Cl(std::forward<T>(Cl)), IP(-1), BasePointer(BasePointer) {}
+      : Cl(std::forward<T>(Cl)), IP(0), BasePointer(BasePointer) {}
 
-  code::Instructions &instructions();
+  const code::Word *instructions() const;
+  object::HashIndexCache *indexCaches() const;
 
-  std::shared_ptr<object::Object> Cl;
+  object::Value Cl;
+  // Word offset of the next instruction to execute.
   int IP;
   int BasePointer;
 };
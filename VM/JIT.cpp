@@ -0,0 +1,406 @@
+#include "JIT.h"
+#include "Operations.h"
+#include "VM.h"
+
+#include <JIT/Assembler.h>
+#include <JIT/ExecutableMemory.h>
+#include <JIT/PerfMap.h>
+
+#include <Object/BuiltIns.h>
+
+#include <optional>
+#include <sstream>
+
+namespace monkey::vm {
+
+using code::Word;
+
+// Called from native code with the VM and up to two operands of the
+// instruction. Each helper is the equivalent of the interpreter's handler.
+struct JITHelpers {
+  using Helper = int (*)(VM *, Word, Word);
+
+  // Exceptions can't be unwound through native frames, so errors are handed
+  // back to the VM and reported through the return value.
+  template <void (*Fn)(VM &, Word, Word)>
+  static int guarded(VM *M, Word A, Word B) noexcept {
+    try {
+      Fn(*M, A, B);
+      return 0;
+    } catch (...) {
+      M->PendingError = std::current_exception();
+      return 1;
+    }
+  }
+
+  static object::Value &top(VM &M, int Offset) {
+    return M.Stack[M.SP - Offset];
+  }
+  static object::Value &local(VM &M, Word Index) {
+    return M.Stack[M.currentFrame().BasePointer + Index];
+  }
+
+  static void constant(VM &M, Word Index, Word) {
+    M.push(M.Constants[Index]);
+  }
+  template <code::OpCode Op> static void binary(VM &M, Word, Word) {
+    auto &Left = top(M, 2);
+    Left = binaryOperation(Op, Left, top(M, 1));
+    --M.SP;
+  }
+  template <code::OpCode Op> static void compare(VM &M, Word, Word) {
+    auto &Left = top(M, 2);
+    Left = comparison(Op, Left, top(M, 1));
+    --M.SP;
+  }
+  static void pop(VM &M, Word, Word) { --M.SP; }
+  static void pushTrue(VM &M, Word, Word) {
+    M.push(object::Value::boolean(true));
+  }
+  static void pushFalse(VM &M, Word, Word) {
+    M.push(object::Value::boolean(false));
+  }
+  static void pushNull(VM &M, Word, Word) { M.push(object::Value::null()); }
+  static void minus(VM &M, Word, Word) {
+    auto &Operand = top(M, 1);
+    Operand = minusOperator(Operand);
+  }
+  static void bang(VM &M, Word, Word) {
+    auto &Operand = top(M, 1);
+    Operand = bangOperator(Operand);
+  }
+  static void getGlobal(VM &M, Word Index, Word) { M.push(M.Globals[Index]); }
+  static void setGlobal(VM &M, Word Index, Word) {
+    M.Globals[Index] = top(M, 1);
+    --M.SP;
+  }
+  static void getLocal(VM &M, Word Index, Word) { M.push(local(M, Index)); }
+  static void setLocal(VM &M, Word Index, Word) {
+    local(M, Index) = top(M, 1);
+    --M.SP;
+  }
+  static void array(VM &M, Word NumElem, Word) {
+    auto Array = buildArray(&top(M, NumElem), &top(M, 0));
+    M.SP -= NumElem;
+    M.push(std::move(Array));
+  }
+  static void hash(VM &M, Word NumElem, Word) {
+    auto Hash = buildHash(&top(M, NumElem), &top(M, 0));
+    M.SP -= NumElem;
+    M.push(std::move(Hash));
+  }
+  static void index(VM &M, Word, Word) {
+    auto Result = indexExpression(top(M, 2), top(M, 1));
+    M.SP -= 2;
+    M.push(std::move(Result));
+  }
+  // The native code passes the address of the instruction's cache.
+  static void indexConst(VM &M, Word ConstIndex, Word Cache) {
+    auto &Left = top(M, 1);
+    Left = indexExpression(Left, M.Constants[ConstIndex],
+                           *reinterpret_cast<object::HashIndexCache *>(Cache));
+  }
+  static void call(VM &M, Word NumArgs, Word) {
+    const auto Depth = M.FrameIndex;
+    M.executeCall(NumArgs);
+
+    // The callee wasn't compiled, so interpret it until it returns.
+    if (M.FrameIndex > Depth)
+      M.runNested();
+  }
+  static void callKnown(VM &M, Word ConstIndex, Word NumArgs) {
+    const auto Depth = M.FrameIndex;
+    M.executeKnownCall(ConstIndex, NumArgs);
+
+    if (M.FrameIndex > Depth)
+      M.runNested();
+  }
+  // Tail calls hand the frame over to the callee. The native code then leaves
+  // for the VM to run the callee, unless it was a built-in.
+  template <bool Known>
+  static int tailCall(VM *M, Word A, Word B) noexcept {
+    try {
+      switch (Known ? M->setUpKnownTailCall(A, B) : M->setUpTailCall(A)) {
+      case VM::TailCall::BUILT_IN:
+        return NATIVE_RETURNED;
+      case VM::TailCall::CLOSURE:
+        return NATIVE_TAIL_CALLED;
+      case VM::TailCall::SELF:
+        return NATIVE_SELF_TAIL_CALLED;
+      }
+    } catch (...) {
+      M->PendingError = std::current_exception();
+    }
+    return NATIVE_ERROR;
+  }
+  static void returnValue(VM &M, Word, Word) {
+    auto Return = std::move(top(M, 1));
+    M.SP = M.popFrame().BasePointer - 1;
+    M.push(std::move(Return));
+  }
+  static void returnNull(VM &M, Word, Word) {
+    M.SP = M.popFrame().BasePointer - 1;
+    M.push(object::Value::null());
+  }
+  static void getBuiltIn(VM &M, Word Index, Word) {
+    M.push(object::BUILTINS.at(Index).second.get());
+  }
+  static void closure(VM &M, Word ConstIndex, Word NumFree) {
+    M.pushClosure(ConstIndex, NumFree);
+  }
+  static void getFree(VM &M, Word Index, Word) {
+    const auto *Cl = static_cast<const object::Closure *>(
+        M.currentFrame().Cl.asObject());
+    M.push(Cl->Free[Index]);
+  }
+  template <code::OpCode Op>
+  static void binaryLocalConst(VM &M, Word LocalIndex, Word ConstIndex) {
+    M.push(binaryOperation(Op, local(M, LocalIndex), M.Constants[ConstIndex]));
+  }
+
+  // Address of the current frame's first local. Frames never move while they
+  // are executing.
+  static object::Value *locals(VM *M) { return &local(*M, 0); }
+
+  // Conditions for jumps. They can't fail and return whether to jump.
+  static int jumpNotTruthy(VM *M, Word, Word) {
+    return !isTruthy(M->Stack[--M->SP]);
+  }
+  static int jumpIfLocalNotEqConst(VM *M, Word LocalIndex, Word ConstIndex) {
+    return local(*M, LocalIndex) != M->Constants[ConstIndex];
+  }
+
+  static Helper lookup(code::OpCode Op) {
+    switch (Op) {
+    case code::OpCode::OpConstant:
+      return guarded<constant>;
+    case code::OpCode::OpAdd:
+      return guarded<binary<code::OpCode::OpAdd>>;
+    case code::OpCode::OpSub:
+      return guarded<binary<code::OpCode::OpSub>>;
+    case code::OpCode::OpMul:
+      return guarded<binary<code::OpCode::OpMul>>;
+    case code::OpCode::OpDiv:
+      return guarded<binary<code::OpCode::OpDiv>>;
+    case code::OpCode::OpPop:
+      return guarded<pop>;
+    case code::OpCode::OpTrue:
+      return guarded<pushTrue>;
+    case code::OpCode::OpFalse:
+      return guarded<pushFalse>;
+    case code::OpCode::OpNull:
+      return guarded<pushNull>;
+    case code::OpCode::OpEqual:
+      return guarded<compare<code::OpCode::OpEqual>>;
+    case code::OpCode::OpNotEqual:
+      return guarded<compare<code::OpCode::OpNotEqual>>;
+    case code::OpCode::OpGreaterThan:
+      return guarded<compare<code::OpCode::OpGreaterThan>>;
+    case code::OpCode::OpMinus:
+      return guarded<minus>;
+    case code::OpCode::OpBang:
+      return guarded<bang>;
+    case code::OpCode::OpGetGlobal:
+      return guarded<getGlobal>;
+    case code::OpCode::OpSetGlobal:
+      return guarded<setGlobal>;
+    case code::OpCode::OpGetLocal:
+      return guarded<getLocal>;
+    case code::OpCode::OpSetLocal:
+      return guarded<setLocal>;
+    case code::OpCode::OpArray:
+      return guarded<array>;
+    case code::OpCode::OpHash:
+      return guarded<hash>;
+    case code::OpCode::OpIndex:
+      return guarded<index>;
+    case code::OpCode::OpIndexConst:
+      return guarded<indexConst>;
+    case code::OpCode::OpCall:
+      return guarded<call>;
+    case code::OpCode::OpCallKnown:
+      return guarded<callKnown>;
+    case code::OpCode::OpTailCall:
+      return tailCall<false>;
+    case code::OpCode::OpTailCallKnown:
+      return tailCall<true>;
+    case code::OpCode::OpReturnValue:
+      return guarded<returnValue>;
+    case code::OpCode::OpReturn:
+      return guarded<returnNull>;
+    case code::OpCode::OpGetBuiltIn:
+      return guarded<getBuiltIn>;
+    case code::OpCode::OpClosure:
+      return guarded<closure>;
+    case code::OpCode::OpGetFree:
+      return guarded<getFree>;
+    case code::OpCode::OpAddLocalConst:
+      return guarded<binaryLocalConst<code::OpCode::OpAdd>>;
+    case code::OpCode::OpSubLocalConst:
+      return guarded<binaryLocalConst<code::OpCode::OpSub>>;
+    case code::OpCode::OpJumpNotTruthy:
+      return jumpNotTruthy;
+    case code::OpCode::OpJumpIfLocalNotEqConst:
+      return jumpIfLocalNotEqConst;
+    default:
+      return nullptr;
+    }
+  }
+};
+
+#ifdef MONKEY_HAS_JIT
+
+bool compileNative(const object::CompiledFunction &Fn,
+                   const std::vector<object::Value> &Constants, bool PerfMap) {
+  using jit::Register;
+
+  const auto &Words = Fn.DecodedIns.Value;
+  jit::Assembler A;
+
+  // The VM and the address of the frame's locals stay in callee saved
+  // registers for the whole function. The padding keeps the stack 16 byte
+  // aligned for the helper calls.
+  A.push(Register::RBX);
+  A.push(Register::R12);
+  A.subRsp(8);
+  A.mov(Register::RBX, Register::RDI);
+  A.mov(Register::RAX, reinterpret_cast<uint64_t>(JITHelpers::locals));
+  A.call(Register::RAX);
+  A.mov(Register::R12, Register::RAX);
+
+  std::vector<size_t> NativeOffsets(Words.size() + 1, 0);
+  std::vector<std::pair<size_t, Word>> Jumps;
+  std::vector<size_t> Returns;
+  std::vector<size_t> Errors;
+  // Exits that pass on the helper's result.
+  std::vector<size_t> Leaves;
+
+  const auto CallHelper = [&A](JITHelpers::Helper H, Word Arg0, Word Arg1) {
+    A.mov(Register::RDI, Register::RBX);
+    A.mov(Register::RSI, static_cast<uint64_t>(Arg0));
+    A.mov(Register::RDX, static_cast<uint64_t>(Arg1));
+    A.mov(Register::RAX, reinterpret_cast<uint64_t>(H));
+    A.call(Register::RAX);
+    A.testEax();
+  };
+
+  for (size_t I = 0; I < Words.size();) {
+    const auto Op = static_cast<code::OpCode>(Words[I]);
+    const auto NumOperands =
+        code::lookup(static_cast<char>(Op)).OperandWidths.size();
+    const auto Operand = [&Words, I, NumOperands](size_t N) -> Word {
+      return N < NumOperands ? Words[I + 1 + N] : 0;
+    };
+
+    NativeOffsets[I] = A.size();
+
+    switch (Op) {
+    case code::OpCode::OpJump:
+      Jumps.emplace_back(A.jmp(), Operand(0));
+      break;
+    case code::OpCode::OpJumpNotTruthy:
+      CallHelper(JITHelpers::lookup(Op), 0, 0);
+      Jumps.emplace_back(A.jcc(jit::Condition::NOT_ZERO), Operand(0));
+      break;
+    case code::OpCode::OpJumpIfLocalNotEqConst: {
+      const auto &Constant = Constants.at(Operand(1));
+      const auto Slot = Operand(0) * sizeof(object::Value);
+      std::optional<size_t> Slow, Done;
+
+      // Compare integers inline and fall back to the helper for anything else.
+      if (Constant.isInteger() && Constant.asInteger() >= INT32_MIN &&
+          Constant.asInteger() <= INT32_MAX && Slot <= INT32_MAX) {
+        A.cmp8(Register::R12, Slot + object::Value::typeOffset(),
+               static_cast<uint8_t>(object::ValueType::INTEGER_VAL));
+        Slow = A.jcc(jit::Condition::NOT_ZERO);
+        A.cmp64(Register::R12, Slot + object::Value::integerOffset(),
+                Constant.asInteger());
+        Jumps.emplace_back(A.jcc(jit::Condition::NOT_ZERO), Operand(2));
+        Done = A.jmp();
+        A.bind(*Slow, A.size());
+      }
+
+      CallHelper(JITHelpers::lookup(Op), Operand(0), Operand(1));
+      Jumps.emplace_back(A.jcc(jit::Condition::NOT_ZERO), Operand(2));
+
+      if (Done)
+        A.bind(*Done, A.size());
+      break;
+    }
+    case code::OpCode::OpHalt:
+      Returns.push_back(A.jmp());
+      break;
+    case code::OpCode::OpIndexConst:
+      CallHelper(JITHelpers::lookup(Op), Operand(0),
+                 reinterpret_cast<Word>(&Fn.IndexCaches.at(Operand(1))));
+      Errors.push_back(A.jcc(jit::Condition::NOT_ZERO));
+      break;
+    case code::OpCode::OpTailCall:
+    case code::OpCode::OpTailCallKnown:
+      CallHelper(JITHelpers::lookup(Op), Operand(0), Operand(1));
+      Leaves.push_back(A.jcc(jit::Condition::NOT_ZERO));
+      break;
+    default: {
+      const auto H = JITHelpers::lookup(Op);
+      if (!H)
+        return false;
+
+      CallHelper(H, Operand(0), Operand(1));
+      Errors.push_back(A.jcc(jit::Condition::NOT_ZERO));
+
+      if (Op == code::OpCode::OpReturnValue || Op == code::OpCode::OpReturn)
+        Returns.push_back(A.jmp());
+    }
+    }
+
+    I += 1 + NumOperands;
+  }
+
+  const auto ReturnLabel = A.size();
+  A.xorEax();
+  A.addRsp(8);
+  A.pop(Register::R12);
+  A.pop(Register::RBX);
+  A.ret();
+
+  const auto ErrorLabel = A.size();
+  A.movEax(NATIVE_ERROR);
+  const auto LeaveLabel = A.size();
+  A.addRsp(8);
+  A.pop(Register::R12);
+  A.pop(Register::RBX);
+  A.ret();
+
+  for (const auto &J : Jumps)
+    A.bind(J.first, NativeOffsets.at(J.second));
+  for (const auto R : Returns)
+    A.bind(R, ReturnLabel);
+  for (const auto E : Errors)
+    A.bind(E, ErrorLabel);
+  for (const auto L : Leaves)
+    A.bind(L, LeaveLabel);
+
+  const auto *Code = jit::install(A.code());
+  if (!Code)
+    return false;
+
+  if (PerfMap) {
+    std::stringstream Name;
+    Name << "monkey::CompiledFunction[" << &Fn << "]";
+    jit::PerfMap::instance().add(Code, A.size(), Name.str());
+  }
+
+  Fn.NativeCode = Code;
+  return true;
+}
+
+#else
+
+bool compileNative(const object::CompiledFunction &,
+                   const std::vector<object::Value> &, bool) {
+  return false;
+}
+
+#endif
+
+} // namespace monkey::vm
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Object/Object.h>
+
+// The baseline JIT emits x86-64 code and relies on the System V calling
+// convention.
+#if defined(MONKEY_JIT) && defined(__x86_64__) && defined(__linux__)
+#define MONKEY_HAS_JIT
+#endif
+
+namespace monkey::vm {
+
+class VM;
+
+// Signature of JIT compiled functions. The VM's current frame must be the
+// function's frame. Returns one of 'NativeResult'.
+using NativeFunction = int (*)(VM *);
+
+enum NativeResult {
+  // The function has returned.
+  NATIVE_RETURNED = 0,
+  // An error was raised and the exception is left in the VM.
+  NATIVE_ERROR = 1,
+  // The function tail called and its frame now belongs to the callee, which
+  // hasn't started running yet.
+  NATIVE_TAIL_CALLED = 2,
+  // Like 'NATIVE_TAIL_CALLED' but the function called itself.
+  NATIVE_SELF_TAIL_CALLED = 3
+};
+
+struct JITOptions {
+  // Compile a function once it has been called this many times. 0 disables
+  // the JIT.
+  int Threshold = 0;
+  // Describe compiled code in /tmp/perf-<pid>.map.
+  bool PerfMap = false;
+  // Record a trace of a function once it has tail called itself this many
+  // times and run the function as a native loop from then on. 0 disables
+  // tracing.
+  int LoopThreshold = 0;
+};
+
+// Baseline template JIT. Every instruction of the function's decoded code
+// becomes a fixed stub that calls into a helper operating on the VM's stack,
+// so only the dispatch overhead goes away. Jumps become native jumps and
+// comparisons of a local against an integer constant are done inline.
+//
+// Returns false if the function couldn't be compiled.
+bool compileNative(const object::CompiledFunction &,
+                   const std::vector<object::Value> &Constants, bool PerfMap);
+
+} // namespace monkey::vm
@@ -0,0 +1,210 @@
+#include "Operations.h"
+
+namespace monkey::vm {
+
+namespace {
+
+object::Value binaryIntegerOperation(code::OpCode Op, int64_t LeftVal,
+                                     int64_t RightVal) {
+  switch (Op) {
+  case code::OpCode::OpAdd:
+    return object::Value::integer(LeftVal + RightVal);
+  case code::OpCode::OpSub:
+    return object::Value::integer(LeftVal - RightVal);
+  case code::OpCode::OpMul:
+    return object::Value::integer(LeftVal * RightVal);
+  case code::OpCode::OpDiv:
+    return object::Value::integer(LeftVal / RightVal);
+  default:
+    throw std::runtime_error("unknown integer operator: " +
+                             std::to_string(static_cast<char>(Op)));
+  }
+}
+
+object::Value binaryStringOperation(code::OpCode Op,
+                                    const object::Object &Left,
+                                    const object::Object &Right) {
+  if (Op != code::OpCode::OpAdd)
+    throw std::runtime_error("unknown string operator: " +
+                             std::to_string(static_cast<char>(Op)));
+
+  return object::concatenate(object::objCast<const object::String *>(&Left),
+                             object::objCast<const object::String *>(&Right));
+}
+
+object::Value integerComparison(code::OpCode Op, int64_t LeftVal,
+                                int64_t RightVal) {
+  switch (Op) {
+  case code::OpCode::OpEqual:
+    return object::Value::boolean(LeftVal == RightVal);
+  case code::OpCode::OpNotEqual:
+    return object::Value::boolean(LeftVal != RightVal);
+  case code::OpCode::OpGreaterThan:
+    return object::Value::boolean(LeftVal > RightVal);
+  default:
+    throw std::runtime_error("unknown operator: " +
+                             std::to_string(static_cast<char>(Op)));
+  }
+}
+
+object::Value arrayIndex(const object::Object &Array, int64_t I) {
+  const auto *ArrayObj = object::objCast<const object::Array *>(&Array);
+  const int64_t Max = ArrayObj->size() - 1;
+
+  if (I < 0 || I > Max)
+    return object::Value::null();
+
+  return (*ArrayObj)[I];
+}
+
+object::Value hashIndex(const object::Object &Hash,
+                        const object::Value &Index) {
+  const auto *HashObj = object::objCast<const object::Hash *>(&Hash);
+  const object::HashKey Key(Index.toObject());
+
+  if (!object::hasHashKey(Key))
+    throw std::runtime_error(std::string("unusable as hash key: ") +
+                             object::objTypeToString(Index.type()));
+
+  if (auto *Found = HashObj->find(Key.Key))
+    return Found;
+  return object::Value::null();
+}
+
+} // namespace
+
+bool isTruthy(const object::Value &Val) {
+  if (Val.isBoolean())
+    return Val.asBoolean();
+
+  if (Val.isNull())
+    return false;
+
+  return true;
+}
+
+object::Value binaryOperation(code::OpCode Op, const object::Value &Left,
+                              const object::Value &Right) {
+  if (Left.isInteger() && Right.isInteger())
+    return binaryIntegerOperation(Op, Left.asInteger(), Right.asInteger());
+
+  const auto LeftType = Left.type();
+  const auto RightType = Right.type();
+
+  if (LeftType == object::ObjectType::STRING_OBJ &&
+      RightType == object::ObjectType::STRING_OBJ)
+    return binaryStringOperation(Op, *Left.asObject(), *Right.asObject());
+
+  throw std::runtime_error(
+      std::string("unsupported types for binary operation ") +
+      object::objTypeToString(LeftType) + " " +
+      object::objTypeToString(RightType));
+}
+
+object::Value comparison(code::OpCode Op, const object::Value &Left,
+                         const object::Value &Right) {
+  if (Left.isInteger() && Right.isInteger())
+    return integerComparison(Op, Left.asInteger(), Right.asInteger());
+
+  switch (Op) {
+  case code::OpCode::OpEqual:
+    return object::Value::boolean(Right == Left);
+  case code::OpCode::OpNotEqual:
+    return object::Value::boolean(Right != Left);
+  default:
+    throw std::runtime_error("unknown operator " +
+                             std::to_string(static_cast<char>(Op)) + " (" +
+                             object::objTypeToString(Left.type()) + " " +
+                             object::objTypeToString(Right.type()) + ")");
+  }
+}
+
+object::Value bangOperator(const object::Value &Operand) {
+  if (Operand.isBoolean())
+    return object::Value::boolean(!Operand.asBoolean());
+
+  return object::Value::boolean(Operand.isNull());
+}
+
+object::Value minusOperator(const object::Value &Operand) {
+  if (!Operand.isInteger())
+    throw std::runtime_error(std::string("unsupported type for negation: ") +
+                             object::objTypeToString(Operand.type()));
+
+  return object::Value::integer(-Operand.asInteger());
+}
+
+object::Value buildArray(const object::Value *Begin,
+                         const object::Value *End) {
+  std::vector<object::Object *> Elements;
+  Elements.reserve(End - Begin);
+
+  for (const auto *I = Begin; I != End; ++I)
+    Elements.push_back(I->toObject());
+
+  return object::makeArray(std::move(Elements));
+}
+
+object::Value buildHash(const object::Value *Begin, const object::Value *End) {
+  object::Hash::PairMap HashedPairs;
+  HashedPairs.reserve((End - Begin) / 2);
+
+  for (const auto *I = Begin; I != End; I += 2) {
+    auto *Key = I->toObject();
+    const auto &Value = I[1];
+
+    if (!object::hasHashKey(object::HashKey(Key)))
+      throw std::runtime_error(std::string("unusable as hash key: ") +
+                               object::objTypeToString(Key->type()));
+
+    HashedPairs[object::HashKey(Key)] = Value.toObject();
+  }
+
+  return object::makeHash(std::move(HashedPairs));
+}
+
+object::Value indexExpression(const object::Value &Left,
+                              const object::Value &Index) {
+  if (Left.type() == object::ObjectType::ARRAY_OBJ && Index.isInteger())
+    return arrayIndex(*Left.asObject(), Index.asInteger());
+
+  if (Left.type() == object::ObjectType::HASH_OBJ)
+    return hashIndex(*Left.asObject(), Index);
+
+  throw std::runtime_error(std::string("index operator not supported: ") +
+                           object::objTypeToString(Left.type()));
+}
+
+object::Value indexExpression(const object::Value &Left,
+                              const object::Value &Index,
+                              object::HashIndexCache &Cache) {
+  const auto *HashObj = object::objCast<const object::Hash *>(Left.asObject());
+  if (!HashObj || !Index.isObject() ||
+      !object::hasHashKey(object::HashKey(Index.object())))
+    return indexExpression(Left, Index);
+
+  if (auto *Found = HashObj->find(Index.object(), Cache))
+    return Found;
+  return object::Value::null();
+}
+
+object::Value callBuiltIn(const object::Object &Fn, const object::Value *Begin,
+                          const object::Value *End) {
+  const std::vector<object::Value> Args(Begin, End);
+  return object::objCast<const object::BuiltIn *>(&Fn)->Fn(Args);
+}
+
+object::Value buildClosure(const object::Value &Constant,
+                           const object::Value *Begin,
+                           const object::Value *End) {
+  const auto *Function =
+      object::objCast<const object::CompiledFunction *>(Constant.asObject());
+  if (!Function)
+    throw std::runtime_error(std::string("not a function: ") +
+                             object::objTypeToString(Constant.type()));
+
+  return object::makeClosure(Constant.object(),
+                             std::vector<object::Value>(Begin, End));
+}
+
+} // namespace monkey::vm
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <Code/Code.h>
+#include <Object/Object.h>
+
+namespace monkey::vm {
+
+// The semantics of the VM's operators, shared by the stack and the register
+// VM. Operators are identified by the stack VM's opcode. Errors are thrown as
+// 'std::runtime_error'.
+
+bool isTruthy(const object::Value &);
+object::Value binaryOperation(code::OpCode, const object::Value &,
+                              const object::Value &);
+object::Value comparison(code::OpCode, const object::Value &,
+                         const object::Value &);
+object::Value bangOperator(const object::Value &);
+object::Value minusOperator(const object::Value &);
+object::Value buildArray(const object::Value *, const object::Value *);
+object::Value buildHash(const object::Value *, const object::Value *);
+object::Value indexExpression(const object::Value &, const object::Value &);
+// Indexes with a constant, using the cache of the instruction for hashes.
+object::Value indexExpression(const object::Value &, const object::Value &,
+                              object::HashIndexCache &);
+object::Value callBuiltIn(const object::Object &, const object::Value *,
+                          const object::Value *);
+object::Value buildClosure(const object::Value &, const object::Value *,
+                           const object::Value *);
+
+} // namespace monkey::vm
@@ -0,0 +1,57 @@
+#include "Profile.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace monkey::vm {
+
+OpCodeProfile::OpCodeProfile() : Counts{}, Pairs{}, Previous(-1) {}
+
+uint64_t OpCodeProfile::count(code::OpCode Op) const {
+  return Counts.at(static_cast<uint8_t>(Op));
+}
+
+uint64_t OpCodeProfile::count(code::OpCode First, code::OpCode Second) const {
+  return Pairs.at(static_cast<uint8_t>(First)).at(static_cast<uint8_t>(Second));
+}
+
+uint64_t OpCodeProfile::total() const {
+  uint64_t Total = 0;
+  for (const auto C : Counts)
+    Total += C;
+  return Total;
+}
+
+std::vector<OpCodeProfile::Pair> OpCodeProfile::pairs() const {
+  std::vector<Pair> Result;
+  for (unsigned int I = 0; I < NUM_OPCODES; ++I)
+    for (unsigned int J = 0; J < NUM_OPCODES; ++J)
+      if (Pairs[I][J])
+        Result.push_back({static_cast<code::OpCode>(I),
+                          static_cast<code::OpCode>(J), Pairs[I][J]});
+
+  std::stable_sort(
+      Result.begin(), Result.end(),
+      [](const Pair &L, const Pair &R) { return L.Count > R.Count; });
+  return Result;
+}
+
+std::string OpCodeProfile::report(size_t Limit) const {
+  std::stringstream SS;
+  const auto Total = total();
+  SS << "instructions: " << Total << "\n";
+
+  const auto All = pairs();
+  for (size_t I = 0; I < All.size() && I < Limit; ++I) {
+    const auto &P = All.at(I);
+    SS << std::setw(12) << P.Count << " " << std::fixed << std::setprecision(2)
+       << std::setw(6) << 100.0 * P.Count / Total << "% "
+       << code::lookup(static_cast<char>(P.First)).Name << " -> "
+       << code::lookup(static_cast<char>(P.Second)).Name << "\n";
+  }
+
+  return SS.str();
+}
+
+} // namespace monkey::vm
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Code/Code.h>
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+namespace monkey::vm {
+
+static const size_t NUM_OPCODES = static_cast<size_t>(code::OpCode::OpHalt) + 1;
+
+// Counts how often each opcode is immediately followed by another one at
+// runtime. The most frequent pairs are the candidates for superinstructions.
+class OpCodeProfile {
+public:
+  struct Pair {
+    code::OpCode First;
+    code::OpCode Second;
+    uint64_t Count;
+  };
+
+  OpCodeProfile();
+
+  void record(code::OpCode Op) {
+    const auto Index = static_cast<uint8_t>(Op);
+    ++Counts[Index];
+    if (Previous >= 0)
+      ++Pairs[Previous][Index];
+    Previous = Index;
+  }
+
+  uint64_t count(code::OpCode) const;
+  uint64_t count(code::OpCode, code::OpCode) const;
+  uint64_t total() const;
+  // All pairs that were seen at least once, most frequent first.
+  std::vector<Pair> pairs() const;
+  std::string report(size_t) const;
+
+private:
+  std::array<uint64_t, NUM_OPCODES> Counts;
+  std::array<std::array<uint64_t, NUM_OPCODES>, NUM_OPCODES> Pairs;
+  int Previous;
+};
+
+} // namespace monkey::vm
@@ -0,0 +1,375 @@
+#include "RegisterVM.h"
+#include "Operations.h"
+
+#include <Object/BuiltIns.h>
+
+namespace monkey::vm {
+
+RegisterVM::RegisterVM(compiler::RegisterByteCode &&BC,
+                       std::vector<object::Value> &Globals)
+    : Constants(BC.Constants), Globals(Globals),
+      Main(std::move(BC.Instructions)), FrameIndex(0),
+      LiveEnd(Registers.data() + BC.NumRegisters),
+      MainRegisters(BC.NumRegisters) {
+  if (Globals.size() < static_cast<size_t>(BC.NumGlobals))
+    Globals.resize(BC.NumGlobals);
+
+  if (static_cast<size_t>(BC.NumRegisters) > STACK_SIZE)
+    throw std::runtime_error("stack overflow");
+
+  gc::heap().addRoots(this);
+}
+
+RegisterVM::~RegisterVM() { gc::heap().removeRoots(this); }
+
+object::Object *RegisterVM::result() const {
+  return Registers.at(compiler::RegisterCompiler::RESULT_REGISTER).toObject();
+}
+
+void RegisterVM::traceRoots(gc::Tracer &Tr) {
+  Registers[compiler::RegisterCompiler::RESULT_REGISTER].trace(Tr);
+  for (auto *R = Registers.data(); R < LiveEnd; ++R)
+    R->trace(Tr);
+  for (auto &Global : Globals)
+    Global.trace(Tr);
+  for (auto &Constant : Constants)
+    Constant.trace(Tr);
+}
+
+void RegisterVM::run() { run(DEFAULT_DISPATCH); }
+
+void RegisterVM::run(Dispatch D) {
+#ifdef MONKEY_HAS_COMPUTED_GOTO
+  if (D == Dispatch::THREADED) {
+    execute<true>();
+    return;
+  }
+#else
+  (void)D;
+#endif
+
+  execute<false>();
+}
+
+// Same structure as 'VM::execute'. The state of the current call lives in
+// locals and is only spilled into 'Frames' on calls.
+template <bool Threaded> void RegisterVM::execute() {
+  object::Value *const RegistersEnd = Registers.data() + STACK_SIZE;
+  const object::Closure *Cl = nullptr;
+  object::Value *Base = Registers.data();
+  const code::Word *Code = Main.Value.data();
+  const code::Word *Ip = Code;
+  code::RegOpCode Op;
+
+#define READ_OPERAND() (*Ip++)
+#define REG() Base[READ_OPERAND()]
+#define RK(W) ((W) >= 0 ? Base[(W)] : Constants[~(W)])
+
+#ifdef MONKEY_HAS_COMPUTED_GOTO
+  // Must be kept in the same order as 'code::RegOpCode'.
+  static const void *const DispatchTable[] = {
+      &&OpLoadConstant_Label,    &&OpLoadTrue_Label,
+      &&OpLoadFalse_Label,       &&OpLoadNull_Label,
+      &&OpMove_Label,            &&OpGetGlobal_Label,
+      &&OpSetGlobal_Label,       &&OpGetBuiltIn_Label,
+      &&OpGetFree_Label,         &&OpAdd_Label,
+      &&OpSub_Label,             &&OpMul_Label,
+      &&OpDiv_Label,             &&OpEqual_Label,
+      &&OpNotEqual_Label,        &&OpGreaterThan_Label,
+      &&OpMinus_Label,           &&OpBang_Label,
+      &&OpJump_Label,            &&OpJumpIfFalse_Label,
+      &&OpJumpIfNotEqual_Label,  &&OpJumpIfEqual_Label,
+      &&OpJumpIfNotGreater_Label, &&OpArray_Label,
+      &&OpHash_Label,            &&OpIndex_Label,
+      &&OpCall_Label,            &&OpReturn_Label,
+      &&OpReturnNull_Label,      &&OpClosure_Label,
+      &&OpHalt_Label};
+  static_assert(sizeof(DispatchTable) / sizeof(DispatchTable[0]) ==
+                    static_cast<size_t>(code::RegOpCode::OpHalt) + 1,
+                "dispatch table out of sync with RegOpCode");
+
+#define CASE(Name)                                                             \
+  case code::RegOpCode::Name:                                                  \
+  Name##_Label:
+#define DISPATCH()                                                             \
+  if constexpr (Threaded) {                                                    \
+    Op = static_cast<code::RegOpCode>(*Ip++);                                  \
+    goto *DispatchTable[static_cast<uint8_t>(Op)];                             \
+  } else                                                                       \
+    continue
+#else
+#define CASE(Name) case code::RegOpCode::Name:
+#define DISPATCH() continue
+#endif
+
+#define ARITHMETIC(Name, Operator)                                             \
+  CASE(Name) {                                                                 \
+    auto &Dst = REG();                                                         \
+    const auto L = READ_OPERAND();                                             \
+    const auto R = READ_OPERAND();                                             \
+    const auto &Left = RK(L);                                                  \
+    const auto &Right = RK(R);                                                 \
+    if (Left.isInteger() && Right.isInteger())                                 \
+      Dst = object::Value::integer(Left.asInteger()                            \
+                                       Operator Right.asInteger());            \
+    else                                                                       \
+      Dst = binaryOperation(code::OpCode::Name, Left, Right);                  \
+    DISPATCH();                                                                \
+  }
+#define COMPARISON(Name, Operator)                                             \
+  CASE(Name) {                                                                 \
+    auto &Dst = REG();                                                         \
+    const auto L = READ_OPERAND();                                             \
+    const auto R = READ_OPERAND();                                             \
+    const auto &Left = RK(L);                                                  \
+    const auto &Right = RK(R);                                                 \
+    if (Left.isInteger() && Right.isInteger())                                 \
+      Dst = object::Value::boolean(Left.asInteger()                            \
+                                       Operator Right.asInteger());            \
+    else                                                                       \
+      Dst = comparison(code::OpCode::Name, Left, Right);                       \
+    DISPATCH();                                                                \
+  }
+
+  for (;;) {
+    Op = static_cast<code::RegOpCode>(*Ip++);
+
+#ifdef MONKEY_HAS_COMPUTED_GOTO
+    if constexpr (Threaded)
+      goto *DispatchTable[static_cast<uint8_t>(Op)];
+#endif
+
+    switch (Op) {
+      CASE(OpLoadConstant) {
+        auto &Dst = REG();
+        Dst = Constants[READ_OPERAND()];
+        DISPATCH();
+      }
+      CASE(OpLoadTrue) {
+        REG() = object::Value::boolean(true);
+        DISPATCH();
+      }
+      CASE(OpLoadFalse) {
+        REG() = object::Value::boolean(false);
+        DISPATCH();
+      }
+      CASE(OpLoadNull) {
+        REG() = object::Value::null();
+        DISPATCH();
+      }
+      CASE(OpMove) {
+        auto &Dst = REG();
+        Dst = REG();
+        DISPATCH();
+      }
+      CASE(OpGetGlobal) {
+        auto &Dst = REG();
+        Dst = Globals[READ_OPERAND()];
+        DISPATCH();
+      }
+      CASE(OpSetGlobal) {
+        auto &Global = Globals[READ_OPERAND()];
+        Global = REG();
+        DISPATCH();
+      }
+      CASE(OpGetBuiltIn) {
+        auto &Dst = REG();
+        Dst = object::BUILTINS.at(READ_OPERAND()).second.get();
+        DISPATCH();
+      }
+      CASE(OpGetFree) {
+        auto &Dst = REG();
+        Dst = Cl->Free[READ_OPERAND()];
+        DISPATCH();
+      }
+      ARITHMETIC(OpAdd, +)
+      ARITHMETIC(OpSub, -)
+      ARITHMETIC(OpMul, *)
+      CASE(OpDiv) {
+        auto &Dst = REG();
+        const auto L = READ_OPERAND();
+        const auto R = READ_OPERAND();
+        Dst = binaryOperation(code::OpCode::OpDiv, RK(L), RK(R));
+        DISPATCH();
+      }
+      COMPARISON(OpEqual, ==)
+      COMPARISON(OpNotEqual, !=)
+      COMPARISON(OpGreaterThan, >)
+      CASE(OpMinus) {
+        auto &Dst = REG();
+        Dst = minusOperator(REG());
+        DISPATCH();
+      }
+      CASE(OpBang) {
+        auto &Dst = REG();
+        Dst = bangOperator(REG());
+        DISPATCH();
+      }
+      CASE(OpJump) {
+        Ip = Code + *Ip;
+        DISPATCH();
+      }
+      CASE(OpJumpIfFalse) {
+        const auto &Condition = REG();
+        const auto Target = READ_OPERAND();
+        if (!isTruthy(Condition))
+          Ip = Code + Target;
+        DISPATCH();
+      }
+      CASE(OpJumpIfNotEqual) {
+        const auto L = READ_OPERAND();
+        const auto R = READ_OPERAND();
+        const auto Target = READ_OPERAND();
+        if (RK(L) != RK(R))
+          Ip = Code + Target;
+        DISPATCH();
+      }
+      CASE(OpJumpIfEqual) {
+        const auto L = READ_OPERAND();
+        const auto R = READ_OPERAND();
+        const auto Target = READ_OPERAND();
+        if (RK(L) == RK(R))
+          Ip = Code + Target;
+        DISPATCH();
+      }
+      CASE(OpJumpIfNotGreater) {
+        const auto L = READ_OPERAND();
+        const auto R = READ_OPERAND();
+        const auto Target = READ_OPERAND();
+        const auto &Left = RK(L);
+        const auto &Right = RK(R);
+        const bool Greater =
+            Left.isInteger() && Right.isInteger()
+                ? Left.asInteger() > Right.asInteger()
+                : comparison(code::OpCode::OpGreaterThan, Left, Right)
+                      .asBoolean();
+        if (!Greater)
+          Ip = Code + Target;
+        DISPATCH();
+      }
+      CASE(OpArray) {
+        auto &Dst = REG();
+        const auto *First = &REG();
+        const auto NumElem = READ_OPERAND();
+        Dst = buildArray(First, First + NumElem);
+        DISPATCH();
+      }
+      CASE(OpHash) {
+        auto &Dst = REG();
+        const auto *First = &REG();
+        const auto NumElem = READ_OPERAND();
+        Dst = buildHash(First, First + NumElem);
+        DISPATCH();
+      }
+      CASE(OpIndex) {
+        auto &Dst = REG();
+        const auto &Left = REG();
+        const auto I = READ_OPERAND();
+        Dst = indexExpression(Left, RK(I));
+        DISPATCH();
+      }
+      CASE(OpCall) {
+        auto *Result = &REG();
+        auto *Callee = &REG();
+        const auto NumArgs = READ_OPERAND();
+
+        // Everything the caller still needs is in its window.
+        const auto *CallerFn =
+            Cl ? static_cast<const object::CompiledFunction *>(Cl->Fn)
+               : nullptr;
+        LiveEnd = Base + (CallerFn ? CallerFn->NumLocals : MainRegisters);
+        gc::heap().safePoint();
+
+        switch (Callee->type()) {
+        case object::ObjectType::CLOSURE_OBJ: {
+          const auto *ClObj =
+              static_cast<const object::Closure *>(Callee->asObject());
+          const auto *FnObj =
+              static_cast<const object::CompiledFunction *>(ClObj->Fn);
+          if (NumArgs != FnObj->NumParameters)
+            throw std::runtime_error("wrong number of arguments: want=" +
+                                     std::to_string(FnObj->NumParameters) +
+                                     ", got=" + std::to_string(NumArgs));
+
+          auto *NewBase = Callee + 1;
+          if (NewBase + FnObj->NumLocals > RegistersEnd ||
+              FrameIndex >= static_cast<int>(MAX_FRAMES))
+            throw std::runtime_error("stack overflow");
+
+          // Clear what previous calls left in the callee's window.
+          std::fill(NewBase + NumArgs, NewBase + FnObj->NumLocals,
+                    object::Value());
+          Frames[FrameIndex++] = {Cl, Code, Ip, Base, Result};
+          Cl = ClObj;
+          Code = Ip = FnObj->RegisterIns.Value.data();
+          Base = NewBase;
+          break;
+        }
+        case object::ObjectType::BUILTIN_OBJ:
+          *Result = callBuiltIn(*Callee->asObject(), Callee + 1,
+                                Callee + 1 + NumArgs);
+          break;
+        default:
+          throw std::runtime_error("calling non-closure and non-built-in");
+        }
+        DISPATCH();
+      }
+      CASE(OpReturn) {
+        const auto Operand = READ_OPERAND();
+        auto ReturnValue = RK(Operand);
+        if (!FrameIndex) {
+          Registers[compiler::RegisterCompiler::RESULT_REGISTER] =
+              std::move(ReturnValue);
+          goto Exit;
+        }
+
+        const auto &Caller = Frames[--FrameIndex];
+        Cl = Caller.Cl;
+        Code = Caller.Code;
+        Ip = Caller.Ip;
+        Base = Caller.Base;
+        *Caller.Result = std::move(ReturnValue);
+        DISPATCH();
+      }
+      CASE(OpReturnNull) {
+        if (!FrameIndex) {
+          Registers[compiler::RegisterCompiler::RESULT_REGISTER] =
+              object::Value::null();
+          goto Exit;
+        }
+
+        const auto &Caller = Frames[--FrameIndex];
+        Cl = Caller.Cl;
+        Code = Caller.Code;
+        Ip = Caller.Ip;
+        Base = Caller.Base;
+        *Caller.Result = object::Value::null();
+        DISPATCH();
+      }
+      CASE(OpClosure) {
+        auto &Dst = REG();
+        const auto &Constant = Constants[READ_OPERAND()];
+        const auto *First = &REG();
+        const auto NumFree = READ_OPERAND();
+        Dst = buildClosure(Constant, First, First + NumFree);
+        DISPATCH();
+      }
+      CASE(OpHalt) { goto Exit; }
+    default:
+      DISPATCH();
+    }
+  }
+
+Exit:
+  FrameIndex = 0;
+
+#undef READ_OPERAND
+#undef REG
+#undef RK
+#undef CASE
+#undef DISPATCH
+#undef ARITHMETIC
+#undef COMPARISON
+}
+
+} // namespace monkey::vm
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "VM.h"
+
+#include <Compiler/RegisterCompiler.h>
+
+namespace monkey::vm {
+
+// State of a caller that is restored when the callee returns.
+struct RegisterFrame {
+  const object::Closure *Cl;
+  const code::Word *Code;
+  const code::Word *Ip;
+  object::Value *Base;
+  // Where the callee's return value goes.
+  object::Value *Result;
+};
+
+// Executes the three-address code produced by 'compiler::RegisterCompiler'.
+// Each call gets a window of registers starting right after the callee in the
+// caller's window, so arguments are passed without copying.
+//
+// Like 'VM' it roots its registers, globals and constants. Closures of active
+// frames are reachable from the caller's callee register.
+class RegisterVM : public gc::RootProvider {
+public:
+  RegisterVM(compiler::RegisterByteCode &&, std::vector<object::Value> &);
+  virtual ~RegisterVM();
+  RegisterVM(const RegisterVM &) = delete;
+  RegisterVM &operator=(const RegisterVM &) = delete;
+
+  // The value of the last top-level expression statement.
+  object::Object *result() const;
+  void run();
+  void run(Dispatch);
+
+  void traceRoots(gc::Tracer &) override;
+
+protected:
+  template <bool Threaded> void execute();
+
+  std::vector<object::Value> &Constants;
+  std::vector<object::Value> &Globals;
+  code::RegisterInstructions Main;
+  std::array<object::Value, STACK_SIZE> Registers;
+  std::array<RegisterFrame, MAX_FRAMES> Frames;
+  int FrameIndex;
+  // End of the current frame's window as of the last call. Registers past it
+  // may hold stale values.
+  object::Value *LiveEnd;
+  const int MainRegisters;
+};
+
+} // namespace monkey::vm
@@ -0,0 +1,384 @@
+#include "Trace.h"
+#include "JIT.h"
+
+#include <JIT/Assembler.h>
+#include <JIT/ExecutableMemory.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace monkey::vm {
+
+using code::OpCode;
+using code::Word;
+
+void TraceRecorder::start(const object::Closure &Closure, int Index,
+                          const object::Value *Locals,
+                          const std::vector<object::Value> &Consts) {
+  Fn = static_cast<const object::CompiledFunction *>(Closure.Fn);
+  Parameters.clear();
+  Steps.clear();
+
+  for (int I = 0; I < Fn->NumParameters; ++I) {
+    if (Locals[I].isInteger())
+      Parameters.push_back(TraceType::INTEGER);
+    else if (Locals[I].isBoolean())
+      Parameters.push_back(TraceType::BOOLEAN);
+    else {
+      abort();
+      return;
+    }
+  }
+
+  Cl = &Closure;
+  Constants = &Consts;
+  FrameIndex = Index;
+}
+
+void TraceRecorder::abort() {
+  // Don't bother recording the function again.
+  if (Fn)
+    Fn->LoopCount = std::numeric_limits<int>::min();
+
+  Cl = nullptr;
+  Fn = nullptr;
+}
+
+std::shared_ptr<const Trace>
+TraceRecorder::record(int Index, int Position, const object::Value *Top,
+                      const std::vector<object::Value> &Globals) {
+  if (Index != FrameIndex) {
+    abort();
+    return nullptr;
+  }
+
+  const auto *Ins = Fn->DecodedIns.Value.data();
+  const auto Op = static_cast<OpCode>(Ins[Position]);
+  bool Supported = false;
+  bool Callee = false;
+
+  switch (Op) {
+  case OpCode::OpConstant:
+  case OpCode::OpAdd:
+  case OpCode::OpSub:
+  case OpCode::OpMul:
+  case OpCode::OpPop:
+  case OpCode::OpTrue:
+  case OpCode::OpFalse:
+  case OpCode::OpEqual:
+  case OpCode::OpNotEqual:
+  case OpCode::OpGreaterThan:
+  case OpCode::OpMinus:
+  case OpCode::OpBang:
+  case OpCode::OpJumpNotTruthy:
+  case OpCode::OpJump:
+  case OpCode::OpGetLocal:
+  case OpCode::OpSetLocal:
+  case OpCode::OpAddLocalConst:
+  case OpCode::OpSubLocalConst:
+  case OpCode::OpJumpIfLocalNotEqConst:
+    Supported = true;
+    break;
+  case OpCode::OpGetGlobal:
+    Supported = Callee = Globals[Ins[Position + 1]].asObject() == Cl;
+    break;
+  case OpCode::OpGetFree:
+    Supported = Callee = Cl->Free[Ins[Position + 1]].asObject() == Cl;
+    break;
+  case OpCode::OpTailCall:
+    Supported = Top[-1 - Ins[Position + 1]].asObject() == Cl;
+    break;
+  case OpCode::OpTailCallKnown:
+    Supported = (*Constants)[Ins[Position + 1]].asObject() == Cl;
+    break;
+  default:
+    break;
+  }
+
+  if (!Supported) {
+    abort();
+    return nullptr;
+  }
+
+  Steps.push_back({Position, Callee});
+  if (Op != OpCode::OpTailCall && Op != OpCode::OpTailCallKnown)
+    return nullptr;
+
+  auto Result = compile();
+  if (!Result) {
+    abort();
+    return nullptr;
+  }
+
+  Cl = nullptr;
+  Fn = nullptr;
+  return Result;
+}
+
+#ifdef MONKEY_HAS_JIT
+
+std::shared_ptr<const Trace> TraceRecorder::compile() const {
+  using jit::Condition;
+  using jit::Register;
+
+  const auto *Ins = Fn->DecodedIns.Value.data();
+  auto Result = std::make_shared<Trace>();
+  Result->Parameters = Parameters;
+
+  // Types of the locals and the operand stack at the current instruction.
+  std::vector<TraceType> Locals(Fn->NumLocals, TraceType::UNDEFINED);
+  std::copy(Parameters.begin(), Parameters.end(), Locals.begin());
+  std::vector<TraceType> Operands;
+  size_t MaxOperands = 0;
+
+  const auto LocalSlot = [](Word Index) {
+    return static_cast<int32_t>(Index * sizeof(int64_t));
+  };
+  const auto OperandSlot = [this](size_t Index) {
+    return static_cast<int32_t>((Fn->NumLocals + Index) * sizeof(int64_t));
+  };
+  const auto Constant = [this](Word Index) -> const object::Value & {
+    return Constants->at(Index);
+  };
+
+  jit::Assembler A;
+  std::vector<std::pair<size_t, size_t>> ExitJumps;
+
+  // Leave through the given exit, which resumes the instruction at 'Position',
+  // when the condition holds.
+  const auto Guard = [&](Condition C, int Position) {
+    Result->Exits.push_back({Position, Locals, Operands});
+    ExitJumps.emplace_back(A.jcc(C), Result->Exits.size() - 1);
+  };
+  const auto Push = [&](TraceType Type) {
+    if (Type != TraceType::CALLEE)
+      A.store(Register::R12, OperandSlot(Operands.size()), Register::RAX);
+    Operands.push_back(Type);
+    MaxOperands = std::max(MaxOperands, Operands.size());
+  };
+  // Load the two topmost operands into RAX and RCX if they have the given
+  // type.
+  const auto PopBinary = [&](TraceType Type) {
+    if (Operands.size() < 2 || Operands[Operands.size() - 2] != Type ||
+        Operands.back() != Type)
+      return false;
+
+    A.load(Register::RAX, Register::R12, OperandSlot(Operands.size() - 2));
+    A.load(Register::RCX, Register::R12, OperandSlot(Operands.size() - 1));
+    Operands.resize(Operands.size() - 2);
+    return true;
+  };
+  const auto IntegerConstant = [&](Word Index) {
+    return Constant(Index).isInteger();
+  };
+
+  // The state stays in a callee saved register. Nothing is called so the
+  // stack alignment doesn't matter.
+  A.push(Register::R12);
+  A.mov(Register::R12, Register::RDI);
+  const auto LoopHead = A.size();
+
+  for (size_t I = 0; I < Steps.size(); ++I) {
+    const auto Position = Steps[I].Position;
+    const auto *Operand = Ins + Position + 1;
+    // Where the recording went next, which tells which way branches went.
+    const auto Next = I + 1 < Steps.size() ? Steps[I + 1].Position : -1;
+
+    switch (static_cast<OpCode>(Ins[Position])) {
+    case OpCode::OpConstant:
+      if (!IntegerConstant(Operand[0]))
+        return nullptr;
+      A.mov(Register::RAX,
+            static_cast<uint64_t>(Constant(Operand[0]).asInteger()));
+      Push(TraceType::INTEGER);
+      break;
+    case OpCode::OpTrue:
+    case OpCode::OpFalse:
+      A.mov(Register::RAX,
+            static_cast<uint64_t>(Ins[Position] ==
+                                  static_cast<Word>(OpCode::OpTrue)));
+      Push(TraceType::BOOLEAN);
+      break;
+    case OpCode::OpAdd:
+    case OpCode::OpSub:
+    case OpCode::OpMul: {
+      if (!PopBinary(TraceType::INTEGER))
+        return nullptr;
+
+      const auto Op = static_cast<OpCode>(Ins[Position]);
+      if (Op == OpCode::OpAdd)
+        A.add(Register::RAX, Register::RCX);
+      else if (Op == OpCode::OpSub)
+        A.sub(Register::RAX, Register::RCX);
+      else
+        A.imul(Register::RAX, Register::RCX);
+      Push(TraceType::INTEGER);
+      break;
+    }
+    case OpCode::OpEqual:
+    case OpCode::OpNotEqual: {
+      if (!PopBinary(TraceType::INTEGER) && !PopBinary(TraceType::BOOLEAN))
+        return nullptr;
+
+      A.cmp(Register::RAX, Register::RCX);
+      A.set(static_cast<OpCode>(Ins[Position]) == OpCode::OpEqual
+                ? Condition::ZERO
+                : Condition::NOT_ZERO,
+            Register::RAX);
+      Push(TraceType::BOOLEAN);
+      break;
+    }
+    case OpCode::OpGreaterThan:
+      if (!PopBinary(TraceType::INTEGER))
+        return nullptr;
+
+      A.cmp(Register::RAX, Register::RCX);
+      A.set(Condition::GREATER, Register::RAX);
+      Push(TraceType::BOOLEAN);
+      break;
+    case OpCode::OpMinus:
+    case OpCode::OpBang: {
+      const auto Type = static_cast<OpCode>(Ins[Position]) == OpCode::OpMinus
+                            ? TraceType::INTEGER
+                            : TraceType::BOOLEAN;
+      if (Operands.empty() || Operands.back() != Type)
+        return nullptr;
+
+      Operands.pop_back();
+      A.load(Register::RAX, Register::R12, OperandSlot(Operands.size()));
+      if (Type == TraceType::INTEGER)
+        A.neg(Register::RAX);
+      else
+        A.xor8(Register::RAX, 1);
+      Push(Type);
+      break;
+    }
+    case OpCode::OpPop:
+      Operands.pop_back();
+      break;
+    case OpCode::OpJump:
+      break;
+    case OpCode::OpJumpNotTruthy: {
+      // Integers are always truthy so only booleans need a guard.
+      const auto Type = Operands.back();
+      if (Type == TraceType::BOOLEAN) {
+        // Leave if the condition doesn't go the same way as when recorded.
+        A.cmp64(Register::R12, OperandSlot(Operands.size() - 1), 0);
+        Guard(Next == Operand[0] ? Condition::NOT_ZERO : Condition::ZERO,
+              Position);
+      } else if (Type != TraceType::INTEGER) {
+        return nullptr;
+      }
+
+      Operands.pop_back();
+      break;
+    }
+    case OpCode::OpGetLocal: {
+      const auto Type = Locals.at(Operand[0]);
+      if (Type == TraceType::UNDEFINED)
+        return nullptr;
+
+      A.load(Register::RAX, Register::R12, LocalSlot(Operand[0]));
+      Push(Type);
+      break;
+    }
+    case OpCode::OpSetLocal: {
+      const auto Type = Operands.back();
+      if (Type == TraceType::CALLEE)
+        return nullptr;
+
+      Operands.pop_back();
+      A.load(Register::RAX, Register::R12, OperandSlot(Operands.size()));
+      A.store(Register::R12, LocalSlot(Operand[0]), Register::RAX);
+      Locals.at(Operand[0]) = Type;
+      break;
+    }
+    case OpCode::OpAddLocalConst:
+    case OpCode::OpSubLocalConst:
+      if (Locals.at(Operand[0]) != TraceType::INTEGER ||
+          !IntegerConstant(Operand[1]))
+        return nullptr;
+
+      A.load(Register::RAX, Register::R12, LocalSlot(Operand[0]));
+      A.mov(Register::RCX,
+            static_cast<uint64_t>(Constant(Operand[1]).asInteger()));
+      if (static_cast<OpCode>(Ins[Position]) == OpCode::OpAddLocalConst)
+        A.add(Register::RAX, Register::RCX);
+      else
+        A.sub(Register::RAX, Register::RCX);
+      Push(TraceType::INTEGER);
+      break;
+    case OpCode::OpJumpIfLocalNotEqConst:
+      if (Locals.at(Operand[0]) != TraceType::INTEGER ||
+          !IntegerConstant(Operand[1]))
+        return nullptr;
+
+      A.load(Register::RAX, Register::R12, LocalSlot(Operand[0]));
+      A.mov(Register::RCX,
+            static_cast<uint64_t>(Constant(Operand[1]).asInteger()));
+      A.cmp(Register::RAX, Register::RCX);
+      Guard(Next == Operand[2] ? Condition::ZERO : Condition::NOT_ZERO,
+            Position);
+      break;
+    case OpCode::OpGetGlobal:
+    case OpCode::OpGetFree:
+      // Only reads of the closure itself are recorded. The VM checks that
+      // they still hold it before entering the trace.
+      Result->Callees.push_back(
+          {static_cast<OpCode>(Ins[Position]), static_cast<int>(Operand[0])});
+      Push(TraceType::CALLEE);
+      break;
+    case OpCode::OpTailCall:
+    case OpCode::OpTailCallKnown: {
+      // Known calls have no callee below their arguments.
+      const bool Known =
+          Ins[Position] == static_cast<Word>(OpCode::OpTailCallKnown);
+      const auto NumArgs = static_cast<size_t>(Operand[Known ? 1 : 0]);
+      if (NumArgs != Parameters.size() ||
+          Operands.size() < NumArgs + !Known ||
+          (!Known &&
+           Operands[Operands.size() - NumArgs - 1] != TraceType::CALLEE) ||
+          !std::equal(Parameters.begin(), Parameters.end(),
+                      Operands.end() - NumArgs))
+        return nullptr;
+
+      // The arguments become the parameters of the next iteration.
+      for (size_t J = 0; J < NumArgs; ++J) {
+        A.load(Register::RAX, Register::R12,
+               OperandSlot(Operands.size() - NumArgs + J));
+        A.store(Register::R12, LocalSlot(J), Register::RAX);
+      }
+      A.bind(A.jmp(), LoopHead);
+      break;
+    }
+    default:
+      return nullptr;
+    }
+  }
+
+  for (size_t E = 0; E < Result->Exits.size(); ++E) {
+    for (const auto &J : ExitJumps)
+      if (J.second == E)
+        A.bind(J.first, A.size());
+
+    A.movEax(static_cast<uint32_t>(E));
+    A.pop(Register::R12);
+    A.ret();
+  }
+
+  Result->Code = jit::install(A.code());
+  if (!Result->Code)
+    return nullptr;
+
+  Result->CodeSize = A.size();
+  Result->StateSize = Fn->NumLocals + MaxOperands;
+  return Result;
+}
+
+#else
+
+std::shared_ptr<const Trace> TraceRecorder::compile() const { return nullptr; }
+
+#endif
+
+} // namespace monkey::vm
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <Code/Code.h>
+#include <Object/Object.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace monkey::vm {
+
+// How a local or an operand is held in a trace's native state. Integers and
+// booleans are unboxed into 64-bit slots. The function's own closure only
+// exists to be called and has no slot value.
+enum class TraceType : uint8_t { UNDEFINED, INTEGER, BOOLEAN, CALLEE };
+
+// Where the interpreter picks up when a guard fails. The instruction at
+// 'Position' is executed again with the locals and operands rebuilt from the
+// native state.
+struct TraceExit {
+  int Position;
+  std::vector<TraceType> Locals;
+  std::vector<TraceType> Operands;
+};
+
+// A global or free variable read by the trace that must hold the function's
+// own closure.
+struct TraceCallee {
+  code::OpCode Op;
+  int Index;
+};
+
+// A self tail-recursive function compiled into a native loop. Every iteration
+// runs from the function's entry to its tail call on unboxed values and jumps
+// back with the arguments as the new parameters. The loop returns the index of
+// the exit it took.
+struct Trace {
+  using NativeLoop = int (*)(int64_t *State);
+
+  const void *Code = nullptr;
+  size_t CodeSize = 0;
+  // Locals are slots [0, NumLocals) of the state and operands follow them.
+  size_t StateSize = 0;
+  std::vector<TraceType> Parameters;
+  std::vector<TraceCallee> Callees;
+  std::vector<TraceExit> Exits;
+};
+
+// Records the path a frame takes from its function's entry to a self tail
+// call, one instruction at a time. Recording is abandoned as soon as the frame
+// does anything a trace can't express, such as calling another function,
+// returning or touching values other than integers and booleans.
+class TraceRecorder {
+public:
+  bool active() const { return Cl != nullptr; }
+
+  void start(const object::Closure &, int FrameIndex,
+             const object::Value *Locals,
+             const std::vector<object::Value> &Constants);
+  void abort();
+  // Called before each instruction while active. Returns the compiled trace
+  // once the tail call is reached.
+  std::shared_ptr<const Trace>
+  record(int FrameIndex, int Position, const object::Value *Top,
+         const std::vector<object::Value> &Globals);
+
+private:
+  struct Step {
+    int Position;
+    // Set for reads of globals and free variables holding the closure.
+    bool Callee;
+  };
+
+  std::shared_ptr<const Trace> compile() const;
+
+  const object::Closure *Cl = nullptr;
+  const object::CompiledFunction *Fn = nullptr;
+  const std::vector<object::Value> *Constants = nullptr;
+  int FrameIndex = 0;
+  std::vector<TraceType> Parameters;
+  std::vector<Step> Steps;
+};
+
+} // namespace monkey::vm
@@ -1,212 +1,521 @@
 #include "VM.h"
 
+#include "Operations.h"
+
+#include <JIT/PerfMap.h>
 #include <Object/BuiltIns.h>
 
-#include <arpa/inet.h>
+#include <algorithm>
 #include <cassert>
+#include <limits>
+#include <sstream>
 
 namespace monkey::vm {
 
-namespace {
+VM::VM(compiler::ByteCode &&BC, std::vector<object::Value> &Globals)
+    : Constants(BC.Constants), SP(0), Globals(Globals), FrameIndex(1),
+      Profile(nullptr), ActiveDispatch(DEFAULT_DISPATCH), ExitFrameIndex(-1) {
+  if (Globals.size() < static_cast<size_t>(BC.NumGlobals))
+    Globals.resize(BC.NumGlobals);
+
+  // Decode every function up front so that the interpreter loop only ever sees
+  // the VM's internal instruction format. Constants are shared between VMs in
+  // the REPL so functions may have been decoded by a previous run.
+  for (const auto &Constant : Constants) {
+    if (Constant.type() != object::ObjectType::COMPILED_FUNCTION_OBJ)
+      continue;
+
+    auto *Fn = static_cast<object::CompiledFunction *>(Constant.object());
+    if (Fn->DecodedIns.Value.empty()) {
+      Fn->DecodedIns = code::decode(Fn->Ins);
+      Fn->IndexCaches.resize(Fn->DecodedIns.NumIndexCaches);
+    }
+  }
 
-bool isTruthy(const object::Object *Obj) {
-  const auto *BooleanObj = object::objCast<const object::Boolean *>(Obj);
-  if (BooleanObj)
-    return BooleanObj->Value;
+  auto *MainFn =
+      object::makeCompiledFunction(std::move(BC.Instructions), 0, 0);
+  MainFn->DecodedIns = code::decode(MainFn->Ins);
+  MainFn->IndexCaches.resize(MainFn->DecodedIns.NumIndexCaches);
+  Frames.front() = Frame(object::makeClosure(MainFn), 0);
 
-  const auto *NullObj = object::objCast<const object::Null *>(Obj);
-  if (NullObj)
-    return false;
+  gc::heap().addRoots(this);
+}
 
-  return true;
+VM::~VM() { gc::heap().removeRoots(this); }
+
+object::Object *VM::lastPoppedStackElem() const {
+  return Stack.at(SP).toObject();
 }
 
-} // namespace
-
-VM::VM(compiler::ByteCode &&BC,
-       std::array<std::shared_ptr<object::Object>, GLOBALS_SIZE> &Globals)
-    : Constants(BC.Constants), Stack{nullptr}, SP(0), Globals(Globals),
-      FrameIndex(1) {
-  auto MainFn = std::make_shared<object::CompiledFunction>(
-      std::move(BC.Instructions), 0, 0);
-  auto MainClosure = object::makeClosure(std::move(MainFn));
-  Frame MainFrame(std::move(MainClosure), 0);
-  Frames.front() = std::move(MainFrame);
+void VM::traceRoots(gc::Tracer &Tr) {
+  // The slot just above the top holds the last popped element.
+  const auto Top = std::min<size_t>(SP, STACK_SIZE - 1);
+  for (size_t I = 0; I <= Top; ++I)
+    Stack[I].trace(Tr);
+  for (int I = 0; I < FrameIndex; ++I)
+    Frames[I].Cl.trace(Tr);
+  for (auto &Global : Globals)
+    Global.trace(Tr);
+  for (auto &Constant : Constants)
+    Constant.trace(Tr);
 }
 
-const object::Object *VM::lastPoppedStackElem() const {
-  return Stack.at(SP).get();
+void VM::setProfile(OpCodeProfile *P) { Profile = P; }
+
+void VM::run() { run(DEFAULT_DISPATCH); }
+
+void VM::setJIT(const JITOptions &Options) {
+#ifdef MONKEY_HAS_JIT
+  JIT = Options;
+#else
+  (void)Options;
+#endif
 }
 
-void VM::run() {
-  while (currentFrame().IP <
-         static_cast<int>(currentFrame().instructions().Value.size()) - 1) {
-    ++currentFrame().IP;
+void VM::run(Dispatch D) {
+  ActiveDispatch = D;
+  ExitFrameIndex = -1;
+  resume();
+}
 
-    auto &IP = currentFrame().IP;
-    auto &Instructions = currentFrame().instructions();
-    const auto Op(static_cast<code::OpCode>(Instructions.Value.at(IP)));
+void VM::resume() {
+  if (Profile || Recorder.active()) {
+    execute<false, true>();
+    return;
+  }
 
-    switch (Op) {
-    case code::OpCode::OpConstant: {
-      const int16_t ConstIndex =
-          ntohs(reinterpret_cast<int16_t &>(Instructions.Value.at(IP + 1)));
-      IP += 2;
+#ifdef MONKEY_HAS_COMPUTED_GOTO
+  if (ActiveDispatch == Dispatch::THREADED) {
+    execute<true, false>();
+    return;
+  }
+#endif
 
-      push(Constants.at(ConstIndex));
-      break;
-    }
-    case code::OpCode::OpAdd:
-    case code::OpCode::OpSub:
-    case code::OpCode::OpMul:
-    case code::OpCode::OpDiv:
-      executeBinaryOperation(Op);
-      break;
-    case code::OpCode::OpPop:
-      pop();
-      break;
-    case code::OpCode::OpTrue:
-      push(object::TRUE_GLOBAL);
-      break;
-    case code::OpCode::OpFalse:
-      push(object::FALSE_GLOBAL);
-      break;
-    case code::OpCode::OpEqual:
-    case code::OpCode::OpNotEqual:
-    case code::OpCode::OpGreaterThan:
-      executeComparison(Op);
-      break;
-    case code::OpCode::OpBang:
-      executeBangOperator();
-      break;
-    case code::OpCode::OpMinus:
-      executeMinusOperator();
-      break;
-    case code::OpCode::OpJump: {
-      const int16_t JumpPos =
-          ntohs(reinterpret_cast<int16_t &>(Instructions.Value.at(IP + 1)));
-      IP = JumpPos - 1;
-      break;
-    }
-    case code::OpCode::OpJumpNotTruthy: {
-      const int16_t JumpPos =
-          ntohs(reinterpret_cast<int16_t &>(Instructions.Value.at(IP + 1)));
-      IP += 2;
-      const auto &Condition = pop();
-      if (!isTruthy(Condition.get()))
-        IP = JumpPos - 1;
-      break;
-    }
-    case code::OpCode::OpNull:
-      push(object::NULL_GLOBAL);
-      break;
-    case code::OpCode::OpSetGlobal: {
-      const int16_t GlobalIndex =
-          ntohs(reinterpret_cast<int16_t &>(Instructions.Value.at(IP + 1)));
-      IP += 2;
-      Globals.at(GlobalIndex) = pop();
-      break;
-    }
-    case code::OpCode::OpGetGlobal: {
-      const int16_t GlobalIndex =
-          ntohs(reinterpret_cast<int16_t &>(Instructions.Value.at(IP + 1)));
-      IP += 2;
-      push(Globals.at(GlobalIndex));
-      break;
-    }
-    case code::OpCode::OpSetLocal: {
-      const auto LocalIndex = Instructions.Value.at(IP + 1);
-      auto &Frame = currentFrame();
-      ++Frame.IP;
-      Stack.at(Frame.BasePointer + LocalIndex) = pop();
-      break;
-    }
-    case code::OpCode::OpGetLocal: {
-      const auto LocalIndex = Instructions.Value.at(IP + 1);
-      auto &Frame = currentFrame();
-      ++Frame.IP;
-      push(Stack.at(Frame.BasePointer + LocalIndex));
-      break;
-    }
-    case code::OpCode::OpArray: {
-      const int16_t NumElem =
-          ntohs(reinterpret_cast<int16_t &>(Instructions.Value.at(IP + 1)));
-      IP += 2;
-
-      auto Array = buildArray(SP - NumElem, SP);
-      SP = SP - NumElem;
-      push(std::move(Array));
-      break;
-    }
-    case code::OpCode::OpHash: {
-      const int16_t NumElem =
-          ntohs(reinterpret_cast<int16_t &>(Instructions.Value.at(IP + 1)));
-      IP += 2;
-      const auto Hash = buildHash(SP - NumElem, SP);
-      SP -= NumElem;
-      push(std::move(Hash));
-      break;
-    }
-    case code::OpCode::OpIndex: {
-      const auto &Index = pop();
-      const auto &Left = pop();
+  execute<false, false>();
+}
 
-      executeIndexExpression(*Left, Index);
-      break;
-    }
-    case code::OpCode::OpCall: {
-      const auto NumArgs = Instructions.Value.at(IP + 1);
-      ++currentFrame().IP;
+// Run the current frame until it returns.
+void VM::runNested() {
+  const auto PreviousExit = ExitFrameIndex;
+  ExitFrameIndex = FrameIndex - 1;
 
-      executeCall(NumArgs);
-      break;
-    }
-    case code::OpCode::OpReturnValue: {
-      auto Return = pop();
-      const auto &Frame = popFrame();
-      SP = Frame.BasePointer - 1;
-      push(std::move(Return));
-      break;
-    }
-    case code::OpCode::OpReturn: {
-      const auto &Frame = popFrame();
-      SP = Frame.BasePointer - 1;
-      push(object::NULL_GLOBAL);
-      break;
-    }
-    case code::OpCode::OpGetBuiltIn: {
-      const auto BuiltInIndex = Instructions.Value.at(IP + 1);
-      ++IP;
+  try {
+    resume();
+  } catch (...) {
+    ExitFrameIndex = PreviousExit;
+    throw;
+  }
 
-      const auto &Definition = object::BUILTINS.at(BuiltInIndex);
-      push(Definition.second);
-      break;
-    }
-    case code::OpCode::OpClosure: {
-      const int16_t ConstIndex =
-          ntohs(reinterpret_cast<int16_t &>(Instructions.Value.at(IP + 1)));
-      const auto NumFree = Instructions.Value.at(IP + 3);
-      IP += 3;
-      pushClosure(ConstIndex, NumFree);
-      break;
-    }
-    case code::OpCode::OpGetFree: {
-      const auto FreeIndex = Instructions.Value.at(IP + 1);
-      ++IP;
-
-      const auto *CurrentClosure =
-          object::objCast<const object::Closure *>(currentFrame().Cl.get());
-      assert(CurrentClosure);
-      push(CurrentClosure->Free.at(FreeIndex));
-      break;
+  ExitFrameIndex = PreviousExit;
+}
+
+// The interpreter loop. The instruction pointer, the current frame's
+// instructions and the stack pointer are cached in locals and only written
+// back to the VM when calling out into a helper that needs them or when the
+// current frame changes.
+//
+// Each handler is shared between the two dispatch engines. With 'Threaded' set,
+// every handler jumps straight to the next one through a table of label
+// addresses. Otherwise control returns to the top of the loop and goes through
+// the 'switch'.
+//
+// With 'Instrumented' set, every executed opcode is recorded in 'Profile' and
+// fed to the trace recorder before it's dispatched. Instrumented runs always go
+// through the 'switch'.
+template <bool Threaded, bool Instrumented> void VM::execute() {
+  object::Value *const StackBase = Stack.data();
+  object::Value *const StackEnd = StackBase + STACK_SIZE;
+  object::Value *Top;
+  Frame *F;
+  const code::Word *Base;
+  const code::Word *Ip;
+  code::OpCode Op;
+
+#define LOAD_FRAME()                                                           \
+  do {                                                                         \
+    F = &Frames[FrameIndex - 1];                                               \
+    Base = F->instructions();                                                  \
+    Ip = Base + F->IP;                                                         \
+  } while (false)
+#define SAVE_IP() (F->IP = static_cast<int>(Ip - Base))
+#define LOAD_SP() (Top = StackBase + SP)
+#define SAVE_SP() (SP = static_cast<unsigned int>(Top - StackBase))
+#define PUSH(V)                                                                \
+  do {                                                                         \
+    if (Top >= StackEnd)                                                       \
+      throw std::runtime_error("stack overflow");                              \
+    *Top++ = V;                                                                \
+  } while (false)
+#define READ_OPERAND() (*Ip++)
+
+#ifdef MONKEY_HAS_COMPUTED_GOTO
+  // Must be kept in the same order as 'code::OpCode'.
+  static const void *const DispatchTable[] = {
+      &&OpConstant_Label, &&OpAdd_Label, &&OpPop_Label, &&OpSub_Label,
+      &&OpMul_Label, &&OpDiv_Label, &&OpTrue_Label, &&OpFalse_Label,
+      &&OpEqual_Label, &&OpNotEqual_Label, &&OpGreaterThan_Label,
+      &&OpMinus_Label, &&OpBang_Label, &&OpJumpNotTruthy_Label, &&OpJump_Label,
+      &&OpNull_Label, &&OpGetGlobal_Label, &&OpSetGlobal_Label, &&OpArray_Label,
+      &&OpHash_Label, &&OpIndex_Label, &&OpCall_Label, &&OpReturnValue_Label,
+      &&OpReturn_Label, &&OpGetLocal_Label, &&OpSetLocal_Label,
+      &&OpGetBuiltIn_Label, &&OpClosure_Label, &&OpGetFree_Label,
+      &&OpAddLocalConst_Label, &&OpSubLocalConst_Label,
+      &&OpJumpIfLocalNotEqConst_Label, &&OpCallKnown_Label, &&OpTailCall_Label,
+      &&OpTailCallKnown_Label, &&OpIndexConst_Label, &&OpExtendArg_Label,
+      &&OpHalt_Label};
+  static_assert(sizeof(DispatchTable) / sizeof(DispatchTable[0]) ==
+                    static_cast<size_t>(code::OpCode::OpHalt) + 1,
+                "dispatch table out of sync with OpCode");
+
+#define CASE(Name)                                                             \
+  case code::OpCode::Name:                                                     \
+  Name##_Label:
+#define DISPATCH()                                                             \
+  if constexpr (Threaded) {                                                    \
+    Op = static_cast<code::OpCode>(*Ip++);                                     \
+    goto *DispatchTable[static_cast<uint8_t>(Op)];                             \
+  } else                                                                       \
+    continue
+#else
+#define CASE(Name) case code::OpCode::Name:
+#define DISPATCH() continue
+#endif
+
+  LOAD_FRAME();
+  LOAD_SP();
+
+  for (;;) {
+    Op = static_cast<code::OpCode>(*Ip++);
+
+    if constexpr (Instrumented) {
+      if (Profile)
+        Profile->record(Op);
+      if (Recorder.active())
+        recordTrace(Ip - 1, Top);
     }
+
+#ifdef MONKEY_HAS_COMPUTED_GOTO
+    if constexpr (Threaded)
+      goto *DispatchTable[static_cast<uint8_t>(Op)];
+#endif
+
+    switch (Op) {
+      CASE(OpConstant) {
+        const auto ConstIndex = READ_OPERAND();
+        PUSH(Constants[ConstIndex]);
+        DISPATCH();
+      }
+      CASE(OpAdd) {
+        if (Top[-2].isInteger() && Top[-1].isInteger()) {
+          Top[-2] = object::Value::integer(Top[-2].asInteger() +
+                                           Top[-1].asInteger());
+          --Top;
+          DISPATCH();
+        }
+
+        goto BinaryOperation;
+      }
+      CASE(OpSub) {
+        if (Top[-2].isInteger() && Top[-1].isInteger()) {
+          Top[-2] = object::Value::integer(Top[-2].asInteger() -
+                                           Top[-1].asInteger());
+          --Top;
+          DISPATCH();
+        }
+
+        goto BinaryOperation;
+      }
+      CASE(OpMul) {
+        if (Top[-2].isInteger() && Top[-1].isInteger()) {
+          Top[-2] = object::Value::integer(Top[-2].asInteger() *
+                                           Top[-1].asInteger());
+          --Top;
+          DISPATCH();
+        }
+
+        goto BinaryOperation;
+      }
+      CASE(OpDiv) {
+      BinaryOperation:
+        SAVE_SP();
+        executeBinaryOperation(Op);
+        LOAD_SP();
+        DISPATCH();
+      }
+      CASE(OpPop) {
+        --Top;
+        DISPATCH();
+      }
+      CASE(OpTrue) {
+        PUSH(object::Value::boolean(true));
+        DISPATCH();
+      }
+      CASE(OpFalse) {
+        PUSH(object::Value::boolean(false));
+        DISPATCH();
+      }
+      CASE(OpEqual) {
+        if (Top[-2].isInteger() && Top[-1].isInteger()) {
+          Top[-2] = object::Value::boolean(Top[-2].asInteger() ==
+                                           Top[-1].asInteger());
+          --Top;
+          DISPATCH();
+        }
+
+        goto Comparison;
+      }
+      CASE(OpNotEqual) {
+        if (Top[-2].isInteger() && Top[-1].isInteger()) {
+          Top[-2] = object::Value::boolean(Top[-2].asInteger() !=
+                                           Top[-1].asInteger());
+          --Top;
+          DISPATCH();
+        }
+
+        goto Comparison;
+      }
+      CASE(OpGreaterThan) {
+      Comparison:
+        SAVE_SP();
+        executeComparison(Op);
+        LOAD_SP();
+        DISPATCH();
+      }
+      CASE(OpMinus) {
+        SAVE_SP();
+        executeMinusOperator();
+        LOAD_SP();
+        DISPATCH();
+      }
+      CASE(OpBang) {
+        SAVE_SP();
+        executeBangOperator();
+        LOAD_SP();
+        DISPATCH();
+      }
+      CASE(OpJumpNotTruthy) {
+        const auto JumpPos = READ_OPERAND();
+        if (!isTruthy(*--Top))
+          Ip = Base + JumpPos;
+        DISPATCH();
+      }
+      CASE(OpJump) {
+        const auto JumpPos = READ_OPERAND();
+        Ip = Base + JumpPos;
+        DISPATCH();
+      }
+      CASE(OpNull) {
+        PUSH(object::Value::null());
+        DISPATCH();
+      }
+      CASE(OpSetGlobal) {
+        const auto GlobalIndex = READ_OPERAND();
+        Globals[GlobalIndex] = *--Top;
+        DISPATCH();
+      }
+      CASE(OpGetGlobal) {
+        const auto GlobalIndex = READ_OPERAND();
+        PUSH(Globals[GlobalIndex]);
+        DISPATCH();
+      }
+      CASE(OpSetLocal) {
+        const auto LocalIndex = READ_OPERAND();
+        StackBase[F->BasePointer + LocalIndex] = *--Top;
+        DISPATCH();
+      }
+      CASE(OpGetLocal) {
+        const auto LocalIndex = READ_OPERAND();
+        PUSH(StackBase[F->BasePointer + LocalIndex]);
+        DISPATCH();
+      }
+      CASE(OpArray) {
+        const auto NumElem = READ_OPERAND();
+        auto Array = buildArray(Top - NumElem, Top);
+        Top -= NumElem;
+        PUSH(std::move(Array));
+        DISPATCH();
+      }
+      CASE(OpHash) {
+        const auto NumElem = READ_OPERAND();
+        auto Hash = buildHash(Top - NumElem, Top);
+        Top -= NumElem;
+        PUSH(std::move(Hash));
+        DISPATCH();
+      }
+      CASE(OpIndex) {
+        const auto &Index = *--Top;
+        const auto &Left = *--Top;
+        SAVE_SP();
+        executeIndexExpression(Left, Index);
+        LOAD_SP();
+        DISPATCH();
+      }
+      CASE(OpIndexConst) {
+        const auto ConstIndex = READ_OPERAND();
+        const auto CacheIndex = READ_OPERAND();
+        Top[-1] = indexExpression(Top[-1], Constants[ConstIndex],
+                                  F->indexCaches()[CacheIndex]);
+        DISPATCH();
+      }
+      CASE(OpCall) {
+        const auto NumArgs = READ_OPERAND();
+        SAVE_IP();
+        SAVE_SP();
+        executeCall(NumArgs);
+        LOAD_FRAME();
+        LOAD_SP();
+        DISPATCH();
+      }
+      CASE(OpCallKnown) {
+        const auto ConstIndex = READ_OPERAND();
+        const auto NumArgs = READ_OPERAND();
+        SAVE_IP();
+        SAVE_SP();
+        executeKnownCall(ConstIndex, NumArgs);
+        LOAD_FRAME();
+        LOAD_SP();
+        DISPATCH();
+      }
+      CASE(OpTailCall) {
+        const auto NumArgs = READ_OPERAND();
+        SAVE_IP();
+        SAVE_SP();
+        executeTailCall(NumArgs);
+        LOAD_FRAME();
+        LOAD_SP();
+        // The callee may have run to completion and returned from the frame.
+        if (FrameIndex == ExitFrameIndex)
+          goto Exit;
+        DISPATCH();
+      }
+      CASE(OpTailCallKnown) {
+        const auto ConstIndex = READ_OPERAND();
+        const auto NumArgs = READ_OPERAND();
+        SAVE_IP();
+        SAVE_SP();
+        executeKnownTailCall(ConstIndex, NumArgs);
+        LOAD_FRAME();
+        LOAD_SP();
+        if (FrameIndex == ExitFrameIndex)
+          goto Exit;
+        DISPATCH();
+      }
+      CASE(OpReturnValue) {
+        // A return from the main frame ends the program like 'OpHalt' and
+        // leaves the value as the last popped element.
+        if (FrameIndex == 1) {
+          --Top;
+          goto Exit;
+        }
+
+        auto Return = std::move(Top[-1]);
+        const auto &Frame = popFrame();
+        Top = StackBase + Frame.BasePointer - 1;
+        *Top++ = std::move(Return);
+        LOAD_FRAME();
+        if (FrameIndex == ExitFrameIndex)
+          goto Exit;
+        DISPATCH();
+      }
+      CASE(OpReturn) {
+        if (FrameIndex == 1) {
+          PUSH(object::Value::null());
+          --Top;
+          goto Exit;
+        }
+
+        const auto &Frame = popFrame();
+        Top = StackBase + Frame.BasePointer - 1;
+        *Top++ = object::Value::null();
+        LOAD_FRAME();
+        if (FrameIndex == ExitFrameIndex)
+          goto Exit;
+        DISPATCH();
+      }
+      CASE(OpGetBuiltIn) {
+        const auto BuiltInIndex = READ_OPERAND();
+        const auto &Definition = object::BUILTINS.at(BuiltInIndex);
+        PUSH(Definition.second.get());
+        DISPATCH();
+      }
+      CASE(OpClosure) {
+        const auto ConstIndex = READ_OPERAND();
+        const auto NumFree = READ_OPERAND();
+        SAVE_SP();
+        pushClosure(ConstIndex, NumFree);
+        LOAD_SP();
+        DISPATCH();
+      }
+      CASE(OpGetFree) {
+        const auto FreeIndex = READ_OPERAND();
+        const auto *CurrentClosure =
+            object::objCast<const object::Closure *>(F->Cl.asObject());
+        assert(CurrentClosure);
+        PUSH(CurrentClosure->Free[FreeIndex]);
+        DISPATCH();
+      }
+      CASE(OpAddLocalConst) {
+        const auto &Local = StackBase[F->BasePointer + READ_OPERAND()];
+        const auto &Constant = Constants[READ_OPERAND()];
+        if (Local.isInteger() && Constant.isInteger()) {
+          PUSH(object::Value::integer(Local.asInteger() +
+                                      Constant.asInteger()));
+          DISPATCH();
+        }
+
+        PUSH(Local);
+        PUSH(Constant);
+        Op = code::OpCode::OpAdd;
+        goto BinaryOperation;
+      }
+      CASE(OpSubLocalConst) {
+        const auto &Local = StackBase[F->BasePointer + READ_OPERAND()];
+        const auto &Constant = Constants[READ_OPERAND()];
+        if (Local.isInteger() && Constant.isInteger()) {
+          PUSH(object::Value::integer(Local.asInteger() -
+                                      Constant.asInteger()));
+          DISPATCH();
+        }
+
+        PUSH(Local);
+        PUSH(Constant);
+        Op = code::OpCode::OpSub;
+        goto BinaryOperation;
+      }
+      CASE(OpJumpIfLocalNotEqConst) {
+        const auto &Local = StackBase[F->BasePointer + READ_OPERAND()];
+        const auto &Constant = Constants[READ_OPERAND()];
+        const auto JumpPos = READ_OPERAND();
+        // Same semantics as 'OpEqual' followed by 'OpJumpNotTruthy'.
+        if (Local != Constant)
+          Ip = Base + JumpPos;
+        DISPATCH();
+      }
+      CASE(OpHalt) { goto Exit; }
+      CASE(OpExtendArg) {
+        // Folded into the following instruction when decoding.
+        throw std::runtime_error("unexpected OpExtendArg");
+      }
     default:
-      break;
+      DISPATCH();
     }
   }
+
+Exit:
+  SAVE_IP();
+  SAVE_SP();
+
+#undef LOAD_FRAME
+#undef SAVE_IP
+#undef LOAD_SP
+#undef SAVE_SP
+#undef PUSH
+#undef READ_OPERAND
+#undef CASE
+#undef DISPATCH
 }
 
-const std::shared_ptr<object::Object> &VM::pop() {
+const object::Value &VM::pop() {
   const auto &Obj = Stack.at(SP - 1);
   --SP;
   return Obj;
@@ -215,262 +524,290 @@ const std::shared_ptr<object::Object> &VM::pop() {
 void VM::executeBinaryOperation(code::OpCode Op) {
   const auto &Right = pop();
   const auto &Left = pop();
+  push(binaryOperation(Op, Left, Right));
+}
 
-  const auto LeftType = Left->type();
-  const auto RightType = Right->type();
-
-  if (LeftType == object::ObjectType::INTEGER_OBJ &&
-      RightType == object::ObjectType::INTEGER_OBJ) {
-    executeBinaryIntegerOperation(Op, *Left, *Right);
-  } else if (LeftType == object::ObjectType::STRING_OBJ &&
-             RightType == object::ObjectType::STRING_OBJ) {
-    executeBinaryStringOperation(Op, *Left, *Right);
-  } else {
-    throw std::runtime_error(
-        std::string("unsupported types for binary operation ") +
-        object::objTypeToString(LeftType) + " " +
-        object::objTypeToString(RightType));
-  }
+void VM::executeComparison(code::OpCode Op) {
+  const auto &Right = pop();
+  const auto &Left = pop();
+  push(comparison(Op, Left, Right));
 }
 
-void VM::executeBinaryIntegerOperation(code::OpCode Op,
-                                       const object::Object &Left,
-                                       const object::Object &Right) {
-  const auto LeftVal = object::objCast<const object::Integer *>(&Left)->Value;
-  const auto RightVal = object::objCast<const object::Integer *>(&Right)->Value;
+void VM::executeBangOperator() { push(bangOperator(pop())); }
 
-  const int64_t Result = [Op, LeftVal, RightVal]() {
-    switch (Op) {
-    case code::OpCode::OpAdd:
-      return LeftVal + RightVal;
-    case code::OpCode::OpSub:
-      return LeftVal - RightVal;
-    case code::OpCode::OpMul:
-      return LeftVal * RightVal;
-    case code::OpCode::OpDiv:
-      return LeftVal / RightVal;
-    default:
-      throw std::runtime_error("unknown integer operator: " +
-                               std::to_string(static_cast<char>(Op)));
-    }
-  }();
+void VM::executeMinusOperator() { push(minusOperator(pop())); }
 
-  push(object::makeInteger(Result));
+void VM::executeIndexExpression(const object::Value &Left,
+                                const object::Value &Index) {
+  push(indexExpression(Left, Index));
 }
 
-void VM::executeBinaryStringOperation(code::OpCode Op,
-                                      const object::Object &Left,
-                                      const object::Object &Right) {
-  if (Op != code::OpCode::OpAdd)
-    throw std::runtime_error("unknown string operator: " +
-                             std::to_string(static_cast<char>(Op)));
-
-  const auto &LeftVal = object::objCast<const object::String *>(&Left)->Value;
-  const auto &RightVal = object::objCast<const object::String *>(&Right)->Value;
+Frame &VM::currentFrame() { return Frames.at(FrameIndex - 1); }
 
-  push(object::makeString(LeftVal + RightVal));
+Frame &VM::popFrame() {
+  auto &F = Frames.at(--FrameIndex);
+  return F;
 }
 
-void VM::executeComparison(code::OpCode Op) {
-  const auto &Right = pop();
-  const auto &Left = pop();
-
-  if (Left->type() == object::ObjectType::INTEGER_OBJ &&
-      Right->type() == object::ObjectType::INTEGER_OBJ) {
-    executeIntegerComparison(Op, *Left, *Right);
-    return;
-  }
+void VM::executeCall(int NumArgs) {
+  gc::heap().safePoint();
 
-  switch (Op) {
-  case code::OpCode::OpEqual:
-    push(object::nativeBooleanToBooleanObject(Right.get() == Left.get()));
-    break;
-  case code::OpCode::OpNotEqual:
-    push(object::nativeBooleanToBooleanObject(Right.get() != Left.get()));
-    break;
+  const auto &Callee = Stack.at(SP - 1 - NumArgs);
+  switch (Callee.type()) {
+  case object::ObjectType::CLOSURE_OBJ:
+    return callClosure(Callee, NumArgs);
+  case object::ObjectType::BUILTIN_OBJ:
+    return callBuiltIn(*Callee.asObject(), NumArgs);
   default:
-    throw std::runtime_error("unknown operator " +
-                             std::to_string(static_cast<char>(Op)) + " (" +
-                             object::objTypeToString(Left->type()) + " " +
-                             object::objTypeToString(Right->type()) + ")");
+    throw std::runtime_error("calling non-closure and non-built-in");
   }
 }
 
-void VM::executeIntegerComparison(code::OpCode Op, const object::Object &Left,
-                                  const object::Object &Right) {
-  const auto LeftVal = static_cast<const object::Integer &>(Left).Value;
-  const auto RightVal = static_cast<const object::Integer &>(Right).Value;
-
-  switch (Op) {
-  case code::OpCode::OpEqual:
-    push(object::nativeBooleanToBooleanObject(LeftVal == RightVal));
-    break;
-  case code::OpCode::OpNotEqual:
-    push(object::nativeBooleanToBooleanObject(LeftVal != RightVal));
-    break;
-  case code::OpCode::OpGreaterThan:
-    push(object::nativeBooleanToBooleanObject(LeftVal > RightVal));
-    break;
-  default:
-    throw std::runtime_error("unknown operator: " +
-                             std::to_string(static_cast<char>(Op)));
-  }
+// The compiler has already checked the number of arguments and the closure
+// is a constant, so there is nothing to look at before entering it. Only the
+// callee's slot below the arguments, which the return overwrites, has to be
+// made.
+void VM::executeKnownCall(int ConstIndex, int NumArgs) {
+  gc::heap().safePoint();
+
+  if (SP >= STACK_SIZE)
+    throw std::runtime_error("stack overflow");
+
+  auto *Args = &Stack[SP - NumArgs];
+  std::move_backward(Args, Args + NumArgs, Args + NumArgs + 1);
+  *Args = Constants[ConstIndex];
+  ++SP;
+  pushCallFrame(*Args, NumArgs);
+  startFrame(false);
 }
 
-void VM::executeBangOperator() {
-  const auto &Operand = pop();
-
-  if (Operand.get() == object::TRUE_GLOBAL.get())
-    push(object::FALSE_GLOBAL);
-  else if (Operand.get() == object::FALSE_GLOBAL.get())
-    push(object::TRUE_GLOBAL);
-  else if (Operand.get() == object::NULL_GLOBAL.get())
-    push(object::TRUE_GLOBAL);
-  else
-    push(object::FALSE_GLOBAL);
+void VM::executeTailCall(int NumArgs) {
+  const auto Call = setUpTailCall(NumArgs);
+  if (Call != TailCall::BUILT_IN)
+    startFrame(Call == TailCall::SELF);
 }
 
-void VM::executeMinusOperator() {
-  const auto &Operand = pop();
+void VM::executeKnownTailCall(int ConstIndex, int NumArgs) {
+  startFrame(setUpKnownTailCall(ConstIndex, NumArgs) == TailCall::SELF);
+}
 
-  if (Operand->type() != object::ObjectType::INTEGER_OBJ)
-    throw std::runtime_error(std::string("unsupported type for negation: ") +
-                             object::objTypeToString(Operand->type()));
+// Built-ins return into the caller's frame like for any other call, which then
+// returns their result.
+VM::TailCall VM::setUpTailCall(int NumArgs) {
+  gc::heap().safePoint();
 
-  auto Value = static_cast<const object::Integer *>(Operand.get())->Value;
-  push(object::makeInteger(-Value));
+  const auto &Callee = Stack.at(SP - 1 - NumArgs);
+  switch (Callee.type()) {
+  case object::ObjectType::CLOSURE_OBJ:
+    checkArguments(Callee, NumArgs);
+    return replaceFrame(Callee, NumArgs);
+  case object::ObjectType::BUILTIN_OBJ:
+    callBuiltIn(*Callee.asObject(), NumArgs);
+    return TailCall::BUILT_IN;
+  default:
+    throw std::runtime_error("calling non-closure and non-built-in");
+  }
 }
 
-std::shared_ptr<object::Object> VM::buildArray(int StartIndex,
-                                               int EndIndex) const {
-  std::vector<std::shared_ptr<object::Object>> Elements(EndIndex - StartIndex,
-                                                        nullptr);
+VM::TailCall VM::setUpKnownTailCall(int ConstIndex, int NumArgs) {
+  gc::heap().safePoint();
 
-  for (int I = StartIndex; I < EndIndex; ++I)
-    Elements.at(I - StartIndex) = Stack.at(I);
-
-  return object::makeArray(std::move(Elements));
+  return replaceFrame(Constants[ConstIndex], NumArgs);
 }
 
-std::shared_ptr<object::Object> VM::buildHash(int StartIndex,
-                                              int EndIndex) const {
-  std::unordered_map<object::HashKey, std::shared_ptr<object::Object>,
-                     object::HashKeyHasher>
-      HashedPairs;
+// Move the callee and the arguments at the top of the stack to the bottom of
+// the current frame's window and give the frame to the callee.
+VM::TailCall VM::replaceFrame(object::Value Cl, int NumArgs) {
+  const auto &F = currentFrame();
+  const bool Self = F.Cl.asObject() == Cl.asObject();
+  const auto BasePointer = F.BasePointer;
+
+  if (SP - NumArgs != static_cast<unsigned int>(BasePointer))
+    std::move(Stack.begin() + SP - NumArgs, Stack.begin() + SP,
+              Stack.begin() + BasePointer);
+  Stack[BasePointer - 1] = std::move(Cl);
+  // Pushes uncover the slot above the top, which is traced, so nothing the
+  // caller left behind may outlive the frame.
+  std::fill(Stack.begin() + BasePointer + NumArgs, Stack.begin() + SP,
+            object::Value());
+  SP = BasePointer + NumArgs;
+
+  popFrame();
+  pushCallFrame(Stack[BasePointer - 1], NumArgs);
+  return Self ? TailCall::SELF : TailCall::CLOSURE;
+}
 
-  for (int I = StartIndex; I < EndIndex; I += 2) {
-    const auto &Key = Stack.at(I);
-    const auto &Value = Stack.at(I + 1);
+void VM::callClosure(const object::Value &Cl, int NumArgs) {
+  checkArguments(Cl, NumArgs);
+  pushCallFrame(Cl, NumArgs);
+  startFrame(false);
+}
 
-    if (!object::hasHashKey(object::HashKey(Key)))
-      throw std::runtime_error(std::string("unusable as hash key: ") +
-                               object::objTypeToString(Key->type()));
+void VM::checkArguments(const object::Value &Cl, int NumArgs) const {
+  const auto *ClObj = object::objCast<const object::Closure *>(Cl.asObject());
+  assert(ClObj);
+  const auto *FnObj =
+      object::objCast<const object::CompiledFunction *>(ClObj->Fn);
+  if (NumArgs != FnObj->NumParameters)
+    throw std::runtime_error("wrong number of arguments: want=" +
+                             std::to_string(FnObj->NumParameters) +
+                             ", got=" + std::to_string(NumArgs));
+}
 
-    HashedPairs[object::HashKey(Key)] = Value;
-  }
+void VM::pushCallFrame(const object::Value &Cl, int NumArgs) {
+  const auto *ClObj = static_cast<const object::Closure *>(Cl.asObject());
+  const auto *FnObj =
+      static_cast<const object::CompiledFunction *>(ClObj->Fn);
 
-  return object::makeHash(std::move(HashedPairs));
+  pushFrame(Frame(Cl, SP - NumArgs));
+  // Whatever a previous call left in the new locals must not be traced.
+  const auto NewSP = SP + FnObj->NumLocals + NumArgs;
+  std::fill(Stack.begin() + std::min<size_t>(SP, STACK_SIZE),
+            Stack.begin() + std::min<size_t>(NewSP, STACK_SIZE),
+            object::Value());
+  SP = NewSP;
 }
 
-void VM::executeIndexExpression(const object::Object &Left,
-                                const std::shared_ptr<object::Object> &Index) {
-  if (Left.type() == object::ObjectType::ARRAY_OBJ &&
-      Index->type() == object::ObjectType::INTEGER_OBJ)
-    executeArrayIndex(Left, *Index);
-  else if (Left.type() == object::ObjectType::HASH_OBJ)
-    executeHashIndex(Left, Index);
-  else
-    throw std::runtime_error(std::string("index operator not supported: ") +
-                             object::objTypeToString(Left.type()));
-}
+// Start running the frame that was just pushed. It's left to the interpreter
+// unless it's entered a trace or has been compiled, in which case the native
+// code runs to completion here. Native code leaves on tail calls for the loop
+// to start the callee, so native loops don't grow the native stack.
+void VM::startFrame(bool SelfTailCall) {
+  for (;;) {
+    const auto *ClObj =
+        static_cast<const object::Closure *>(currentFrame().Cl.asObject());
+    const auto *FnObj =
+        static_cast<const object::CompiledFunction *>(ClObj->Fn);
+
+    // A tail call of the function to itself is the back-edge of a loop.
+    const bool BackEdge = JIT.LoopThreshold > 0 && !FnObj->Trace &&
+                          FnObj->LoopCount >= 0 && !FnObj->NativeCode &&
+                          SelfTailCall;
+
+    if (FnObj->Trace) {
+      if (runTrace(*FnObj->Trace))
+        return;
+    } else if (BackEdge && ++FnObj->LoopCount >= JIT.LoopThreshold) {
+      // Record this invocation. The recorder compiles the trace once it
+      // reaches the tail call, which then enters it.
+      Recorder.start(*ClObj, FrameIndex, &Stack[currentFrame().BasePointer],
+                     Constants);
+      if (Recorder.active()) {
+        runNested();
+        return;
+      }
+    }
 
-void VM::executeArrayIndex(const object::Object &Array,
-                           const object::Object &Index) {
-  const auto *ArrayObj = object::objCast<const object::Array *>(&Array);
-  const auto I = object::objCast<const object::Integer *>(&Index)->Value;
-  const int Max = ArrayObj->Elements.size() - 1;
+    if (JIT.Threshold <= 0)
+      return;
 
-  if (I < 0 || I > Max) {
-    push(object::NULL_GLOBAL);
-    return;
-  }
+    if (!FnObj->NativeCode && ++FnObj->CallCount >= JIT.Threshold &&
+        !compileNative(*FnObj, Constants, JIT.PerfMap))
+      FnObj->CallCount = std::numeric_limits<int>::min();
+
+    if (!FnObj->NativeCode)
+      return;
 
-  push(ArrayObj->Elements.at(I));
+    // Compiled functions leave the return value on the stack like the
+    // interpreter would.
+    const auto Result =
+        reinterpret_cast<NativeFunction>(FnObj->NativeCode)(this);
+    if (Result == NATIVE_RETURNED)
+      return;
+    if (Result == NATIVE_ERROR)
+      std::rethrow_exception(PendingError);
+
+    SelfTailCall = Result == NATIVE_SELF_TAIL_CALLED;
+  }
 }
 
-void VM::executeHashIndex(const object::Object &Hash,
-                          const std::shared_ptr<object::Object> &Index) {
-  const auto *HashObj = object::objCast<const object::Hash *>(&Hash);
-  const object::HashKey Key(Index);
+void VM::recordTrace(const code::Word *Ip, const object::Value *Top) {
+  const auto &F = currentFrame();
+  const auto Position = static_cast<int>(Ip - F.instructions());
+  auto T = Recorder.record(FrameIndex, Position, Top, Globals);
+  if (!T)
+    return;
 
-  if (!object::hasHashKey(Key))
-    throw std::runtime_error(std::string("unusable as hash key: ") +
-                             object::objTypeToString(Index->type()));
+  if (JIT.PerfMap) {
+    std::stringstream Name;
+    Name << "monkey::Trace[" << F.Cl.inspect() << "]";
+    jit::PerfMap::instance().add(T->Code, T->CodeSize, Name.str());
+  }
 
-  const auto HashIter = HashObj->Pairs.find(Key);
-  if (HashIter == HashObj->Pairs.end())
-    push(object::NULL_GLOBAL);
-  else
-    push(HashIter->second);
+  const auto *Cl = static_cast<const object::Closure *>(F.Cl.asObject());
+  static_cast<const object::CompiledFunction &>(*Cl->Fn).Trace = std::move(T);
 }
 
-Frame &VM::currentFrame() { return Frames.at(FrameIndex - 1); }
+// Run the trace of the current frame's function and leave the frame as the
+// interpreter would have when reaching the trace's exit. Returns false without
+// running anything if the frame doesn't match what the trace was recorded
+// with.
+bool VM::runTrace(const Trace &T) {
+  auto &F = currentFrame();
+  const auto *Cl = static_cast<const object::Closure *>(F.Cl.asObject());
+  object::Value *Locals = &Stack[F.BasePointer];
 
-Frame &VM::popFrame() {
-  auto &F = Frames.at(--FrameIndex);
-  return F;
-}
+  if (F.BasePointer + T.StateSize > STACK_SIZE)
+    return false;
 
-void VM::executeCall(int NumArgs) {
-  const auto &Callee = Stack.at(SP - 1 - NumArgs);
-  switch (Callee->type()) {
-  case object::ObjectType::CLOSURE_OBJ:
-    return callClosure(Callee, NumArgs);
-  case object::ObjectType::BUILTIN_OBJ:
-    return callBuiltIn(*Callee, NumArgs);
-  default:
-    throw std::runtime_error("calling non-closure and non-built-in");
+  for (const auto &Callee : T.Callees) {
+    const auto &V = Callee.Op == code::OpCode::OpGetGlobal
+                        ? Globals[Callee.Index]
+                        : Cl->Free[Callee.Index];
+    if (V.asObject() != Cl)
+      return false;
   }
-}
 
-void VM::callClosure(const std::shared_ptr<object::Object> &Cl, int NumArgs) {
-  const auto *ClObj = object::objCast<const object::Closure *>(Cl.get());
-  assert(ClObj);
-  const auto *FnObj =
-      object::objCast<const object::CompiledFunction *>(ClObj->Fn.get());
-  if (NumArgs != FnObj->NumParameters)
-    throw std::runtime_error("wrong number of arguments: want=" +
-                             std::to_string(FnObj->NumParameters) +
-                             ", got=" + std::to_string(NumArgs));
-  pushFrame(Frame(Cl, SP - NumArgs));
-  SP += FnObj->NumLocals + NumArgs;
+  TraceState.resize(T.StateSize);
+  for (size_t I = 0; I < T.Parameters.size(); ++I) {
+    const auto &Param = Locals[I];
+    if (T.Parameters[I] == TraceType::INTEGER && Param.isInteger())
+      TraceState[I] = Param.asInteger();
+    else if (T.Parameters[I] == TraceType::BOOLEAN && Param.isBoolean())
+      TraceState[I] = Param.asBoolean();
+    else
+      return false;
+  }
+
+  const auto ExitIndex =
+      reinterpret_cast<Trace::NativeLoop>(T.Code)(TraceState.data());
+  const auto &Exit = T.Exits.at(ExitIndex);
+
+  const auto Box = [&F](TraceType Type, int64_t Slot) {
+    switch (Type) {
+    case TraceType::INTEGER:
+      return object::Value::integer(Slot);
+    case TraceType::BOOLEAN:
+      return object::Value::boolean(Slot);
+    default:
+      return F.Cl;
+    }
+  };
+
+  const auto NumLocals = Exit.Locals.size();
+  for (size_t I = 0; I < NumLocals; ++I)
+    if (Exit.Locals[I] != TraceType::UNDEFINED)
+      Locals[I] = Box(Exit.Locals[I], TraceState[I]);
+  for (size_t I = 0; I < Exit.Operands.size(); ++I)
+    Locals[NumLocals + I] = Box(Exit.Operands[I], TraceState[NumLocals + I]);
+
+  SP = static_cast<unsigned int>(F.BasePointer + NumLocals +
+                                 Exit.Operands.size());
+  F.IP = Exit.Position;
+  return true;
 }
 
 void VM::callBuiltIn(const object::Object &Fn, int NumArgs) {
-  std::vector<std::shared_ptr<object::Object>> Args;
-  std::copy(Stack.begin() + SP - NumArgs, Stack.begin() + SP,
-            std::back_inserter(Args));
-
-  auto Result = object::objCast<const object::BuiltIn *>(&Fn)->Fn(Args);
+  auto Result = vm::callBuiltIn(Fn, &Stack[SP - NumArgs], &Stack[SP]);
   SP -= (NumArgs + 1);
   push(std::move(Result));
 }
 
 void VM::pushClosure(int ConstIndex, int NumFree) {
-  const auto &Constant = Constants.at(ConstIndex);
-  const auto *Function =
-      object::objCast<const object::CompiledFunction *>(Constant.get());
-  if (!Function)
-    throw std::runtime_error(std::string("not a function: ") +
-                             object::objTypeToString(Constant->type()));
-
-  std::vector<std::shared_ptr<object::Object>> Free;
-  Free.reserve(NumFree);
-  for (int I = 0; I < NumFree; ++I)
-    Free.push_back(Stack.at(SP - NumFree + I));
-
+  auto Closure =
+      buildClosure(Constants.at(ConstIndex), &Stack[SP - NumFree], &Stack[SP]);
   SP -= NumFree;
-  push(object::makeClosure(Constant, std::move(Free)));
+  push(std::move(Closure));
 }
 
 } // namespace monkey::vm
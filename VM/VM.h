@@ -1,67 +1,114 @@
 #pragma once
 
 #include "Frame.h"
+#include "JIT.h"
+#include "Profile.h"
+#include "Trace.h"
 
 #include <Compiler/Compiler.h>
 
 #include <array>
 
 static const size_t STACK_SIZE = 2048;
-static const size_t GLOBALS_SIZE = 65536;
 static const size_t MAX_FRAMES = 1024;
 
+// Labels as values are a GNU extension supported by both GCC and Clang.
+#if defined(__GNUC__)
+#define MONKEY_HAS_COMPUTED_GOTO
+#endif
+
 namespace monkey::vm {
 
-class VM {
+// How the interpreter loop dispatches to the handler for the next instruction.
+// 'THREADED' uses computed gotos and is only available when the compiler
+// supports them. Otherwise it falls back to 'SWITCH'.
+enum class Dispatch { SWITCH, THREADED };
+
+#if defined(MONKEY_THREADED_DISPATCH) && defined(MONKEY_HAS_COMPUTED_GOTO)
+static const Dispatch DEFAULT_DISPATCH = Dispatch::THREADED;
+#else
+static const Dispatch DEFAULT_DISPATCH = Dispatch::SWITCH;
+#endif
+
+// The VM's stack, frames, globals and constants are roots of the heap for as
+// long as it exists. Collections happen at calls.
+class VM : public gc::RootProvider {
 public:
-  VM(compiler::ByteCode &&,
-     std::array<std::shared_ptr<object::Object>, GLOBALS_SIZE> &);
-  virtual ~VM() = default;
+  VM(compiler::ByteCode &&, std::vector<object::Value> &);
+  virtual ~VM();
+  VM(const VM &) = delete;
+  VM &operator=(const VM &) = delete;
 
-  const object::Object *lastPoppedStackElem() const;
+  object::Object *lastPoppedStackElem() const;
   void run();
+  void run(Dispatch);
+  // Record every executed opcode into the given profile. Pass nullptr to stop
+  // profiling.
+  void setProfile(OpCodeProfile *);
+  // Opt into compiling hot functions to native code. Ignored on platforms
+  // without JIT support.
+  void setJIT(const JITOptions &);
+
+  void traceRoots(gc::Tracer &) override;
 
 protected:
+  friend struct JITHelpers;
+
+  void resume();
+  void runNested();
+  template <bool Threaded, bool Instrumented> void execute();
+  void recordTrace(const code::Word *, const object::Value *);
+  bool runTrace(const Trace &);
   template <typename T> void push(T &&Obj) {
     if (SP >= STACK_SIZE)
       throw std::runtime_error("stack overflow");
 
     Stack.at(SP++) = std::forward<T>(Obj);
   }
-  virtual const std::shared_ptr<object::Object> &pop();
+  virtual const object::Value &pop();
   void executeBinaryOperation(code::OpCode);
-  void executeBinaryIntegerOperation(code::OpCode, const object::Object &,
-                                     const object::Object &);
-  void executeBinaryStringOperation(code::OpCode, const object::Object &,
-                                    const object::Object &);
   void executeComparison(code::OpCode);
-  void executeIntegerComparison(code::OpCode, const object::Object &,
-                                const object::Object &);
   void executeBangOperator();
   void executeMinusOperator();
-  std::shared_ptr<object::Object> buildArray(int, int) const;
-  std::shared_ptr<object::Object> buildHash(int, int) const;
-  void executeIndexExpression(const object::Object &,
-                              const std::shared_ptr<object::Object> &);
-  void executeArrayIndex(const object::Object &, const object::Object &);
-  void executeHashIndex(const object::Object &,
-                        const std::shared_ptr<object::Object> &);
+  void executeIndexExpression(const object::Value &, const object::Value &);
   Frame &currentFrame();
   template <typename T> void pushFrame(T &&Frame) {
     Frames.at(FrameIndex++) = std::forward<T>(Frame);
   }
   Frame &popFrame();
+  // What a tail call did with the frame making it.
+  enum class TailCall { BUILT_IN, CLOSURE, SELF };
+
   void executeCall(int);
-  void callClosure(const std::shared_ptr<object::Object> &, int);
+  void executeKnownCall(int, int);
+  void executeTailCall(int);
+  void executeKnownTailCall(int, int);
+  TailCall setUpTailCall(int);
+  TailCall setUpKnownTailCall(int, int);
+  TailCall replaceFrame(object::Value, int);
+  void callClosure(const object::Value &, int);
+  void checkArguments(const object::Value &, int) const;
+  void pushCallFrame(const object::Value &, int);
+  void startFrame(bool);
   void callBuiltIn(const object::Object &, int);
   void pushClosure(int, int);
 
-  std::vector<std::shared_ptr<object::Object>> &Constants;
-  std::array<std::shared_ptr<object::Object>, STACK_SIZE> Stack;
+  std::vector<object::Value> &Constants;
+  std::array<object::Value, STACK_SIZE> Stack;
   unsigned int SP;
-  std::array<std::shared_ptr<object::Object>, GLOBALS_SIZE> &Globals;
+  std::vector<object::Value> &Globals;
   std::array<Frame, MAX_FRAMES> Frames;
   int FrameIndex;
+  OpCodeProfile *Profile;
+  Dispatch ActiveDispatch;
+  // 'execute' returns once a return leaves this many frames on the stack.
+  int ExitFrameIndex;
+  JITOptions JIT;
+  // An error raised while running native code.
+  std::exception_ptr PendingError;
+  TraceRecorder Recorder;
+  // Unboxed locals and operands of the running trace.
+  std::vector<int64_t> TraceState;
 };
 
 } // namespace monkey::vm
@@ -1,7 +1,9 @@
+#include "RegisterVM.h"
 #include "VM.h"
 
 #include <AST/AST.h>
 #include <Compiler/Compiler.h>
+#include <Compiler/RegisterCompiler.h>
 #include <Lexer/Lexer.h>
 #include <Object/Object.h>
 #include <Parser/Parser.h>
@@ -39,28 +41,30 @@ void testVoidObject(const object::Object *Obj) {
 void testStringObject(const std::string &Expected, const object::Object *Obj) {
   const auto *String = dynamic_cast<const object::String *>(Obj);
   ASSERT_THAT(String, testing::NotNull());
-  ASSERT_EQ(String->Value, Expected);
+  ASSERT_EQ(String->value(), Expected);
 }
 
 void testArrayObject(const std::vector<int> &Expected,
                      const object::Object *Obj) {
   const auto *ArrayL = dynamic_cast<const object::Array *>(Obj);
   ASSERT_THAT(ArrayL, testing::NotNull());
-  ASSERT_EQ(ArrayL->Elements.size(), Expected.size());
+  ASSERT_EQ(ArrayL->size(), Expected.size());
   for (unsigned int I = 0; I < Expected.size(); ++I)
-    testIntegerObject(Expected.at(I), ArrayL->Elements.at(I).get());
+    testIntegerObject(Expected.at(I), (*ArrayL)[I]);
 }
 
-void testHashObject(
-    const std::vector<std::pair<object::HashKey, int>> &Expected,
-    const object::Object *Obj) {
+// Expected keys and the integer values they map to.
+using ExpectedPairs =
+    std::vector<std::pair<std::shared_ptr<object::Object>, int>>;
+
+void testHashObject(const ExpectedPairs &Expected, const object::Object *Obj) {
   const auto *HashL = dynamic_cast<const object::Hash *>(Obj);
   ASSERT_THAT(HashL, testing::NotNull());
-  ASSERT_EQ(HashL->Pairs.size(), Expected.size());
+  ASSERT_EQ(HashL->size(), Expected.size());
   for (const auto &Exp : Expected) {
-    const auto HashIter = HashL->Pairs.find(Exp.first);
-    ASSERT_NE(HashIter, HashL->Pairs.end());
-    testIntegerObject(Exp.second, HashIter->second.get());
+    const auto *Value = HashL->find(Exp.first.get());
+    ASSERT_NE(Value, nullptr);
+    testIntegerObject(Exp.second, Value);
   }
 }
 
@@ -73,8 +77,7 @@ void testErrorObj(const std::shared_ptr<object::Error> &Expected,
 
 using ExpectedType =
     std::variant<int, bool, std::string, std::vector<int>, void *,
-                 std::vector<std::pair<object::HashKey, int>>,
-                 std::shared_ptr<object::Error>>;
+                 ExpectedPairs, std::shared_ptr<object::Error>>;
 
 struct VMTestCase {
   const std::string Input;
@@ -96,9 +99,7 @@ void testExpectedObject(const ExpectedType &Expected,
           [Obj](const std::string &Arg) { testStringObject(Arg, Obj); },
           [Obj](const std::vector<int> &Arg) { testArrayObject(Arg, Obj); },
           [Obj](const void *) { testVoidObject(Obj); },
-          [Obj](const std::vector<std::pair<object::HashKey, int>> &Arg) {
-            testHashObject(Arg, Obj);
-          },
+          [Obj](const ExpectedPairs &Arg) { testHashObject(Arg, Obj); },
           [Obj](const std::shared_ptr<object::Error> &Arg) {
             testErrorObj(Arg, Obj);
           }},
@@ -108,29 +109,69 @@ void testExpectedObject(const ExpectedType &Expected,
 class TestVM : public VM {
 public:
   TestVM(compiler::ByteCode &&BC,
-         std::array<std::shared_ptr<object::Object>, GLOBALS_SIZE> &Globals)
+         std::vector<object::Value> &Globals)
       : VM(std::move(BC), Globals) {}
   virtual ~TestVM() = default;
 
-  void push(const std::shared_ptr<object::Object> &Obj) { VM::push(Obj); }
-  const std::shared_ptr<object::Object> &pop() override { return VM::pop(); }
+  void push(const object::Value &Val) { VM::push(Val); }
+  const object::Value &pop() override { return VM::pop(); }
 };
 
-void runVMTests(const std::vector<VMTestCase> &Tests) {
-  for (const auto &Test : Tests) {
-    auto Program = parse(Test.Input);
-
-    compiler::SymbolTable ST;
-    std::vector<std::shared_ptr<object::Object>> Constants;
-    compiler::Compiler C(ST, Constants);
-    ASSERT_NO_THROW(C.compile(Program.get()));
+// 'JIT' is the stack VM compiling every function on its first call and
+// 'MIXED_JIT' on the second one, which mixes native and interpreted frames.
+// 'FOLDED' is the stack VM running code compiled with constant folding, which
+// the others turn off so that they execute every operation.
+enum class Backend { STACK, FOLDED, JIT, MIXED_JIT, TRACE, REGISTER };
+
+const auto ALL_BACKENDS = {Backend::STACK,     Backend::FOLDED,
+                           Backend::JIT,       Backend::MIXED_JIT,
+                           Backend::TRACE,     Backend::REGISTER};
+
+// Compile and run the program on one of the VMs and return the value of the
+// last expression statement.
+// The result is referenced since the VM no longer keeps it alive once it's
+// gone.
+object::Ref<object::Object> run(const ast::Program &Program, Backend B,
+                                Dispatch D) {
+  compiler::SymbolTable ST;
+  std::vector<object::Value> Constants;
+  std::vector<object::Value> Globals;
+
+  if (B == Backend::REGISTER) {
+    compiler::RegisterCompiler C(ST, Constants);
+    C.compile(&Program);
+
+    RegisterVM VM(C.byteCode(), Globals);
+    VM.run(D);
+    return object::Ref<object::Object>(VM.result());
+  }
 
-    std::array<std::shared_ptr<object::Object>, GLOBALS_SIZE> Globals;
-    TestVM VM(C.byteCode(), Globals);
-    ASSERT_NO_THROW(VM.run());
+  compiler::Compiler C(ST, Constants);
+  C.setFoldConstants(B == Backend::FOLDED);
+  C.compile(&Program);
+
+  TestVM VM(C.byteCode(), Globals);
+  if (B == Backend::JIT)
+    VM.setJIT({1, false});
+  else if (B == Backend::MIXED_JIT)
+    VM.setJIT({2, false});
+  else if (B == Backend::TRACE)
+    VM.setJIT({0, false, 1});
+  VM.run(D);
+  return object::Ref<object::Object>(VM.lastPoppedStackElem());
+}
 
-    const auto *StackElem = VM.lastPoppedStackElem();
-    testExpectedObject(Test.Expected, StackElem);
+void runVMTests(const std::vector<VMTestCase> &Tests) {
+  for (const auto B : ALL_BACKENDS) {
+    for (const auto D : {Dispatch::SWITCH, Dispatch::THREADED}) {
+      for (const auto &Test : Tests) {
+        auto Program = parse(Test.Input);
+
+        object::Ref<object::Object> Result;
+        ASSERT_NO_THROW(Result = run(*Program, B, D)) << Test.Input;
+        testExpectedObject(Test.Expected, Result.get());
+      }
+    }
   }
 }
 
@@ -218,7 +259,21 @@ TEST(VMTests, testStringExpressions) {
   const std::vector<VMTestCase> Tests = {
       {"\"monkey\"", std::string("monkey")},
       {"\"mon\" + \"key\"", std::string("monkey")},
-      {"\"mon\" + \"key\" + \"banana\"", std::string("monkeybanana")}};
+      {"\"mon\" + \"key\" + \"banana\"", std::string("monkeybanana")},
+      // Strings compare by identity, which folding mustn't change.
+      {"\"ab\" + \"c\" == \"abc\"", false},
+      // Nor may sharing the constants of equal literals.
+      {"\"a\" == \"a\"", false},
+      {"\"a\" != \"a\"", true},
+      {"fn(x) { if (x == \"a\") { 1 } else { 2 } }(\"a\")", 2},
+      {"let a = \"a\"; a == a", true},
+      {"let s = \"0123456789012345678901234567890123456789\"; s + s + \"!\"",
+       std::string("0123456789012345678901234567890123456789"
+                   "0123456789012345678901234567890123456789!")},
+      {"let s = \"0123456789012345678901234567890123456789\"; len(s + s)", 80},
+      {"let s = \"0123456789012345678901234567890123456789\";"
+       "{s + s: 1}[s + s]",
+       1}};
 
   runVMTests(Tests);
 }
@@ -234,15 +289,13 @@ TEST(VMTests, testArrayLiterals) {
 
 TEST(VMTests, testHashLiterals) {
   const std::vector<VMTestCase> Tests = {
-      {"{}", std::vector<std::pair<object::HashKey, int>>{}},
+      {"{}", ExpectedPairs{}},
       {"{1: 2, 2: 3}",
-       std::vector<std::pair<object::HashKey, int>>{
-           {object::HashKey(std::make_shared<object::Integer>(1)), 2},
-           {object::HashKey(std::make_shared<object::Integer>(2)), 3}}},
+       ExpectedPairs{{std::make_shared<object::Integer>(1), 2},
+                     {std::make_shared<object::Integer>(2), 3}}},
       {"{1 + 1: 2 * 2, 3 + 3: 4 * 4}",
-       std::vector<std::pair<object::HashKey, int>>{
-           {object::HashKey(std::make_shared<object::Integer>(2)), 4},
-           {object::HashKey(std::make_shared<object::Integer>(6)), 16}}}};
+       ExpectedPairs{{std::make_shared<object::Integer>(2), 4},
+                     {std::make_shared<object::Integer>(6), 16}}}};
 
   runVMTests(Tests);
 }
@@ -253,7 +306,41 @@ TEST(VMTests, testIndexExpressions) {
       {"[[1, 1, 1]][0][0]", 1},   {"{1: 1, 2: 2}[1]", 1},
       {"{1: 1, 2: 2}[2]", 2},     {"[][0]", nullptr},
       {"[1, 2, 3][99]", nullptr}, {"[1][-1]", nullptr},
-      {"{1: 1}[0]", nullptr},     {"{}[0]", nullptr}};
+      {"{1: 1}[0]", nullptr},     {"{}[0]", nullptr},
+      {"{1: 1, true: 2, \"1\": 3}[true]", 2},
+      {"{1: 5}[true]", nullptr},
+      // Keys of every length the string hash reads differently.
+      {"let k = fn(s) { s + \"\" };"
+       "let h = {\"\": 1, \"ab\": 2, \"abcdefghij\": 3,"
+       "\"abcdefghijklmnopqrstuvwxyz\": 4,"
+       "\"abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz\": 5};"
+       "h[k(\"\")] + h[k(\"ab\")] + h[k(\"abcdefghij\")] +"
+       "h[k(\"abcdefghijklmnopqrstuvwxyz\")] +"
+       "h[k(\"abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz\")]",
+       15}};
+
+  runVMTests(Tests);
+}
+
+TEST(VMTests, testIndexingWithConstantKeys) {
+  const std::vector<VMTestCase> Tests = {
+      // The same lookup on hashes with different bucket counts.
+      {"let get = fn(h) { h[\"b\"] };"
+       "let small = {\"a\": 1, \"b\": 2};"
+       "let big = {\"a\": 1, \"b\": 3, \"c\": 4, \"d\": 5, \"e\": 6,"
+       "\"f\": 7, \"g\": 8, \"h\": 9, \"i\": 10, \"j\": 11, \"k\": 12,"
+       "\"l\": 13, \"m\": 14, \"n\": 15, \"o\": 16, \"p\": 17};"
+       "get(small) + get(big) + get(small) + get({\"b\": 4}) + get(big)",
+       14},
+      // Keys that were built at runtime aren't the constant.
+      {"let key = fn(s) { s + \"b\" };"
+       "let h = {key(\"a\"): 1, key(\"\"): 2};"
+       "h[\"ab\"] + h[\"b\"] + h[\"ab\"]",
+       4},
+      {"let get = fn(h) { h[\"x\"] }; get({\"x\": 1}); get({\"y\": 1})",
+       nullptr},
+      {"let first = fn(a) { a[0] }; first([1]) + first([2, 3])", 3},
+      {"let h = {1: \"a\", true: \"b\"}; h[1] + h[true]", "ab"}};
 
   runVMTests(Tests);
 }
@@ -287,6 +374,21 @@ TEST(VMTests, testFunctionsWithReturnStatement) {
   runVMTests(Tests);
 }
 
+TEST(VMTests, testTopLevelReturnStatement) {
+  const std::vector<VMTestCase> Tests = {
+      {"return 5;", 5},
+      {"return 5; 10;", 5},
+      {"let c = true; let x = 7; if (c) { return x; } 9;", 7},
+      {"let c = false; let x = 7; if (c) { return x; } 9;", 9},
+      {"let f = fn() { 3 }; return f() + 1;", 4},
+      // Calls in the main program are never tail calls.
+      {"let f = fn(x) { x * 2 }; return f(4);", 8},
+      {"let f = fn(x) { x }; let g = f; if (true) { return g(3); } 0;", 3},
+      {"return len([1, 2]);", 2}};
+
+  runVMTests(Tests);
+}
+
 TEST(VMTests, testFunctionsWithoutReturnValue) {
   const std::vector<VMTestCase> Tests = {
       {"let noReturn = fn() { };"
@@ -394,27 +496,51 @@ TEST(VMTests, testCallingFunctionWithWrongArguments) {
   const std::vector<std::pair<std::string, std::string>> Tests = {
       {"fn() { 1; }(1);", "wrong number of arguments: want=0, got=1"},
       {"fn(a) { a; }();", "wrong number of arguments: want=1, got=0"},
-      {"fn(a, b) { a + b; }(1);", "wrong number of arguments: want=2, got=1"}};
-
-  for (const auto &Test : Tests) {
-    const auto Program = parse(Test.first);
-
-    compiler::SymbolTable ST;
-    std::vector<std::shared_ptr<object::Object>> Constants;
-    compiler::Compiler C(ST, Constants);
-    ASSERT_NO_THROW(C.compile(Program.get()));
-
-    std::array<std::shared_ptr<object::Object>, GLOBALS_SIZE> Globals;
-    VM VM(C.byteCode(), Globals);
-    std::string Error;
-    try {
-      VM.run();
-    } catch (const std::runtime_error &RE) {
-      Error = RE.what();
+      {"fn(a, b) { a + b; }(1);", "wrong number of arguments: want=2, got=1"},
+      {"let g = fn(a) { a; }; let f = fn() { g(); }; f();",
+       "wrong number of arguments: want=1, got=0"},
+      {"let f = fn() { 1 + true; }; f();",
+       "unsupported types for binary operation INTEGER BOOLEAN"}};
+
+  for (const auto B : ALL_BACKENDS) {
+    for (const auto &Test : Tests) {
+      const auto Program = parse(Test.first);
+
+      std::string Error;
+      try {
+        run(*Program, B, DEFAULT_DISPATCH);
+      } catch (const std::runtime_error &RE) {
+        Error = RE.what();
+      }
+
+      ASSERT_FALSE(Error.empty());
+      ASSERT_EQ(Error, Test.second);
     }
+  }
+}
 
-    ASSERT_FALSE(Error.empty());
-    ASSERT_EQ(Error, Test.second);
+// Simplifications must not hide errors, so every backend raises them.
+TEST(VMTests, testTypeErrors) {
+  const std::vector<std::pair<std::string, std::string>> Tests = {
+      {"let x = \"s\"; x * 1",
+       "unsupported types for binary operation STRING INTEGER"},
+      {"let x = \"s\"; 1 * x",
+       "unsupported types for binary operation INTEGER STRING"},
+      {"let x = true; -(-x)", "unsupported type for negation: BOOLEAN"}};
+
+  for (const auto B : ALL_BACKENDS) {
+    for (const auto &Test : Tests) {
+      const auto Program = parse(Test.first);
+
+      std::string Error;
+      try {
+        run(*Program, B, DEFAULT_DISPATCH);
+      } catch (const std::runtime_error &RE) {
+        Error = RE.what();
+      }
+
+      ASSERT_EQ(Error, Test.second) << Test.first;
+    }
   }
 }
 
@@ -443,7 +569,50 @@ TEST(VMTests, testBuiltInFunctions) {
       {"last(1)", std::make_shared<object::Error>(
                       "argument to \"last\" must be ARRAY, got INTEGER")},
       {"push(1, 1)", std::make_shared<object::Error>(
-                         "argument to \"push\" must be ARRAY, got INTEGER")}};
+                         "argument to \"push\" must be ARRAY, got INTEGER")},
+      {"assoc({1: 2}, 3, 4)",
+       ExpectedPairs{{std::make_shared<object::Integer>(1), 2},
+                     {std::make_shared<object::Integer>(3), 4}}},
+      {"assoc({1: 2}, 1, 4)",
+       ExpectedPairs{{std::make_shared<object::Integer>(1), 4}}},
+      {"dissoc({1: 2, 3: 4}, 1)",
+       ExpectedPairs{{std::make_shared<object::Integer>(3), 4}}},
+      {"dissoc({1: 2}, 3)",
+       ExpectedPairs{{std::make_shared<object::Integer>(1), 2}}},
+      {"let h = {1: 2}; let g = assoc(h, 3, 4); h[3]", nullptr},
+      {"let h = assoc(assoc({}, 1, 2), 3, 4); dissoc(h, 3)[1] + h[3]", 6},
+      {"assoc(1, 1, 1)", std::make_shared<object::Error>(
+                             "argument to \"assoc\" must be HASH, got INTEGER")},
+      {"dissoc({}, [1])",
+       std::make_shared<object::Error>("unusable as hash key: ARRAY")},
+      {"assoc({}, 1)", std::make_shared<object::Error>(
+                           "wrong number of arguments. got=2, want=3")}};
+
+  runVMTests(Tests);
+}
+
+TEST(VMTests, testArraysShareElements) {
+  const std::vector<VMTestCase> Tests = {
+      {"let a = [1, 2]; let b = push(a, 3); let c = push(a, 4); b",
+       std::vector<int>{1, 2, 3}},
+      {"let a = [1, 2]; let b = push(a, 3); let c = push(a, 4); c",
+       std::vector<int>{1, 2, 4}},
+      {"let a = rest([1, 2, 3]); let b = push(a, 4); a",
+       std::vector<int>{2, 3}},
+      {"let a = rest([1, 2, 3]); let b = push(a, 4); b",
+       std::vector<int>{2, 3, 4}},
+      {"rest(rest(rest([1, 2, 3])))", std::vector<int>{}},
+      {"let a = push(push([], 1), 2); let b = rest(a);"
+       "first(b) + last(a) + len(b) + a[0] + b[0]",
+       8},
+      {"let build = fn(a, n) {"
+       "if (n == 0) { a } else { build(push(a, n), n - 1) }"
+       "};"
+       "let sum = fn(a, acc) {"
+       "if (len(a) == 0) { acc } else { sum(rest(a), acc + first(a)) }"
+       "};"
+       "sum(build([], 500), 0)",
+       125250}};
 
   runVMTests(Tests);
 }
@@ -514,4 +683,230 @@ TEST(VMTests, testRecursiveFibonacci) {
   runVMTests(Tests);
 }
 
+TEST(VMTests, testKnownFunctionCalls) {
+  const std::vector<VMTestCase> Tests = {
+      // The callee's slot is made below arguments already on the stack.
+      {"let add = fn(a, b) { a + b }; 1 + add(2, 3)", 6},
+      {"let one = fn() { 1 }; [one(), one()]", std::vector<int>{1, 1}},
+      {"let f = fn(a) { a }; [1, f(2), f(f(3))][2]", 3},
+      {"let f = fn() { 1 }; let g = f; g() + f()", 2},
+      {"let f = fn() { 1 }; let f = fn() { 2 }; f()", 2}};
+
+  runVMTests(Tests);
+}
+
+TEST(VMTests, testLocalsDefinedInArguments) {
+  const std::vector<VMTestCase> Tests = {
+      {"let identity = fn(a) { let b = a * 2; let c = b; a };"
+       "let f = fn() {"
+       "let r = identity(if (true) { let y = 5; y } else { 0 });"
+       "r + y"
+       "};"
+       "f();",
+       10}};
+
+  runVMTests(Tests);
+}
+
+TEST(VMTests, testTailRecursiveLoops) {
+  const std::vector<VMTestCase> Tests = {
+      {"let sum = fn(n, acc) {"
+       "if (n == 0) { acc } else { sum(n - 1, acc + n) }"
+       "};"
+       "sum(100, 0);",
+       5050},
+      // Leaves the trace halfway through the loop and enters it again.
+      {"let f = fn(n, acc) {"
+       "if (n == 0) { acc } else {"
+       "if (n == 50) { f(n - 1, acc * 2) } else { f(n - 1, acc + 1) }"
+       "}"
+       "};"
+       "f(100, 0);",
+       149},
+      {"let loop = fn(i, flag, acc) {"
+       "let next = i - 1;"
+       "if (i > 0) {"
+       "loop(next, !flag, if (flag) { acc + i } else { acc })"
+       "} else { acc }"
+       "};"
+       "loop(10, true, 0);",
+       30},
+      // Parameters that can't be unboxed aren't traced.
+      {"let f = fn(x, n) { if (n == 0) { x } else { f(x, n - 1) } };"
+       "f(\"a\", 10);",
+       std::string("a")}};
+
+  runVMTests(Tests);
+}
+
+TEST(VMTests, testTailCallsDontUseFrames) {
+  // Far deeper than the frame limit. The register VM doesn't reuse frames.
+  const std::vector<VMTestCase> Tests = {
+      {"let count = fn(n) { if (n == 0) { 0 } else { count(n - 1) } };"
+       "count(100000);",
+       0},
+      {"let loop = fn(f, n) { if (n == 0) { \"done\" } else { f(f, n - 1) } };"
+       "loop(loop, 100000);",
+       std::string("done")},
+      {"let sum = fn(arr, i, acc) {"
+       "if (i == len(arr)) { return acc; }"
+       "let next = fn(x) { sum(arr, i + 1, acc + x) };"
+       "next(arr[i])"
+       "};"
+       "let build = fn(n, acc) {"
+       "if (n == 0) { acc } else { build(n - 1, push(acc, n)) }"
+       "};"
+       "sum(build(3000, []), 0, 0);",
+       4501500},
+      {"let last = fn(n) { if (n == 0) { len(\"abc\") } else { last(n - 1) } };"
+       "last(5000);",
+       3}};
+
+  for (const auto B : ALL_BACKENDS) {
+    if (B == Backend::REGISTER)
+      continue;
+
+    for (const auto &Test : Tests) {
+      auto Program = parse(Test.Input);
+
+      object::Ref<object::Object> Result;
+      ASSERT_NO_THROW(Result = run(*Program, B, DEFAULT_DISPATCH))
+          << Test.Input;
+      testExpectedObject(Test.Expected, Result.get());
+    }
+  }
+}
+
+#ifdef MONKEY_HAS_JIT
+TEST(VMTests, testTracedLoopsDontUseFrames) {
+  // Far deeper than the interpreter's frame limit.
+  auto Program = parse("let sum = fn(n, acc) {"
+                       "if (n == 0) { acc } else { sum(n - 1, acc + n) }"
+                       "};"
+                       "sum(50000, 0);");
+
+  object::Ref<object::Object> Result;
+  ASSERT_NO_THROW(Result = run(*Program, Backend::TRACE, DEFAULT_DISPATCH));
+  testIntegerObject(1250025000, Result.get());
+}
+#endif
+
+TEST(VMTests, testCollectingAtEveryCall) {
+  // Collect on every call so that anything the VMs forget to root is freed
+  // while still in use.
+  const auto Options = gc::heap().options();
+  const auto Collections = gc::heap().stats().Collections;
+  gc::heap().configure({0, 0, 0.0, 0});
+
+  runVMTests({{"let newAdder = fn(x) { fn(y) { x + y } };"
+               "let add = fn(a, b) { newAdder(a)(b) };"
+               "add(add(1, 2), add(3, 4));",
+               10},
+              {"let build = fn(n, acc) {"
+               "if (n == 0) { acc }"
+               "else { build(n - 1, push(acc, [n, \"s\"])) }"
+               "};"
+               "build(20, [])[4][0];",
+               16},
+              {"let h = {\"a\": [1, 2], \"b\": fn() { 3 }};"
+               "let g = fn() { h[\"b\"]() };"
+               "g() + h[\"a\"][1];",
+               5},
+              {"let fibonacci = fn(x) {"
+               "if (x < 2) { x } else { fibonacci(x - 1) + fibonacci(x - 2) }"
+               "};"
+               "fibonacci(10);",
+               55}});
+
+  ASSERT_GT(gc::heap().stats().Collections, Collections);
+  gc::heap().configure(Options);
+}
+
+TEST(VMTests, testResultsOutliveTheVM) {
+  auto Program = parse("let pair = fn(a) { [a, \"b\"] }; pair(1);");
+
+  for (const auto B : ALL_BACKENDS) {
+    const auto Result = run(*Program, B, DEFAULT_DISPATCH);
+    gc::heap().collect();
+    ASSERT_EQ(Result->inspect(), "[1, b]");
+  }
+}
+
+TEST(VMTests, testSuperInstructions) {
+  const std::vector<VMTestCase> Tests = {
+      {"let f = fn(a) { a - 1 }; f(5)", 4},
+      {"let f = fn(a) { a + 1 }; f(5)", 6},
+      {"let f = fn(a) { a + \"b\" }; f(\"a\")", std::string("ab")},
+      {"let f = fn(a) { if (a == 1) { 2 } else { 3 } }; f(1)", 2},
+      {"let f = fn(a) { if (a == 1) { 2 } else { 3 } }; f(4)", 3},
+      {"let f = fn(a) { if (a == 1) { 2 } else { 3 } }; f(true)", 3},
+      // Strings compare by identity and every literal is a string of its own.
+      {"let f = fn(a) { if (a == \"a\") { 2 } }; f(\"a\")", nullptr},
+      {"let f = fn(a) { if (a == \"a\") { 2 } }; f(\"b\")", nullptr}};
+
+  runVMTests(Tests);
+}
+
+TEST(VMTests, testOpCodeProfile) {
+  auto Program = parse("1 + 2");
+
+  compiler::SymbolTable ST;
+  std::vector<object::Value> Constants;
+  compiler::Compiler C(ST, Constants);
+  C.setFoldConstants(false);
+  ASSERT_NO_THROW(C.compile(Program.get()));
+
+  std::vector<object::Value> Globals;
+  OpCodeProfile Profile;
+  VM Machine(C.byteCode(), Globals);
+  Machine.setProfile(&Profile);
+  ASSERT_NO_THROW(Machine.run());
+
+  ASSERT_EQ(Profile.total(), 5u);
+  ASSERT_EQ(Profile.count(code::OpCode::OpConstant), 2u);
+  ASSERT_EQ(Profile.count(code::OpCode::OpConstant, code::OpCode::OpConstant),
+            1u);
+  ASSERT_EQ(Profile.count(code::OpCode::OpConstant, code::OpCode::OpAdd), 1u);
+  ASSERT_EQ(Profile.count(code::OpCode::OpAdd, code::OpCode::OpPop), 1u);
+  ASSERT_EQ(Profile.count(code::OpCode::OpPop, code::OpCode::OpHalt), 1u);
+  ASSERT_EQ(Profile.pairs().size(), 4u);
+}
+
+TEST(VMTests, testLargeConstantAndGlobalIndices) {
+  // Identifiers can't contain digits so spell the index out in letters.
+  const auto Name = [](int I) {
+    std::string N("g");
+    for (; I; I /= 26)
+      N += static_cast<char>('a' + I % 26);
+    return N;
+  };
+
+  // More constants and globals than fit into a two byte operand.
+  const int Count = 70000;
+  std::string Input;
+  for (int I = 0; I < Count; ++I)
+    Input += "let " + Name(I) + " = " + std::to_string(I) + ";";
+
+  Input += Name(Count - 1) + " - " + Name(1) + ";";
+
+  runVMTests({{Input, Count - 2}});
+}
+
+TEST(VMTests, testJumpsPastTwoByteOffsets) {
+  // Enough code that the jumps land beyond what fits into two bytes.
+  std::string Main("let x = 1;");
+  std::string Body;
+  for (int I = 0; I < 25000; ++I) {
+    Main += "x;";
+    Body += "a;";
+  }
+
+  runVMTests({{Main + "if (x) { 10 }", 10},
+              {Main + "if (x > 1) { 10 } else { 20 }", 20},
+              {"let f = fn(a) {" + Body +
+                   "if (a == 1) { 10 } else { 20 } };"
+                   "f(1) + f(2)",
+               30}});
+}
+
 } // namespace monkey::vm::test
@@ -1,11 +1,15 @@
 #include <Compiler/Compiler.h>
+#include <Compiler/RegisterCompiler.h>
+#include <Evaluator/ClosureCompiler.h>
 #include <Evaluator/Evaluator.h>
 #include <Lexer/Lexer.h>
 #include <Parser/Parser.h>
+#include <VM/RegisterVM.h>
 #include <VM/VM.h>
 
 #include <chrono>
 #include <iostream>
+#include <unordered_map>
 
 static const std::string Input("let fibonacci = fn(x) {"
                                "if (x == 0) {"
@@ -20,6 +24,445 @@ static const std::string Input("let fibonacci = fn(x) {"
                                "};"
                                "fibonacci(35);");
 
+// Sums the numbers up to 100 with a tail recursive loop 2^14 times.
+static const std::string LoopInput("let sum = fn(n, acc) {"
+                                   "if (n == 0) {"
+                                   "acc"
+                                   "} else {"
+                                   "sum(n - 1, acc + n)"
+                                   "}"
+                                   "};"
+                                   "let repeat = fn(depth) {"
+                                   "if (depth == 0) {"
+                                   "sum(100, 0)"
+                                   "} else {"
+                                   "repeat(depth - 1) + repeat(depth - 1)"
+                                   "}"
+                                   "};"
+                                   "repeat(14);");
+
+// Looks up record fields in a hash 2^10 times. Seven of the lookups use the
+// hash's own keys and one a string that was just built.
+static const std::string HashInput(
+    "let keys = [\"customer_name\", \"customer_email_address\","
+    "\"billing_street_address\", \"shipping_street_address\","
+    "\"order_total_in_cents\", \"preferred_payment_method\","
+    "\"loyalty_programme_number\", \"last_order_timestamp\"];"
+    "let h = {\"customer_name\": 1, \"customer_email_address\": 2,"
+    "\"billing_street_address\": 3, \"shipping_street_address\": 4,"
+    "\"order_total_in_cents\": 5, \"preferred_payment_method\": 6,"
+    "\"loyalty_programme_number\": 7, \"last_order_timestamp\": 8};"
+    "let sum = fn(i, acc) {"
+    "if (i == 0) {"
+    "acc"
+    "} else {"
+    "let k = keys[i - (i / 8) * 8];"
+    "sum(i - 1, acc + h[k] + h[k] + h[k] + h[k] + h[k] + h[k] + h[k] +"
+    "h[k + \"\"])"
+    "}"
+    "};"
+    "let repeat = fn(depth) {"
+    "if (depth == 0) {"
+    "sum(200, 0)"
+    "} else {"
+    "repeat(depth - 1) + repeat(depth - 1)"
+    "}"
+    "};"
+    "repeat(10);");
+
+// Builds a list of 20000 numbers with 'push' and sums it with 'rest', both
+// tail recursively.
+static const std::string ArrayInput(
+    "let build = fn(a, n) {"
+    "if (n == 0) {"
+    "a"
+    "} else {"
+    "build(push(a, n), n - 1)"
+    "}"
+    "};"
+    "let sum = fn(a, acc) {"
+    "if (len(a) == 0) {"
+    "acc"
+    "} else {"
+    "sum(rest(a), acc + first(a))"
+    "}"
+    "};"
+    "sum(build([], 20000), 0);");
+
+// Appends 100000 fragments to a string and then uses it as a hash key, which
+// needs all of its characters.
+static const std::string ConcatInput(
+    "let build = fn(s, n) {"
+    "if (n == 0) {"
+    "s"
+    "} else {"
+    "build(s + \"fragment \", n - 1)"
+    "}"
+    "};"
+    "let s = build(\"\", 100000);"
+    "{s: len(s)}[s];");
+
+// A script of 100000 lines that uses every kind of node, for timing the
+// passes over the syntax tree rather than the programs they produce.
+static std::string compileInput() {
+  std::string Script = "let x = 1;\n";
+  for (int I = 1; I < 100000; ++I) {
+    const auto N = std::to_string(I % 1000);
+    Script += "if (x < " + N + ") { -x * " + N + " + [x, \"a\"][0] } else { " +
+              "{\"k\": !x}[\"k\"] }; fn(y) { return y / x - " + N + "; }(x);\n";
+  }
+  return Script;
+}
+
+namespace ast = monkey::ast;
+
+// A value for every operator, so that the walks below can't skip looking at it.
+static int64_t operatorWeight(const std::string &Operator) {
+  if (Operator == "+")
+    return 1;
+  if (Operator == "-")
+    return 2;
+  if (Operator == "!")
+    return 3;
+  if (Operator == "*")
+    return 4;
+  if (Operator == "/")
+    return 5;
+  if (Operator == "<")
+    return 6;
+  if (Operator == ">")
+    return 7;
+  if (Operator == "==")
+    return 8;
+  if (Operator == "!=")
+    return 9;
+  return 0;
+}
+
+static int64_t operatorWeight(ast::OperatorType Op) {
+  switch (Op) {
+  case ast::OperatorType::PLUS:
+    return 1;
+  case ast::OperatorType::MINUS:
+    return 2;
+  case ast::OperatorType::BANG:
+    return 3;
+  case ast::OperatorType::ASTERISK:
+    return 4;
+  case ast::OperatorType::SLASH:
+    return 5;
+  case ast::OperatorType::LT:
+    return 6;
+  case ast::OperatorType::GT:
+    return 7;
+  case ast::OperatorType::EQ:
+    return 8;
+  case ast::OperatorType::NOT_EQ:
+    return 9;
+  default:
+    return 0;
+  }
+}
+
+// Visits every node of the tree the way the compiler and the evaluator used
+// to, trying one 'astCast' after another and comparing operator strings. The
+// result adds up the literals and operators so that nothing is optimised away.
+static int64_t walkWithCasts(const ast::Node *Node) {
+  int64_t Sum = 1;
+  if (const auto *Program = ast::astCast<const ast::Program *>(Node)) {
+    for (const auto &Statement : Program->Statements)
+      Sum += walkWithCasts(Statement.get());
+  } else if (const auto *ExprS =
+                 ast::astCast<const ast::ExpressionStatement *>(Node)) {
+    Sum += walkWithCasts(ExprS->Expr.get());
+  } else if (const auto *Infix =
+                 ast::astCast<const ast::InfixExpression *>(Node)) {
+    Sum += walkWithCasts(Infix->Left.get()) +
+           walkWithCasts(Infix->Right.get()) + operatorWeight(Infix->Operator);
+  } else if (const auto *Integer =
+                 ast::astCast<const ast::IntegerLiteral *>(Node)) {
+    Sum += Integer->Value;
+  } else if (const auto *Bool = ast::astCast<const ast::Boolean *>(Node)) {
+    Sum += Bool->Value;
+  } else if (const auto *Prefix =
+                 ast::astCast<const ast::PrefixExpression *>(Node)) {
+    Sum += walkWithCasts(Prefix->Right.get()) +
+           operatorWeight(Prefix->Operator);
+  } else if (const auto *If = ast::astCast<const ast::IfExpression *>(Node)) {
+    Sum += walkWithCasts(If->Condition.get()) +
+           walkWithCasts(If->Consequence.get()) +
+           walkWithCasts(If->Alternative.get());
+  } else if (const auto *Block =
+                 ast::astCast<const ast::BlockStatement *>(Node)) {
+    for (const auto &Statement : Block->Statements)
+      Sum += walkWithCasts(Statement.get());
+  } else if (const auto *Let = ast::astCast<const ast::LetStatement *>(Node)) {
+    Sum += walkWithCasts(Let->Value.get());
+  } else if (ast::astCast<const ast::Identifier *>(Node)) {
+    Sum += 2;
+  } else if (ast::astCast<const ast::String *>(Node)) {
+    Sum += 3;
+  } else if (const auto *Array =
+                 ast::astCast<const ast::ArrayLiteral *>(Node)) {
+    for (const auto &Elem : Array->Elements)
+      Sum += walkWithCasts(Elem.get());
+  } else if (const auto *Hash = ast::astCast<const ast::HashLiteral *>(Node)) {
+    for (const auto &P : Hash->Pairs)
+      Sum += walkWithCasts(P.first.get()) + walkWithCasts(P.second.get());
+  } else if (const auto *Index =
+                 ast::astCast<const ast::IndexExpression *>(Node)) {
+    Sum += walkWithCasts(Index->Left.get()) + walkWithCasts(Index->Index.get());
+  } else if (const auto *Function =
+                 ast::astCast<ast::FunctionLiteral *>(Node)) {
+    Sum += walkWithCasts(Function->Body.get());
+  } else if (const auto *Return =
+                 ast::astCast<const ast::ReturnStatement *>(Node)) {
+    Sum += walkWithCasts(Return->ReturnValue.get());
+  } else if (const auto *Call =
+                 ast::astCast<const ast::CallExpression *>(Node)) {
+    Sum += walkWithCasts(Call->Function.get());
+    for (const auto &Arg : Call->Arguments)
+      Sum += walkWithCasts(Arg.get());
+  }
+  return Sum;
+}
+
+// The same walk with a single 'switch' on the node's type and the operators
+// the parser resolved.
+static int64_t walkWithSwitch(const ast::Node *Node) {
+  if (!Node)
+    return 1;
+
+  int64_t Sum = 1;
+  switch (Node->type()) {
+  case ast::ASTType::PROGRAM_AST:
+    for (const auto &Statement :
+         static_cast<const ast::Program *>(Node)->Statements)
+      Sum += walkWithSwitch(Statement.get());
+    break;
+  case ast::ASTType::EXPR_STATEMENT_AST:
+    Sum += walkWithSwitch(
+        static_cast<const ast::ExpressionStatement *>(Node)->Expr.get());
+    break;
+  case ast::ASTType::INFIX_EXPR_AST: {
+    const auto *Infix = static_cast<const ast::InfixExpression *>(Node);
+    Sum += walkWithSwitch(Infix->Left.get()) +
+           walkWithSwitch(Infix->Right.get()) + operatorWeight(Infix->Op);
+    break;
+  }
+  case ast::ASTType::INTEGER_AST:
+    Sum += static_cast<const ast::IntegerLiteral *>(Node)->Value;
+    break;
+  case ast::ASTType::BOOLEAN_AST:
+    Sum += static_cast<const ast::Boolean *>(Node)->Value;
+    break;
+  case ast::ASTType::PREFIX_EXPR_AST: {
+    const auto *Prefix = static_cast<const ast::PrefixExpression *>(Node);
+    Sum += walkWithSwitch(Prefix->Right.get()) + operatorWeight(Prefix->Op);
+    break;
+  }
+  case ast::ASTType::IF_AST: {
+    const auto *If = static_cast<const ast::IfExpression *>(Node);
+    Sum += walkWithSwitch(If->Condition.get()) +
+           walkWithSwitch(If->Consequence.get()) +
+           walkWithSwitch(If->Alternative.get());
+    break;
+  }
+  case ast::ASTType::BLOCK_AST:
+    for (const auto &Statement :
+         static_cast<const ast::BlockStatement *>(Node)->Statements)
+      Sum += walkWithSwitch(Statement.get());
+    break;
+  case ast::ASTType::LET_AST:
+    Sum += walkWithSwitch(
+        static_cast<const ast::LetStatement *>(Node)->Value.get());
+    break;
+  case ast::ASTType::IDENTIFIER_AST:
+    Sum += 2;
+    break;
+  case ast::ASTType::STRING_AST:
+    Sum += 3;
+    break;
+  case ast::ASTType::ARRAY_AST:
+    for (const auto &Elem :
+         static_cast<const ast::ArrayLiteral *>(Node)->Elements)
+      Sum += walkWithSwitch(Elem.get());
+    break;
+  case ast::ASTType::HASH_AST:
+    for (const auto &P : static_cast<const ast::HashLiteral *>(Node)->Pairs)
+      Sum += walkWithSwitch(P.first.get()) + walkWithSwitch(P.second.get());
+    break;
+  case ast::ASTType::INDEX_AST: {
+    const auto *Index = static_cast<const ast::IndexExpression *>(Node);
+    Sum +=
+        walkWithSwitch(Index->Left.get()) + walkWithSwitch(Index->Index.get());
+    break;
+  }
+  case ast::ASTType::FUNCTION_AST:
+    Sum += walkWithSwitch(
+        static_cast<const ast::FunctionLiteral *>(Node)->Body.get());
+    break;
+  case ast::ASTType::RETURN_AST:
+    Sum += walkWithSwitch(
+        static_cast<const ast::ReturnStatement *>(Node)->ReturnValue.get());
+    break;
+  case ast::ASTType::CALL_AST: {
+    const auto *Call = static_cast<const ast::CallExpression *>(Node);
+    Sum += walkWithSwitch(Call->Function.get());
+    for (const auto &Arg : Call->Arguments)
+      Sum += walkWithSwitch(Arg.get());
+    break;
+  }
+  }
+  return Sum;
+}
+
+// The result is kept as a string since later runs may collect the object.
+struct BenchmarkResult {
+  std::string Result;
+  std::chrono::duration<double> Duration;
+};
+
+static BenchmarkResult runVM(const monkey::ast::Program &Program,
+                             monkey::vm::Dispatch D,
+                             monkey::vm::OpCodeProfile *Profile = nullptr,
+                             const monkey::vm::JITOptions &JIT = {}) {
+  monkey::compiler::SymbolTable ST;
+  std::vector<monkey::object::Value> Constants;
+  std::vector<monkey::object::Value> Globals;
+  monkey::compiler::Compiler C(ST, Constants);
+
+  try {
+    C.compile(&Program);
+  } catch (const std::runtime_error &E) {
+    std::cout << "compiler error: " << E.what() << "\n";
+  }
+
+  monkey::vm::VM Machine(C.byteCode(), Globals);
+  Machine.setProfile(Profile);
+  Machine.setJIT(JIT);
+  const auto Start = std::chrono::high_resolution_clock::now();
+
+  try {
+    Machine.run(D);
+  } catch (const std::runtime_error &E) {
+    std::cout << "vm error: " << E.what() << "\n";
+  }
+
+  const auto End = std::chrono::high_resolution_clock::now();
+  return {Machine.lastPoppedStackElem()->inspect(), End - Start};
+}
+
+// The table hashes used before 'object::HashMap', for comparison.
+struct HashKeyHasher {
+  size_t operator()(const monkey::object::HashKey &Key) const {
+    return Key.Key->hash();
+  }
+};
+using UnorderedPairMap = std::unordered_map<monkey::object::HashKey,
+                                            monkey::object::Object *,
+                                            HashKeyHasher>;
+
+// Nanoseconds per entry to build a map of the keys and to look up equal keys
+// that are different objects, averaged over enough rounds to do about 2^22 of
+// each.
+template <typename Map>
+static std::pair<double, double>
+timeHashMap(const std::vector<monkey::object::Object *> &Keys,
+            const std::vector<monkey::object::Object *> &Probes) {
+  const size_t Rounds = std::max<size_t>(1, (1 << 22) / Keys.size());
+  std::chrono::duration<double, std::nano> Build{}, Lookup{};
+  size_t Found = 0;
+
+  for (size_t R = 0; R < Rounds; ++R) {
+    const auto Start = std::chrono::high_resolution_clock::now();
+    Map M;
+    M.reserve(Keys.size());
+    for (auto *Key : Keys)
+      M[monkey::object::HashKey(Key)] = Key;
+    const auto Built = std::chrono::high_resolution_clock::now();
+    for (auto *Probe : Probes)
+      Found += M.find(monkey::object::HashKey(Probe)) != M.end();
+    const auto End = std::chrono::high_resolution_clock::now();
+
+    Build += Built - Start;
+    Lookup += End - Built;
+  }
+
+  if (Found != Rounds * Keys.size())
+    std::cerr << "lost keys\n";
+
+  const auto Ops = static_cast<double>(Rounds * Keys.size());
+  return {Build.count() / Ops, Lookup.count() / Ops};
+}
+
+// Nanoseconds per lookup of string keys in a hash with the record's fields.
+// The probes are equal to the keys but different objects, like keys that were
+// just built. The first number recomputes each probe's hash for every lookup,
+// as before strings kept it, and the second uses the hash the string keeps.
+static std::pair<double, double> timeStringLookups() {
+  const std::vector<std::string> Names = {
+      "customer_name",          "customer_email_address",
+      "billing_street_address", "shipping_street_address",
+      "order_total_in_cents",   "preferred_payment_method",
+      "loyalty_programme_number", "last_order_timestamp"};
+
+  monkey::object::HashMap M;
+  std::vector<monkey::object::String *> Probes;
+  for (const auto &Name : Names) {
+    auto *Key = monkey::object::makeString(Name);
+    M[monkey::object::HashKey(Key)] = Key;
+    Probes.push_back(monkey::object::makeString(Name));
+  }
+
+  const size_t Rounds = (1 << 22) / Probes.size();
+  auto time = [&](bool Cached) {
+    size_t Found = 0;
+    const auto Start = std::chrono::high_resolution_clock::now();
+    for (size_t R = 0; R < Rounds; ++R) {
+      for (auto *Probe : Probes) {
+        if (!Cached)
+          Probe->Hashed = false;
+        Found += M.find(monkey::object::HashKey(Probe)) != M.end();
+      }
+    }
+    const auto End = std::chrono::high_resolution_clock::now();
+
+    if (Found != Rounds * Probes.size())
+      std::cerr << "lost keys\n";
+    return std::chrono::duration<double, std::nano>(End - Start).count() /
+           static_cast<double>(Rounds * Probes.size());
+  };
+
+  const auto Uncached = time(false);
+  return {Uncached, time(true)};
+}
+
+static BenchmarkResult runRegisterVM(const monkey::ast::Program &Program) {
+  monkey::compiler::SymbolTable ST;
+  std::vector<monkey::object::Value> Constants;
+  std::vector<monkey::object::Value> Globals;
+  monkey::compiler::RegisterCompiler C(ST, Constants);
+
+  try {
+    C.compile(&Program);
+  } catch (const std::runtime_error &E) {
+    std::cout << "compiler error: " << E.what() << "\n";
+  }
+
+  monkey::vm::RegisterVM Machine(C.byteCode(), Globals);
+  const auto Start = std::chrono::high_resolution_clock::now();
+
+  try {
+    Machine.run();
+  } catch (const std::runtime_error &E) {
+    std::cout << "vm error: " << E.what() << "\n";
+  }
+
+  const auto End = std::chrono::high_resolution_clock::now();
+  return {Machine.result()->inspect(), End - Start};
+}
+
 int main(int argc, char **argv) {
   if (argc != 2) {
     std::cerr << "usage: ./benchmark [engine]\n";
@@ -32,49 +475,227 @@ int main(int argc, char **argv) {
   monkey::parser::Parser P(L);
   auto Program = P.parseProgram();
 
-  std::shared_ptr<monkey::object::Object> ResultPtr;
-  const monkey::object::Object *Result;
-  std::chrono::high_resolution_clock::time_point Start;
-  std::chrono::high_resolution_clock::time_point End;
+  BenchmarkResult Result;
 
   if (Engine == "vm") {
-    monkey::compiler::SymbolTable ST;
-    std::vector<std::shared_ptr<monkey::object::Object>> Constants;
-    std::array<std::shared_ptr<monkey::object::Object>, GLOBALS_SIZE> Globals;
-    monkey::compiler::Compiler C(ST, Constants);
+    Result = runVM(*Program, monkey::vm::DEFAULT_DISPATCH);
+  } else if (Engine == "jit") {
+    // Compile every function on its first call and describe the code for perf.
+    Result = runVM(*Program, monkey::vm::DEFAULT_DISPATCH, nullptr, {1, true});
+  } else if (Engine == "register") {
+    Result = runRegisterVM(*Program);
+  } else if (Engine == "eval") {
+    monkey::environment::Environment Env;
+    const auto Start = std::chrono::high_resolution_clock::now();
+
+    auto *Evaluated = monkey::evaluator::eval(Program.get(), &Env);
+
+    const auto End = std::chrono::high_resolution_clock::now();
+    Result.Result = Evaluated->inspect();
+    Result.Duration = End - Start;
+  } else if (Engine == "closures") {
+    // Compile the program to closures and run them. The time includes
+    // compiling.
+    monkey::environment::Environment Env;
+    const auto Start = std::chrono::high_resolution_clock::now();
 
-    try {
-      C.compile(Program.get());
-    } catch (const std::runtime_error &E) {
-      std::cout << "compiler error: " << E.what() << "\n";
+    auto *Evaluated = monkey::evaluator::evalClosures(Program.get(), &Env);
+
+    const auto End = std::chrono::high_resolution_clock::now();
+    Result.Result = Evaluated->inspect();
+    Result.Duration = End - Start;
+  } else if (Engine == "dispatch") {
+    // Compare the VM's dispatch engines against each other.
+    const auto Switch = runVM(*Program, monkey::vm::Dispatch::SWITCH);
+    const auto Threaded = runVM(*Program, monkey::vm::Dispatch::THREADED);
+
+    std::cout << "engine=vm-switch, result=" << Switch.Result
+              << ", duration=" << Switch.Duration.count() << "\n";
+    std::cout << "engine=vm-threaded, result=" << Threaded.Result
+              << ", duration=" << Threaded.Duration.count() << "\n";
+    std::cout << "speedup=" << Switch.Duration / Threaded.Duration << "\n";
+    return EXIT_SUCCESS;
+  } else if (Engine == "trace") {
+    // Compare the interpreter against the tracing JIT on a loop.
+    monkey::lexer::Lexer LoopL(LoopInput);
+    monkey::parser::Parser LoopP(LoopL);
+    auto LoopProgram = LoopP.parseProgram();
+
+    const auto Interpreted =
+        runVM(*LoopProgram, monkey::vm::DEFAULT_DISPATCH);
+    const auto Traced = runVM(*LoopProgram, monkey::vm::DEFAULT_DISPATCH,
+                              nullptr, {0, true, 10});
+
+    std::cout << "engine=vm, result=" << Interpreted.Result
+              << ", duration=" << Interpreted.Duration.count() << "\n";
+    std::cout << "engine=trace, result=" << Traced.Result
+              << ", duration=" << Traced.Duration.count() << "\n";
+    std::cout << "speedup=" << Interpreted.Duration / Traced.Duration << "\n";
+    return EXIT_SUCCESS;
+  } else if (Engine == "hash") {
+    // Time hash lookups in the VM and the evaluator.
+    monkey::lexer::Lexer HashL(HashInput);
+    monkey::parser::Parser HashP(HashL);
+    auto HashProgram = HashP.parseProgram();
+
+    const auto Interpreted = runVM(*HashProgram, monkey::vm::DEFAULT_DISPATCH);
+
+    monkey::environment::Environment Env;
+    const auto Start = std::chrono::high_resolution_clock::now();
+    auto *Evaluated = monkey::evaluator::eval(HashProgram.get(), &Env);
+    const auto End = std::chrono::high_resolution_clock::now();
+
+    std::cout << "engine=vm, result=" << Interpreted.Result
+              << ", duration=" << Interpreted.Duration.count() << "\n";
+    std::cout << "engine=eval, result=" << Evaluated->inspect() << ", duration="
+              << std::chrono::duration<double>(End - Start).count() << "\n";
+
+    // Compare a lookup that hashes the key again with one that doesn't.
+    const auto Lookups = timeStringLookups();
+    std::cout << "engine=hash-uncached, lookup=" << Lookups.first << "ns\n";
+    std::cout << "engine=hash-cached, lookup=" << Lookups.second << "ns\n";
+    std::cout << "speedup=" << Lookups.first / Lookups.second << "\n";
+    return EXIT_SUCCESS;
+  } else if (Engine == "array") {
+    // Time building up and taking apart a long list in the VM.
+    monkey::lexer::Lexer ArrayL(ArrayInput);
+    monkey::parser::Parser ArrayP(ArrayL);
+    auto ArrayProgram = ArrayP.parseProgram();
+
+    Result = runVM(*ArrayProgram, monkey::vm::DEFAULT_DISPATCH);
+  } else if (Engine == "concat") {
+    // Time building a long string piece by piece in the VM.
+    monkey::lexer::Lexer ConcatL(ConcatInput);
+    monkey::parser::Parser ConcatP(ConcatL);
+    auto ConcatProgram = ConcatP.parseProgram();
+
+    Result = runVM(*ConcatProgram, monkey::vm::DEFAULT_DISPATCH);
+  } else if (Engine == "hashmap") {
+    // Compare the hashes' table against 'std::unordered_map' with integer
+    // keys. Collections only happen in the VM, so the keys are safe here.
+    for (const size_t Size : {10, 1000, 1000000}) {
+      std::vector<monkey::object::Object *> Keys, Probes;
+      for (size_t I = 0; I < Size; ++I) {
+        const auto Value = static_cast<int64_t>(I * 7919 + 100000);
+        Keys.push_back(monkey::object::makeInteger(Value));
+        Probes.push_back(monkey::object::makeInteger(Value));
+      }
+
+      const auto Flat = timeHashMap<monkey::object::HashMap>(Keys, Probes);
+      const auto Unordered = timeHashMap<UnorderedPairMap>(Keys, Probes);
+      std::cout << "engine=hashmap, size=" << Size
+                << ", build=" << Flat.first << "ns, lookup=" << Flat.second
+                << "ns, unordered_map_build=" << Unordered.first
+                << "ns, unordered_map_lookup=" << Unordered.second << "ns\n";
     }
+    return EXIT_SUCCESS;
+  } else if (Engine == "gc") {
+    // Report how the collector copes with the evaluator's temporaries.
+    monkey::lexer::Lexer LoopL(LoopInput);
+    monkey::parser::Parser LoopP(LoopL);
+    auto LoopProgram = LoopP.parseProgram();
 
-    monkey::vm::VM Machine(C.byteCode(), Globals);
-    Start = std::chrono::high_resolution_clock::now();
+    monkey::environment::Environment Env;
+    auto *Evaluated = monkey::evaluator::eval(LoopProgram.get(), &Env);
 
-    try {
-      Machine.run();
-    } catch (const std::runtime_error &E) {
-      std::cout << "vm error: " << E.what() << "\n";
+    const auto &Heap = monkey::gc::heap();
+    const auto &Stats = Heap.stats();
+    std::cout << "engine=gc, result=" << Evaluated->inspect()
+              << ", collections=" << Stats.Collections
+              << ", minor=" << Stats.MinorCollections
+              << ", allocation_rate=" << Heap.allocationRate() / (1 << 20)
+              << "MiB/s, survival_rate=" << Stats.survivalRate()
+              << ", pause=" << Stats.PauseTime.count() / 1e6
+              << "ms, max_pause=" << Stats.MaxPauseTime.count() / 1e6
+              << "ms, small_integer_hit_rate="
+              << monkey::object::smallIntegerStats().hitRate() << "\n";
+    return EXIT_SUCCESS;
+  } else if (Engine == "constants") {
+    // Report the size of the constant pool with and without deduplication.
+    monkey::lexer::Lexer LoopL(LoopInput);
+    monkey::parser::Parser LoopP(LoopL);
+    auto LoopProgram = LoopP.parseProgram();
+
+    for (const auto *Prog : {Program.get(), LoopProgram.get()}) {
+      monkey::compiler::SymbolTable ST;
+      std::vector<monkey::object::Value> Constants;
+      monkey::compiler::Compiler C(ST, Constants);
+      C.compile(Prog);
+
+      std::cout << "engine=constants, before="
+                << C.constantPool().sizeWithoutDeduplication()
+                << ", after=" << Constants.size() << "\n";
     }
+    return EXIT_SUCCESS;
+  } else if (Engine == "compile") {
+    // Time parsing a long script, compiling it to bytecode and evaluating it.
+    // The compiler and the evaluator change the tree, so each gets its own.
+    const auto Script = compileInput();
+    auto parse = [&Script]() {
+      monkey::lexer::Lexer CompileL(Script);
+      monkey::parser::Parser CompileP(CompileL);
+      return CompileP.parseProgram();
+    };
 
-    End = std::chrono::high_resolution_clock::now();
-    Result = Machine.lastPoppedStackElem();
-  } else if (Engine == "eval") {
-    auto Env = std::make_shared<monkey::environment::Environment>();
-    Start = std::chrono::high_resolution_clock::now();
+    const auto Start = std::chrono::high_resolution_clock::now();
+    auto Compiled = parse();
+    const auto Parsed = std::chrono::high_resolution_clock::now();
+
+    monkey::compiler::SymbolTable ST;
+    std::vector<monkey::object::Value> Constants;
+    monkey::compiler::Compiler C(ST, Constants);
+    C.compile(Compiled.get());
+    const auto End = std::chrono::high_resolution_clock::now();
+
+    auto Evaluated = parse();
+    monkey::environment::Environment Env;
+    const auto EvalStart = std::chrono::high_resolution_clock::now();
+    auto *Value = monkey::evaluator::eval(Evaluated.get(), &Env);
+    const auto EvalEnd = std::chrono::high_resolution_clock::now();
+
+    std::cout << "engine=compile, result=" << Value->inspect() << ", parse="
+              << std::chrono::duration<double>(Parsed - Start).count()
+              << ", compile="
+              << std::chrono::duration<double>(End - Parsed).count()
+              << ", eval="
+              << std::chrono::duration<double>(EvalEnd - EvalStart).count()
+              << "\n";
 
-    ResultPtr = monkey::evaluator::eval(Program.get(), Env);
+    // Compare the two ways of dispatching on the nodes on their own, walking
+    // the whole tree ten times with each.
+    auto Walked = parse();
+    auto timeWalk = [&Walked](int64_t (*Walk)(const ast::Node *)) {
+      int64_t Sum = 0;
+      const auto WalkStart = std::chrono::high_resolution_clock::now();
+      for (int I = 0; I < 10; ++I)
+        Sum += Walk(Walked.get());
+      const auto WalkEnd = std::chrono::high_resolution_clock::now();
+      return std::make_pair(
+          Sum, std::chrono::duration<double>(WalkEnd - WalkStart));
+    };
 
-    End = std::chrono::high_resolution_clock::now();
-    Result = ResultPtr.get();
+    const auto Casts = timeWalk(walkWithCasts);
+    const auto Switched = timeWalk(walkWithSwitch);
+    std::cout << "engine=walk-casts, result=" << Casts.first
+              << ", duration=" << Casts.second.count() << "\n";
+    std::cout << "engine=walk-switch, result=" << Switched.first
+              << ", duration=" << Switched.second.count() << "\n";
+    std::cout << "speedup=" << Casts.second / Switched.second << "\n";
+    return EXIT_SUCCESS;
+  } else if (Engine == "profile") {
+    // Report the most frequently executed opcode pairs.
+    monkey::vm::OpCodeProfile Profile;
+    runVM(*Program, monkey::vm::DEFAULT_DISPATCH, &Profile);
+
+    std::cout << Profile.report(20);
+    return EXIT_SUCCESS;
   } else {
-    std::cerr << "engine type must be one of [vm, eval]\n";
+    std::cerr << "engine type must be one of [vm, jit, register, eval, "
+                 "closures, dispatch, trace, hash, array, concat, hashmap, gc, "
+                 "constants, compile, profile]\n";
     return -1;
   }
 
-  std::chrono::duration<double> Duration = End - Start;
-
-  std::cout << "engine=" << Engine << ", result=" << Result->inspect()
-            << ", duration=" << Duration.count() << "\n";
+  std::cout << "engine=" << Engine << ", result=" << Result.Result
+            << ", duration=" << Result.Duration.count() << "\n";
 }